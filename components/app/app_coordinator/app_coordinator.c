@@ -1,79 +1,391 @@
 #include "app_coordinator.h"
 #include "dht_reader.h"
+#include "dht_bus.h"
 #include "ota_update.h"
 #include "app_nvs.h"
+#include "sensor_history.h"
+#include "history_log.h"
+#include "json_writer.h"
+#include "snapshot_lock.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_random.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
 
 static const char *TAG = "app_coordinator";
 
 // Firmware version
 #define FIRMWARE_VERSION "1.0.0"
 
-// Cached sensor data
+// Per-task statistics need the trace facility and run-time stats
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define TASK_STATS_ENABLED 1
+#else
+#define TASK_STATS_ENABLED 0
+#endif
+
+// Run-time counter samples kept per task (one per second, covers the long window)
+#define TASK_STATS_SAMPLES (APP_COORDINATOR_CPU_LONG_WINDOW_S + 1)
+
+// Cached sensor data (written by sensor_monitor_task only)
 static app_coordinator_sensor_data_t cached_sensor_data = {0};
-static SemaphoreHandle_t sensor_mutex = NULL;
+static snapshot_lock_t sensor_snapshot = SNAPSHOT_LOCK_INIT;
 
-// Cached system info
+// Cached system info (written by system_monitor_task only)
 static app_coordinator_system_info_t cached_system_info = {0};
-static SemaphoreHandle_t system_mutex = NULL;
+static snapshot_lock_t system_snapshot = SNAPSHOT_LOCK_INIT;
+
+// Cached task statistics (written by system_monitor_task only)
+static app_coordinator_task_stats_t cached_task_stats = {0};
+static bool task_stats_valid = false;
+static snapshot_lock_t task_stats_snapshot = SNAPSHOT_LOCK_INIT;
+
+/**
+ * Double-buffered pre-rendered JSON
+ * The single writer renders into the back buffer without any lock, then
+ * flips front under the seqlock. A reader still copying the old front
+ * buffer sees the seq change and retries.
+ */
+typedef struct {
+    char buf[2][APP_COORDINATOR_JSON_MAX];
+    size_t len[2];
+    uint8_t front;
+    uint32_t version;
+    bool valid;
+    snapshot_lock_t lock;
+} json_cache_t;
 
-// DHT queue handle
-static QueueHandle_t dht_queue = NULL;
+static json_cache_t json_caches[APP_COORDINATOR_JSON_COUNT] = {
+    [0 ... APP_COORDINATOR_JSON_COUNT - 1] = { .lock = SNAPSHOT_LOCK_INIT },
+};
+
+// DHT sample bus subscription
+static dht_bus_subscriber_t *dht_subscriber = NULL;
 
 // System start time
 static uint64_t system_start_time = 0;
 
+/**
+ * Feed records from the flash log into the in-memory history
+ */
+static bool history_replay_cb(const history_log_record_t *records, size_t count, void *ctx)
+{
+    size_t *replayed = ctx;
+    for (size_t i = 0; i < count; i++) {
+        sensor_history_add(records[i].timestamp, records[i].temp / 10.0f, records[i].hum / 10.0f);
+    }
+    *replayed += count;
+    return true;
+}
+
+/**
+ * Restore history from the flash log
+ * The log covers about a day at the 2 s read interval, less than the hour
+ * tier holds, so it is replayed whole.
+ */
+static void history_replay(void)
+{
+    const int64_t start = esp_timer_get_time();
+    size_t replayed = 0;
+    
+    esp_err_t ret = history_log_read(0, UINT32_MAX, history_replay_cb, &replayed);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "History replay failed: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Replayed %zu history records in %lld ms",
+             replayed, (long long)((esp_timer_get_time() - start) / 1000));
+}
+
+/**
+ * Start rendering into the back buffer of a cache (writer only)
+ */
+static void json_cache_render_begin(app_coordinator_json_t which, json_writer_t *w)
+{
+    json_cache_t *cache = &json_caches[which];
+    json_writer_init(w, cache->buf[cache->front ^ 1], APP_COORDINATOR_JSON_MAX, NULL, NULL);
+}
+
+/**
+ * Publish the back buffer as the new version (writer only)
+ */
+static void json_cache_render_end(app_coordinator_json_t which, json_writer_t *w)
+{
+    if (json_writer_error(w) != ESP_OK) {
+        ESP_LOGE(TAG, "JSON response %d does not fit in %d bytes", which, APP_COORDINATOR_JSON_MAX);
+        return;
+    }
+    
+    json_cache_t *cache = &json_caches[which];
+    snapshot_write_begin(&cache->lock);
+    cache->front ^= 1;
+    cache->len[cache->front] = w->len;
+    cache->version++;
+    cache->valid = true;
+    snapshot_write_end(&cache->lock);
+}
+
+/**
+ * Render /dhtSensor.json
+ */
+static void render_sensor_json(const dht_data_t *data)
+{
+    char temp_str[32], humidity_str[32];
+    snprintf(temp_str, sizeof(temp_str), "%.1f°C", data->temperature);
+    snprintf(humidity_str, sizeof(humidity_str), "%.1f%%", data->humidity);
+    
+    json_writer_t w;
+    json_cache_render_begin(APP_COORDINATOR_JSON_SENSOR, &w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_string(&w, "temp", temp_str);
+    json_writer_string(&w, "humidity", humidity_str);
+    json_writer_object_end(&w);
+    json_cache_render_end(APP_COORDINATOR_JSON_SENSOR, &w);
+}
+
+/**
+ * Render /systemStatus.json
+ */
+static void render_system_json(const app_coordinator_system_info_t *info)
+{
+    json_writer_t w;
+    json_cache_render_begin(APP_COORDINATOR_JSON_SYSTEM, &w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_int(&w, "heap_free", info->heap_free);
+    json_writer_int(&w, "heap_min", info->heap_min);
+    json_writer_int(&w, "uptime_seconds", info->uptime_seconds);
+    json_writer_string(&w, "firmware_version", info->firmware_version);
+    json_writer_string(&w, "compile_date", info->compile_date);
+    json_writer_string(&w, "compile_time", info->compile_time);
+    json_writer_bool(&w, "wifi_sta_connected", info->wifi_sta_connected);
+    json_writer_int(&w, "wifi_ap_clients", info->wifi_ap_clients);
+    json_writer_object_end(&w);
+    json_cache_render_end(APP_COORDINATOR_JSON_SYSTEM, &w);
+}
+
 /**
  * Sensor monitoring task
- * Subscribes to DHT reader queue and caches latest readings
+ * Subscribes to the DHT sample bus and caches latest readings
  */
 static void sensor_monitor_task(void *pvParameters)
 {
-    dht_data_t dht_data;
+    dht_sample_t sample;
     
     ESP_LOGI(TAG, "Sensor monitor task started");
     
     while (1) {
-        if (xQueueReceive(dht_queue, &dht_data, portMAX_DELAY)) {
-            // Update cached sensor data (thread-safe)
-            if (xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-                cached_sensor_data.temperature = dht_data.temperature;
-                cached_sensor_data.humidity = dht_data.humidity;
-                cached_sensor_data.timestamp = time(NULL);
-                cached_sensor_data.valid = true;
-                xSemaphoreGive(sensor_mutex);
-                
-                ESP_LOGD(TAG, "Sensor data updated: %.1f°C, %.1f%%", 
-                         dht_data.temperature, dht_data.humidity);
+        if (dht_bus_receive(dht_subscriber, &sample, portMAX_DELAY) == ESP_OK) {
+            // The cached reading tracks the primary sensor
+            if (sample.data.sensor_id != 0) {
+                continue;
+            }
+            const dht_data_t dht_data = sample.data;
+            const time_t now = time(NULL);
+            
+            // Update cached sensor data (never waits on readers)
+            snapshot_write_begin(&sensor_snapshot);
+            cached_sensor_data.temperature = dht_data.temperature;
+            cached_sensor_data.humidity = dht_data.humidity;
+            cached_sensor_data.timestamp = now;
+            cached_sensor_data.valid = true;
+            snapshot_write_end(&sensor_snapshot);
+            
+            render_sensor_json(&dht_data);
+            
+            // History needs wall-clock time: skip samples taken before the clock is set
+            if (now >= HISTORY_LOG_MIN_TIMESTAMP) {
+                sensor_history_add(now, dht_data.temperature, dht_data.humidity);
+                history_log_append(now, dht_data.temperature, dht_data.humidity);
             }
+            
+            ESP_LOGD(TAG, "Sensor data updated: %.1f°C, %.1f%%", 
+                     dht_data.temperature, dht_data.humidity);
         }
     }
 }
 
+#if TASK_STATS_ENABLED
+/**
+ * Run-time counter history of one task
+ * Tasks are matched by task number, which is never reused.
+ */
+typedef struct {
+    bool used;
+    bool seen;                  // Present in the latest sample
+    UBaseType_t task_number;
+    uint32_t samples;           // Samples taken since the task was first seen
+    configRUN_TIME_COUNTER_TYPE runtime[TASK_STATS_SAMPLES];
+} task_runtime_t;
+
+// Only touched by system_monitor_task
+static task_runtime_t task_runtime[APP_COORDINATOR_MAX_TASKS];
+static configRUN_TIME_COUNTER_TYPE task_stats_time[TASK_STATS_SAMPLES];
+static uint32_t task_stats_taken = 0;
+static app_coordinator_task_stats_t task_stats_scratch;
+
+// uxTaskGetSystemState() buffer, only grown when the task count outgrows it
+static TaskStatus_t *task_status = NULL;
+static UBaseType_t task_status_capacity = 0;
+
+static task_runtime_t *task_runtime_get(UBaseType_t task_number)
+{
+    task_runtime_t *free_entry = NULL;
+    for (int i = 0; i < APP_COORDINATOR_MAX_TASKS; i++) {
+        if (task_runtime[i].used && task_runtime[i].task_number == task_number) {
+            return &task_runtime[i];
+        }
+        if (!task_runtime[i].used && free_entry == NULL) {
+            free_entry = &task_runtime[i];
+        }
+    }
+    if (free_entry != NULL) {
+        free_entry->used = true;
+        free_entry->task_number = task_number;
+        free_entry->samples = 0;
+    }
+    return free_entry;
+}
+
+/**
+ * CPU usage of a task over the last window samples, in percent of one core
+ * Tasks seen for less than the window are measured over their lifetime.
+ */
+static float task_cpu_percent(const task_runtime_t *entry, uint32_t window)
+{
+    if (window >= entry->samples) {
+        window = entry->samples - 1;
+    }
+    if (window == 0) {
+        return 0.0f;
+    }
+
+    const uint32_t now = (task_stats_taken - 1) % TASK_STATS_SAMPLES;
+    const uint32_t then = (task_stats_taken - 1 - window) % TASK_STATS_SAMPLES;
+    // Unsigned differences stay correct across counter wrap-around
+    const configRUN_TIME_COUNTER_TYPE elapsed = task_stats_time[now] - task_stats_time[then];
+    if (elapsed == 0) {
+        return 0.0f;
+    }
+    return (float)(entry->runtime[now] - entry->runtime[then]) * 100.0f / (float)elapsed;
+}
+
+/**
+ * Sample run-time counters and stack high-water marks of all tasks
+ */
+static void task_stats_sample(void)
+{
+    if (uxTaskGetNumberOfTasks() > task_status_capacity) {
+        // Room for a few tasks created between the two calls
+        const UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4;
+        TaskStatus_t *grown = realloc(task_status, capacity * sizeof(TaskStatus_t));
+        if (grown == NULL) {
+            return;
+        }
+        task_status = grown;
+        task_status_capacity = capacity;
+    }
+    TaskStatus_t *status = task_status;
+
+    configRUN_TIME_COUNTER_TYPE total_time;
+    UBaseType_t count = uxTaskGetSystemState(status, task_status_capacity, &total_time);
+    if (count == 0) {
+        return;
+    }
+
+    const uint32_t slot = task_stats_taken % TASK_STATS_SAMPLES;
+    task_stats_time[slot] = total_time;
+    task_stats_taken++;
+
+    for (int i = 0; i < APP_COORDINATOR_MAX_TASKS; i++) {
+        task_runtime[i].seen = false;
+    }
+
+    app_coordinator_task_stats_t *stats = &task_stats_scratch;
+    memset(stats, 0, sizeof(*stats));
+    stats->task_total = count;
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        task_runtime_t *entry = task_runtime_get(status[i].xTaskNumber);
+        if (entry == NULL) {
+            continue;
+        }
+        entry->runtime[slot] = status[i].ulRunTimeCounter;
+        entry->samples++;
+        entry->seen = true;
+
+        const float cpu_short = task_cpu_percent(entry, APP_COORDINATOR_CPU_SHORT_WINDOW_S);
+        const float cpu_long = task_cpu_percent(entry, APP_COORDINATOR_CPU_LONG_WINDOW_S);
+
+        for (int core = 0; core < configNUMBER_OF_CORES && core < APP_COORDINATOR_MAX_CORES; core++) {
+            if (status[i].xHandle == xTaskGetIdleTaskHandleForCore(core)) {
+                stats->idle_short[core] = cpu_short;
+                stats->idle_long[core] = cpu_long;
+            }
+        }
+
+        if (stats->task_count < APP_COORDINATOR_MAX_TASKS) {
+            app_coordinator_task_info_t *info = &stats->tasks[stats->task_count++];
+            strlcpy(info->name, status[i].pcTaskName, sizeof(info->name));
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+            info->core = (status[i].xCoreID == tskNO_AFFINITY) ? -1 : (int8_t)status[i].xCoreID;
+#else
+            info->core = -1;
+#endif
+            info->priority = (uint8_t)status[i].uxCurrentPriority;
+            info->cpu_short = cpu_short;
+            info->cpu_long = cpu_long;
+            info->stack_free_min = status[i].usStackHighWaterMark;
+        }
+    }
+
+    // Forget deleted tasks
+    for (int i = 0; i < APP_COORDINATOR_MAX_TASKS; i++) {
+        if (!task_runtime[i].seen) {
+            task_runtime[i].used = false;
+        }
+    }
+
+    snapshot_write_begin(&task_stats_snapshot);
+    cached_task_stats = *stats;
+    task_stats_valid = true;
+    snapshot_write_end(&task_stats_snapshot);
+}
+#endif // TASK_STATS_ENABLED
+
 /**
  * System monitoring task
- * Tracks heap, uptime, and other system metrics
+ * Tracks heap, uptime, per-task CPU usage and stack high-water marks
  */
 static void system_monitor_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "System monitor task started");
     
     while (1) {
-        // Update system info (thread-safe)
-        if (xSemaphoreTake(system_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-            cached_system_info.heap_free = esp_get_free_heap_size();
-            cached_system_info.heap_min = esp_get_minimum_free_heap_size();
-            cached_system_info.uptime_seconds = (esp_timer_get_time() - system_start_time) / 1000000;
-            cached_system_info.firmware_version = FIRMWARE_VERSION;
-            cached_system_info.compile_date = __DATE__;
-            cached_system_info.compile_time = __TIME__;
-            // WiFi status will be updated by app_wifi
-            xSemaphoreGive(system_mutex);
-        }
+        // Sample outside the critical section, then publish (never waits on readers)
+        const size_t heap_free = esp_get_free_heap_size();
+        const size_t heap_min = esp_get_minimum_free_heap_size();
+        const uint32_t uptime_seconds = (esp_timer_get_time() - system_start_time) / 1000000;
+        
+        snapshot_write_begin(&system_snapshot);
+        cached_system_info.heap_free = heap_free;
+        cached_system_info.heap_min = heap_min;
+        cached_system_info.uptime_seconds = uptime_seconds;
+        cached_system_info.firmware_version = FIRMWARE_VERSION;
+        cached_system_info.compile_date = __DATE__;
+        cached_system_info.compile_time = __TIME__;
+        // WiFi status will be updated by app_wifi
+        const app_coordinator_system_info_t info = cached_system_info;
+        snapshot_write_end(&system_snapshot);
+        
+        render_system_json(&info);
+        
+#if TASK_STATS_ENABLED
+        task_stats_sample();
+#endif
         
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
@@ -86,23 +398,25 @@ esp_err_t app_coordinator_start(void)
     // Record system start time
     system_start_time = esp_timer_get_time();
     
-    // Initialize DHT reader and get queue handle
-    dht_queue = dht_init();
-    if (dht_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to initialize DHT reader");
-        return ESP_FAIL;
+    // History is optional: without it only the latest reading is available
+    if (sensor_history_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Sensor history unavailable");
+    } else if (history_log_init() != ESP_OK) {
+        ESP_LOGW(TAG, "History log unavailable, history will not survive a restart");
+    } else {
+        history_replay();
     }
     
-    // Create mutexes for thread-safe access
-    sensor_mutex = xSemaphoreCreateMutex();
-    if (sensor_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create sensor mutex");
+    // Subscribe before starting the reader so no sample is missed
+    dht_subscriber = dht_bus_subscribe();
+    if (dht_subscriber == NULL) {
+        ESP_LOGE(TAG, "Failed to subscribe to DHT samples");
         return ESP_FAIL;
     }
     
-    system_mutex = xSemaphoreCreateMutex();
-    if (system_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create system mutex");
+    // Initialize DHT reader
+    if (dht_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize DHT reader");
         return ESP_FAIL;
     }
     
@@ -111,6 +425,12 @@ esp_err_t app_coordinator_start(void)
     cached_system_info.compile_date = __DATE__;
     cached_system_info.compile_time = __TIME__;
     
+    // Versions start at random so ETags from before a restart never match
+    for (int i = 0; i < APP_COORDINATOR_JSON_COUNT; i++) {
+        json_caches[i].version = esp_random();
+    }
+    render_system_json(&cached_system_info);
+    
     // Create sensor monitoring task
     BaseType_t ret = xTaskCreate(
         sensor_monitor_task,
@@ -130,7 +450,7 @@ esp_err_t app_coordinator_start(void)
     ret = xTaskCreate(
         system_monitor_task,
         "system_mon",
-        2048,
+        3072,
         NULL,
         5,
         NULL
@@ -151,13 +471,13 @@ esp_err_t app_coordinator_get_sensor_data(app_coordinator_sensor_data_t *data)
         return ESP_ERR_INVALID_ARG;
     }
     
-    if (xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+    uint32_t seq;
+    do {
+        seq = snapshot_read_begin(&sensor_snapshot);
         *data = cached_sensor_data;
-        xSemaphoreGive(sensor_mutex);
-        return cached_sensor_data.valid ? ESP_OK : ESP_ERR_NOT_FOUND;
-    }
+    } while (snapshot_read_retry(&sensor_snapshot, seq));
     
-    return ESP_ERR_TIMEOUT;
+    return data->valid ? ESP_OK : ESP_ERR_NOT_FOUND;
 }
 
 esp_err_t app_coordinator_get_system_info(app_coordinator_system_info_t *info)
@@ -166,13 +486,70 @@ esp_err_t app_coordinator_get_system_info(app_coordinator_system_info_t *info)
         return ESP_ERR_INVALID_ARG;
     }
     
-    if (xSemaphoreTake(system_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+    uint32_t seq;
+    do {
+        seq = snapshot_read_begin(&system_snapshot);
         *info = cached_system_info;
-        xSemaphoreGive(system_mutex);
-        return ESP_OK;
+    } while (snapshot_read_retry(&system_snapshot, seq));
+    
+    return ESP_OK;
+}
+
+esp_err_t app_coordinator_get_task_stats(app_coordinator_task_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
     }
     
-    return ESP_ERR_TIMEOUT;
+#if TASK_STATS_ENABLED
+    bool valid;
+    uint32_t seq;
+    do {
+        seq = snapshot_read_begin(&task_stats_snapshot);
+        *stats = cached_task_stats;
+        valid = task_stats_valid;
+    } while (snapshot_read_retry(&task_stats_snapshot, seq));
+    
+    return valid ? ESP_OK : ESP_ERR_NOT_FOUND;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t app_coordinator_get_json(app_coordinator_json_t which, char *buf, size_t size,
+                                   size_t *len, uint32_t *version)
+{
+    if (which >= APP_COORDINATOR_JSON_COUNT || buf == NULL || len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    json_cache_t *cache = &json_caches[which];
+    bool valid;
+    uint32_t cache_version;
+    size_t cache_len;
+    uint32_t seq;
+    do {
+        seq = snapshot_read_begin(&cache->lock);
+        valid = cache->valid;
+        cache_version = cache->version;
+        cache_len = cache->len[cache->front];
+        if (valid && cache_len <= size) {
+            memcpy(buf, cache->buf[cache->front], cache_len);
+        }
+    } while (snapshot_read_retry(&cache->lock, seq));
+    
+    if (!valid) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (cache_len > size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    *len = cache_len;
+    if (version != NULL) {
+        *version = cache_version;
+    }
+    return ESP_OK;
 }
 
 esp_err_t app_coordinator_trigger_ota(const uint8_t *data, size_t size)
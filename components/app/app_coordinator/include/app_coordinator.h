@@ -30,6 +30,43 @@ typedef struct {
     uint8_t wifi_ap_clients;
 } app_coordinator_system_info_t;
 
+// Maximum number of tasks reported in task statistics
+#define APP_COORDINATOR_MAX_TASKS 24
+
+// Task name length including terminator (matches configMAX_TASK_NAME_LEN)
+#define APP_COORDINATOR_TASK_NAME_LEN 16
+
+// Number of cores reported in task statistics
+#define APP_COORDINATOR_MAX_CORES 2
+
+// CPU usage windows in seconds
+#define APP_COORDINATOR_CPU_SHORT_WINDOW_S 1
+#define APP_COORDINATOR_CPU_LONG_WINDOW_S 10
+
+/**
+ * Per-task statistics
+ * CPU usage is in percent of one core over the short and long windows.
+ */
+typedef struct {
+    char name[APP_COORDINATOR_TASK_NAME_LEN];
+    int8_t core;                // Pinned core, -1 if the task can run on any core
+    uint8_t priority;
+    float cpu_short;
+    float cpu_long;
+    uint32_t stack_free_min;    // Stack high-water mark: least free stack ever, in bytes
+} app_coordinator_task_info_t;
+
+/**
+ * Task statistics snapshot, refreshed once per second
+ */
+typedef struct {
+    uint32_t task_count;        // Entries used in tasks
+    uint32_t task_total;        // Tasks in the system (may exceed APP_COORDINATOR_MAX_TASKS)
+    float idle_short[APP_COORDINATOR_MAX_CORES];   // Idle time per core in percent
+    float idle_long[APP_COORDINATOR_MAX_CORES];
+    app_coordinator_task_info_t tasks[APP_COORDINATOR_MAX_TASKS];
+} app_coordinator_task_stats_t;
+
 /**
  * OTA status structure
  */
@@ -48,7 +85,7 @@ typedef struct {
 esp_err_t app_coordinator_start(void);
 
 /**
- * Get latest sensor reading (thread-safe)
+ * Get latest sensor reading (thread-safe, never blocks)
  * 
  * @param data Pointer to sensor data structure
  * @return ESP_OK on success, ESP_ERR_INVALID_ARG if data is NULL,
@@ -57,13 +94,54 @@ esp_err_t app_coordinator_start(void);
 esp_err_t app_coordinator_get_sensor_data(app_coordinator_sensor_data_t *data);
 
 /**
- * Get system status information
+ * Get system status information (thread-safe, never blocks)
  * 
  * @param info Pointer to system info structure
  * @return ESP_OK on success, ESP_ERR_INVALID_ARG if info is NULL
  */
 esp_err_t app_coordinator_get_system_info(app_coordinator_system_info_t *info);
 
+/**
+ * Get per-task CPU and stack statistics (thread-safe, never blocks)
+ * Needs FreeRTOS trace facility and run-time stats (see sdkconfig.defaults).
+ * 
+ * @param stats Pointer to task statistics structure
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL,
+ *         ESP_ERR_NOT_SUPPORTED if run-time stats are disabled,
+ *         ESP_ERR_NOT_FOUND before the first sample
+ */
+esp_err_t app_coordinator_get_task_stats(app_coordinator_task_stats_t *stats);
+
+// Size of one pre-rendered JSON response
+#define APP_COORDINATOR_JSON_MAX 256
+
+/**
+ * Pre-rendered JSON responses
+ */
+typedef enum {
+    APP_COORDINATOR_JSON_SENSOR,    // /dhtSensor.json, rendered on every new sample
+    APP_COORDINATOR_JSON_SYSTEM,    // /systemStatus.json, rendered every second
+    APP_COORDINATOR_JSON_COUNT
+} app_coordinator_json_t;
+
+/**
+ * Get a pre-rendered JSON response (thread-safe, never blocks)
+ * The coordinator renders each response once per update into a double
+ * buffer, so readers only copy bytes. The version changes with every
+ * update and starts at a random value on boot, so it can serve as an ETag.
+ * 
+ * @param which Response to get
+ * @param buf Buffer receiving the JSON (not NUL-terminated)
+ * @param size Size of buf, APP_COORDINATOR_JSON_MAX always fits
+ * @param len Receives the JSON length
+ * @param version Receives the version of the data, may be NULL
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on bad arguments,
+ *         ESP_ERR_NOT_FOUND if nothing was rendered yet (no sensor reading),
+ *         ESP_ERR_INVALID_SIZE if buf is too small
+ */
+esp_err_t app_coordinator_get_json(app_coordinator_json_t which, char *buf, size_t size,
+                                   size_t *len, uint32_t *version);
+
 /**
  * Trigger OTA firmware update
  * 
@@ -0,0 +1,53 @@
+#ifndef SNAPSHOT_LOCK_H
+#define SNAPSHOT_LOCK_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Seqlock guarding a cached snapshot
+ * The single writer makes seq odd while it updates the snapshot and even
+ * again when done; readers copy the snapshot and retry if seq was odd or
+ * changed meanwhile. The update runs in a critical section, so readers on
+ * the writer's core never see an odd seq and readers on the other core
+ * spin for at most one struct copy. Readers never block the writer.
+ */
+typedef struct {
+    atomic_uint_least32_t seq;
+    portMUX_TYPE lock;
+} snapshot_lock_t;
+
+#define SNAPSHOT_LOCK_INIT { .seq = 0, .lock = portMUX_INITIALIZER_UNLOCKED }
+
+static inline void snapshot_write_begin(snapshot_lock_t *snapshot)
+{
+    taskENTER_CRITICAL(&snapshot->lock);
+    atomic_fetch_add_explicit(&snapshot->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void snapshot_write_end(snapshot_lock_t *snapshot)
+{
+    atomic_fetch_add_explicit(&snapshot->seq, 1, memory_order_release);
+    taskEXIT_CRITICAL(&snapshot->lock);
+}
+
+static inline uint32_t snapshot_read_begin(snapshot_lock_t *snapshot)
+{
+    uint32_t seq;
+    while ((seq = atomic_load_explicit(&snapshot->seq, memory_order_acquire)) & 1) {
+        // Writer is mid-update on the other core
+    }
+    return seq;
+}
+
+static inline bool snapshot_read_retry(snapshot_lock_t *snapshot, uint32_t seq)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&snapshot->seq, memory_order_relaxed) != seq;
+}
+
+#endif // SNAPSHOT_LOCK_H
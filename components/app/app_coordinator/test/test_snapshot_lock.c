@@ -0,0 +1,217 @@
+/**
+ * Host stress benchmark of the coordinator snapshot lock
+ * Reader threads copy a cached snapshot while a writer keeps updating it,
+ * first under a mutex (how the getters used to work) and then under the
+ * seqlock. Every copy must be consistent; the read latency percentiles of
+ * both are reported, along with the writer's, which readers must not hold
+ * up under the seqlock.
+ */
+#include "snapshot_lock.h"
+#include "app_coordinator.h"
+#include "host_test.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READERS 4
+#define READS_PER_READER 200000
+#define WRITE_PAUSE_NS 20000
+// A pre-rendered JSON buffer, the largest snapshot readers copy
+#define SNAPSHOT_WORDS (APP_COORDINATOR_JSON_MAX / sizeof(uint32_t))
+#define MAX_WRITES (4 * 1024 * 1024)
+
+typedef struct {
+    uint32_t words[SNAPSHOT_WORDS];
+} snapshot_t;
+
+typedef struct {
+    const char *name;
+    void (*read)(snapshot_t *out);
+    void (*write)(uint32_t value);
+} scheme_t;
+
+static snapshot_t shared;
+
+static pthread_mutex_t shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+static snapshot_lock_t shared_lock = SNAPSHOT_LOCK_INIT;
+
+static void fill(snapshot_t *snapshot, uint32_t value)
+{
+    for (size_t i = 0; i < SNAPSHOT_WORDS; i++) {
+        snapshot->words[i] = value;
+    }
+}
+
+static void mutex_read(snapshot_t *out)
+{
+    pthread_mutex_lock(&shared_mutex);
+    *out = shared;
+    pthread_mutex_unlock(&shared_mutex);
+}
+
+static void mutex_write(uint32_t value)
+{
+    pthread_mutex_lock(&shared_mutex);
+    fill(&shared, value);
+    pthread_mutex_unlock(&shared_mutex);
+}
+
+static void seqlock_read(snapshot_t *out)
+{
+    uint32_t seq;
+    do {
+        seq = snapshot_read_begin(&shared_lock);
+        *out = shared;
+    } while (snapshot_read_retry(&shared_lock, seq));
+}
+
+static void seqlock_write(uint32_t value)
+{
+    snapshot_write_begin(&shared_lock);
+    fill(&shared, value);
+    snapshot_write_end(&shared_lock);
+}
+
+typedef struct {
+    const scheme_t *scheme;
+    pthread_barrier_t *start;
+    uint32_t *latency_ns;
+    size_t count;
+    size_t torn;
+} worker_t;
+
+static atomic_bool readers_done;
+
+static void *reader_main(void *arg)
+{
+    worker_t *reader = arg;
+    snapshot_t copy;
+
+    pthread_barrier_wait(reader->start);
+    for (size_t i = 0; i < READS_PER_READER; i++) {
+        uint64_t start = host_test_now_ns();
+        reader->scheme->read(&copy);
+        reader->latency_ns[i] = (uint32_t)(host_test_now_ns() - start);
+
+        for (size_t w = 1; w < SNAPSHOT_WORDS; w++) {
+            if (copy.words[w] != copy.words[0]) {
+                reader->torn++;
+                break;
+            }
+        }
+    }
+    reader->count = READS_PER_READER;
+    return NULL;
+}
+
+static void *writer_main(void *arg)
+{
+    worker_t *writer = arg;
+    const struct timespec pause = { .tv_nsec = WRITE_PAUSE_NS };
+    uint32_t value = 0;
+
+    pthread_barrier_wait(writer->start);
+    while (!atomic_load(&readers_done) && writer->count < MAX_WRITES) {
+        uint64_t start = host_test_now_ns();
+        writer->scheme->write(++value);
+        writer->latency_ns[writer->count++] = (uint32_t)(host_test_now_ns() - start);
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_percentiles(const char *name, const char *who, uint32_t *latency_ns, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    qsort(latency_ns, count, sizeof(latency_ns[0]), compare_u32);
+    printf("  %-8s %-7s %8zu ops  p50 %6u ns  p99 %6u ns  p99.9 %7u ns  max %8u ns\n", name, who, count,
+           latency_ns[count / 2], latency_ns[count * 99 / 100], latency_ns[count * 999 / 1000],
+           latency_ns[count - 1]);
+}
+
+static void stress(const scheme_t *scheme)
+{
+    pthread_t threads[READERS + 1];
+    worker_t workers[READERS + 1];
+    pthread_barrier_t start;
+    uint32_t *read_latency = malloc(sizeof(uint32_t) * READERS * READS_PER_READER);
+    uint32_t *write_latency = malloc(sizeof(uint32_t) * MAX_WRITES);
+    CHECK(read_latency != NULL && write_latency != NULL);
+    if (read_latency == NULL || write_latency == NULL) {
+        free(read_latency);
+        free(write_latency);
+        return;
+    }
+
+    fill(&shared, 0);
+    atomic_store(&readers_done, false);
+    pthread_barrier_init(&start, NULL, READERS + 1);
+    for (int i = 0; i <= READERS; i++) {
+        workers[i] = (worker_t){
+            .scheme = scheme,
+            .start = &start,
+            .latency_ns = (i < READERS) ? &read_latency[i * READS_PER_READER] : write_latency,
+        };
+        pthread_create(&threads[i], NULL, (i < READERS) ? reader_main : writer_main, &workers[i]);
+    }
+
+    size_t torn = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(threads[i], NULL);
+        torn += workers[i].torn;
+    }
+    atomic_store(&readers_done, true);
+    pthread_join(threads[READERS], NULL);
+    pthread_barrier_destroy(&start);
+
+    // Readers must only ever see whole snapshots
+    CHECK(torn == 0);
+    CHECK(workers[READERS].count > 0);
+
+    print_percentiles(scheme->name, "read", read_latency, (size_t)READERS * READS_PER_READER);
+    print_percentiles(scheme->name, "write", write_latency, workers[READERS].count);
+    free(read_latency);
+    free(write_latency);
+}
+
+static void test_seqlock_single_thread(void)
+{
+    snapshot_t copy;
+
+    seqlock_write(7);
+    CHECK(atomic_load(&shared_lock.seq) % 2 == 0);
+    seqlock_read(&copy);
+    CHECK(copy.words[0] == 7 && copy.words[SNAPSHOT_WORDS - 1] == 7);
+
+    // A reader that overlaps a write has to retry
+    uint32_t seq = snapshot_read_begin(&shared_lock);
+    seqlock_write(8);
+    CHECK(snapshot_read_retry(&shared_lock, seq));
+    seq = snapshot_read_begin(&shared_lock);
+    CHECK(!snapshot_read_retry(&shared_lock, seq));
+}
+
+int main(void)
+{
+    static const scheme_t schemes[] = {
+        { .name = "mutex", .read = mutex_read, .write = mutex_write },
+        { .name = "seqlock", .read = seqlock_read, .write = seqlock_write },
+    };
+
+    test_seqlock_single_thread();
+
+    printf("%d readers, writer every %d us, %zu byte snapshot:\n", READERS, WRITE_PAUSE_NS / 1000,
+           sizeof(snapshot_t));
+    for (size_t i = 0; i < sizeof(schemes) / sizeof(schemes[0]); i++) {
+        stress(&schemes[i]);
+    }
+    return host_test_result("snapshot_lock");
+}
@@ -8,6 +8,8 @@
 #include "lwip/sockets.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
 #include "tasks.h"
 #include "app_nvs.h"
 #include "http_server.h"
@@ -33,9 +35,27 @@ static wifi_config_t wifi_config = {0};
 // Retry counter for STA connection
 static int g_retry_number = 0;
 
+// Connection retries since boot
+static uint32_t g_retry_total = 0;
+
 // Connection status tracking
 static wifi_app_connection_status_e connection_status = WIFI_STATUS_DISCONNECTED;
 
+// Scan state: results of the latest completed scan (guarded by scan_mutex)
+static SemaphoreHandle_t scan_mutex = NULL;
+static wifi_app_scan_results_t scan_results = {0};
+static int64_t scan_done_time_us = 0;
+static bool scan_valid = false;
+static bool scan_running = false;
+static wifi_scan_done_callback_t wifi_scan_done_cb = NULL;
+
+// Raw records of the last scan and sliced scan progress (WiFi task only)
+static wifi_ap_record_t scan_records[WIFI_APP_SCAN_MAX_RESULTS];
+static bool scan_sliced = false;
+static uint8_t scan_channel = 0;
+static uint8_t scan_last_channel = 0;
+static esp_timer_handle_t scan_home_timer = NULL;
+
 // STA credentials storage
 static char sta_ssid[MAX_SSID_LENGTH + 1] = {0};
 static char sta_password[MAX_PASSWORD_LENGTH + 1] = {0};
@@ -69,6 +89,11 @@ static void wifi_app_event_handler(void *arg, esp_event_base_t event_base, int32
             break;
         }
 
+        case WIFI_EVENT_SCAN_DONE:
+            // Results are collected on the WiFi task, not in the event loop
+            wifi_app_send_message(WIFI_APP_MSG_SCAN_DONE);
+            break;
+
         case WIFI_EVENT_STA_START:
             ESP_LOGI(TAG, "Station mode started");
             connection_status = WIFI_STATUS_CONNECTING;
@@ -88,6 +113,7 @@ static void wifi_app_event_handler(void *arg, esp_event_base_t event_base, int32
             {
                 esp_wifi_connect();
                 g_retry_number++;
+                g_retry_total++;
                 connection_status = WIFI_STATUS_CONNECTING;
                 ESP_LOGI(TAG, "Retrying connection... (%d/%d)", g_retry_number, MAX_CONNECTION_RETRIES);
             }
@@ -233,6 +259,177 @@ static void wifi_app_connect_sta(void)
     ESP_ERROR_CHECK(esp_wifi_connect());
 }
 
+/**
+ * Ends a scan and notifies the callback
+ */
+static void wifi_app_scan_finish(esp_err_t result)
+{
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    scan_running = false;
+    xSemaphoreGive(scan_mutex);
+
+    if (wifi_scan_done_cb)
+    {
+        wifi_scan_done_cb(result);
+    }
+}
+
+/**
+ * Starts a non-blocking scan of one channel (0 = all), WIFI_EVENT_SCAN_DONE reports the end
+ */
+static void wifi_app_scan_channel(uint8_t channel, uint32_t dwell_ms)
+{
+    wifi_scan_config_t scan_config = {
+        .ssid = NULL,
+        .bssid = NULL,
+        .channel = channel,
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time = {
+            .active = {
+                .min = dwell_ms / 2,
+                .max = dwell_ms
+            }
+        }
+    };
+
+    esp_err_t ret = esp_wifi_scan_start(&scan_config, false);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "WiFi scan failed: %s", esp_err_to_name(ret));
+        wifi_app_scan_finish(ret);
+    }
+}
+
+/**
+ * Starts a scan
+ * With AP clients connected the channels are scanned one at a time (see
+ * WIFI_APP_SCAN_SLICED), otherwise in one go.
+ */
+static void wifi_app_scan_start(void)
+{
+    wifi_sta_list_t stations;
+    scan_sliced = WIFI_APP_SCAN_SLICED &&
+                  esp_wifi_ap_get_sta_list(&stations) == ESP_OK && stations.num > 0;
+
+    if (!scan_sliced)
+    {
+        ESP_LOGI(TAG, "Starting WiFi scan");
+        wifi_app_scan_channel(0, 300);
+        return;
+    }
+
+    wifi_country_t country;
+    if (esp_wifi_get_country(&country) == ESP_OK && country.nchan > 0)
+    {
+        scan_channel = country.schan;
+        scan_last_channel = country.schan + country.nchan - 1;
+    }
+    else
+    {
+        scan_channel = 1;
+        scan_last_channel = 11;
+    }
+
+    ESP_LOGI(TAG, "Starting sliced WiFi scan, channels %d-%d", scan_channel, scan_last_channel);
+    wifi_app_scan_channel(scan_channel, WIFI_APP_SCAN_DWELL_MS);
+}
+
+/**
+ * Home timer callback: time to visit the next channel
+ */
+static void wifi_app_scan_home_timer_cb(void *arg)
+{
+    wifi_app_send_message(WIFI_APP_MSG_SCAN_NEXT_CHANNEL);
+}
+
+/**
+ * Merges scan records into the cache (scan_mutex held)
+ * Networks the previous scan found on the scanned channel (or on any
+ * channel for a full scan) are replaced; the cache stays sorted by RSSI
+ * and keeps the strongest WIFI_APP_SCAN_MAX_RESULTS.
+ */
+static void wifi_app_scan_merge(const wifi_ap_record_t *records, uint16_t count, uint8_t channel)
+{
+    wifi_app_scan_result_t *networks = scan_results.networks;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < scan_results.count; i++)
+    {
+        if (channel != 0 && networks[i].channel != channel)
+        {
+            networks[kept++] = networks[i];
+        }
+    }
+
+    for (uint16_t r = 0; r < count; r++)
+    {
+        size_t pos = kept;
+        while (pos > 0 && networks[pos - 1].rssi < records[r].rssi)
+        {
+            pos--;
+        }
+        if (pos == WIFI_APP_SCAN_MAX_RESULTS)
+        {
+            continue;
+        }
+        if (kept < WIFI_APP_SCAN_MAX_RESULTS)
+        {
+            kept++;
+        }
+        memmove(&networks[pos + 1], &networks[pos], (kept - 1 - pos) * sizeof(networks[0]));
+
+        memcpy(networks[pos].ssid, records[r].ssid, MAX_SSID_LENGTH);
+        networks[pos].ssid[MAX_SSID_LENGTH] = '\0';
+        networks[pos].rssi = records[r].rssi;
+        networks[pos].auth_mode = records[r].authmode;
+        networks[pos].channel = records[r].primary;
+    }
+    scan_results.count = kept;
+}
+
+/**
+ * Collects the results of a finished scan into the cache
+ * A sliced scan merges each channel as it completes and moves on to the
+ * next one after WIFI_APP_SCAN_HOME_MS on the AP channel.
+ */
+static void wifi_app_scan_collect(void)
+{
+    uint16_t count = WIFI_APP_SCAN_MAX_RESULTS;
+    esp_err_t ret = esp_wifi_scan_get_ap_records(&count, scan_records);
+    // Drop records beyond WIFI_APP_SCAN_MAX_RESULTS
+    esp_wifi_clear_ap_list();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to get scan results: %s", esp_err_to_name(ret));
+        wifi_app_scan_finish(ret);
+        return;
+    }
+
+    const bool last = !scan_sliced || scan_channel >= scan_last_channel;
+
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    wifi_app_scan_merge(scan_records, count, scan_sliced ? scan_channel : 0);
+    if (last)
+    {
+        scan_results.generation++;
+        scan_done_time_us = esp_timer_get_time();
+        scan_valid = true;
+    }
+    const size_t total = scan_results.count;
+    xSemaphoreGive(scan_mutex);
+
+    if (!last)
+    {
+        scan_channel++;
+        esp_timer_start_once(scan_home_timer, WIFI_APP_SCAN_HOME_MS * 1000ULL);
+        return;
+    }
+
+    ESP_LOGI(TAG, "WiFi scan complete, %zu networks", total);
+    wifi_app_scan_finish(ESP_OK);
+}
+
 /**
  * Main WiFi application task
  */
@@ -347,6 +544,20 @@ static void wifi_app_task(void *pvParameters)
                 break;
             }
 
+            case WIFI_APP_MSG_SCAN_START:
+                ESP_LOGI(TAG, "Received: SCAN_START");
+                wifi_app_scan_start();
+                break;
+
+            case WIFI_APP_MSG_SCAN_DONE:
+                ESP_LOGI(TAG, "Received: SCAN_DONE");
+                wifi_app_scan_collect();
+                break;
+
+            case WIFI_APP_MSG_SCAN_NEXT_CHANNEL:
+                wifi_app_scan_channel(scan_channel, WIFI_APP_SCAN_DWELL_MS);
+                break;
+
             default:
                 ESP_LOGW(TAG, "Unknown message ID: %d", msg.msgID);
                 break;
@@ -378,8 +589,15 @@ void wifi_app_start(void)
     // Configure Access Point
     wifi_app_soft_ap_config();
 
-    // Create message queue
-    wifi_app_queue_handle = xQueueCreate(3, sizeof(wifi_app_queue_message_t));
+    // Create message queue and scan cache lock
+    wifi_app_queue_handle = xQueueCreate(5, sizeof(wifi_app_queue_message_t));
+    scan_mutex = xSemaphoreCreateMutex();
+
+    const esp_timer_create_args_t home_timer_args = {
+        .callback = wifi_app_scan_home_timer_cb,
+        .name = "wifi_scan_home",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&home_timer_args, &scan_home_timer));
 
     // Create WiFi application task
     xTaskCreatePinnedToCore(
@@ -425,6 +643,14 @@ int8_t wifi_app_get_rssi(void)
     return 0;
 }
 
+/**
+ * Gets the number of STA connection retries since boot
+ */
+uint32_t wifi_app_get_retry_count(void)
+{
+    return g_retry_total;
+}
+
 /**
  * Get WiFi connection status
  */
@@ -473,97 +699,55 @@ esp_err_t wifi_app_get_connection_info(wifi_app_connection_info_t *info)
 }
 
 /**
- * Scan for available WiFi networks
+ * Request a background scan
  */
-esp_err_t wifi_app_scan_networks(wifi_app_scan_result_t **results, size_t *count)
+esp_err_t wifi_app_request_scan(void)
 {
-    if (results == NULL || count == NULL) {
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    ESP_LOGI(TAG, "Starting WiFi scan");
-    
-    // Start scan
-    wifi_scan_config_t scan_config = {
-        .ssid = NULL,
-        .bssid = NULL,
-        .channel = 0,
-        .show_hidden = false,
-        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-        .scan_time = {
-            .active = {
-                .min = 100,
-                .max = 300
-            }
-        }
-    };
-    
-    esp_err_t ret = esp_wifi_scan_start(&scan_config, true);  // Block until done
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "WiFi scan failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    // Get scan results
-    uint16_t ap_count = 0;
-    esp_wifi_scan_get_ap_num(&ap_count);
-    
-    if (ap_count == 0) {
-        ESP_LOGW(TAG, "No APs found");
-        *results = NULL;
-        *count = 0;
-        return ESP_OK;
+    if (scan_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
     }
     
-    // Limit to 20 results
-    if (ap_count > 20) {
-        ap_count = 20;
-    }
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    const bool start = !scan_running;
+    scan_running = true;
+    xSemaphoreGive(scan_mutex);
     
-    wifi_ap_record_t *ap_records = malloc(sizeof(wifi_ap_record_t) * ap_count);
-    if (ap_records == NULL) {
-        esp_wifi_scan_stop();
-        return ESP_ERR_NO_MEM;
+    // A running scan serves this request too
+    if (start) {
+        wifi_app_send_message(WIFI_APP_MSG_SCAN_START);
     }
-    
-    uint16_t actual_count = ap_count;
-    ret = esp_wifi_scan_get_ap_records(&actual_count, ap_records);
-    if (ret != ESP_OK) {
-        free(ap_records);
-        return ret;
-    }
-    
-    // Allocate results array
-    *results = malloc(sizeof(wifi_app_scan_result_t) * actual_count);
-    if (*results == NULL) {
-        free(ap_records);
-        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+/**
+ * Get the results of the latest completed scan
+ */
+esp_err_t wifi_app_get_scan_results(wifi_app_scan_results_t *results)
+{
+    if (results == NULL) {
+        return ESP_ERR_INVALID_ARG;
     }
-    
-    // Copy and sort by RSSI
-    for (int i = 0; i < actual_count; i++) {
-        memcpy((*results)[i].ssid, ap_records[i].ssid, MAX_SSID_LENGTH);
-        (*results)[i].ssid[MAX_SSID_LENGTH] = '\0';
-        (*results)[i].rssi = ap_records[i].rssi;
-        (*results)[i].auth_mode = ap_records[i].authmode;
+    if (scan_mutex == NULL) {
+        return ESP_ERR_NOT_FOUND;
     }
     
-    // Simple bubble sort by RSSI (strongest first)
-    for (int i = 0; i < actual_count - 1; i++) {
-        for (int j = 0; j < actual_count - i - 1; j++) {
-            if ((*results)[j].rssi < (*results)[j + 1].rssi) {
-                wifi_app_scan_result_t temp = (*results)[j];
-                (*results)[j] = (*results)[j + 1];
-                (*results)[j + 1] = temp;
-            }
-        }
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    const bool valid = scan_valid;
+    if (valid) {
+        *results = scan_results;
+        results->age_ms = (esp_timer_get_time() - scan_done_time_us) / 1000;
     }
+    xSemaphoreGive(scan_mutex);
     
-    *count = actual_count;
-    free(ap_records);
-    
-    ESP_LOGI(TAG, "WiFi scan complete, found %d networks", actual_count);
-    return ESP_OK;
+    return valid ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * Sets the scan done callback
+ */
+void wifi_app_set_scan_callback(wifi_scan_done_callback_t cb)
+{
+    wifi_scan_done_cb = cb;
 }
 
 /**
@@ -9,6 +9,7 @@ typedef struct esp_netif_obj esp_netif_t;
 
 // Callback typedef
 typedef void (*wifi_connected_event_callback_t)(void);
+typedef void (*wifi_scan_done_callback_t)(esp_err_t result);
 
 // WiFi application settings
 #define WIFI_AP_SSID "esp32-ap" // AP name
@@ -25,6 +26,11 @@ typedef void (*wifi_connected_event_callback_t)(void);
 #define MAX_SSID_LENGTH 32 // IEEE standard maximum
 #define MAX_PASSWORD_LENGTH 64 // IEEE standard maximum
 #define MAX_CONNECTION_RETRIES 5 // Retry number on disconnect
+#define WIFI_APP_SCAN_MAX_RESULTS 20 // Networks kept from a scan (strongest first)
+#define WIFI_APP_SCAN_TTL_MS 30000 // Scan results younger than this are served from the cache
+#define WIFI_APP_SCAN_SLICED 1 // With AP clients connected, scan one channel at a time
+#define WIFI_APP_SCAN_DWELL_MS 120 // Sliced scan: max active dwell on each channel
+#define WIFI_APP_SCAN_HOME_MS 250 // Sliced scan: time back on the AP channel between channels
 
 // netif object for the Station and Access Point
 extern esp_netif_t *esp_netif_sta;
@@ -41,6 +47,9 @@ typedef enum wifi_app_message {
   WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT,
   WIFI_APP_MSG_LOAD_SAVED_CREDENTIALS,
   WIFI_APP_MSG_STA_DISCONNECTED,
+  WIFI_APP_MSG_SCAN_START,
+  WIFI_APP_MSG_SCAN_DONE,
+  WIFI_APP_MSG_SCAN_NEXT_CHANNEL,
 } wifi_app_message_e;
 
 /**
@@ -83,6 +92,12 @@ void wifi_app_set_callback(wifi_connected_event_callback_t cb);
  */
 int8_t wifi_app_get_rssi(void);
 
+/**
+ * Gets the number of STA connection retries since boot.
+ * @return retry count.
+ */
+uint32_t wifi_app_get_retry_count(void);
+
 /**
  * WiFi connection status enum
  */
@@ -110,6 +125,7 @@ typedef struct {
     char ssid[MAX_SSID_LENGTH + 1];
     int8_t rssi;
     wifi_auth_mode_t auth_mode;
+    uint8_t channel;
 } wifi_app_scan_result_t;
 
 /**
@@ -126,12 +142,35 @@ wifi_app_connection_status_e wifi_app_get_connection_status(void);
 esp_err_t wifi_app_get_connection_info(wifi_app_connection_info_t *info);
 
 /**
- * Scan for available WiFi networks
- * @param results Pointer to receive array of scan results (caller must free)
- * @param count Pointer to receive number of results
- * @return ESP_OK on success
+ * Scan results snapshot
+ */
+typedef struct {
+    wifi_app_scan_result_t networks[WIFI_APP_SCAN_MAX_RESULTS]; // Strongest first
+    size_t count;
+    uint32_t generation;    // Incremented by every completed scan (sliced scans merge channels in as they go)
+    uint32_t age_ms;        // Time since the scan completed
+} wifi_app_scan_results_t;
+
+/**
+ * Request a background scan on the WiFi task
+ * Returns right away. Requests made while a scan is running join that
+ * scan, so concurrent callers cause a single scan.
+ * @return ESP_OK if a scan is running or was started
+ */
+esp_err_t wifi_app_request_scan(void);
+
+/**
+ * Get the results of the latest completed scan
+ * @param results Pointer to receive the results
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no scan has completed yet
+ */
+esp_err_t wifi_app_get_scan_results(wifi_app_scan_results_t *results);
+
+/**
+ * Sets the function called on the WiFi task when a scan ends.
+ * @note The callback must not block; queue any real work elsewhere.
  */
-esp_err_t wifi_app_scan_networks(wifi_app_scan_result_t **results, size_t *count);
+void wifi_app_set_scan_callback(wifi_scan_done_callback_t cb);
 
 /**
  * Set WiFi credentials for STA connection
@@ -11,6 +11,21 @@
  #define HTTP_SERVER_TASK_PRIORITY			4
  #define HTTP_SERVER_TASK_CORE_ID			0
  
+ // HTTP worker tasks (slow handlers, on the core the httpd task does not use)
+ #define HTTP_WORKER_TASK_STACK_SIZE		6144
+ #define HTTP_WORKER_TASK_PRIORITY			3
+ #define HTTP_WORKER_TASK_CORE_ID			1
+ 
+ // OTA flash writer task (pipelined updates, opposite the HTTP workers)
+ #define OTA_WRITER_TASK_STACK_SIZE			4096
+ #define OTA_WRITER_TASK_PRIORITY			4
+ #define OTA_WRITER_TASK_CORE_ID			0
+ 
+ // HTTP Server-Sent Events task
+ #define HTTP_EVENTS_TASK_STACK_SIZE		4096
+ #define HTTP_EVENTS_TASK_PRIORITY			3
+ #define HTTP_EVENTS_TASK_CORE_ID			0
+ 
  // HTTP Server Monitor task
  #define HTTP_SERVER_MONITOR_STACK_SIZE		4096
  #define HTTP_SERVER_MONITOR_PRIORITY		3
@@ -14,6 +14,9 @@ static int dns_socket = -1;
 static TaskHandle_t dns_task_handle = NULL;
 static bool dns_running = false;
 
+// Queries answered since boot
+static uint32_t dns_query_count = 0;
+
 /**
  * DNS header structure
  */
@@ -130,6 +133,7 @@ static void dns_server_task(void *pvParameters)
             if (response_len > 0) {
                 sendto(dns_socket, tx_buffer, response_len, 0,
                       (struct sockaddr *)&client_addr, client_addr_len);
+                dns_query_count++;
                 
                 ESP_LOGD(TAG, "DNS query responded");
             }
@@ -207,3 +211,7 @@ bool dns_server_is_running(void)
     return dns_running;
 }
 
+uint32_t dns_server_get_query_count(void)
+{
+    return dns_query_count;
+}
@@ -2,6 +2,8 @@
 #define DNS_SERVER_H
 
 #include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
 
 /**
  * Start DNS server for captive portal
@@ -25,5 +27,12 @@ esp_err_t dns_server_stop(void);
  */
 bool dns_server_is_running(void);
 
+/**
+ * Get the number of queries answered since boot
+ * 
+ * @return Query count
+ */
+uint32_t dns_server_get_query_count(void);
+
 #endif // DNS_SERVER_H
 
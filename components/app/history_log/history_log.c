@@ -0,0 +1,570 @@
+#include "history_log.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "series_codec.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "history_log";
+
+// One log block per flash sector, so every block is erased on its own
+#define LOG_BLOCK_SIZE 4096
+
+// "HLG2": bump the digit when the block layout changes
+// (HLG1 stored plain 8-byte records; such blocks are ignored and reused)
+#define LOG_BLOCK_MAGIC 0x32474C48
+
+// Value of erased flash
+#define LOG_ERASED_U32 0xFFFFFFFF
+#define LOG_ERASED_U16 0xFFFF
+
+/**
+ * Block header, written when the block is opened
+ * Frames follow the header back to back until the block is full.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           // Block sequence number, +1 for every block opened
+    uint32_t first_ts;      // Timestamp of the first record
+    uint32_t crc;           // CRC32 of the fields above
+} log_block_header_t;
+
+/**
+ * Frame header
+ * Every flush writes one frame: up to HISTORY_LOG_BUFFER_RECORDS samples
+ * compressed with series_codec, padded to 4 bytes.
+ */
+typedef struct {
+    uint16_t count;         // Samples in the frame
+    uint16_t size;          // Encoded payload size in bytes
+    uint32_t crc;           // CRC32 of the payload
+} log_frame_header_t;
+
+#define LOG_BLOCK_DATA_SIZE (LOG_BLOCK_SIZE - sizeof(log_block_header_t))
+
+// Largest frame, header included
+#define LOG_FRAME_MAX_SIZE (sizeof(log_frame_header_t) + \
+                            ((SERIES_CODEC_MAX_BYTES(HISTORY_LOG_BUFFER_RECORDS) + 3) & ~3u))
+
+/**
+ * Log state
+ * Blocks are used as a ring in partition order: the log runs from the tail
+ * block to the head block, and the oldest block is erased when the ring
+ * wraps, so every sector sees the same number of erase cycles.
+ */
+typedef struct {
+    const esp_partition_t *partition;
+    size_t block_count;
+    uint32_t *block_first_ts;   // RAM time index, one entry per block
+    uint32_t *block_seq;        // Sequence number per block, 0 if not part of the log
+    size_t tail;                // Oldest block
+    size_t head;                // Block being written
+    size_t used_blocks;         // Blocks in the log, 0 if empty
+    size_t head_used;           // Frame bytes written to the head block
+    uint32_t next_seq;
+    uint32_t last_ts;           // Timestamp of the newest record
+    history_log_record_t buffer[HISTORY_LOG_BUFFER_RECORDS];
+    size_t buffered;
+    uint8_t frame[LOG_FRAME_MAX_SIZE];  // Frame being written
+} history_log_t;
+
+static history_log_t history_log = {0};
+static SemaphoreHandle_t log_mutex = NULL;
+
+static size_t block_offset(size_t block)
+{
+    return block * LOG_BLOCK_SIZE;
+}
+
+static size_t data_offset(size_t block, size_t offset)
+{
+    return block_offset(block) + sizeof(log_block_header_t) + offset;
+}
+
+static uint32_t header_crc(const log_block_header_t *header)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)header, offsetof(log_block_header_t, crc));
+}
+
+/**
+ * Decode the frame at offset in a block's data area
+ * Power loss can leave the last frame torn; an erased header ends the
+ * data, anything that does not check out is reported as torn.
+ *
+ * @return ESP_OK with the frame size in *frame_size, ESP_ERR_NOT_FOUND at
+ *         the end of the data, ESP_ERR_INVALID_CRC for a torn frame
+ */
+static esp_err_t frame_decode(const uint8_t *data, size_t data_size, size_t offset,
+                              history_log_record_t *records, size_t *count, size_t *frame_size)
+{
+    if (offset + sizeof(log_frame_header_t) > data_size) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    log_frame_header_t header;
+    memcpy(&header, data + offset, sizeof(header));
+    if (header.count == 0xFFFF && header.size == 0xFFFF) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const size_t padded = (header.size + 3) & ~3u;
+    const uint8_t *payload = data + offset + sizeof(header);
+    if (header.count == 0 || header.count > HISTORY_LOG_BUFFER_RECORDS ||
+        offset + sizeof(header) + padded > data_size ||
+        esp_rom_crc32_le(0, payload, header.size) != header.crc) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    series_decoder_t dec;
+    series_decoder_init(&dec, payload, header.size, header.count);
+    for (size_t i = 0; i < header.count; i++) {
+        if (series_decoder_next(&dec, &records[i].timestamp, &records[i].temp, &records[i].hum) != ESP_OK) {
+            return ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    *count = header.count;
+    *frame_size = sizeof(header) + padded;
+    return ESP_OK;
+}
+
+/**
+ * Find the log bounds and the write position from the block headers
+ */
+static esp_err_t history_log_scan(void)
+{
+    history_log_t *log = &history_log;
+    log_block_header_t header;
+    bool found = false;
+
+    for (size_t i = 0; i < log->block_count; i++) {
+        log->block_seq[i] = 0;
+        esp_err_t ret = esp_partition_read(log->partition, block_offset(i), &header, sizeof(header));
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (header.magic != LOG_BLOCK_MAGIC || header.crc != header_crc(&header) || header.seq == 0) {
+            continue;
+        }
+        log->block_seq[i] = header.seq;
+        log->block_first_ts[i] = header.first_ts;
+        if (!found || header.seq > log->block_seq[log->head]) {
+            log->head = i;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        log->used_blocks = 0;
+        log->next_seq = 1;
+        return ESP_OK;
+    }
+
+    // Walk back from the head while the sequence has no gaps
+    log->tail = log->head;
+    log->used_blocks = 1;
+    while (log->used_blocks < log->block_count) {
+        size_t prev = (log->tail + log->block_count - 1) % log->block_count;
+        if (log->block_seq[prev] != log->block_seq[log->tail] - 1 ||
+            log->block_first_ts[prev] > log->block_first_ts[log->tail]) {
+            break;
+        }
+        log->tail = prev;
+        log->used_blocks++;
+    }
+
+    // Anything outside the tail..head run is stale
+    for (size_t i = 0; i < log->block_count; i++) {
+        size_t age = (i + log->block_count - log->tail) % log->block_count;
+        if (age >= log->used_blocks) {
+            log->block_seq[i] = 0;
+        }
+    }
+
+    // Find the end of the head block
+    uint8_t *data = malloc(LOG_BLOCK_DATA_SIZE);
+    if (data == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = esp_partition_read(log->partition, data_offset(log->head, 0), data, LOG_BLOCK_DATA_SIZE);
+    if (ret == ESP_OK) {
+        size_t offset = 0;
+        size_t count = 0;
+        size_t frame_size = 0;
+        esp_err_t frame_ret;
+
+        log->last_ts = log->block_first_ts[log->head];
+        while ((frame_ret = frame_decode(data, LOG_BLOCK_DATA_SIZE, offset, log->buffer,
+                                         &count, &frame_size)) == ESP_OK) {
+            log->last_ts = log->buffer[count - 1].timestamp;
+            offset += frame_size;
+        }
+        log->head_used = offset;
+
+        // A torn frame leaves programmed bits behind: close the block
+        if (frame_ret == ESP_ERR_INVALID_CRC) {
+            ESP_LOGW(TAG, "Torn frame in block %zu, starting a new block", log->head);
+            log->head_used = LOG_BLOCK_DATA_SIZE;
+        }
+    }
+    free(data);
+
+    log->next_seq = log->block_seq[log->head] + 1;
+    return ret;
+}
+
+/**
+ * Erase the next block and make it the head (mutex held)
+ */
+static esp_err_t history_log_open_block(uint32_t first_ts)
+{
+    history_log_t *log = &history_log;
+    size_t next = (log->used_blocks == 0) ? 0 : (log->head + 1) % log->block_count;
+
+    // Ring is full: drop the oldest block
+    if (log->used_blocks == log->block_count) {
+        log->block_seq[log->tail] = 0;
+        log->tail = (log->tail + 1) % log->block_count;
+        log->used_blocks--;
+    }
+
+    esp_err_t ret = esp_partition_erase_range(log->partition, block_offset(next), LOG_BLOCK_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    log_block_header_t header = {
+        .magic = LOG_BLOCK_MAGIC,
+        .seq = log->next_seq,
+        .first_ts = first_ts,
+    };
+    header.crc = header_crc(&header);
+
+    ret = esp_partition_write(log->partition, block_offset(next), &header, sizeof(header));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (log->used_blocks == 0) {
+        log->tail = next;
+    }
+    log->head = next;
+    log->head_used = 0;
+    log->used_blocks++;
+    log->block_seq[next] = log->next_seq++;
+    log->block_first_ts[next] = first_ts;
+    return ESP_OK;
+}
+
+/**
+ * Write the RAM buffer to flash as one frame, or two if the head block
+ * fills up (mutex held)
+ */
+static esp_err_t history_log_flush_locked(void)
+{
+    history_log_t *log = &history_log;
+    size_t written = 0;
+    esp_err_t ret = ESP_OK;
+
+    while (written < log->buffered) {
+        // Room for at least the frame header and the verbatim first sample
+        if (log->used_blocks == 0 ||
+            log->head_used + sizeof(log_frame_header_t) + 8 > LOG_BLOCK_DATA_SIZE) {
+            ret = history_log_open_block(log->buffer[written].timestamp);
+            if (ret != ESP_OK) {
+                break;
+            }
+        }
+
+        size_t capacity = LOG_BLOCK_DATA_SIZE - log->head_used - sizeof(log_frame_header_t);
+        if (capacity > LOG_FRAME_MAX_SIZE - sizeof(log_frame_header_t)) {
+            capacity = LOG_FRAME_MAX_SIZE - sizeof(log_frame_header_t);
+        }
+        capacity &= ~3u;
+
+        series_encoder_t enc;
+        series_encoder_init(&enc, log->frame + sizeof(log_frame_header_t), capacity);
+        size_t count = 0;
+        while (written + count < log->buffered) {
+            const history_log_record_t *r = &log->buffer[written + count];
+            if (series_encoder_add(&enc, r->timestamp, r->temp, r->hum) != ESP_OK) {
+                break;
+            }
+            count++;
+        }
+
+        if (count == 0) {
+            // Not even one sample fits: close the block
+            log->head_used = LOG_BLOCK_DATA_SIZE;
+            continue;
+        }
+
+        const size_t size = series_encoder_size(&enc);
+        const size_t padded = (size + 3) & ~3u;
+        memset(log->frame + sizeof(log_frame_header_t) + size, 0xFF, padded - size);
+
+        log_frame_header_t header = {
+            .count = (uint16_t)count,
+            .size = (uint16_t)size,
+            .crc = esp_rom_crc32_le(0, log->frame + sizeof(log_frame_header_t), size),
+        };
+        memcpy(log->frame, &header, sizeof(header));
+
+        ret = esp_partition_write(log->partition, data_offset(log->head, log->head_used),
+                                  log->frame, sizeof(header) + padded);
+        if (ret != ESP_OK) {
+            break;
+        }
+        log->head_used += sizeof(header) + padded;
+        written += count;
+    }
+
+    if (ret != ESP_OK) {
+        // Don't retry into a block in an unknown state, and don't let a
+        // failing flash stall the producer: drop the batch
+        ESP_LOGE(TAG, "Failed to write %zu records: %s", log->buffered - written, esp_err_to_name(ret));
+        if (log->used_blocks > 0) {
+            log->head_used = LOG_BLOCK_DATA_SIZE;
+        }
+    }
+
+    log->buffered = 0;
+    return ret;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+static void history_log_shutdown_handler(void)
+{
+    history_log_flush();
+}
+#endif
+
+esp_err_t history_log_init(void)
+{
+    if (log_mutex != NULL) {
+        return ESP_OK;
+    }
+
+    history_log_t *log = &history_log;
+
+    log->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                              HISTORY_LOG_PARTITION_LABEL);
+    if (log->partition == NULL) {
+        ESP_LOGE(TAG, "Partition '%s' not found", HISTORY_LOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    log->block_count = log->partition->size / LOG_BLOCK_SIZE;
+    if (log->block_count < 2) {
+        ESP_LOGE(TAG, "Partition too small (%lu bytes)", (unsigned long)log->partition->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    log->block_first_ts = calloc(log->block_count, sizeof(uint32_t));
+    log->block_seq = calloc(log->block_count, sizeof(uint32_t));
+    if (log->block_first_ts == NULL || log->block_seq == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate block index");
+        free(log->block_first_ts);
+        free(log->block_seq);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = history_log_scan();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to scan log: %s", esp_err_to_name(ret));
+        free(log->block_first_ts);
+        free(log->block_seq);
+        return ret;
+    }
+
+    log_mutex = xSemaphoreCreateMutex();
+    if (log_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create log mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    // Flush on esp_restart() (OTA, config restore); power loss loses at most one buffer
+    if (esp_register_shutdown_handler(history_log_shutdown_handler) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to register shutdown handler");
+    }
+#endif
+
+    ESP_LOGI(TAG, "Log initialized: %zu/%zu blocks used", log->used_blocks, log->block_count);
+    return ESP_OK;
+}
+
+esp_err_t history_log_append(time_t timestamp, float temperature, float humidity)
+{
+    if (log_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (timestamp < HISTORY_LOG_MIN_TIMESTAMP || timestamp > UINT32_MAX - 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    history_log_t *log = &history_log;
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+
+    // Records must stay time ordered for the index to work
+    if ((uint32_t)timestamp < log->last_ts) {
+        xSemaphoreGive(log_mutex);
+        ESP_LOGW(TAG, "Dropping sample older than the log head");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    log->buffer[log->buffered++] = (history_log_record_t) {
+        .timestamp = (uint32_t)timestamp,
+        .temp = (int16_t)lroundf(temperature * 10.0f),
+        .hum = (uint16_t)lroundf(humidity * 10.0f),
+    };
+    log->last_ts = (uint32_t)timestamp;
+
+    if (log->buffered == HISTORY_LOG_BUFFER_RECORDS) {
+        ret = history_log_flush_locked();
+    }
+
+    xSemaphoreGive(log_mutex);
+    return ret;
+}
+
+esp_err_t history_log_flush(void)
+{
+    if (log_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    esp_err_t ret = history_log_flush_locked();
+    xSemaphoreGive(log_mutex);
+    return ret;
+}
+
+/**
+ * Keep the records within [from, to], compacted to the start of the array
+ */
+static size_t filter_range(history_log_record_t *records, size_t count, uint32_t from, uint32_t to)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (records[i].timestamp >= from && records[i].timestamp <= to) {
+            records[kept++] = records[i];
+        }
+    }
+    return kept;
+}
+
+esp_err_t history_log_read(time_t from, time_t to, history_log_read_cb_t cb, void *ctx)
+{
+    if (log_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (cb == NULL || from > to || to < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const uint32_t from_ts = (from < 0) ? 0 : (uint32_t)from;
+    const uint32_t to_ts = (to > UINT32_MAX) ? UINT32_MAX : (uint32_t)to;
+    history_log_t *log = &history_log;
+
+    // Frame data of one block, and the decoded records of one frame
+    uint8_t *data = malloc(LOG_BLOCK_DATA_SIZE);
+    history_log_record_t *records = malloc(HISTORY_LOG_BUFFER_RECORDS * sizeof(history_log_record_t));
+    if (data == NULL || records == NULL) {
+        free(data);
+        free(records);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = ESP_OK;
+    bool more = true;
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+
+    // Position is kept as (block sequence number, byte offset), so appends
+    // and wraps while the lock is released neither repeat nor skip records
+    // that still exist
+    uint32_t seq = (log->used_blocks > 0) ? log->block_seq[log->tail] : log->next_seq;
+    size_t offset = 0;
+
+    while (more && log->used_blocks > 0 && seq < log->next_seq) {
+        if (seq < log->block_seq[log->tail]) {
+            // Overwritten while the lock was released
+            seq = log->block_seq[log->tail];
+            offset = 0;
+        }
+        size_t age = log->used_blocks - (log->next_seq - seq);
+        size_t block = (log->tail + age) % log->block_count;
+        size_t next_block = (block + 1) % log->block_count;
+        const bool is_head = (block == log->head);
+        const size_t used = is_head ? log->head_used : LOG_BLOCK_DATA_SIZE;
+
+        if (log->block_first_ts[block] > to_ts) {
+            break;
+        }
+
+        // Records of a block end at or before the first record of the next one
+        if (offset >= used || (!is_head && log->block_first_ts[next_block] < from_ts)) {
+            if (is_head) {
+                break;
+            }
+            seq++;
+            offset = 0;
+            continue;
+        }
+
+        ret = esp_partition_read(log->partition, data_offset(block, offset), data, used - offset);
+        xSemaphoreGive(log_mutex);
+
+        if (ret != ESP_OK) {
+            free(data);
+            free(records);
+            return ret;
+        }
+
+        size_t pos = 0;
+        size_t count = 0;
+        size_t frame_size = 0;
+        while (more && frame_decode(data, used - offset, pos, records, &count, &frame_size) == ESP_OK) {
+            pos += frame_size;
+            if (records[count - 1].timestamp < from_ts) {
+                continue;
+            }
+            if (records[0].timestamp > to_ts) {
+                more = false;
+                break;
+            }
+            size_t kept = filter_range(records, count, from_ts, to_ts);
+            if (kept > 0) {
+                more = cb(records, kept, ctx);
+            }
+        }
+        // Frames are only appended; a frame that does not decode ends the block
+        offset = (offset + pos < used) ? LOG_BLOCK_DATA_SIZE : used;
+
+        xSemaphoreTake(log_mutex, portMAX_DELAY);
+    }
+
+    // Samples not written yet
+    size_t kept = 0;
+    if (more) {
+        memcpy(records, log->buffer, log->buffered * sizeof(history_log_record_t));
+        kept = filter_range(records, log->buffered, from_ts, to_ts);
+    }
+    xSemaphoreGive(log_mutex);
+
+    if (kept > 0) {
+        cb(records, kept, ctx);
+    }
+
+    free(data);
+    free(records);
+    return ESP_OK;
+}
@@ -0,0 +1,86 @@
+#ifndef HISTORY_LOG_H
+#define HISTORY_LOG_H
+
+#include "esp_err.h"
+#include <time.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Label of the data partition holding the log (see partitions.csv)
+#define HISTORY_LOG_PARTITION_LABEL "history"
+
+// Records kept in RAM, then compressed and written to flash as one frame (64 s at the 2 s read interval)
+#define HISTORY_LOG_BUFFER_RECORDS 32
+
+// Samples before this time (2020-01-01) were taken before the clock was set
+#define HISTORY_LOG_MIN_TIMESTAMP 1577836800
+
+/**
+ * Stored sample (0.1 °C / 0.1 % fixed point)
+ */
+typedef struct {
+    uint32_t timestamp;
+    int16_t temp;
+    uint16_t hum;
+} history_log_record_t;
+
+/**
+ * Range read callback
+ * Called with consecutive batches of records in time order.
+ *
+ * @param records Records of this batch
+ * @param count Number of records
+ * @param ctx User context passed to history_log_read
+ * @return true to continue, false to stop the read
+ */
+typedef bool (*history_log_read_cb_t)(const history_log_record_t *records, size_t count, void *ctx);
+
+/**
+ * Initialize the log
+ * Scans the block headers of the history partition to rebuild the time
+ * index and find the write position. Nothing else is read.
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is no history partition,
+ *         ESP_ERR_NO_MEM if allocation failed
+ */
+esp_err_t history_log_init(void);
+
+/**
+ * Append a sample
+ * Samples are buffered in RAM and written once the buffer is full. Samples
+ * older than the last appended one, or taken before the clock was set, are
+ * dropped.
+ *
+ * @param timestamp Sample time
+ * @param temperature Temperature in °C
+ * @param humidity Relative humidity in %
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized,
+ *         ESP_ERR_INVALID_ARG if the sample was dropped, or a flash error
+ */
+esp_err_t history_log_append(time_t timestamp, float temperature, float humidity);
+
+/**
+ * Write buffered samples to flash
+ * Also called from a shutdown handler, so a restart (e.g. after OTA) loses nothing.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized, or a flash error
+ */
+esp_err_t history_log_flush(void);
+
+/**
+ * Read records in a time range, oldest first
+ * Only blocks overlapping the range are read. Buffered samples not yet
+ * written to flash are included. The callback runs without the log lock
+ * held, so it may block (e.g. on a socket).
+ *
+ * @param from First timestamp to include
+ * @param to Last timestamp to include
+ * @param cb Callback receiving the records
+ * @param ctx User context for the callback
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized,
+ *         ESP_ERR_NO_MEM if allocation failed, or a flash error
+ */
+esp_err_t history_log_read(time_t from, time_t to, history_log_read_cb_t cb, void *ctx);
+
+#endif // HISTORY_LOG_H
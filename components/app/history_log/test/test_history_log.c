@@ -0,0 +1,317 @@
+/**
+ * Host test and benchmark of the history log
+ * The log runs on a file-backed image of the history partition (384 KB,
+ * see partitions.csv) with flash write and erase rules enforced. Several
+ * days of 2 s samples wrap the ring; the test measures append cost,
+ * flash traffic and wear, range and full reads, and the boot scan and
+ * replay after a reboot. Reboots run in a child process that reopens the
+ * image, which also covers recovery from a write torn by power loss.
+ */
+#include "history_log.h"
+#include "host_partition.h"
+#include "host_test.h"
+#include "esp_system.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PARTITION_SIZE (384 * 1024)
+#define SAMPLE_INTERVAL_S 2
+#define START_TS 1700000000u
+// About a week at the read interval, more than the ring holds
+#define SAMPLE_COUNT (7 * 24 * 3600 / SAMPLE_INTERVAL_S)
+#define RANGE_READ_S 3600
+// Appended after the week: one batch after the reboot, one torn by power loss
+#define EXTRA_COUNT (2 * HISTORY_LOG_BUFFER_RECORDS)
+
+typedef struct {
+    uint32_t timestamp;
+    int16_t temp;
+    uint16_t hum;
+} sample_t;
+
+static const char *image_path;
+static const esp_partition_t *partition;
+static sample_t *samples;
+static size_t sample_count;
+
+/* FreeRTOS and system calls history_log.c makes (single-threaded here) */
+
+static int mutex_handle;
+static bool mutex_taken;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return (SemaphoreHandle_t)&mutex_handle;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait)
+{
+    CHECK(!mutex_taken);
+    mutex_taken = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    CHECK(mutex_taken);
+    mutex_taken = false;
+    return pdTRUE;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle)
+{
+    return ESP_OK;
+}
+
+/* Sensor data */
+
+/**
+ * A room: daily temperature and humidity swing plus sensor noise, in the
+ * log's 0.1 fixed point
+ */
+static void make_samples(size_t count)
+{
+    uint32_t rng = 6;
+    samples = malloc(count * sizeof(sample_t));
+    CHECK(samples != NULL);
+    for (size_t i = 0; i < count; i++) {
+        double day = 2 * M_PI * (i * SAMPLE_INTERVAL_S) / 86400.0;
+        int noise_t = (int)(host_test_rand(&rng) % 3) - 1;
+        int noise_h = (int)(host_test_rand(&rng) % 5) - 2;
+        samples[i] = (sample_t){
+            .timestamp = START_TS + i * SAMPLE_INTERVAL_S,
+            .temp = (int16_t)(215 + lround(30 * sin(day)) + noise_t),
+            .hum = (uint16_t)(450 - lround(80 * sin(day)) + noise_h),
+        };
+    }
+    sample_count = count;
+}
+
+static esp_err_t append(const sample_t *sample)
+{
+    return history_log_append(sample->timestamp, sample->temp / 10.0f, sample->hum / 10.0f);
+}
+
+/* Read-back */
+
+typedef struct {
+    size_t count;
+    size_t first;           // Index in samples of the first record
+    size_t mismatches;
+} collect_t;
+
+static bool collect_cb(const history_log_record_t *records, size_t count, void *ctx)
+{
+    collect_t *c = ctx;
+    for (size_t i = 0; i < count; i++) {
+        const history_log_record_t *r = &records[i];
+        if (c->count == 0) {
+            c->first = (r->timestamp - START_TS) / SAMPLE_INTERVAL_S;
+        }
+        // Records must be consecutive samples, in order
+        size_t index = c->first + c->count;
+        if (index >= sample_count || r->timestamp != samples[index].timestamp ||
+            r->temp != samples[index].temp || r->hum != samples[index].hum) {
+            c->mismatches++;
+        }
+        c->count++;
+    }
+    return true;
+}
+
+static collect_t read_range(uint32_t from, uint32_t to, uint64_t *elapsed_ns, uint64_t *read_bytes)
+{
+    collect_t c = {0};
+    host_partition_stats_t stats;
+    host_partition_reset_stats(partition);
+    uint64_t start = host_test_now_ns();
+    CHECK(history_log_read(from, to, collect_cb, &c) == ESP_OK);
+    *elapsed_ns = host_test_now_ns() - start;
+    host_partition_get_stats(partition, &stats);
+    *read_bytes = stats.read_bytes;
+    CHECK(c.mismatches == 0);
+    return c;
+}
+
+static void open_partition(void)
+{
+    partition = host_partition_add(HISTORY_LOG_PARTITION_LABEL, ESP_PARTITION_TYPE_DATA, 0x40,
+                                   PARTITION_SIZE, image_path);
+    CHECK(partition != NULL);
+    if (partition == NULL) {
+        exit(host_test_result("history_log"));
+    }
+}
+
+/* Scenarios */
+
+static void test_append(void)
+{
+    open_partition();
+    CHECK(history_log_init() == ESP_OK);
+
+    uint64_t worst_ns = 0;
+    uint64_t start = host_test_now_ns();
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        uint64_t t0 = host_test_now_ns();
+        CHECK(append(&samples[i]) == ESP_OK);
+        uint64_t t = host_test_now_ns() - t0;
+        worst_ns = t > worst_ns ? t : worst_ns;
+    }
+    uint64_t elapsed = host_test_now_ns() - start;
+
+    // Out of order and pre-clock samples are dropped
+    CHECK(append(&samples[0]) == ESP_ERR_INVALID_ARG);
+    CHECK(history_log_append(HISTORY_LOG_MIN_TIMESTAMP - 1, 20, 50) == ESP_ERR_INVALID_ARG);
+
+    host_partition_stats_t stats;
+    host_partition_get_stats(partition, &stats);
+    size_t sectors;
+    const uint32_t *erases = host_partition_sector_erases(partition, &sectors);
+    uint32_t erases_min = UINT32_MAX, erases_max = 0;
+    for (size_t i = 0; i < sectors; i++) {
+        erases_min = erases[i] < erases_min ? erases[i] : erases_min;
+        erases_max = erases[i] > erases_max ? erases[i] : erases_max;
+    }
+    CHECK(stats.write_conflicts == 0);
+    // The ring wears all sectors evenly
+    CHECK(erases_max - erases_min <= 1);
+    CHECK(erases_min >= 1);
+
+    printf("append: %d samples in %.1f ms, %.0f ns/sample (worst %.1f us)\n", SAMPLE_COUNT, elapsed / 1e6,
+           (double)elapsed / SAMPLE_COUNT, worst_ns / 1e3);
+    printf("  flash: %u writes, %.2f bytes/sample written, %u sector erases (%u..%u per sector)\n",
+           stats.writes, (double)stats.write_bytes / SAMPLE_COUNT, stats.erases, erases_min, erases_max);
+
+    uint64_t ns, bytes;
+    collect_t all = read_range(0, UINT32_MAX, &ns, &bytes);
+    // The newest samples, buffered ones included, up to the last one appended
+    CHECK(all.count > 0 && all.first + all.count == SAMPLE_COUNT);
+    printf("  retained %zu samples (%.1f days), full read %.2f ms, %llu bytes read\n", all.count,
+           all.count * SAMPLE_INTERVAL_S / 86400.0, ns / 1e6, (unsigned long long)bytes);
+
+    // One hour from the middle of the retained range only touches its blocks
+    const uint32_t from = samples[all.first + all.count / 2].timestamp;
+    collect_t hour = read_range(from, from + RANGE_READ_S - 1, &ns, &bytes);
+    CHECK(hour.count == RANGE_READ_S / SAMPLE_INTERVAL_S);
+    CHECK(bytes <= 3 * HOST_PARTITION_SECTOR_SIZE);
+    printf("  1 h range read: %zu samples in %.1f us, %llu bytes read\n", hour.count, ns / 1e3,
+           (unsigned long long)bytes);
+
+    // Buffered samples survive an orderly restart
+    CHECK(history_log_flush() == ESP_OK);
+}
+
+/**
+ * Boot on the image left by test_append: scan and replay
+ */
+static void test_reboot(void)
+{
+    open_partition();
+
+    host_partition_stats_t stats;
+    uint64_t start = host_test_now_ns();
+    CHECK(history_log_init() == ESP_OK);
+    uint64_t scan_ns = host_test_now_ns() - start;
+    host_partition_get_stats(partition, &stats);
+
+    uint64_t replay_ns, replay_bytes;
+    collect_t all = read_range(0, UINT32_MAX, &replay_ns, &replay_bytes);
+    CHECK(all.count > 0 && all.first + all.count == SAMPLE_COUNT);
+
+    printf("reboot: scan %.1f us (%u reads, %llu bytes), replay of %zu samples %.2f ms (%llu bytes)\n",
+           scan_ns / 1e3, stats.reads, (unsigned long long)stats.read_bytes, all.count, replay_ns / 1e6,
+           (unsigned long long)replay_bytes);
+
+    // New samples go after the replayed ones
+    for (size_t i = SAMPLE_COUNT; i < SAMPLE_COUNT + HISTORY_LOG_BUFFER_RECORDS; i++) {
+        CHECK(append(&samples[i]) == ESP_OK);
+    }
+    all = read_range(0, UINT32_MAX, &replay_ns, &replay_bytes);
+    CHECK(all.first + all.count == SAMPLE_COUNT + HISTORY_LOG_BUFFER_RECORDS);
+}
+
+/**
+ * Power loss in the middle of the next frame write
+ */
+static void test_torn_write(void)
+{
+    open_partition();
+    CHECK(history_log_init() == ESP_OK);
+
+    // The process ends right after the torn write, as the device would
+    host_partition_tear_next_write(partition, 6);
+    esp_err_t ret = ESP_OK;
+    for (size_t i = SAMPLE_COUNT + HISTORY_LOG_BUFFER_RECORDS; i < SAMPLE_COUNT + EXTRA_COUNT; i++) {
+        esp_err_t r = append(&samples[i]);
+        ret = (r != ESP_OK) ? r : ret;
+    }
+    CHECK(ret == ESP_FAIL);
+}
+
+/**
+ * Boot after the power loss: the torn batch is gone, the rest is intact
+ * and the log goes on in a fresh block
+ */
+static void test_recovery(void)
+{
+    open_partition();
+    CHECK(history_log_init() == ESP_OK);
+
+    uint64_t ns, bytes;
+    collect_t all = read_range(0, UINT32_MAX, &ns, &bytes);
+    CHECK(all.count > 0 && all.first + all.count == SAMPLE_COUNT + HISTORY_LOG_BUFFER_RECORDS);
+
+    host_partition_stats_t stats;
+    host_partition_reset_stats(partition);
+    for (size_t i = SAMPLE_COUNT + HISTORY_LOG_BUFFER_RECORDS; i < SAMPLE_COUNT + EXTRA_COUNT; i++) {
+        CHECK(append(&samples[i]) == ESP_OK);
+    }
+    host_partition_get_stats(partition, &stats);
+    CHECK(stats.erases == 1);
+    CHECK(stats.write_conflicts == 0);
+
+    all = read_range(0, UINT32_MAX, &ns, &bytes);
+    CHECK(all.first + all.count == SAMPLE_COUNT + EXTRA_COUNT);
+}
+
+static void run_isolated(void (*scenario)(void), const char *name)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        scenario();
+        fflush(stdout);
+        _exit(host_test_failures > 0 ? 1 : 0);
+    }
+    int status = 0;
+    CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed\n", name);
+        host_test_failures++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <image file>\n", argv[0]);
+        return 2;
+    }
+    image_path = argv[1];
+    unlink(image_path);
+    make_samples(SAMPLE_COUNT + EXTRA_COUNT);
+
+    // Every scenario is a boot of the device on the same flash image
+    run_isolated(test_append, "append");
+    run_isolated(test_reboot, "reboot");
+    run_isolated(test_torn_write, "torn write");
+    run_isolated(test_recovery, "recovery");
+
+    free(samples);
+    return host_test_result("history_log");
+}
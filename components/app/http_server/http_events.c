@@ -0,0 +1,277 @@
+#include "http_events.h"
+#include "http_stats.h"
+#include "app_coordinator.h"
+#include "app_wifi.h"
+#include "sntp_client.h"
+#include "dht_bus.h"
+#include "tasks.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "http_events";
+
+// Time strings are minute resolution, see sntp_client_get_time_string()
+#define EVENTS_TIME_LEN 64
+
+// Open streams: async requests owned by this module until closed. Only
+// events_handler() adds streams, only the broadcast and http_events_stop() remove them.
+static httpd_req_t *subscribers[HTTP_EVENTS_MAX_SUBSCRIBERS];
+static size_t subscriber_count = 0;
+static SemaphoreHandle_t subscribers_mutex = NULL;
+
+// Held for a whole broadcast, so http_events_stop() cannot free a stream mid-send
+static SemaphoreHandle_t broadcast_mutex = NULL;
+
+static dht_bus_subscriber_t *events_dht_subscriber = NULL;
+static TaskHandle_t events_task_handle = NULL;
+static TickType_t last_send_tick = 0;
+
+/**
+ * Close a stream (mutex held)
+ */
+static void events_drop(size_t index)
+{
+    httpd_req_t *req = subscribers[index];
+    httpd_handle_t handle = req->handle;
+    int sockfd = httpd_req_to_sockfd(req);
+
+    httpd_req_async_handler_complete(req);
+    httpd_sess_trigger_close(handle, sockfd);
+
+    subscribers[index] = NULL;
+    subscriber_count--;
+    ESP_LOGI(TAG, "Event stream closed (%zu open)", subscriber_count);
+}
+
+/**
+ * Send an event to every stream, dropping the ones that fail
+ * Sends happen outside subscribers_mutex: a slow client may block for its
+ * send timeout, and events_handler() on the httpd task must not wait for it.
+ */
+static void events_broadcast(const char *buf, size_t len)
+{
+    httpd_req_t *targets[HTTP_EVENTS_MAX_SUBSCRIBERS];
+    bool failed[HTTP_EVENTS_MAX_SUBSCRIBERS] = {false};
+
+    xSemaphoreTake(broadcast_mutex, portMAX_DELAY);
+
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    memcpy(targets, subscribers, sizeof(targets));
+    xSemaphoreGive(subscribers_mutex);
+
+    for (size_t i = 0; i < HTTP_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (targets[i] != NULL && httpd_resp_send_chunk(targets[i], buf, len) != ESP_OK) {
+            failed[i] = true;
+        }
+    }
+
+    // Streams opened meanwhile only took free slots, so failed ones are still in place
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < HTTP_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (failed[i]) {
+            events_drop(i);
+        }
+    }
+    xSemaphoreGive(subscribers_mutex);
+
+    last_send_tick = xTaskGetTickCount();
+    xSemaphoreGive(broadcast_mutex);
+}
+
+static int events_format_sensor(char *buf, size_t size, float temperature, float humidity)
+{
+    // Same fields as /dhtSensor.json
+    return snprintf(buf, size, "event: sensor\ndata: {\"temp\":\"%.1f°C\",\"humidity\":\"%.1f%%\"}\n\n",
+                    temperature, humidity);
+}
+
+static int events_format_status(char *buf, size_t size, wifi_app_connection_status_e status)
+{
+    // Same fields as /wifiConnectStatus
+    return snprintf(buf, size, "event: status\ndata: {\"wifi_connect_status\":%d}\n\n", status);
+}
+
+static int events_format_time(char *buf, size_t size, const char *time_str)
+{
+    // Same fields as /localTime.json
+    return snprintf(buf, size, "event: time\ndata: {\"time\":\"%s\"}\n\n", time_str);
+}
+
+static void events_get_time(char *time_str, size_t size)
+{
+    if (sntp_client_get_time_string(time_str, size) != ESP_OK) {
+        strlcpy(time_str, "Time not available", size);
+    }
+}
+
+/**
+ * Event task
+ * Wakes on every DHT sample and at least once per second to check for
+ * status and time changes.
+ */
+static void http_events_task(void *pvParameters)
+{
+    char buf[192];
+    char time_str[EVENTS_TIME_LEN];
+    char last_time[EVENTS_TIME_LEN];
+    wifi_app_connection_status_e last_status = wifi_app_get_connection_status();
+    events_get_time(last_time, sizeof(last_time));
+
+    ESP_LOGI(TAG, "Event task started");
+
+    while (1) {
+        dht_sample_t sample;
+        esp_err_t ret = dht_bus_receive(events_dht_subscriber, &sample, pdMS_TO_TICKS(1000));
+
+        // Nothing to format without listeners, but keep the change trackers current
+        const bool listening = (subscriber_count > 0);
+
+        if (ret == ESP_OK && sample.data.sensor_id == 0 && listening) {
+            int len = events_format_sensor(buf, sizeof(buf), sample.data.temperature, sample.data.humidity);
+            events_broadcast(buf, len);
+        }
+
+        wifi_app_connection_status_e status = wifi_app_get_connection_status();
+        if (status != last_status) {
+            last_status = status;
+            if (listening) {
+                int len = events_format_status(buf, sizeof(buf), status);
+                events_broadcast(buf, len);
+            }
+        }
+
+        events_get_time(time_str, sizeof(time_str));
+        if (strcmp(time_str, last_time) != 0) {
+            strlcpy(last_time, time_str, sizeof(last_time));
+            if (listening) {
+                int len = events_format_time(buf, sizeof(buf), time_str);
+                events_broadcast(buf, len);
+            }
+        }
+
+        if (listening && xTaskGetTickCount() - last_send_tick >= pdMS_TO_TICKS(HTTP_EVENTS_HEARTBEAT_MS)) {
+            // SSE comment line: ignored by EventSource, detects dead streams
+            events_broadcast(": ping\n\n", 8);
+        }
+    }
+}
+
+/**
+ * Events handler - opens a Server-Sent Events stream
+ * The current state is sent right away, then the stream is handed to the
+ * event task and the httpd task is free again.
+ */
+static esp_err_t events_handler(httpd_req_t *req)
+{
+    // A free slot stays free until this handler fills it: only this handler adds streams
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    size_t slot = HTTP_EVENTS_MAX_SUBSCRIBERS;
+    for (size_t i = 0; i < HTTP_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    xSemaphoreGive(subscribers_mutex);
+
+    if (slot == HTTP_EVENTS_MAX_SUBSCRIBERS) {
+        // EventSource gives up on a non-200 response; app.js then falls back to polling
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "30");
+        httpd_resp_sendstr(req, "Too many event streams");
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "text/event-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    char buf[384];
+    int len = snprintf(buf, sizeof(buf), "retry: %d\n\n", HTTP_EVENTS_RETRY_MS);
+
+    app_coordinator_sensor_data_t data;
+    if (app_coordinator_get_sensor_data(&data) == ESP_OK) {
+        len += events_format_sensor(buf + len, sizeof(buf) - len, data.temperature, data.humidity);
+    }
+    len += events_format_status(buf + len, sizeof(buf) - len, wifi_app_get_connection_status());
+
+    char time_str[EVENTS_TIME_LEN];
+    events_get_time(time_str, sizeof(time_str));
+    len += events_format_time(buf + len, sizeof(buf) - len, time_str);
+
+    httpd_req_t *async_req = NULL;
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK ||
+        httpd_req_async_handler_begin(req, &async_req) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open event stream");
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    subscribers[slot] = async_req;
+    subscriber_count++;
+    xSemaphoreGive(subscribers_mutex);
+
+    ESP_LOGI(TAG, "Event stream opened (%zu open)", subscriber_count);
+    return ESP_OK;
+}
+
+esp_err_t http_events_start(httpd_handle_t server)
+{
+    if (events_task_handle == NULL) {
+        subscribers_mutex = xSemaphoreCreateMutex();
+        broadcast_mutex = xSemaphoreCreateMutex();
+        if (subscribers_mutex == NULL || broadcast_mutex == NULL) {
+            ESP_LOGE(TAG, "Failed to create subscribers mutex");
+            return ESP_ERR_NO_MEM;
+        }
+
+        events_dht_subscriber = dht_bus_subscribe();
+        if (events_dht_subscriber == NULL) {
+            ESP_LOGE(TAG, "Failed to subscribe to DHT samples");
+            return ESP_FAIL;
+        }
+
+        BaseType_t ret = xTaskCreatePinnedToCore(
+            http_events_task,
+            "http_events",
+            HTTP_EVENTS_TASK_STACK_SIZE,
+            NULL,
+            HTTP_EVENTS_TASK_PRIORITY,
+            &events_task_handle,
+            HTTP_EVENTS_TASK_CORE_ID);
+
+        if (ret != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create event task");
+            return ESP_FAIL;
+        }
+    }
+
+    httpd_uri_t events_uri = {
+        .uri = "/events",
+        .method = HTTP_GET,
+        .handler = events_handler,
+        .user_ctx = NULL
+    };
+    return http_stats_register_uri(server, &events_uri);
+}
+
+void http_events_stop(void)
+{
+    if (subscribers_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(broadcast_mutex, portMAX_DELAY);
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < HTTP_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i] != NULL) {
+            events_drop(i);
+        }
+    }
+    xSemaphoreGive(subscribers_mutex);
+    xSemaphoreGive(broadcast_mutex);
+}
@@ -0,0 +1,32 @@
+#ifndef HTTP_EVENTS_H
+#define HTTP_EVENTS_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Maximum number of concurrent /events streams (one per AP client)
+#define HTTP_EVENTS_MAX_SUBSCRIBERS 5
+
+// A comment line is sent after this much silence to keep streams alive
+#define HTTP_EVENTS_HEARTBEAT_MS 15000
+
+// Reconnect delay advertised to EventSource clients
+#define HTTP_EVENTS_RETRY_MS 5000
+
+/**
+ * Register the /events Server-Sent Events endpoint
+ * Starts the event task on first use. Streams push "sensor" on every new
+ * sample and "status"/"time" when they change.
+ *
+ * @param server HTTP server handle
+ * @return ESP_OK on success
+ */
+esp_err_t http_events_start(httpd_handle_t server);
+
+/**
+ * Close all event streams
+ * Must be called before the server is stopped.
+ */
+void http_events_stop(void);
+
+#endif // HTTP_EVENTS_H
@@ -0,0 +1,205 @@
+#include "http_metrics.h"
+#include "http_stats.h"
+#include "app_coordinator.h"
+#include "app_wifi.h"
+#include "dns_server.h"
+#include "ota_update.h"
+#include "dht_reader.h"
+#include "esp_log.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+static const char *TAG = "http_metrics";
+
+// Output buffer, sent as a chunk whenever the next line does not fit
+#define METRICS_BUF_SIZE 512
+
+/**
+ * Exposition output state
+ */
+typedef struct {
+    httpd_req_t *req;
+    esp_err_t err;
+    size_t len;
+    char buf[METRICS_BUF_SIZE];
+} metrics_out_t;
+
+static void metrics_flush(metrics_out_t *out)
+{
+    if (out->err == ESP_OK && out->len > 0) {
+        out->err = httpd_resp_send_chunk(out->req, out->buf, out->len);
+    }
+    out->len = 0;
+}
+
+/**
+ * Append a line, flushing first if it does not fit
+ */
+static void metrics_printf(metrics_out_t *out, const char *fmt, ...)
+{
+    if (out->err != ESP_OK) {
+        return;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_list args;
+        va_start(args, fmt);
+        const size_t space = sizeof(out->buf) - out->len;
+        int len = vsnprintf(out->buf + out->len, space, fmt, args);
+        va_end(args);
+
+        if (len >= 0 && (size_t)len < space) {
+            out->len += len;
+            return;
+        }
+        metrics_flush(out);
+    }
+    // Longer than the whole buffer: no line we write gets there
+    ESP_LOGW(TAG, "Metric line too long, skipped");
+}
+
+/**
+ * Write the HELP and TYPE lines of a metric
+ */
+static void metrics_header(metrics_out_t *out, const char *name, const char *type, const char *help)
+{
+    metrics_printf(out, "# HELP " HTTP_METRICS_PREFIX "%s %s\n# TYPE " HTTP_METRICS_PREFIX "%s %s\n",
+                   name, help, name, type);
+}
+
+static void metrics_gauge(metrics_out_t *out, const char *name, const char *help, double value)
+{
+    metrics_header(out, name, "gauge", help);
+    metrics_printf(out, HTTP_METRICS_PREFIX "%s %.2f\n", name, value);
+}
+
+static void metrics_gauge_int(metrics_out_t *out, const char *name, const char *help, int64_t value)
+{
+    metrics_header(out, name, "gauge", help);
+    metrics_printf(out, HTTP_METRICS_PREFIX "%s %" PRId64 "\n", name, value);
+}
+
+static void metrics_counter(metrics_out_t *out, const char *name, const char *help, uint32_t value)
+{
+    metrics_header(out, name, "counter", help);
+    metrics_printf(out, HTTP_METRICS_PREFIX "%s %" PRIu32 "\n", name, value);
+}
+
+static void metrics_write_sensor(metrics_out_t *out)
+{
+    app_coordinator_sensor_data_t data;
+    if (app_coordinator_get_sensor_data(&data) == ESP_OK) {
+        metrics_gauge(out, "temperature_celsius", "Latest temperature reading.", data.temperature);
+        metrics_gauge(out, "humidity_percent", "Latest relative humidity reading.", data.humidity);
+        metrics_gauge_int(out, "sensor_last_update_timestamp_seconds",
+                          "Time of the latest reading.", data.timestamp);
+    }
+
+    const size_t sensors = dht_get_sensor_count();
+    dht_stats_t stats[DHT_MAX_SENSORS];
+    for (size_t i = 0; i < sensors; i++) {
+        dht_get_stats(i, &stats[i]);
+    }
+
+    metrics_header(out, "dht_reads_total", "counter", "DHT read attempts.");
+    for (size_t i = 0; i < sensors; i++) {
+        metrics_printf(out, HTTP_METRICS_PREFIX "dht_reads_total{sensor=\"%zu\"} %" PRIu32 "\n",
+                       i, stats[i].reads);
+    }
+    metrics_header(out, "dht_read_failures_total", "counter", "Failed DHT reads.");
+    for (size_t i = 0; i < sensors; i++) {
+        metrics_printf(out, HTTP_METRICS_PREFIX "dht_read_failures_total{sensor=\"%zu\"} %" PRIu32 "\n",
+                       i, stats[i].failures);
+    }
+    metrics_header(out, "dht_consecutive_failures", "gauge", "Failed DHT reads since the last good one.");
+    for (size_t i = 0; i < sensors; i++) {
+        metrics_printf(out, HTTP_METRICS_PREFIX "dht_consecutive_failures{sensor=\"%zu\"} %" PRIu32 "\n",
+                       i, stats[i].consecutive_failures);
+    }
+}
+
+static void metrics_write_system(metrics_out_t *out)
+{
+    app_coordinator_system_info_t info;
+    if (app_coordinator_get_system_info(&info) != ESP_OK) {
+        return;
+    }
+
+    metrics_gauge_int(out, "heap_free_bytes", "Free heap.", info.heap_free);
+    metrics_gauge_int(out, "heap_min_free_bytes", "Lowest free heap since boot.", info.heap_min);
+    metrics_counter(out, "uptime_seconds_total", "Seconds since boot.", info.uptime_seconds);
+    metrics_header(out, "build_info", "gauge", "Firmware build, always 1.");
+    metrics_printf(out, HTTP_METRICS_PREFIX "build_info{version=\"%s\",date=\"%s\",time=\"%s\"} 1\n",
+                   info.firmware_version, info.compile_date, info.compile_time);
+}
+
+static void metrics_write_wifi(metrics_out_t *out)
+{
+    const wifi_app_connection_status_e status = wifi_app_get_connection_status();
+
+    metrics_gauge_int(out, "wifi_connection_status",
+                      "STA state: 0 disconnected, 1 connecting, 2 failed, 3 connected.", status);
+    metrics_counter(out, "wifi_connect_retries_total", "STA connection retries.",
+                    wifi_app_get_retry_count());
+    if (status == WIFI_STATUS_CONNECTED) {
+        metrics_gauge_int(out, "wifi_rssi_dbm", "Signal strength of the STA connection.",
+                          wifi_app_get_rssi());
+    }
+}
+
+static void metrics_write_dns(metrics_out_t *out)
+{
+    metrics_counter(out, "dns_queries_total", "Captive portal DNS queries answered.",
+                    dns_server_get_query_count());
+}
+
+static void metrics_write_ota(metrics_out_t *out)
+{
+    app_coordinator_ota_status_t status;
+    if (app_coordinator_get_ota_status(&status) == ESP_OK) {
+        metrics_gauge_int(out, "ota_status", "Last OTA result: -1 error, 0 idle, 1 complete.",
+                          status.status);
+    }
+    metrics_gauge_int(out, "ota_progress_percent", "Progress of the running OTA update.",
+                      ota_update_get_progress());
+}
+
+/**
+ * Metrics handler - Prometheus text exposition
+ * Values are formatted straight into one stack buffer and sent in chunks,
+ * nothing is allocated.
+ */
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    metrics_out_t out = {
+        .req = req,
+        .err = ESP_OK,
+    };
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4; charset=utf-8");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    metrics_write_sensor(&out);
+    metrics_write_system(&out);
+    metrics_write_wifi(&out);
+    metrics_write_dns(&out);
+    metrics_write_ota(&out);
+
+    metrics_flush(&out);
+    if (out.err != ESP_OK) {
+        return out.err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t http_metrics_start(httpd_handle_t server)
+{
+    httpd_uri_t metrics_uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_handler,
+        .user_ctx = NULL
+    };
+    return http_stats_register_uri(server, &metrics_uri);
+}
@@ -0,0 +1,20 @@
+#ifndef HTTP_METRICS_H
+#define HTTP_METRICS_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Prefix of every exported metric name
+#define HTTP_METRICS_PREFIX "esp32_"
+
+/**
+ * Register the /metrics endpoint
+ * Serves sensor, system, WiFi, DNS and OTA gauges and counters in the
+ * Prometheus text format.
+ *
+ * @param server HTTP server handle
+ * @return ESP_OK on success
+ */
+esp_err_t http_metrics_start(httpd_handle_t server);
+
+#endif // HTTP_METRICS_H
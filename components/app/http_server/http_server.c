@@ -1,18 +1,64 @@
 #include "http_server.h"
+#include "http_events.h"
+#include "http_stats.h"
+#include "http_metrics.h"
+#include "http_workers.h"
 #include "app_coordinator.h"
 #include "app_wifi.h"
 #include "sntp_client.h"
 #include "ota_update.h"
+#include "ota_pipeline.h"
+#include "esp_ota_ops.h"
+#include "multipart_parser.h"
+#include "sensor_history.h"
+#include "history_log.h"
+#include "series_codec.h"
 #include "esp_log.h"
 #include "esp_http_server.h"
-#include "cJSON.h"
+#include "json_writer.h"
+#include "tasks.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <inttypes.h>
 #include <string.h>
+#include <strings.h>
+#include <stdlib.h>
 
 static const char *TAG = "http_server";
 
+// Stack buffer for JSON responses; longer output is sent in chunks
+#define JSON_RESPONSE_BUF_SIZE 512
+
+// History points fetched per batch while streaming /history.json
+#define HISTORY_BATCH_POINTS 32
+
+// Export stream magic, followed by frames and a zero-count end frame
+#define HISTORY_EXPORT_MAGIC "HSX1"
+
+// Largest export frame: 2-byte count, 2-byte size, payload
+#define HISTORY_EXPORT_FRAME_MAX (4 + SERIES_CODEC_MAX_BYTES(HISTORY_LOG_BUFFER_RECORDS))
+
+// Requests waiting for a WiFi scan at most
+#define SCAN_MAX_WAITERS 4
+
+// Largest chunk of a resumable OTA upload (held in RAM for its CRC check)
+#define OTA_SESSION_CHUNK_MAX 16384
+
+// Consecutive receive timeouts (recv_wait_timeout each) before an OTA
+// upload counts as dropped: a peer that lost its link may never close
+#define OTA_RECV_MAX_TIMEOUTS 3
+
+// OTA receive buffer when not pipelined (same size as the pipeline's)
+#define OTA_RECV_BUF_SIZE OTA_PIPELINE_BUFFER_SIZE
+
 // HTTP server handle
 static httpd_handle_t server = NULL;
 
+// Requests parked until the running WiFi scan completes
+static httpd_req_t *scan_waiters[SCAN_MAX_WAITERS];
+static SemaphoreHandle_t scan_waiters_mutex = NULL;
+
 // Embedded file declarations (will be populated by CMake)
 extern const uint8_t index_html_start[] asm("_binary_index_html_start");
 extern const uint8_t index_html_end[] asm("_binary_index_html_end");
@@ -25,53 +71,152 @@ extern const uint8_t jquery_3_3_1_min_js_end[] asm("_binary_jquery_3_3_1_min_js_
 extern const uint8_t favicon_ico_start[] asm("_binary_favicon_ico_start");
 extern const uint8_t favicon_ico_end[] asm("_binary_favicon_ico_end");
 
+// Gzip-compressed copies, generated at build time
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+extern const uint8_t app_css_gz_start[] asm("_binary_app_css_gz_start");
+extern const uint8_t app_css_gz_end[] asm("_binary_app_css_gz_end");
+extern const uint8_t app_js_gz_start[] asm("_binary_app_js_gz_start");
+extern const uint8_t app_js_gz_end[] asm("_binary_app_js_gz_end");
+extern const uint8_t jquery_3_3_1_min_js_gz_start[] asm("_binary_jquery_3_3_1_min_js_gz_start");
+extern const uint8_t jquery_3_3_1_min_js_gz_end[] asm("_binary_jquery_3_3_1_min_js_gz_end");
+extern const uint8_t favicon_ico_gz_start[] asm("_binary_favicon_ico_gz_start");
+extern const uint8_t favicon_ico_gz_end[] asm("_binary_favicon_ico_gz_end");
+
+// Files that change with the firmware: always revalidate (answered with 304)
+#define CACHE_CONTROL_REVALIDATE "no-cache"
+
+// Versioned or effectively static files: cache for a year
+#define CACHE_CONTROL_IMMUTABLE "public, max-age=31536000, immutable"
+
 /**
- * Root handler - serves index.html
+ * Embedded static file
+ * ETags are CRC32 content hashes computed at startup, one per encoding.
  */
-static esp_err_t root_handler(httpd_req_t *req)
-{
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, (const char *)index_html_start, index_html_end - index_html_start);
-    return ESP_OK;
-}
+typedef struct {
+    const char *uri;
+    const char *type;
+    const char *cache_control;
+    const uint8_t *start;
+    const uint8_t *end;
+    const uint8_t *gz_start;
+    const uint8_t *gz_end;
+    char etag[12];      // "xxxxxxxx" with quotes
+    char etag_gz[15];   // "xxxxxxxx-gz" with quotes
+} static_asset_t;
+
+static static_asset_t static_assets[] = {
+    { "/", "text/html", CACHE_CONTROL_REVALIDATE,
+      index_html_start, index_html_end, index_html_gz_start, index_html_gz_end },
+    { "/app.css", "text/css", CACHE_CONTROL_REVALIDATE,
+      app_css_start, app_css_end, app_css_gz_start, app_css_gz_end },
+    { "/app.js", "application/javascript", CACHE_CONTROL_REVALIDATE,
+      app_js_start, app_js_end, app_js_gz_start, app_js_gz_end },
+    { "/jquery-3.3.1.min.js", "application/javascript", CACHE_CONTROL_IMMUTABLE,
+      jquery_3_3_1_min_js_start, jquery_3_3_1_min_js_end,
+      jquery_3_3_1_min_js_gz_start, jquery_3_3_1_min_js_gz_end },
+    { "/favicon.ico", "image/x-icon", CACHE_CONTROL_IMMUTABLE,
+      favicon_ico_start, favicon_ico_end, favicon_ico_gz_start, favicon_ico_gz_end },
+};
 
 /**
- * CSS file handler
+ * Compute the ETags of all static assets
  */
-static esp_err_t css_handler(httpd_req_t *req)
+static void static_assets_init(void)
 {
-    httpd_resp_set_type(req, "text/css");
-    httpd_resp_send(req, (const char *)app_css_start, app_css_end - app_css_start);
-    return ESP_OK;
+    for (size_t i = 0; i < sizeof(static_assets) / sizeof(static_assets[0]); i++) {
+        static_asset_t *asset = &static_assets[i];
+        uint32_t crc = esp_rom_crc32_le(0, asset->start, asset->end - asset->start);
+        uint32_t crc_gz = esp_rom_crc32_le(0, asset->gz_start, asset->gz_end - asset->gz_start);
+        snprintf(asset->etag, sizeof(asset->etag), "\"%08" PRIx32 "\"", crc);
+        snprintf(asset->etag_gz, sizeof(asset->etag_gz), "\"%08" PRIx32 "-gz\"", crc_gz);
+    }
 }
 
 /**
- * JavaScript file handler
+ * Check whether a request header contains a token
  */
-static esp_err_t js_handler(httpd_req_t *req)
+static bool request_header_contains(httpd_req_t *req, const char *field, const char *token)
 {
-    httpd_resp_set_type(req, "application/javascript");
-    httpd_resp_send(req, (const char *)app_js_start, app_js_end - app_js_start);
-    return ESP_OK;
+    char value[128];
+    if (httpd_req_get_hdr_value_str(req, field, value, sizeof(value)) != ESP_OK) {
+        // Missing, or longer than any value we care about
+        return false;
+    }
+    return strstr(value, token) != NULL;
 }
 
 /**
- * jQuery library handler
+ * Check whether the client accepts a gzip response
+ * Parses Accept-Encoding as comma-separated codings with an optional
+ * quality: "gzip" or "x-gzip" with q=0 is a refusal, and "*" counts for
+ * gzip when gzip is not listed.
  */
-static esp_err_t jquery_handler(httpd_req_t *req)
+static bool request_accepts_gzip(httpd_req_t *req)
 {
-    httpd_resp_set_type(req, "application/javascript");
-    httpd_resp_send(req, (const char *)jquery_3_3_1_min_js_start, jquery_3_3_1_min_js_end - jquery_3_3_1_min_js_start);
-    return ESP_OK;
+    char value[128];
+    if (httpd_req_get_hdr_value_str(req, "Accept-Encoding", value, sizeof(value)) != ESP_OK) {
+        return false;
+    }
+
+    int gzip = -1;      // -1 not listed, 0 refused, 1 accepted
+    int any = -1;
+    char *save;
+    for (char *coding = strtok_r(value, ",", &save); coding != NULL; coding = strtok_r(NULL, ",", &save)) {
+        char *params = strchr(coding, ';');
+        if (params != NULL) {
+            *params++ = '\0';
+        }
+        coding += strspn(coding, " \t");
+        coding[strcspn(coding, " \t")] = '\0';
+
+        // Only the quality matters; q=0 (0, 0.0, 0.000...) refuses the coding
+        bool accepted = true;
+        for (char *param = params; param != NULL && *param != '\0';) {
+            param += strspn(param, " \t;");
+            if (strncasecmp(param, "q=", 2) == 0) {
+                accepted = strtod(param + 2, NULL) > 0;
+            }
+            param = strchr(param, ';');
+        }
+
+        if (strcasecmp(coding, "gzip") == 0 || strcasecmp(coding, "x-gzip") == 0) {
+            gzip = accepted;
+        } else if (strcmp(coding, "*") == 0) {
+            any = accepted;
+        }
+    }
+    return (gzip >= 0) ? gzip == 1 : any == 1;
 }
 
 /**
- * Favicon handler
+ * Static file handler - serves an embedded asset (user_ctx)
+ * Sends the gzip copy when the client accepts it and answers a matching
+ * If-None-Match with 304 Not Modified.
  */
-static esp_err_t favicon_handler(httpd_req_t *req)
+static esp_err_t static_asset_handler(httpd_req_t *req)
 {
-    httpd_resp_set_type(req, "image/x-icon");
-    httpd_resp_send(req, (const char *)favicon_ico_start, favicon_ico_end - favicon_ico_start);
+    const static_asset_t *asset = req->user_ctx;
+    const bool gzip = request_accepts_gzip(req);
+    const char *etag = gzip ? asset->etag_gz : asset->etag;
+    
+    httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    
+    if (request_header_contains(req, "If-None-Match", etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
+    
+    httpd_resp_set_type(req, asset->type);
+    if (gzip) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        httpd_resp_send(req, (const char *)asset->gz_start, asset->gz_end - asset->gz_start);
+    } else {
+        httpd_resp_send(req, (const char *)asset->start, asset->end - asset->start);
+    }
     return ESP_OK;
 }
 
@@ -90,74 +235,313 @@ static esp_err_t captive_portal_handler(httpd_req_t *req)
 }
 
 /**
- * AP SSID handler - returns ESP32 AP SSID
+ * JSON response flush callback, sends the buffer as a chunk
  */
-static esp_err_t ap_ssid_handler(httpd_req_t *req)
+static esp_err_t json_flush_chunk(const char *data, size_t len, void *ctx)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+/**
+ * Start a JSON response written with json_writer
+ * Output goes to buf and is sent in chunks whenever buf fills up, so no
+ * heap is used whatever the response size.
+ */
+static void json_response_begin(httpd_req_t *req, json_writer_t *w, char *buf, size_t size)
 {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "ssid", WIFI_AP_SSID);
-    
-    const char *json_str = cJSON_PrintUnformatted(root);
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_str, strlen(json_str));
-    
-    free((void *)json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+    json_writer_init(w, buf, size, json_flush_chunk, req);
 }
 
 /**
- * DHT sensor handler - returns temperature and humidity
+ * Finish a JSON response
+ * A response that fit in the buffer is sent in one piece with a
+ * Content-Length, anything longer ends the chunked transfer.
  */
-static esp_err_t dht_sensor_handler(httpd_req_t *req)
+static esp_err_t json_response_end(httpd_req_t *req, json_writer_t *w)
+{
+    esp_err_t ret = json_writer_error(w);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (!w->flushed) {
+        return httpd_resp_send(req, w->buf, w->len);
+    }
+    ret = httpd_resp_send_chunk(req, w->buf, w->len);
+    if (ret == ESP_OK) {
+        ret = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return ret;
+}
+
+/**
+ * Status section writers
+ * Each writes the object of one endpoint, so the single endpoints and
+ * /status.json return the same fields. Data is fetched before anything is
+ * written: on error the output is untouched.
+ */
+static esp_err_t json_write_ssid(json_writer_t *w, const char *key)
+{
+    json_writer_object_begin(w, key);
+    json_writer_string(w, "ssid", WIFI_AP_SSID);
+    json_writer_object_end(w);
+    return ESP_OK;
+}
+
+static esp_err_t json_write_sensor(json_writer_t *w, const char *key)
+{
+    char json[APP_COORDINATOR_JSON_MAX];
+    size_t len;
+    esp_err_t ret = app_coordinator_get_json(APP_COORDINATOR_JSON_SENSOR, json, sizeof(json), &len, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    json_writer_raw(w, key, json, len);
+    return ESP_OK;
+}
+
+static esp_err_t json_write_time(json_writer_t *w, const char *key)
 {
-    app_coordinator_sensor_data_t data;
-    esp_err_t ret = app_coordinator_get_sensor_data(&data);
+    char time_str[128] = {0};
+    esp_err_t ret = sntp_client_get_time_string(time_str, sizeof(time_str));
     
     if (ret != ESP_OK) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sensor unavailable");
-        return ESP_FAIL;
+        strcpy(time_str, "Time not available");
     }
     
-    cJSON *root = cJSON_CreateObject();
-    char temp_str[32], humidity_str[32];
-    snprintf(temp_str, sizeof(temp_str), "%.1f°C", data.temperature);
-    snprintf(humidity_str, sizeof(humidity_str), "%.1f%%", data.humidity);
+    json_writer_object_begin(w, key);
+    json_writer_string(w, "time", time_str);
+    json_writer_object_end(w);
+    return ESP_OK;
+}
+
+static esp_err_t json_write_system(json_writer_t *w, const char *key)
+{
+    char json[APP_COORDINATOR_JSON_MAX];
+    size_t len;
+    esp_err_t ret = app_coordinator_get_json(APP_COORDINATOR_JSON_SYSTEM, json, sizeof(json), &len, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
     
-    cJSON_AddStringToObject(root, "temp", temp_str);
-    cJSON_AddStringToObject(root, "humidity", humidity_str);
+    json_writer_raw(w, key, json, len);
+    return ESP_OK;
+}
+
+static esp_err_t json_write_ota(json_writer_t *w, const char *key)
+{
+    app_coordinator_ota_status_t status;
+    esp_err_t ret = app_coordinator_get_ota_status(&status);
+    if (ret != ESP_OK) {
+        return ret;
+    }
     
-    const char *json_str = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_str, strlen(json_str));
+    json_writer_object_begin(w, key);
+    json_writer_int(w, "ota_update_status", status.status);
+    json_writer_string(w, "compile_date", status.compile_date);
+    json_writer_string(w, "compile_time", status.compile_time);
+    
+    ota_pipeline_timing_t timing;
+    if (ota_pipeline_get_timing(&timing) == ESP_OK) {
+        json_writer_object_begin(w, "timing");
+        json_writer_int(w, "bytes", timing.bytes);
+        json_writer_int(w, "recv_ms", timing.recv_us / 1000);
+        json_writer_int(w, "recv_stall_ms", timing.recv_stall_us / 1000);
+        json_writer_int(w, "begin_ms", timing.begin_us / 1000);
+        json_writer_int(w, "write_ms", timing.write_us / 1000);
+        // Whether erasing is counted in write_ms (sector by sector) or begin_ms (up front)
+        json_writer_bool(w, "erase_in_write", OTA_UPDATE_STREAMING_ERASE);
+        json_writer_int(w, "verify_ms", timing.verify_us / 1000);
+        json_writer_int(w, "write_idle_ms", timing.write_idle_us / 1000);
+        json_writer_object_end(w);
+    }
+    json_writer_object_end(w);
+    return ESP_OK;
+}
+
+static void json_write_wifi_status_fields(json_writer_t *w)
+{
+    json_writer_int(w, "wifi_connect_status", wifi_app_get_connection_status());
+}
+
+static void json_write_wifi_info_fields(json_writer_t *w)
+{
+    wifi_app_connection_info_t info;
+    esp_err_t ret = wifi_app_get_connection_info(&info);
     
-    free((void *)json_str);
-    cJSON_Delete(root);
+    if (ret == ESP_OK) {
+        json_writer_string(w, "ap", info.ssid);
+        json_writer_string(w, "ip", info.ip);
+        json_writer_string(w, "netmask", info.netmask);
+        json_writer_string(w, "gw", info.gateway);
+    } else {
+        json_writer_string(w, "ap", "");
+        json_writer_string(w, "ip", "");
+        json_writer_string(w, "netmask", "");
+        json_writer_string(w, "gw", "");
+    }
+}
+
+static esp_err_t json_write_wifi_status(json_writer_t *w, const char *key)
+{
+    json_writer_object_begin(w, key);
+    json_write_wifi_status_fields(w);
+    json_writer_object_end(w);
+    return ESP_OK;
+}
+
+static esp_err_t json_write_wifi_info(json_writer_t *w, const char *key)
+{
+    json_writer_object_begin(w, key);
+    json_write_wifi_info_fields(w);
+    json_writer_object_end(w);
+    return ESP_OK;
+}
+
+static esp_err_t json_write_wifi(json_writer_t *w, const char *key)
+{
+    json_writer_object_begin(w, key);
+    json_write_wifi_status_fields(w);
+    json_write_wifi_info_fields(w);
+    json_writer_object_end(w);
     return ESP_OK;
 }
 
 /**
- * Local time handler - returns formatted local time
+ * /status.json sections, selectable with ?fields=
  */
-static esp_err_t local_time_handler(httpd_req_t *req)
+typedef struct {
+    const char *name;
+    esp_err_t (*write)(json_writer_t *w, const char *key);
+} status_section_t;
+
+static const status_section_t status_sections[] = {
+    { "ssid", json_write_ssid },
+    { "sensor", json_write_sensor },
+    { "time", json_write_time },
+    { "wifi", json_write_wifi },
+    { "ota", json_write_ota },
+    { "system", json_write_system },
+};
+
+#define STATUS_SECTION_COUNT (sizeof(status_sections) / sizeof(status_sections[0]))
+
+/**
+ * Status handler - returns several endpoints in one response
+ * Query: fields=ssid,sensor,time,wifi,ota,system (default all).
+ * Every section holds the fields of its single endpoint; a section whose
+ * data is unavailable (e.g. no sensor reading yet) is null.
+ */
+static esp_err_t status_handler(httpd_req_t *req)
 {
-    char time_str[128] = {0};
-    esp_err_t ret = sntp_client_get_time_string(time_str, sizeof(time_str));
+    uint32_t selected = (1u << STATUS_SECTION_COUNT) - 1;
+    
+    char query[96];
+    char fields[80];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "fields", fields, sizeof(fields)) == ESP_OK) {
+        selected = 0;
+        char *save = NULL;
+        for (char *name = strtok_r(fields, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+            size_t i;
+            for (i = 0; i < STATUS_SECTION_COUNT; i++) {
+                if (strcmp(name, status_sections[i].name) == 0) {
+                    selected |= 1u << i;
+                    break;
+                }
+            }
+            if (i == STATUS_SECTION_COUNT) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown field");
+                return ESP_FAIL;
+            }
+        }
+    }
     
-    if (ret != ESP_OK) {
-        strcpy(time_str, "Time not available");
+    char buf[JSON_RESPONSE_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &w, buf, sizeof(buf));
+    
+    json_writer_object_begin(&w, NULL);
+    for (size_t i = 0; i < STATUS_SECTION_COUNT; i++) {
+        if ((selected & (1u << i)) &&
+            status_sections[i].write(&w, status_sections[i].name) != ESP_OK) {
+            json_writer_null(&w, status_sections[i].name);
+        }
     }
+    json_writer_object_end(&w);
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "time", time_str);
+    return json_response_end(req, &w);
+}
+
+/**
+ * Send one status section as the whole response
+ */
+static esp_err_t send_status_section(httpd_req_t *req, esp_err_t (*write)(json_writer_t *w, const char *key),
+                                     const char *error_msg)
+{
+    char buf[JSON_RESPONSE_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &w, buf, sizeof(buf));
     
-    const char *json_str = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_str, strlen(json_str));
+    if (write(&w, NULL) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, error_msg);
+        return ESP_FAIL;
+    }
+    return json_response_end(req, &w);
+}
+
+/**
+ * Send a response pre-rendered by the coordinator
+ * The data version is the ETag: a poll that finds no new data gets a 304
+ * without a body, and a new one costs a copy of the cached bytes.
+ */
+static esp_err_t send_cached_json(httpd_req_t *req, app_coordinator_json_t which, const char *error_msg)
+{
+    char json[APP_COORDINATOR_JSON_MAX];
+    size_t len;
+    uint32_t version;
+    if (app_coordinator_get_json(which, json, sizeof(json), &len, &version) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, error_msg);
+        return ESP_FAIL;
+    }
     
-    free((void *)json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"%d-%08" PRIx32 "\"", which, version);
+    httpd_resp_set_hdr(req, "Cache-Control", CACHE_CONTROL_REVALIDATE);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    
+    if (request_header_contains(req, "If-None-Match", etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, json, len);
+}
+
+/**
+ * AP SSID handler - returns ESP32 AP SSID
+ */
+static esp_err_t ap_ssid_handler(httpd_req_t *req)
+{
+    return send_status_section(req, json_write_ssid, NULL);
+}
+
+/**
+ * DHT sensor handler - returns temperature and humidity
+ */
+static esp_err_t dht_sensor_handler(httpd_req_t *req)
+{
+    return send_cached_json(req, APP_COORDINATOR_JSON_SENSOR, "Sensor unavailable");
+}
+
+/**
+ * Local time handler - returns formatted local time
+ */
+static esp_err_t local_time_handler(httpd_req_t *req)
+{
+    return send_status_section(req, json_write_time, NULL);
 }
 
 /**
@@ -165,58 +549,267 @@ static esp_err_t local_time_handler(httpd_req_t *req)
  */
 static esp_err_t system_status_handler(httpd_req_t *req)
 {
-    app_coordinator_system_info_t info;
-    esp_err_t ret = app_coordinator_get_system_info(&info);
+    return send_cached_json(req, APP_COORDINATOR_JSON_SYSTEM, "System info unavailable");
+}
+
+/**
+ * Tasks handler - returns per-task CPU usage and stack high-water marks
+ * CPU values are percent of one core; idle is reported per core.
+ */
+static esp_err_t tasks_handler(httpd_req_t *req)
+{
+    app_coordinator_task_stats_t *stats = malloc(sizeof(app_coordinator_task_stats_t));
+    if (stats == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
+        return ESP_FAIL;
+    }
     
+    esp_err_t ret = app_coordinator_get_task_stats(stats);
     if (ret != ESP_OK) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "System info unavailable");
+        free(stats);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Task statistics unavailable");
         return ESP_FAIL;
     }
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "heap_free", info.heap_free);
-    cJSON_AddNumberToObject(root, "heap_min", info.heap_min);
-    cJSON_AddNumberToObject(root, "uptime_seconds", info.uptime_seconds);
-    cJSON_AddStringToObject(root, "firmware_version", info.firmware_version);
-    cJSON_AddStringToObject(root, "compile_date", info.compile_date);
-    cJSON_AddStringToObject(root, "compile_time", info.compile_time);
-    cJSON_AddBoolToObject(root, "wifi_sta_connected", info.wifi_sta_connected);
-    cJSON_AddNumberToObject(root, "wifi_ap_clients", info.wifi_ap_clients);
+    char buf[JSON_RESPONSE_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &w, buf, sizeof(buf));
+    
+    json_writer_object_begin(&w, NULL);
+    json_writer_int(&w, "window_short_s", APP_COORDINATOR_CPU_SHORT_WINDOW_S);
+    json_writer_int(&w, "window_long_s", APP_COORDINATOR_CPU_LONG_WINDOW_S);
+    json_writer_int(&w, "task_total", stats->task_total);
+    
+    json_writer_array_begin(&w, "cores");
+    for (int core = 0; core < APP_COORDINATOR_MAX_CORES; core++) {
+        json_writer_object_begin(&w, NULL);
+        json_writer_int(&w, "core", core);
+        json_writer_float(&w, "idle_short", stats->idle_short[core], 2);
+        json_writer_float(&w, "idle_long", stats->idle_long[core], 2);
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+    
+    json_writer_array_begin(&w, "tasks");
+    for (uint32_t i = 0; i < stats->task_count; i++) {
+        const app_coordinator_task_info_t *task = &stats->tasks[i];
+        json_writer_object_begin(&w, NULL);
+        json_writer_string(&w, "name", task->name);
+        json_writer_int(&w, "core", task->core);
+        json_writer_int(&w, "priority", task->priority);
+        json_writer_float(&w, "cpu_short", task->cpu_short, 2);
+        json_writer_float(&w, "cpu_long", task->cpu_long, 2);
+        json_writer_int(&w, "stack_free_min", task->stack_free_min);
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    free(stats);
     
-    const char *json_str = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_str, strlen(json_str));
+    return json_response_end(req, &w);
+}
+
+/**
+ * HTTP stats handler - returns per-endpoint request statistics
+ * Counts, bytes, status classes and a latency histogram (log2 buckets,
+ * bounds in latency_bounds_us) for every registered handler.
+ */
+static esp_err_t http_stats_handler(httpd_req_t *req)
+{
+    char buf[JSON_RESPONSE_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &w, buf, sizeof(buf));
+    http_stats_write_json(&w);
+    return json_response_end(req, &w);
+}
+
+/**
+ * History handler - streams stored sensor history
+ * Query: tier=raw|minute|hour (default raw), from/to as Unix timestamps
+ */
+static esp_err_t history_handler(httpd_req_t *req)
+{
+    sensor_history_tier_t tier = SENSOR_HISTORY_TIER_RAW;
+    time_t from = 0;
+    time_t to = time(NULL);
+    
+    char query[96];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[24];
+        if (httpd_query_key_value(query, "tier", value, sizeof(value)) == ESP_OK &&
+            sensor_history_tier_from_name(value, &tier) != ESP_OK) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown tier");
+            return ESP_FAIL;
+        }
+        if (httpd_query_key_value(query, "from", value, sizeof(value)) == ESP_OK) {
+            from = strtoll(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "to", value, sizeof(value)) == ESP_OK) {
+            to = strtoll(value, NULL, 10);
+        }
+    }
     
-    free((void *)json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+    sensor_history_point_t *points = malloc(sizeof(sensor_history_point_t) * HISTORY_BATCH_POINTS);
+    if (points == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
+        return ESP_FAIL;
+    }
+    
+    // Points are arrays in "fields" order to keep large responses small
+    static const char *const fields[] = {
+        "t", "count", "temp_min", "temp_mean", "temp_max", "hum_min", "hum_mean", "hum_max"
+    };
+    
+    char buf[1024];
+    json_writer_t w;
+    json_response_begin(req, &w, buf, sizeof(buf));
+    
+    json_writer_object_begin(&w, NULL);
+    json_writer_string(&w, "tier", sensor_history_tier_name(tier));
+    json_writer_array_begin(&w, "fields");
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        json_writer_string(&w, NULL, fields[i]);
+    }
+    json_writer_array_end(&w);
+    
+    json_writer_array_begin(&w, "points");
+    size_t count;
+    while (json_writer_error(&w) == ESP_OK && from <= to &&
+           (count = sensor_history_read(tier, from, to, points, HISTORY_BATCH_POINTS)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            const sensor_history_point_t *p = &points[i];
+            json_writer_array_begin(&w, NULL);
+            json_writer_int(&w, NULL, p->timestamp);
+            json_writer_int(&w, NULL, p->count);
+            json_writer_float(&w, NULL, p->temp_min, 1);
+            json_writer_float(&w, NULL, p->temp_mean, 1);
+            json_writer_float(&w, NULL, p->temp_max, 1);
+            json_writer_float(&w, NULL, p->hum_min, 1);
+            json_writer_float(&w, NULL, p->hum_mean, 1);
+            json_writer_float(&w, NULL, p->hum_max, 1);
+            json_writer_array_end(&w);
+        }
+        from = points[count - 1].timestamp + 1;
+    }
+    free(points);
+    
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    return json_response_end(req, &w);
 }
 
 /**
- * OTA status handler - returns firmware info and OTA status
+ * History export state, buffers frames into chunks
  */
-static esp_err_t ota_status_handler(httpd_req_t *req)
+typedef struct {
+    httpd_req_t *req;
+    esp_err_t ret;
+    bool sent;
+    size_t len;
+    uint8_t chunk[1024];
+} history_export_t;
+
+/**
+ * Encode one batch of log records as an export frame
+ */
+static bool history_export_cb(const history_log_record_t *records, size_t count, void *ctx)
 {
-    app_coordinator_ota_status_t status;
-    esp_err_t ret = app_coordinator_get_ota_status(&status);
+    history_export_t *export = ctx;
+
+    if (export->len + HISTORY_EXPORT_FRAME_MAX > sizeof(export->chunk)) {
+        export->ret = httpd_resp_send_chunk(export->req, (const char *)export->chunk, export->len);
+        export->sent = true;
+        export->len = 0;
+        if (export->ret != ESP_OK) {
+            return false;
+        }
+    }
+
+    // Batches hold at most HISTORY_LOG_BUFFER_RECORDS records, so they always fit
+    uint8_t *frame = export->chunk + export->len;
+    series_encoder_t enc;
+    series_encoder_init(&enc, frame + 4, HISTORY_EXPORT_FRAME_MAX - 4);
+    for (size_t i = 0; i < count; i++) {
+        series_encoder_add(&enc, records[i].timestamp, records[i].temp, records[i].hum);
+    }
+
+    const size_t size = series_encoder_size(&enc);
+    frame[0] = enc.count & 0xFF;
+    frame[1] = enc.count >> 8;
+    frame[2] = size & 0xFF;
+    frame[3] = size >> 8;
+    export->len += 4 + size;
+    return true;
+}
+
+/**
+ * History export handler - streams the flash log in series_codec frames
+ * Query: from/to as Unix timestamps
+ * Body: "HSX1", then frames of [u16 count][u16 size][payload] (little
+ * endian), ended by a frame with count 0. Values are 0.1 °C / 0.1 %.
+ */
+static esp_err_t history_export_handler(httpd_req_t *req)
+{
+    time_t from = 0;
+    time_t to = time(NULL);
+    
+    char query[96];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[24];
+        if (httpd_query_key_value(query, "from", value, sizeof(value)) == ESP_OK) {
+            from = strtoll(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "to", value, sizeof(value)) == ESP_OK) {
+            to = strtoll(value, NULL, 10);
+        }
+    }
     
-    if (ret != ESP_OK) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA status unavailable");
+    history_export_t *export = malloc(sizeof(history_export_t));
+    if (export == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
         return ESP_FAIL;
     }
+    export->req = req;
+    export->ret = ESP_OK;
+    export->sent = false;
+    memcpy(export->chunk, HISTORY_EXPORT_MAGIC, 4);
+    export->len = 4;
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "ota_update_status", status.status);
-    cJSON_AddStringToObject(root, "compile_date", status.compile_date);
-    cJSON_AddStringToObject(root, "compile_time", status.compile_time);
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"history.bin\"");
     
-    const char *json_str = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_str, strlen(json_str));
+    esp_err_t ret = history_log_read(from, to, history_export_cb, export);
+    if (ret != ESP_OK) {
+        // Without the end frame a partial download is detectable: just close
+        if (!export->sent) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "History log unavailable");
+        }
+        free(export);
+        return ESP_FAIL;
+    }
     
-    free((void *)json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+    // End frame
+    if (export->ret == ESP_OK) {
+        memset(export->chunk + export->len, 0, 4);
+        export->len += 4;
+        ret = httpd_resp_send_chunk(req, (const char *)export->chunk, export->len);
+    } else {
+        ret = export->ret;
+    }
+    free(export);
+    
+    if (ret == ESP_OK) {
+        ret = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return ret;
+}
+
+/**
+ * OTA status handler - returns firmware info and OTA status
+ */
+static esp_err_t ota_status_handler(httpd_req_t *req)
+{
+    return send_status_section(req, json_write_ota, "OTA status unavailable");
 }
 
 /**
@@ -266,18 +859,7 @@ static esp_err_t wifi_connect_handler(httpd_req_t *req)
  */
 static esp_err_t wifi_connect_status_handler(httpd_req_t *req)
 {
-    wifi_app_connection_status_e status = wifi_app_get_connection_status();
-    
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "wifi_connect_status", status);
-    
-    const char *json_str = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_str, strlen(json_str));
-    
-    free((void *)json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+    return send_status_section(req, json_write_wifi_status, NULL);
 }
 
 /**
@@ -285,29 +867,7 @@ static esp_err_t wifi_connect_status_handler(httpd_req_t *req)
  */
 static esp_err_t wifi_connect_info_handler(httpd_req_t *req)
 {
-    wifi_app_connection_info_t info;
-    esp_err_t ret = wifi_app_get_connection_info(&info);
-    
-    cJSON *root = cJSON_CreateObject();
-    if (ret == ESP_OK) {
-        cJSON_AddStringToObject(root, "ap", info.ssid);
-        cJSON_AddStringToObject(root, "ip", info.ip);
-        cJSON_AddStringToObject(root, "netmask", info.netmask);
-        cJSON_AddStringToObject(root, "gw", info.gateway);
-    } else {
-        cJSON_AddStringToObject(root, "ap", "");
-        cJSON_AddStringToObject(root, "ip", "");
-        cJSON_AddStringToObject(root, "netmask", "");
-        cJSON_AddStringToObject(root, "gw", "");
-    }
-    
-    const char *json_str = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_str, strlen(json_str));
-    
-    free((void *)json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+    return send_status_section(req, json_write_wifi_info, NULL);
 }
 
 /**
@@ -326,49 +886,165 @@ static esp_err_t wifi_disconnect_handler(httpd_req_t *req)
 }
 
 /**
- * WiFi scan handler - returns available networks
+ * Send scan results as a JSON array, strongest network first
  */
-static esp_err_t wifi_scan_handler(httpd_req_t *req)
+static esp_err_t send_scan_results(httpd_req_t *req, const wifi_app_scan_results_t *results)
 {
-    wifi_app_scan_result_t *results = NULL;
-    size_t count = 0;
-    
-    esp_err_t ret = wifi_app_scan_networks(&results, &count);
-    if (ret != ESP_OK) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Scan failed");
-        return ESP_FAIL;
+    // Age of the cached scan in seconds (RFC 9111)
+    char age[12];
+    snprintf(age, sizeof(age), "%" PRIu32, results->age_ms / 1000);
+    httpd_resp_set_hdr(req, "Age", age);
+    httpd_resp_set_hdr(req, "Cache-Control", CACHE_CONTROL_REVALIDATE);
+    
+    char buf[JSON_RESPONSE_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &w, buf, sizeof(buf));
+    
+    json_writer_array_begin(&w, NULL);
+    for (size_t i = 0; i < results->count; i++) {
+        const wifi_app_scan_result_t *network = &results->networks[i];
+        const char *auth_str = "Open";
+        if (network->auth_mode == WIFI_AUTH_WEP) auth_str = "WEP";
+        else if (network->auth_mode == WIFI_AUTH_WPA_PSK) auth_str = "WPA";
+        else if (network->auth_mode == WIFI_AUTH_WPA2_PSK) auth_str = "WPA2";
+        else if (network->auth_mode == WIFI_AUTH_WPA_WPA2_PSK) auth_str = "WPA/WPA2";
+        else if (network->auth_mode == WIFI_AUTH_WPA3_PSK) auth_str = "WPA3";
+        
+        json_writer_object_begin(&w, NULL);
+        json_writer_string(&w, "ssid", network->ssid);
+        json_writer_int(&w, "rssi", network->rssi);
+        json_writer_int(&w, "channel", network->channel);
+        json_writer_string(&w, "auth", auth_str);
+        json_writer_object_end(&w);
     }
+    json_writer_array_end(&w);
     
-    cJSON *root = cJSON_CreateArray();
+    return json_response_end(req, &w);
+}
+
+/**
+ * Complete every parked scan request (runs on the httpd task)
+ * Requests get the new results, or the previous ones if the scan failed.
+ */
+static void scan_waiters_complete(void *arg)
+{
+    wifi_app_scan_results_t *results = malloc(sizeof(wifi_app_scan_results_t));
+    const bool have_results = (results != NULL && wifi_app_get_scan_results(results) == ESP_OK);
+    
+    xSemaphoreTake(scan_waiters_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < SCAN_MAX_WAITERS; i++) {
+        httpd_req_t *req = scan_waiters[i];
+        if (req == NULL) {
+            continue;
+        }
+        if (have_results) {
+            send_scan_results(req, results);
+        } else {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Scan failed");
+        }
+        httpd_req_async_handler_complete(req);
+        scan_waiters[i] = NULL;
+    }
+    xSemaphoreGive(scan_waiters_mutex);
     
-    for (size_t i = 0; i < count; i++) {
-        cJSON *network = cJSON_CreateObject();
-        cJSON_AddStringToObject(network, "ssid", results[i].ssid);
-        cJSON_AddNumberToObject(network, "rssi", results[i].rssi);
-        
-        const char *auth_str = "Open";
-        if (results[i].auth_mode == WIFI_AUTH_WEP) auth_str = "WEP";
-        else if (results[i].auth_mode == WIFI_AUTH_WPA_PSK) auth_str = "WPA";
-        else if (results[i].auth_mode == WIFI_AUTH_WPA2_PSK) auth_str = "WPA2";
-        else if (results[i].auth_mode == WIFI_AUTH_WPA_WPA2_PSK) auth_str = "WPA/WPA2";
-        else if (results[i].auth_mode == WIFI_AUTH_WPA3_PSK) auth_str = "WPA3";
-        
-        cJSON_AddStringToObject(network, "auth", auth_str);
-        cJSON_AddItemToArray(root, network);
+    free(results);
+}
+
+/**
+ * WiFi scan done callback (runs on the WiFi task)
+ * Responses are sent from the httpd task so a slow client cannot hold up
+ * the WiFi task.
+ */
+static void scan_done_cb(esp_err_t result)
+{
+    if (result != ESP_OK) {
+        ESP_LOGW(TAG, "WiFi scan failed: %s", esp_err_to_name(result));
+    }
+    if (server != NULL) {
+        httpd_queue_work(server, scan_waiters_complete, NULL);
     }
+}
+
+/**
+ * Park a request until the running scan completes
+ */
+static esp_err_t scan_waiter_park(httpd_req_t *req)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
     
-    const char *json_str = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_str, strlen(json_str));
+    xSemaphoreTake(scan_waiters_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < SCAN_MAX_WAITERS; i++) {
+        if (scan_waiters[i] == NULL) {
+            ret = httpd_req_async_handler_begin(req, &scan_waiters[i]);
+            break;
+        }
+    }
+    xSemaphoreGive(scan_waiters_mutex);
+    return ret;
+}
+
+/**
+ * Close parked scan requests
+ * Must be called before the server is stopped.
+ */
+static void scan_waiters_drop_all(void)
+{
+    xSemaphoreTake(scan_waiters_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < SCAN_MAX_WAITERS; i++) {
+        httpd_req_t *req = scan_waiters[i];
+        if (req != NULL) {
+            httpd_handle_t handle = req->handle;
+            int sockfd = httpd_req_to_sockfd(req);
+            httpd_req_async_handler_complete(req);
+            httpd_sess_trigger_close(handle, sockfd);
+            scan_waiters[i] = NULL;
+        }
+    }
+    xSemaphoreGive(scan_waiters_mutex);
+}
+
+/**
+ * WiFi scan handler - returns available networks
+ * Query: refresh=1 to ignore cached results.
+ * Results younger than WIFI_APP_SCAN_TTL_MS are sent right away. Otherwise
+ * the request is parked and answered when the background scan on the WiFi
+ * task lands; requests arriving meanwhile share that scan.
+ */
+static esp_err_t wifi_scan_handler(httpd_req_t *req)
+{
+    bool refresh = false;
+    char query[32];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[4];
+        refresh = (httpd_query_key_value(query, "refresh", value, sizeof(value)) == ESP_OK &&
+                   strcmp(value, "1") == 0);
+    }
     
-    free((void *)json_str);
-    cJSON_Delete(root);
+    wifi_app_scan_results_t *results = malloc(sizeof(wifi_app_scan_results_t));
+    if (results == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
+        return ESP_FAIL;
+    }
     
-    if (results != NULL) {
-        free(results);
+    esp_err_t ret;
+    const bool cached = (wifi_app_get_scan_results(results) == ESP_OK);
+    if (cached && !refresh && results->age_ms < WIFI_APP_SCAN_TTL_MS) {
+        ret = send_scan_results(req, results);
+    } else if (scan_waiter_park(req) == ESP_OK) {
+        // Parked before requesting, so the completion cannot be missed
+        wifi_app_request_scan();
+        ret = ESP_OK;
+    } else if (cached) {
+        // Too many requests waiting: stale results beat none
+        ret = send_scan_results(req, results);
+    } else {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "5");
+        ret = httpd_resp_sendstr(req, "Scan in progress");
     }
     
-    return ESP_OK;
+    free(results);
+    return ret;
 }
 
 /**
@@ -424,9 +1100,104 @@ static esp_err_t config_restore_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+/**
+ * Firmware upload in progress
+ */
+typedef struct {
+    size_t size_hint;       // Upper bound of the image size, for ota_update_begin()
+    size_t written;
+    bool started;
+    bool owner;             // This request's ota_update_begin() succeeded
+    bool pipelined;         // Flash writes run on the OTA writer task
+    esp_err_t err;          // First OTA error, as opposed to a malformed upload
+} ota_upload_t;
+
+/**
+ * Pass firmware bytes to the OTA partition, starting the update on the first call
+ */
+static esp_err_t ota_upload_write(const uint8_t *data, size_t len, void *ctx)
+{
+    ota_upload_t *upload = ctx;
+    
+    if (upload->pipelined) {
+        // The writer task begins the update
+        upload->err = ota_pipeline_write(data, len);
+    } else {
+        if (!upload->started) {
+            upload->err = ota_update_begin(upload->size_hint);
+            if (upload->err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to begin OTA update: %s", esp_err_to_name(upload->err));
+                return upload->err;
+            }
+            upload->owner = true;
+        }
+        upload->err = ota_update_write(data, len);
+    }
+    if (upload->err != ESP_OK) {
+        ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(upload->err));
+        return upload->err;
+    }
+    upload->started = true;
+    upload->written += len;
+    return ESP_OK;
+}
+
+/**
+ * Drop an upload after an error
+ * Only an update this request began is aborted; another one (a session
+ * or an upload on the other worker) keeps running.
+ */
+static void ota_upload_abort(ota_upload_t *upload, uint8_t *buf)
+{
+    if (upload->pipelined) {
+        ota_pipeline_abort();
+    } else {
+        free(buf);
+        if (upload->owner) {
+            ota_update_abort();
+        }
+    }
+}
+
+/**
+ * Answer an OTA error: 409 while another update holds the OTA state
+ * (ota_update_begin() failed, or another OTA call is running), 500 otherwise
+ */
+static esp_err_t send_ota_error(httpd_req_t *req, esp_err_t err)
+{
+    if (err == ESP_ERR_INVALID_STATE || err == ESP_ERR_TIMEOUT) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "OTA busy");
+    } else {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA write failed");
+    }
+    return ESP_FAIL;
+}
+
+/**
+ * Answer a failed ota_update_end(): 400 if the image was rejected
+ */
+static esp_err_t send_ota_end_error(httpd_req_t *req, esp_err_t err)
+{
+    switch (err) {
+        case ESP_ERR_INVALID_SIZE:          // Truncated image or patch
+        case ESP_ERR_INVALID_CRC:           // gzip trailer mismatch
+        case ESP_ERR_INVALID_ARG:           // Corrupt gzip stream
+        case ESP_ERR_OTA_VALIDATE_FAILED:   // Digest or image check failed
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Firmware verification failed");
+            return ESP_FAIL;
+        default:
+            return send_ota_error(req, err);
+    }
+}
+
 /**
  * OTA update handler - receives firmware binary
- * Handles multipart/form-data uploads and streams to OTA partition
+ * Takes raw binary or multipart/form-data (the first part with a
+ * filename). The body is parsed as it arrives and written to the OTA
+ * partition straight from the receive buffer. Flash writes run on the OTA
+ * writer task while the next buffers are received; without memory for
+ * the pipeline, receiving and writing take turns on this task.
  */
 static esp_err_t ota_update_handler(httpd_req_t *req)
 {
@@ -438,230 +1209,346 @@ static esp_err_t ota_update_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
     
-    // Check content type - handle both multipart/form-data and raw binary
-    size_t content_type_len = httpd_req_get_hdr_value_len(req, "Content-Type");
-    bool is_multipart = false;
-    char boundary[128] = {0};
-    
-    if (content_type_len > 0) {
-        char content_type[256];
-        if (httpd_req_get_hdr_value_str(req, "Content-Type", content_type, sizeof(content_type)) == ESP_OK) {
-            if (strstr(content_type, "multipart/form-data") != NULL) {
-                is_multipart = true;
-                // Extract boundary string
-                char *boundary_start = strstr(content_type, "boundary=");
-                if (boundary_start != NULL) {
-                    boundary_start += 9; // Skip "boundary="
-                    char *boundary_end = strchr(boundary_start, ';');
-                    if (boundary_end == NULL) {
-                        boundary_end = strchr(boundary_start, '\0');
-                    }
-                    int boundary_len = boundary_end - boundary_start;
-                    if (boundary_len > 0 && boundary_len < sizeof(boundary)) {
-                        strncpy(boundary, boundary_start, boundary_len);
-                        boundary[boundary_len] = '\0';
-                        // Remove quotes if present
-                        if (boundary[0] == '"' && boundary[boundary_len-1] == '"') {
-                            memmove(boundary, boundary + 1, boundary_len - 2);
-                            boundary[boundary_len - 2] = '\0';
-                        }
-                    }
-                }
-            }
-        }
-    }
-    
-    // Buffer for reading data - use larger buffer for multipart parsing
-    char *buf = malloc(2048);
-    if (buf == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate buffer");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
-        return ESP_FAIL;
-    }
-    
-    int remaining = req->content_len;
-    int total_received = 0;
-    bool data_started = false;
-    bool ota_started = false;
-    size_t firmware_size = 0;
-    
-    // For multipart, we need to parse the structure:
-    // --boundary\r\n
-    // Content-Disposition: form-data; name="file"; filename="..."\r\n
-    // Content-Type: application/octet-stream\r\n
-    // \r\n
-    // [BINARY DATA]
-    // \r\n--boundary--\r\n
-    
-    // Read initial data to find where binary starts
-    int initial_read = httpd_req_recv(req, buf, (remaining < 2048) ? remaining : 2048);
-    if (initial_read <= 0) {
-        ESP_LOGE(TAG, "Failed to receive initial data");
-        free(buf);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive data");
-        return ESP_FAIL;
-    }
+    // The multipart overhead is only a few hundred bytes, so the body size is close enough
+    ota_upload_t upload = {
+        .size_hint = req->content_len,
+    };
     
-    char *data_start = NULL;
-    int data_offset = 0;
-    
-    if (is_multipart) {
-        // Find the end of headers (\r\n\r\n)
-        data_start = strstr(buf, "\r\n\r\n");
-        if (data_start != NULL) {
-            data_start += 4; // Skip \r\n\r\n
-            data_offset = data_start - buf;
-            data_started = true;
-            
-            // Estimate firmware size (total - headers - boundary markers)
-            // This is approximate, we'll adjust as we read
-            firmware_size = req->content_len - data_offset;
-            // Subtract approximate size of closing boundary (boundary + 6 bytes for --\r\n\r\n)
-            if (strlen(boundary) > 0) {
-                firmware_size -= (strlen(boundary) + 6);
-            }
-        } else {
-            ESP_LOGE(TAG, "Could not find data start in multipart");
-            free(buf);
+    bool is_multipart = false;
+    multipart_parser_t parser;
+    char content_type[256];
+    if (httpd_req_get_hdr_value_str(req, "Content-Type", content_type, sizeof(content_type)) == ESP_OK &&
+        strstr(content_type, "multipart/form-data") != NULL) {
+        if (multipart_parser_init(&parser, content_type, ota_upload_write, &upload) != ESP_OK) {
+            ESP_LOGE(TAG, "OTA update: No multipart boundary");
             httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid multipart format");
             return ESP_FAIL;
         }
-    } else {
-        // Raw binary - use all data
-        data_start = buf;
-        data_offset = 0;
-        firmware_size = req->content_len;
-        data_started = true;
+        is_multipart = true;
     }
     
-    // Start OTA update with estimated size
-    if (data_started && firmware_size > 0) {
-        esp_err_t ret = ota_update_begin(firmware_size);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to begin OTA update: %s", esp_err_to_name(ret));
-            free(buf);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA begin failed");
+    uint8_t *buf = NULL;
+    upload.pipelined = (ota_pipeline_begin(upload.size_hint) == ESP_OK);
+    if (!upload.pipelined) {
+        buf = malloc(OTA_RECV_BUF_SIZE);
+        if (buf == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate buffer");
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
             return ESP_FAIL;
         }
-        ota_started = true;
     }
     
-    // Write the first chunk of data
-    if (data_started && ota_started) {
-        int first_chunk_len = initial_read - data_offset;
-        if (first_chunk_len > 0) {
-            esp_err_t ret = ota_update_write((const uint8_t *)data_start, first_chunk_len);
-            if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(ret));
-                free(buf);
-                ota_update_abort();
-                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA write failed");
-                return ESP_FAIL;
+    size_t remaining = req->content_len;
+    int timeouts = 0;
+    while (remaining > 0) {
+        if (upload.pipelined) {
+            upload.err = ota_pipeline_acquire(&buf);
+            if (upload.err != ESP_OK) {
+                ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(upload.err));
+                ota_upload_abort(&upload, buf);
+                return send_ota_error(req, upload.err);
             }
-            total_received += first_chunk_len;
         }
-    }
-    
-    remaining -= initial_read;
-    
-    // Read and write remaining data
-    while (remaining > 0 && ota_started) {
-        int recv_len = httpd_req_recv(req, buf, (remaining < 2048) ? remaining : 2048);
+        
+        int recv_len = httpd_req_recv(req, (char *)buf, (remaining < OTA_RECV_BUF_SIZE) ? remaining : OTA_RECV_BUF_SIZE);
         if (recv_len <= 0) {
-            if (recv_len == HTTPD_SOCK_ERR_TIMEOUT) {
+            if (recv_len == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < OTA_RECV_MAX_TIMEOUTS) {
+                if (upload.pipelined) {
+                    ota_pipeline_release(buf);
+                }
                 continue;
             }
             ESP_LOGE(TAG, "Failed to receive data: %d", recv_len);
-            free(buf);
-            ota_update_abort();
+            ota_upload_abort(&upload, buf);
             httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive data");
             return ESP_FAIL;
         }
+        remaining -= recv_len;
+        timeouts = 0;
         
-        // For multipart, check if we've reached the closing boundary
-        if (is_multipart && recv_len >= 4) {
-            // Check for \r\n--boundary-- pattern
-            if (buf[0] == '\r' && buf[1] == '\n' && buf[2] == '-' && buf[3] == '-') {
-                // Check if this matches our boundary
-                if (strlen(boundary) > 0) {
-                    char boundary_marker[256];
-                    snprintf(boundary_marker, sizeof(boundary_marker), "\r\n--%s--", boundary);
-                    if (strncmp(buf, boundary_marker, strlen(boundary_marker)) == 0) {
-                        // Reached closing boundary, stop reading
-                        ESP_LOGI(TAG, "Reached multipart closing boundary");
-                        break;
-                    }
-                }
-                // Also check for just \r\n-- (simpler check)
-                if (recv_len >= 4 && buf[2] == '-' && buf[3] == '-') {
-                    // Likely boundary, calculate how much data to write
-                    // Find where boundary starts in this buffer
-                    int write_len = 0;
-                    for (int i = 0; i < recv_len - 1; i++) {
-                        if (buf[i] == '\r' && buf[i+1] == '\n' && 
-                            i + 2 < recv_len && buf[i+2] == '-' && buf[i+3] == '-') {
-                            write_len = i;
-                            break;
-                        }
-                    }
-                    if (write_len > 0) {
-                        // Write data before boundary
-                        esp_err_t ret = ota_update_write((const uint8_t *)buf, write_len);
-                        if (ret != ESP_OK) {
-                            ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(ret));
-                            free(buf);
-                            ota_update_abort();
-                            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA write failed");
-                            return ESP_FAIL;
-                        }
-                        total_received += write_len;
-                    }
-                    break;
-                }
-            }
+        esp_err_t ret;
+        if (is_multipart) {
+            ret = multipart_parser_feed(&parser, buf, recv_len);
+        } else {
+            ret = ota_upload_write(buf, recv_len, &upload);
+        }
+        if (upload.pipelined) {
+            ota_pipeline_release(buf);
         }
-        
-        // Write the data
-        esp_err_t ret = ota_update_write((const uint8_t *)buf, recv_len);
         if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(ret));
-            free(buf);
-            ota_update_abort();
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA write failed");
+            ota_upload_abort(&upload, buf);
+            if (upload.err != ESP_OK) {
+                send_ota_error(req, upload.err);
+            } else {
+                ESP_LOGE(TAG, "OTA update: Malformed multipart body");
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid multipart format");
+            }
             return ESP_FAIL;
         }
         
-        total_received += recv_len;
-        remaining -= recv_len;
-        
-        ESP_LOGD(TAG, "OTA progress: %d bytes (%.1f%%)", 
-                 total_received, 
-                 (firmware_size > 0) ? (total_received * 100.0) / firmware_size : 0);
+        if (is_multipart && multipart_parser_file_complete(&parser)) {
+            // Whatever follows the file part is discarded by httpd
+            break;
+        }
     }
     
-    free(buf);
+    esp_err_t ret = ESP_OK;
+    if (upload.pipelined) {
+        // Wait for the writer to catch up; on error it has dropped the update it began
+        ret = ota_pipeline_end();
+        upload.owner = (ret == ESP_OK);
+    } else {
+        free(buf);
+    }
     
-    if (!ota_started) {
-        ESP_LOGE(TAG, "OTA update was not started");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA not started");
+    if (!upload.started || (is_multipart && !multipart_parser_file_complete(&parser))) {
+        ESP_LOGE(TAG, "OTA update: No complete firmware in request");
+        if (upload.owner) {
+            ota_update_abort();
+        }
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No firmware data");
         return ESP_FAIL;
     }
     
-    // Send success response FIRST (before reboot)
-    ESP_LOGI(TAG, "OTA update successful: %d bytes written", total_received);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(ret));
+        return send_ota_error(req, ret);
+    }
+    
+    // Verify and set the boot partition first, so a bad image is reported instead of rebooting
+    ret = ota_update_end();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to end OTA update: %s", esp_err_to_name(ret));
+        return send_ota_end_error(req, ret);
+    }
+    
+    ESP_LOGI(TAG, "OTA update successful: %zu bytes written", upload.written);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, "{\"status\":\"success\"}", HTTPD_RESP_USE_STRLEN);
     
-    // Finalize OTA update (this will set boot partition and reboot after delay)
-    // Response is already sent, so reboot can happen
-    esp_err_t ret = ota_update_end();
+    ota_update_restart();
+    return ESP_OK;
+}
+
+/**
+ * Send an OTA session as JSON
+ */
+static esp_err_t send_ota_session(httpd_req_t *req, const ota_update_session_t *session)
+{
+    char id[9];
+    snprintf(id, sizeof(id), "%08" PRIx32, session->id);
+    
+    char buf[JSON_RESPONSE_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &w, buf, sizeof(buf));
+    json_writer_object_begin(&w, NULL);
+    json_writer_string(&w, "id", id);
+    json_writer_int(&w, "size", session->size);
+    json_writer_int(&w, "offset", session->offset);
+    json_writer_int(&w, "chunk_max", OTA_SESSION_CHUNK_MAX);
+    json_writer_object_end(&w);
+    return json_response_end(req, &w);
+}
+
+/**
+ * Parse the session ID of /ota/session/{id}[/...]
+ *
+ * @param action Receives what follows the ID ("" or "/commit"), query excluded
+ * @param action_size Size of action; a longer path fails
+ */
+static bool ota_session_parse_uri(httpd_req_t *req, uint32_t *id, char *action, size_t action_size)
+{
+    const char *start = req->uri + strlen("/ota/session/");
+    char *end;
+    unsigned long value = strtoul(start, &end, 16);
+    if (end == start || end - start > 8) {
+        return false;
+    }
+    size_t len = strcspn(end, "?");
+    if (len >= action_size) {
+        return false;
+    }
+    memcpy(action, end, len);
+    action[len] = '\0';
+    *id = value;
+    return true;
+}
+
+/**
+ * OTA session handler
+ * POST /ota/session?size=N starts a resumable upload, GET returns the
+ * current session so an interrupted upload knows where to continue.
+ */
+static esp_err_t ota_session_handler(httpd_req_t *req)
+{
+    ota_update_session_t session;
+    esp_err_t ret;
+    
+    if (req->method == HTTP_GET) {
+        ret = ota_update_session_get(&session);
+        if (ret == ESP_ERR_TIMEOUT) {
+            return send_ota_error(req, ret);
+        }
+        if (ret != ESP_OK) {
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No OTA session");
+            return ESP_OK;
+        }
+        return send_ota_session(req, &session);
+    }
+    
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "size", value, sizeof(value)) != ESP_OK ||
+        strtoul(value, NULL, 10) == 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Firmware size required");
+        return ESP_FAIL;
+    }
+    
+    ret = ota_update_session_create(strtoul(value, NULL, 10), &session);
+    if (ret == ESP_ERR_INVALID_SIZE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Firmware too large");
+        return ESP_FAIL;
+    }
+    if (ret == ESP_ERR_INVALID_STATE || ret == ESP_ERR_TIMEOUT) {
+        return send_ota_error(req, ret);
+    }
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to end OTA update: %s", esp_err_to_name(ret));
-        // Response already sent, can't send error - just log it
+        ESP_LOGE(TAG, "Failed to create OTA session: %s", esp_err_to_name(ret));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA begin failed");
+        return ESP_FAIL;
+    }
+    return send_ota_session(req, &session);
+}
+
+/**
+ * OTA session chunk handler - PUT /ota/session/{id}?offset=N
+ * The body is one chunk of at most OTA_SESSION_CHUNK_MAX bytes with its
+ * CRC-32 in X-Chunk-CRC32 (hex). An offset other than the session's gets
+ * 409 with the session, telling the client where to continue.
+ */
+static esp_err_t ota_session_chunk_handler(httpd_req_t *req)
+{
+    uint32_t id;
+    char action[16];
+    if (!ota_session_parse_uri(req, &id, action, sizeof(action)) || action[0] != '\0') {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No OTA session");
+        return ESP_FAIL;
+    }
+    
+    char query[32];
+    char value[12];
+    char crc_str[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "offset", value, sizeof(value)) != ESP_OK ||
+        httpd_req_get_hdr_value_str(req, "X-Chunk-CRC32", crc_str, sizeof(crc_str)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Offset and X-Chunk-CRC32 required");
+        return ESP_FAIL;
+    }
+    const size_t offset = strtoul(value, NULL, 10);
+    const uint32_t crc = strtoul(crc_str, NULL, 16);
+    
+    if (req->content_len == 0 || req->content_len > OTA_SESSION_CHUNK_MAX) {
+        httpd_resp_set_status(req, "413 Content Too Large");
+        httpd_resp_sendstr(req, "Chunk size out of range");
+        return ESP_FAIL;
+    }
+    
+    uint8_t *buf = malloc(req->content_len);
+    if (buf == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
+        return ESP_FAIL;
+    }
+    
+    // The whole chunk is needed before its CRC can be checked
+    size_t received = 0;
+    int timeouts = 0;
+    while (received < req->content_len) {
+        int recv_len = httpd_req_recv(req, (char *)buf + received, req->content_len - received);
+        if (recv_len <= 0) {
+            if (recv_len == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < OTA_RECV_MAX_TIMEOUTS) {
+                continue;
+            }
+            free(buf);
+            // The session stays open; the client resends the chunk
+            ESP_LOGW(TAG, "OTA chunk at %zu interrupted", offset);
+            return ESP_FAIL;
+        }
+        received += recv_len;
+        timeouts = 0;
+    }
+    
+    ota_update_session_t session;
+    esp_err_t ret = ota_update_session_write(id, offset, buf, received, crc, &session);
+    free(buf);
+    
+    switch (ret) {
+        case ESP_OK:
+            return send_ota_session(req, &session);
+        case ESP_ERR_INVALID_STATE:
+            httpd_resp_set_status(req, "409 Conflict");
+            return send_ota_session(req, &session);
+        case ESP_ERR_TIMEOUT:
+            // Still writing an earlier copy of this chunk, or another session call
+            return send_ota_error(req, ret);
+        case ESP_ERR_NOT_FOUND:
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No OTA session");
+            return ESP_FAIL;
+        case ESP_ERR_INVALID_CRC:
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Chunk CRC mismatch");
+            return ESP_FAIL;
+        case ESP_ERR_INVALID_SIZE:
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Chunk past firmware size");
+            return ESP_FAIL;
+        default:
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA write failed");
+            return ESP_FAIL;
+    }
+}
+
+/**
+ * OTA session commit handler - POST /ota/session/{id}/commit
+ * Like /OTAupdate, verifies the image, answers with the result and
+ * reboots on success.
+ */
+static esp_err_t ota_session_commit_handler(httpd_req_t *req)
+{
+    uint32_t id;
+    char action[16];
+    ota_update_session_t session;
+    if (!ota_session_parse_uri(req, &id, action, sizeof(action)) || strcmp(action, "/commit") != 0) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No OTA session");
         return ESP_FAIL;
     }
+    esp_err_t ret = ota_update_session_get(&session);
+    if (ret == ESP_ERR_TIMEOUT) {
+        return send_ota_error(req, ret);
+    }
+    if (ret != ESP_OK || session.id != id) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No OTA session");
+        return ESP_FAIL;
+    }
+    
+    if (session.offset != session.size) {
+        httpd_resp_set_status(req, "409 Conflict");
+        return send_ota_session(req, &session);
+    }
+    
+    ret = ota_update_session_commit(id);
+    if (ret == ESP_ERR_NOT_FOUND) {
+        // Replaced since the check above
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No OTA session");
+        return ESP_FAIL;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to commit OTA session: %s", esp_err_to_name(ret));
+        return send_ota_end_error(req, ret);
+    }
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "{\"status\":\"success\"}", HTTPD_RESP_USE_STRLEN);
     
-    // Note: Device will reboot automatically in ota_update_end() after 500ms delay
+    ota_update_restart();
     return ESP_OK;
 }
 
@@ -675,59 +1562,52 @@ esp_err_t http_server_start(void)
     ESP_LOGI(TAG, "Starting HTTP server");
     
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = 25;  // Increased to accommodate captive portal handlers
-    // max_open_sockets: HTTP server uses 3 sockets internally
-    // Current: 7 (works with LWIP_MAX_SOCKETS=10)
-    // After 'idf.py reconfigure': Change to 17 (works with LWIP_MAX_SOCKETS=20 from sdkconfig.defaults)
-    config.max_open_sockets = 7;  // TODO: After reconfigure, increase to 17 for 5-client support
+    config.max_uri_handlers = 40;  // Increased to accommodate captive portal and API handlers
+    // max_open_sockets: HTTP server uses 3 sockets internally, DNS server 1
+    // (LWIP_MAX_SOCKETS=20 from sdkconfig.defaults). Each client keeps one
+    // /events stream open, the rest is shared by short-lived requests.
+    // No LRU purge: an event stream never sends a request after it opens,
+    // so it would always look least recent and be purged, then reconnect.
+    config.max_open_sockets = 13;
     config.stack_size = 8192;
+    config.core_id = HTTP_SERVER_TASK_CORE_ID;  // The HTTP workers run on the other core
     config.uri_match_fn = httpd_uri_match_wildcard;
+    config.open_fn = http_stats_session_open;  // Counts response bytes per endpoint
+    
+    if (scan_waiters_mutex == NULL) {
+        scan_waiters_mutex = xSemaphoreCreateMutex();
+        if (scan_waiters_mutex == NULL) {
+            ESP_LOGE(TAG, "Failed to create scan waiters mutex");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    
+    // Also reopens an upload session interrupted by a restart (NVS is up by now)
+    if (ota_update_init() != ESP_OK) {
+        return ESP_FAIL;
+    }
+    
+    if (http_workers_start() != ESP_OK) {
+        return ESP_FAIL;
+    }
     
     if (httpd_start(&server, &config) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start HTTP server");
+        http_workers_stop();
         return ESP_FAIL;
     }
     
     // Register static file handlers
-    httpd_uri_t root_uri = {
-        .uri = "/",
-        .method = HTTP_GET,
-        .handler = root_handler,
-        .user_ctx = NULL
-    };
-    httpd_register_uri_handler(server, &root_uri);
-    
-    httpd_uri_t css_uri = {
-        .uri = "/app.css",
-        .method = HTTP_GET,
-        .handler = css_handler,
-        .user_ctx = NULL
-    };
-    httpd_register_uri_handler(server, &css_uri);
-    
-    httpd_uri_t js_uri = {
-        .uri = "/app.js",
-        .method = HTTP_GET,
-        .handler = js_handler,
-        .user_ctx = NULL
-    };
-    httpd_register_uri_handler(server, &js_uri);
-    
-    httpd_uri_t jquery_uri = {
-        .uri = "/jquery-3.3.1.min.js",
-        .method = HTTP_GET,
-        .handler = jquery_handler,
-        .user_ctx = NULL
-    };
-    httpd_register_uri_handler(server, &jquery_uri);
-    
-    httpd_uri_t favicon_uri = {
-        .uri = "/favicon.ico",
-        .method = HTTP_GET,
-        .handler = favicon_handler,
-        .user_ctx = NULL
-    };
-    httpd_register_uri_handler(server, &favicon_uri);
+    static_assets_init();
+    for (size_t i = 0; i < sizeof(static_assets) / sizeof(static_assets[0]); i++) {
+        httpd_uri_t asset_uri = {
+            .uri = static_assets[i].uri,
+            .method = HTTP_GET,
+            .handler = static_asset_handler,
+            .user_ctx = &static_assets[i]
+        };
+        http_stats_register_uri(server, &asset_uri);
+    }
     
     // Register captive portal detection handlers (iOS, Android, Windows)
     httpd_uri_t captive_portal_uri = {
@@ -736,7 +1616,7 @@ esp_err_t http_server_start(void)
         .handler = captive_portal_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &captive_portal_uri);
+    http_stats_register_uri(server, &captive_portal_uri);
     
     httpd_uri_t captive_portal_uri2 = {
         .uri = "/generate_204",
@@ -744,7 +1624,7 @@ esp_err_t http_server_start(void)
         .handler = captive_portal_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &captive_portal_uri2);
+    http_stats_register_uri(server, &captive_portal_uri2);
     
     httpd_uri_t captive_portal_uri3 = {
         .uri = "/gen_204",
@@ -752,7 +1632,7 @@ esp_err_t http_server_start(void)
         .handler = captive_portal_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &captive_portal_uri3);
+    http_stats_register_uri(server, &captive_portal_uri3);
     
     httpd_uri_t captive_portal_uri4 = {
         .uri = "/connecttest.txt",
@@ -760,7 +1640,7 @@ esp_err_t http_server_start(void)
         .handler = captive_portal_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &captive_portal_uri4);
+    http_stats_register_uri(server, &captive_portal_uri4);
     
     httpd_uri_t captive_portal_uri5 = {
         .uri = "/success.txt",
@@ -768,7 +1648,7 @@ esp_err_t http_server_start(void)
         .handler = captive_portal_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &captive_portal_uri5);
+    http_stats_register_uri(server, &captive_portal_uri5);
     
     // Register API handlers
     httpd_uri_t ap_ssid_uri = {
@@ -777,7 +1657,7 @@ esp_err_t http_server_start(void)
         .handler = ap_ssid_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &ap_ssid_uri);
+    http_stats_register_uri(server, &ap_ssid_uri);
     
     httpd_uri_t dht_uri = {
         .uri = "/dhtSensor.json",
@@ -785,7 +1665,7 @@ esp_err_t http_server_start(void)
         .handler = dht_sensor_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &dht_uri);
+    http_stats_register_uri(server, &dht_uri);
     
     httpd_uri_t time_uri = {
         .uri = "/localTime.json",
@@ -793,7 +1673,7 @@ esp_err_t http_server_start(void)
         .handler = local_time_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &time_uri);
+    http_stats_register_uri(server, &time_uri);
     
     httpd_uri_t system_uri = {
         .uri = "/systemStatus.json",
@@ -801,7 +1681,47 @@ esp_err_t http_server_start(void)
         .handler = system_status_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &system_uri);
+    http_stats_register_uri(server, &system_uri);
+    
+    httpd_uri_t status_uri = {
+        .uri = "/status.json",
+        .method = HTTP_GET,
+        .handler = status_handler,
+        .user_ctx = NULL
+    };
+    http_stats_register_uri(server, &status_uri);
+    
+    httpd_uri_t tasks_uri = {
+        .uri = "/tasks.json",
+        .method = HTTP_GET,
+        .handler = tasks_handler,
+        .user_ctx = NULL
+    };
+    http_stats_register_uri(server, &tasks_uri);
+    
+    httpd_uri_t http_stats_uri = {
+        .uri = "/httpStats.json",
+        .method = HTTP_GET,
+        .handler = http_stats_handler,
+        .user_ctx = NULL
+    };
+    http_stats_register_uri(server, &http_stats_uri);
+    
+    httpd_uri_t history_uri = {
+        .uri = "/history.json",
+        .method = HTTP_GET,
+        .handler = history_handler,
+        .user_ctx = NULL
+    };
+    http_stats_register_uri(server, &history_uri);
+    
+    httpd_uri_t history_export_uri = {
+        .uri = "/historyExport.bin",
+        .method = HTTP_GET,
+        .handler = history_export_handler,
+        .user_ctx = NULL
+    };
+    http_workers_register_uri(server, &history_export_uri);
     
     httpd_uri_t ota_status_uri = {
         .uri = "/OTAstatus",
@@ -809,7 +1729,7 @@ esp_err_t http_server_start(void)
         .handler = ota_status_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &ota_status_uri);
+    http_stats_register_uri(server, &ota_status_uri);
     
     httpd_uri_t ota_update_uri = {
         .uri = "/OTAupdate",
@@ -817,7 +1737,39 @@ esp_err_t http_server_start(void)
         .handler = ota_update_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &ota_update_uri);
+    http_workers_register_uri(server, &ota_update_uri);
+    
+    httpd_uri_t ota_session_get_uri = {
+        .uri = "/ota/session",
+        .method = HTTP_GET,
+        .handler = ota_session_handler,
+        .user_ctx = NULL
+    };
+    http_stats_register_uri(server, &ota_session_get_uri);
+    
+    httpd_uri_t ota_session_create_uri = {
+        .uri = "/ota/session",
+        .method = HTTP_POST,
+        .handler = ota_session_handler,
+        .user_ctx = NULL
+    };
+    http_workers_register_uri(server, &ota_session_create_uri);
+    
+    httpd_uri_t ota_session_chunk_uri = {
+        .uri = "/ota/session/*",
+        .method = HTTP_PUT,
+        .handler = ota_session_chunk_handler,
+        .user_ctx = NULL
+    };
+    http_workers_register_uri(server, &ota_session_chunk_uri);
+    
+    httpd_uri_t ota_session_commit_uri = {
+        .uri = "/ota/session/*",
+        .method = HTTP_POST,
+        .handler = ota_session_commit_handler,
+        .user_ctx = NULL
+    };
+    http_workers_register_uri(server, &ota_session_commit_uri);
     
     httpd_uri_t wifi_connect_uri = {
         .uri = "/wifiConnect.json",
@@ -825,7 +1777,7 @@ esp_err_t http_server_start(void)
         .handler = wifi_connect_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &wifi_connect_uri);
+    http_stats_register_uri(server, &wifi_connect_uri);
     
     httpd_uri_t wifi_status_uri = {
         .uri = "/wifiConnectStatus",
@@ -833,7 +1785,7 @@ esp_err_t http_server_start(void)
         .handler = wifi_connect_status_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &wifi_status_uri);
+    http_stats_register_uri(server, &wifi_status_uri);
     
     httpd_uri_t wifi_info_uri = {
         .uri = "/wifiConnectInfo.json",
@@ -841,7 +1793,7 @@ esp_err_t http_server_start(void)
         .handler = wifi_connect_info_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &wifi_info_uri);
+    http_stats_register_uri(server, &wifi_info_uri);
     
     httpd_uri_t wifi_disconnect_uri = {
         .uri = "/wifiDisconnect.json",
@@ -849,7 +1801,7 @@ esp_err_t http_server_start(void)
         .handler = wifi_disconnect_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &wifi_disconnect_uri);
+    http_stats_register_uri(server, &wifi_disconnect_uri);
     
     httpd_uri_t wifi_scan_uri = {
         .uri = "/wifiScan.json",
@@ -857,7 +1809,7 @@ esp_err_t http_server_start(void)
         .handler = wifi_scan_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &wifi_scan_uri);
+    http_stats_register_uri(server, &wifi_scan_uri);
     
     httpd_uri_t config_backup_uri = {
         .uri = "/configBackup.json",
@@ -865,7 +1817,7 @@ esp_err_t http_server_start(void)
         .handler = config_backup_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &config_backup_uri);
+    http_workers_register_uri(server, &config_backup_uri);
     
     httpd_uri_t config_restore_uri = {
         .uri = "/configRestore.json",
@@ -873,7 +1825,14 @@ esp_err_t http_server_start(void)
         .handler = config_restore_handler,
         .user_ctx = NULL
     };
-    httpd_register_uri_handler(server, &config_restore_uri);
+    http_workers_register_uri(server, &config_restore_uri);
+    
+    http_metrics_start(server);
+    wifi_app_set_scan_callback(scan_done_cb);
+    
+    if (http_events_start(server) != ESP_OK) {
+        ESP_LOGW(TAG, "Event stream unavailable, clients will poll");
+    }
     
     ESP_LOGI(TAG, "HTTP server started successfully");
     return ESP_OK;
@@ -887,7 +1846,11 @@ esp_err_t http_server_stop(void)
     }
     
     ESP_LOGI(TAG, "Stopping HTTP server");
+    http_events_stop();
+    scan_waiters_drop_all();
+    http_workers_stop();
     esp_err_t ret = httpd_stop(server);
+    http_stats_stop();
     server = NULL;
     return ret;
 }
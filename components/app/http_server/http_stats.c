@@ -0,0 +1,293 @@
+#include "http_stats.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "http_stats";
+
+// Status classes 1xx-5xx; 0 counts requests answered without a status line
+#define HTTP_STATS_STATUS_CLASSES 6
+
+/**
+ * Counters of one endpoint on one core
+ * 32-bit atomics are native on Xtensa, so increments need no lock. Byte
+ * counters wrap at 4 GB.
+ */
+typedef struct {
+    atomic_uint_least32_t requests;
+    atomic_uint_least32_t bytes_in;
+    atomic_uint_least32_t bytes_out;
+    atomic_uint_least32_t latency_max_us;
+    atomic_uint_least32_t status[HTTP_STATS_STATUS_CLASSES];
+    atomic_uint_least32_t latency[HTTP_STATS_LATENCY_BUCKETS];
+} http_stats_counters_t;
+
+/**
+ * Registered endpoint and the handler it wraps
+ */
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+    http_stats_counters_t cores[configNUMBER_OF_CORES];
+} http_stats_endpoint_t;
+
+static http_stats_endpoint_t endpoints[HTTP_STATS_MAX_ENDPOINTS];
+static atomic_size_t endpoint_count = 0;
+
+/**
+ * Request being handled by a task
+ * Slots are claimed by the httpd task and the HTTP workers on their first
+ * request; only the owning task touches the fields after that.
+ */
+typedef struct {
+    _Atomic(TaskHandle_t) task;
+    http_stats_endpoint_t *endpoint;
+    uint32_t bytes_out;
+    uint8_t status_class;
+} http_stats_active_t;
+
+static http_stats_active_t active[HTTP_STATS_MAX_TASKS];
+
+static size_t latency_bucket(uint32_t us)
+{
+    if (us < (1u << HTTP_STATS_LATENCY_MIN_SHIFT)) {
+        return 0;
+    }
+    // [2^(k+6), 2^(k+7)) µs goes to bucket k
+    const size_t bucket = (32 - __builtin_clz(us)) - HTTP_STATS_LATENCY_MIN_SHIFT;
+    return bucket < HTTP_STATS_LATENCY_BUCKETS ? bucket : HTTP_STATS_LATENCY_BUCKETS - 1;
+}
+
+static void record(http_stats_endpoint_t *endpoint, size_t bytes_in, uint32_t bytes_out,
+                   uint8_t status_class, uint32_t latency_us)
+{
+    http_stats_counters_t *c = &endpoint->cores[xPortGetCoreID()];
+
+    atomic_fetch_add_explicit(&c->requests, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->bytes_in, bytes_in, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->bytes_out, bytes_out, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->status[status_class], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->latency[latency_bucket(latency_us)], 1, memory_order_relaxed);
+
+    uint32_t max = atomic_load_explicit(&c->latency_max_us, memory_order_relaxed);
+    while (latency_us > max &&
+           !atomic_compare_exchange_weak_explicit(&c->latency_max_us, &max, latency_us,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+/**
+ * Slot of the calling task, or NULL
+ */
+static http_stats_active_t *active_find(TaskHandle_t task)
+{
+    for (size_t i = 0; i < HTTP_STATS_MAX_TASKS; i++) {
+        if (atomic_load_explicit(&active[i].task, memory_order_acquire) == task) {
+            return &active[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Slot of the calling task, claiming a free one on first use
+ */
+static http_stats_active_t *active_claim(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    http_stats_active_t *slot = active_find(self);
+
+    for (size_t i = 0; slot == NULL && i < HTTP_STATS_MAX_TASKS; i++) {
+        TaskHandle_t expected = NULL;
+        if (atomic_compare_exchange_strong(&active[i].task, &expected, self)) {
+            slot = &active[i];
+        }
+    }
+    return slot;
+}
+
+/**
+ * Wrapper around every registered handler
+ */
+static esp_err_t instrumented_handler(httpd_req_t *req)
+{
+    http_stats_endpoint_t *endpoint = req->user_ctx;
+    req->user_ctx = endpoint->user_ctx;
+
+    http_stats_active_t *slot = active_claim();
+    if (slot != NULL) {
+        slot->bytes_out = 0;
+        slot->status_class = 0;
+        slot->endpoint = endpoint;
+    }
+
+    const int64_t start = esp_timer_get_time();
+    esp_err_t ret = endpoint->handler(req);
+    const int64_t elapsed = esp_timer_get_time() - start;
+
+    uint32_t bytes_out = 0;
+    uint8_t status_class = 0;
+    if (slot != NULL) {
+        slot->endpoint = NULL;
+        bytes_out = slot->bytes_out;
+        status_class = slot->status_class;
+    }
+    record(endpoint, req->content_len, bytes_out, status_class,
+           elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed);
+    return ret;
+}
+
+/**
+ * Session send function
+ * Same as the httpd default, plus accounting for the request being
+ * handled by the calling task. Sends from other tasks (e.g. /events
+ * streams) pass through.
+ */
+static int http_stats_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    (void)hd;
+    if (buf == NULL) {
+        return HTTPD_SOCK_ERR_INVALID;
+    }
+
+    int ret = send(sockfd, buf, buf_len, flags);
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return HTTPD_SOCK_ERR_TIMEOUT;
+        }
+        if (errno == EINVAL || errno == EBADF || errno == EFAULT || errno == ENOTSOCK) {
+            return HTTPD_SOCK_ERR_INVALID;
+        }
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+
+    http_stats_active_t *slot = active_find(xTaskGetCurrentTaskHandle());
+    if (slot != NULL && slot->endpoint != NULL) {
+        // The first send of a response starts with "HTTP/1.1 NNN"
+        if (slot->bytes_out == 0 && ret >= 10 && memcmp(buf, "HTTP/1.", 7) == 0 &&
+            buf[9] >= '1' && buf[9] <= '5') {
+            slot->status_class = buf[9] - '0';
+        }
+        slot->bytes_out += ret;
+    }
+    return ret;
+}
+
+esp_err_t http_stats_wrap_uri(const httpd_uri_t *uri, httpd_uri_t *wrapped)
+{
+    *wrapped = *uri;
+
+    const size_t index = atomic_load(&endpoint_count);
+    if (index == HTTP_STATS_MAX_ENDPOINTS) {
+        ESP_LOGW(TAG, "No room to track %s, registering without statistics", uri->uri);
+        return ESP_ERR_NO_MEM;
+    }
+
+    http_stats_endpoint_t *endpoint = &endpoints[index];
+    memset(endpoint, 0, sizeof(*endpoint));
+    endpoint->uri = uri->uri;
+    endpoint->method = uri->method;
+    endpoint->handler = uri->handler;
+    endpoint->user_ctx = uri->user_ctx;
+
+    wrapped->handler = instrumented_handler;
+    wrapped->user_ctx = endpoint;
+
+    // Publish the entry only once it is complete
+    atomic_store(&endpoint_count, index + 1);
+    return ESP_OK;
+}
+
+esp_err_t http_stats_register_uri(httpd_handle_t server, const httpd_uri_t *uri)
+{
+    httpd_uri_t wrapped;
+    http_stats_wrap_uri(uri, &wrapped);
+    return httpd_register_uri_handler(server, &wrapped);
+}
+
+esp_err_t http_stats_session_open(httpd_handle_t server, int sockfd)
+{
+    httpd_sess_set_send_override(server, sockfd, http_stats_send);
+    return ESP_OK;
+}
+
+void http_stats_write_json(json_writer_t *w)
+{
+    json_writer_object_begin(w, NULL);
+
+    // Upper bound of each latency bucket, null for the open-ended last one
+    json_writer_array_begin(w, "latency_bounds_us");
+    for (size_t b = 0; b < HTTP_STATS_LATENCY_BUCKETS - 1; b++) {
+        json_writer_int(w, NULL, 1u << (b + HTTP_STATS_LATENCY_MIN_SHIFT));
+    }
+    json_writer_null(w, NULL);
+    json_writer_array_end(w);
+
+    json_writer_array_begin(w, "endpoints");
+    const size_t count = atomic_load(&endpoint_count);
+    for (size_t i = 0; i < count; i++) {
+        const http_stats_endpoint_t *endpoint = &endpoints[i];
+
+        uint32_t requests = 0, bytes_in = 0, bytes_out = 0, latency_max_us = 0;
+        uint32_t status[HTTP_STATS_STATUS_CLASSES] = {0};
+        uint32_t latency[HTTP_STATS_LATENCY_BUCKETS] = {0};
+        for (int core = 0; core < configNUMBER_OF_CORES; core++) {
+            const http_stats_counters_t *c = &endpoint->cores[core];
+            requests += atomic_load_explicit(&c->requests, memory_order_relaxed);
+            bytes_in += atomic_load_explicit(&c->bytes_in, memory_order_relaxed);
+            bytes_out += atomic_load_explicit(&c->bytes_out, memory_order_relaxed);
+            uint32_t max = atomic_load_explicit(&c->latency_max_us, memory_order_relaxed);
+            if (max > latency_max_us) {
+                latency_max_us = max;
+            }
+            for (size_t s = 0; s < HTTP_STATS_STATUS_CLASSES; s++) {
+                status[s] += atomic_load_explicit(&c->status[s], memory_order_relaxed);
+            }
+            for (size_t b = 0; b < HTTP_STATS_LATENCY_BUCKETS; b++) {
+                latency[b] += atomic_load_explicit(&c->latency[b], memory_order_relaxed);
+            }
+        }
+
+        json_writer_object_begin(w, NULL);
+        json_writer_string(w, "uri", endpoint->uri);
+        json_writer_string(w, "method", http_method_str(endpoint->method));
+        json_writer_int(w, "requests", requests);
+        json_writer_int(w, "bytes_in", bytes_in);
+        json_writer_int(w, "bytes_out", bytes_out);
+
+        json_writer_object_begin(w, "status");
+        static const char *const class_names[HTTP_STATS_STATUS_CLASSES] = {
+            "none", "1xx", "2xx", "3xx", "4xx", "5xx"
+        };
+        for (size_t s = 0; s < HTTP_STATS_STATUS_CLASSES; s++) {
+            json_writer_int(w, class_names[s], status[s]);
+        }
+        json_writer_object_end(w);
+
+        json_writer_int(w, "latency_max_us", latency_max_us);
+        json_writer_array_begin(w, "latency");
+        for (size_t b = 0; b < HTTP_STATS_LATENCY_BUCKETS; b++) {
+            json_writer_int(w, NULL, latency[b]);
+        }
+        json_writer_array_end(w);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+
+    json_writer_object_end(w);
+}
+
+void http_stats_stop(void)
+{
+    for (size_t i = 0; i < HTTP_STATS_MAX_TASKS; i++) {
+        active[i].endpoint = NULL;
+    }
+    atomic_store(&endpoint_count, 0);
+}
@@ -0,0 +1,71 @@
+#ifndef HTTP_STATS_H
+#define HTTP_STATS_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "json_writer.h"
+
+// Endpoints tracked (matches max_uri_handlers in http_server_start)
+#define HTTP_STATS_MAX_ENDPOINTS 40
+
+// Tasks that run handlers: the httpd task and the HTTP workers
+#define HTTP_STATS_MAX_TASKS 4
+
+// Latency histogram: bucket 0 is below 128 µs, each next one doubles,
+// the last one (from 8.4 s) is open-ended
+#define HTTP_STATS_LATENCY_BUCKETS 18
+#define HTTP_STATS_LATENCY_MIN_SHIFT 7
+
+/**
+ * Register a URI handler with instrumentation
+ * Drop-in replacement for httpd_register_uri_handler(). Every request to
+ * the handler is counted with its latency, body size, response size and
+ * status class. The uri string must stay valid while the server runs.
+ * Beyond HTTP_STATS_MAX_ENDPOINTS handlers are registered untracked.
+ *
+ * @param server HTTP server handle
+ * @param uri URI handler description
+ * @return Result of httpd_register_uri_handler()
+ */
+esp_err_t http_stats_register_uri(httpd_handle_t server, const httpd_uri_t *uri);
+
+/**
+ * Instrument a URI handler without registering it
+ * For callers that register a dispatcher of their own in front of the
+ * instrumented handler (see http_workers_register_uri()).
+ *
+ * @param uri URI handler description
+ * @param wrapped Set to the instrumented description, or to a copy of
+ *                uri if no more endpoints can be tracked
+ * @return ESP_OK, or ESP_ERR_NO_MEM if uri is not tracked
+ */
+esp_err_t http_stats_wrap_uri(const httpd_uri_t *uri, httpd_uri_t *wrapped);
+
+/**
+ * Session open hook, set as httpd_config_t.open_fn
+ * Installs a send function on the socket that counts response bytes and
+ * picks up the status code.
+ *
+ * @param server HTTP server handle
+ * @param sockfd New session socket
+ * @return ESP_OK
+ */
+esp_err_t http_stats_session_open(httpd_handle_t server, int sockfd);
+
+/**
+ * Write the statistics of all endpoints as a JSON object
+ * Per-core counters are summed; values are read without locking, so an
+ * endpoint's numbers may be one request apart.
+ *
+ * @param w JSON writer
+ */
+void http_stats_write_json(json_writer_t *w);
+
+/**
+ * Forget all endpoints
+ * Must be called when the server is stopped; counters start over on the
+ * next start.
+ */
+void http_stats_stop(void);
+
+#endif // HTTP_STATS_H
@@ -0,0 +1,180 @@
+#include "http_workers.h"
+#include "http_stats.h"
+#include "tasks.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static const char *TAG = "http_workers";
+
+/**
+ * Slow endpoint: the handler the workers run for it
+ */
+typedef struct {
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+} http_workers_endpoint_t;
+
+/**
+ * Request handed to a worker
+ */
+typedef struct {
+    httpd_req_t *req;
+    const http_workers_endpoint_t *endpoint;
+} http_workers_job_t;
+
+static http_workers_endpoint_t endpoints[HTTP_WORKERS_MAX_ENDPOINTS];
+static size_t endpoint_count = 0;
+
+static QueueHandle_t job_queue = NULL;
+static TaskHandle_t worker_tasks[HTTP_WORKERS_COUNT];
+
+// Taken by a worker while it runs a handler, so stop can wait for it
+static SemaphoreHandle_t busy_mutex[HTTP_WORKERS_COUNT];
+
+/**
+ * Close a request that will not be handled
+ */
+static void job_drop(httpd_req_t *req)
+{
+    httpd_handle_t handle = req->handle;
+    int sockfd = httpd_req_to_sockfd(req);
+
+    httpd_req_async_handler_complete(req);
+    httpd_sess_trigger_close(handle, sockfd);
+}
+
+/**
+ * Worker task: runs queued requests to completion
+ */
+static void http_worker_task(void *pvParameters)
+{
+    const size_t index = (size_t)pvParameters;
+    http_workers_job_t job;
+
+    ESP_LOGI(TAG, "Worker %zu started on core %d", index, xPortGetCoreID());
+
+    while (1) {
+        if (xQueueReceive(job_queue, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        xSemaphoreTake(busy_mutex[index], portMAX_DELAY);
+        job.req->user_ctx = job.endpoint->user_ctx;
+        if (job.endpoint->handler(job.req) == ESP_OK) {
+            httpd_req_async_handler_complete(job.req);
+        } else {
+            // Same as the httpd task does after a failed handler
+            job_drop(job.req);
+        }
+        xSemaphoreGive(busy_mutex[index]);
+    }
+}
+
+/**
+ * Registered in place of a slow handler, runs on the httpd task
+ */
+static esp_err_t http_workers_dispatch(httpd_req_t *req)
+{
+    // The httpd task is the only producer, so a free slot stays free
+    if (uxQueueSpacesAvailable(job_queue) == 0) {
+        ESP_LOGW(TAG, "Workers busy, rejecting %s", req->uri);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "5");
+        httpd_resp_sendstr(req, "Server busy");
+        return ESP_OK;
+    }
+
+    http_workers_job_t job = {
+        .endpoint = req->user_ctx,
+    };
+    esp_err_t ret = httpd_req_async_handler_begin(req, &job.req);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to hand over %s: %s", req->uri, esp_err_to_name(ret));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start request");
+        return ESP_FAIL;
+    }
+
+    xQueueSend(job_queue, &job, 0);
+    return ESP_OK;
+}
+
+esp_err_t http_workers_start(void)
+{
+    if (job_queue != NULL) {
+        return ESP_OK;
+    }
+
+    job_queue = xQueueCreate(HTTP_WORKERS_QUEUE_LEN, sizeof(http_workers_job_t));
+    if (job_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create job queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (size_t i = 0; i < HTTP_WORKERS_COUNT; i++) {
+        busy_mutex[i] = xSemaphoreCreateMutex();
+        if (busy_mutex[i] == NULL) {
+            ESP_LOGE(TAG, "Failed to create worker mutex");
+            return ESP_ERR_NO_MEM;
+        }
+
+        BaseType_t ret = xTaskCreatePinnedToCore(
+            http_worker_task,
+            "http_worker",
+            HTTP_WORKER_TASK_STACK_SIZE,
+            (void *)i,
+            HTTP_WORKER_TASK_PRIORITY,
+            &worker_tasks[i],
+            HTTP_WORKER_TASK_CORE_ID);
+
+        if (ret != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create worker task");
+            return ESP_FAIL;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t http_workers_register_uri(httpd_handle_t server, const httpd_uri_t *uri)
+{
+    if (endpoint_count == HTTP_WORKERS_MAX_ENDPOINTS) {
+        ESP_LOGE(TAG, "No room for %s", uri->uri);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The worker runs the instrumented handler, so statistics cover the whole request
+    httpd_uri_t instrumented;
+    http_stats_wrap_uri(uri, &instrumented);
+
+    http_workers_endpoint_t *endpoint = &endpoints[endpoint_count++];
+    endpoint->handler = instrumented.handler;
+    endpoint->user_ctx = instrumented.user_ctx;
+
+    httpd_uri_t dispatch = *uri;
+    dispatch.handler = http_workers_dispatch;
+    dispatch.user_ctx = endpoint;
+    return httpd_register_uri_handler(server, &dispatch);
+}
+
+void http_workers_stop(void)
+{
+    if (job_queue == NULL) {
+        return;
+    }
+
+    http_workers_job_t job;
+    while (xQueueReceive(job_queue, &job, 0) == pdTRUE) {
+        job_drop(job.req);
+    }
+
+    // Wait out requests already running
+    for (size_t i = 0; i < HTTP_WORKERS_COUNT; i++) {
+        xSemaphoreTake(busy_mutex[i], portMAX_DELAY);
+        xSemaphoreGive(busy_mutex[i]);
+    }
+
+    endpoint_count = 0;
+}
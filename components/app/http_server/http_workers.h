@@ -0,0 +1,46 @@
+#ifndef HTTP_WORKERS_H
+#define HTTP_WORKERS_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Worker tasks running slow handlers (see HTTP_WORKER_TASK_* in tasks.h)
+#define HTTP_WORKERS_COUNT 2
+
+// Requests waiting for a worker; beyond that new ones get a 503
+#define HTTP_WORKERS_QUEUE_LEN 4
+
+// Slow endpoints that can be registered (see http_workers_register_uri())
+#define HTTP_WORKERS_MAX_ENDPOINTS 8
+
+/**
+ * Start the worker tasks
+ * Workers are created on first use and kept across server restarts.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM or ESP_FAIL if the queue or a
+ *         task could not be created
+ */
+esp_err_t http_workers_start(void);
+
+/**
+ * Register a slow URI handler that runs on a worker task
+ * The httpd task only hands the request over (as an async request) and
+ * goes on serving other sockets. The handler runs unchanged on a worker,
+ * including body reads. When the queue is full the client gets a 503 with
+ * Retry-After. Requests are counted by http_stats like any other.
+ *
+ * @param server HTTP server handle
+ * @param uri URI handler description
+ * @return Result of httpd_register_uri_handler(), or ESP_ERR_NO_MEM if
+ *         HTTP_WORKERS_MAX_ENDPOINTS are registered already
+ */
+esp_err_t http_workers_register_uri(httpd_handle_t server, const httpd_uri_t *uri);
+
+/**
+ * Close queued requests and forget the registered endpoints
+ * Must be called before the server is stopped. Waits for requests already
+ * on a worker to finish.
+ */
+void http_workers_stop(void);
+
+#endif // HTTP_WORKERS_H
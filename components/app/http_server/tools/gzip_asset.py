@@ -0,0 +1,23 @@
+#!/usr/bin/env python3
+"""Gzip a web asset for embedding into the firmware.
+
+The output is reproducible: no file name and a zero mtime in the gzip
+header, so unchanged assets produce identical bytes (and ETags).
+"""
+import gzip
+import sys
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: gzip_asset.py <input> <output.gz>')
+
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    with open(sys.argv[2], 'wb') as f:
+        f.write(gzip.compress(data, compresslevel=9, mtime=0))
+
+
+if __name__ == '__main__':
+    main()
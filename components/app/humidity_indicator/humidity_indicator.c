@@ -4,7 +4,7 @@
 #include "esp_log.h"
 
 #include "humidity_indicator.h"
-#include "app_coordinator.h"
+#include "dht_bus.h"
 #include "led_controller.h"
 
 static const char *TAG = "humidity_indicator";
@@ -16,25 +16,26 @@ static const led_controller_color_t COLOR_RED = {32, 0, 0};
 
 static void humidity_indicator_task(void *pvParameters)
 {
-    app_coordinator_sensor_data_t sensor_data;
+    dht_bus_subscriber_t *subscriber = (dht_bus_subscriber_t *)pvParameters;
+    dht_sample_t sample;
 
     ESP_LOGI(TAG, "Humidity indicator task started");
 
     while (1)
     {
-        // Get sensor data from app_coordinator
-        esp_err_t ret = app_coordinator_get_sensor_data(&sensor_data);
+        // Block until the next sample is published
+        esp_err_t ret = dht_bus_receive(subscriber, &sample, portMAX_DELAY);
         
-        if (ret == ESP_OK && sensor_data.valid)
+        if (ret == ESP_OK && sample.data.sensor_id == 0)
         {
-            // printf("Humidity: %.1f%% Temp: %.1fC\n", sensor_data.humidity, sensor_data.temperature);
+            // printf("Humidity: %.1f%% Temp: %.1fC\n", sample.data.humidity, sample.data.temperature);
 
             // Update LED color based on humidity
-            if (sensor_data.humidity < 50.0f)
+            if (sample.data.humidity < 50.0f)
             {
                 led_controller_set_color(COLOR_GREEN);
             }
-            else if (sensor_data.humidity < 55.0f)
+            else if (sample.data.humidity < 55.0f)
             {
                 led_controller_set_color(COLOR_ORANGE);
             }
@@ -43,9 +44,6 @@ static void humidity_indicator_task(void *pvParameters)
                 led_controller_set_color(COLOR_RED);
             }
         }
-        
-        // Poll every 2 seconds
-        vTaskDelay(pdMS_TO_TICKS(2000));
     }
 }
 
@@ -53,12 +51,19 @@ esp_err_t humidity_indicator_start(void)
 {
     ESP_LOGI(TAG, "Starting humidity indicator...");
 
+    dht_bus_subscriber_t *subscriber = dht_bus_subscribe();
+    if (subscriber == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to subscribe to DHT samples");
+        return ESP_FAIL;
+    }
+
     // Create the task that processes sensor data and indicates humidity
     BaseType_t task_created = xTaskCreate(
         humidity_indicator_task,
         "humidity_indicator",
         4096,
-        NULL,
+        subscriber,
         5,
         NULL
     );
@@ -7,8 +7,8 @@
  * @brief Initialize and start the humidity indicator
  * 
  * This starts a FreeRTOS task that:
- * - Initializes the DHT reader
- * - Reads temperature and humidity periodically
+ * - Subscribes to the DHT sample bus
+ * - Updates the LED on every new sample of the primary sensor
  * - Indicates humidity level via LED color:
  *   - Green: humidity < 50%
  *   - Red: humidity >= 50%
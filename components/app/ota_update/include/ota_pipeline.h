@@ -0,0 +1,95 @@
+#ifndef OTA_PIPELINE_H
+#define OTA_PIPELINE_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Receive buffers in flight between the receiving task and the flash writer
+#define OTA_PIPELINE_BUFFERS 4
+#define OTA_PIPELINE_BUFFER_SIZE 4096
+
+/**
+ * Where the time of a pipelined update went, in microseconds
+ * Receiving and writing overlap, so the stages add up to more than the
+ * wall time; the stall and idle figures show which side is the bottleneck.
+ * With OTA_UPDATE_STREAMING_ERASE, esp_ota_write() erases each sector it
+ * enters, so erasing is part of write_us and begin_us is close to 0;
+ * without it, begin_us is the up-front erase of the image area.
+ */
+typedef struct {
+    uint32_t recv_us;           // Receiver: filling buffers (network and parsing)
+    uint32_t recv_stall_us;     // Receiver: waiting for the writer to free a buffer
+    uint32_t begin_us;          // Writer: ota_update_begin()
+    uint32_t write_us;          // Writer: ota_update_write(), streaming erase included
+    uint32_t verify_us;         // Writer: hashing the image, part of write_us
+    uint32_t write_idle_us;     // Writer: waiting for data
+    uint32_t bytes;             // Firmware bytes written
+} ota_pipeline_timing_t;
+
+/**
+ * Start a pipelined update
+ * Allocates the buffer pool and starts the flash writer task on the core
+ * the caller does not run on (see OTA_WRITER_TASK_* in tasks.h). The
+ * writer calls ota_update_begin() when the first data arrives. All other
+ * functions must be called from the task that called this one.
+ *
+ * @param firmware_size Expected size of firmware, passed to ota_update_begin()
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if a pipeline is running,
+ *         ESP_ERR_NO_MEM if the buffers or the task could not be allocated
+ */
+esp_err_t ota_pipeline_begin(size_t firmware_size);
+
+/**
+ * Get a free receive buffer of OTA_PIPELINE_BUFFER_SIZE bytes
+ * Blocks while the writer holds all buffers.
+ *
+ * @param buf Set to the buffer
+ * @return ESP_OK, or the writer's first error
+ */
+esp_err_t ota_pipeline_acquire(uint8_t **buf);
+
+/**
+ * Queue firmware data for the writer
+ * The data is not copied: it must lie in an acquired buffer not yet
+ * released, or stay valid until ota_pipeline_end().
+ *
+ * @param data Firmware data chunk
+ * @param size Size of chunk
+ * @return ESP_OK, or the writer's first error
+ */
+esp_err_t ota_pipeline_write(const uint8_t *data, size_t size);
+
+/**
+ * Hand a buffer back once all data in it has been queued
+ * The writer reuses it after writing that data.
+ *
+ * @param buf Buffer from ota_pipeline_acquire()
+ */
+void ota_pipeline_release(uint8_t *buf);
+
+/**
+ * Wait for the writer to drain the queue and stop it
+ * On success the update is ready for ota_update_end() and owned by the
+ * caller. On error the update is aborted if the writer began it.
+ *
+ * @return ESP_OK, the writer's first error (ESP_ERR_INVALID_STATE or
+ *         ESP_ERR_TIMEOUT from ota_update_begin() if another update holds
+ *         the OTA state), or ESP_ERR_INVALID_SIZE if no data was written
+ */
+esp_err_t ota_pipeline_end(void);
+
+/**
+ * Stop the writer and abort the update, if the writer began it
+ */
+void ota_pipeline_abort(void);
+
+/**
+ * Get the time breakdown of the running or last pipelined update
+ *
+ * @param timing Receives the figures
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if no pipelined update ran since boot
+ */
+esp_err_t ota_pipeline_get_timing(ota_pipeline_timing_t *timing);
+
+#endif // OTA_PIPELINE_H
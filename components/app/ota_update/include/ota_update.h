@@ -5,39 +5,102 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// 1: erase flash sector by sector as the image is written, 0: erase the
+// whole image area in ota_update_begin() (takes seconds for a large image)
+#ifndef OTA_UPDATE_STREAMING_ERASE
+#define OTA_UPDATE_STREAMING_ERASE 1
+#endif
+
+// Flash sector size; with streaming erase, writes reach flash in whole sectors
+#define OTA_UPDATE_SECTOR_SIZE 4096
+
+// Upload sessions persist their progress every this many bytes on flash
+#define OTA_UPDATE_SESSION_PERSIST_BYTES (64 * 1024)
+
+/**
+ * Resumable upload session
+ */
+typedef struct {
+    uint32_t id;
+    size_t size;            // Firmware size announced at creation
+    size_t offset;          // Bytes accepted so far, where the next chunk starts
+} ota_update_session_t;
+
+/**
+ * Initialize OTA update
+ * Creates the lock that serializes the OTA calls and reopens a session
+ * persisted before a restart; call once, after nvs_flash_init(), before
+ * any other function. All OTA state is shared: the caller whose
+ * ota_update_begin() succeeded owns the update, and only it may write,
+ * end or abort it.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the lock could not be created
+ */
+esp_err_t ota_update_init(void);
+
 /**
  * Begin OTA update
- * Prepares for firmware upload
+ * Prepares for firmware upload. With OTA_UPDATE_STREAMING_ERASE nothing
+ * is erased yet, so this returns quickly.
  * 
  * @param firmware_size Expected size of firmware
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if an update or
+ *         session is in progress, ESP_ERR_TIMEOUT if another OTA call is
+ *         running, ESP_ERR_NO_MEM if the sector buffer could not be allocated
  */
 esp_err_t ota_update_begin(size_t firmware_size);
 
 /**
  * Write firmware data chunk
- * Streams firmware data to OTA partition
+ * Streams firmware data to OTA partition. An image that starts with the
+ * gzip magic is decompressed on the fly, and a patch made with
+ * tools/ota_delta.py (gzipped or not) is applied to the running firmware
+ * (both need OTA_UPDATE_STREAMING_ERASE). firmware_size, progress and
+ * session offsets count uploaded bytes.
+ * The image is hashed as it is written; a mismatch with the digest
+ * appended by the build fails the write that completes the digest.
  * 
- * @param data Firmware data chunk
+ * @param data Firmware data chunk (any size, the image header may span chunks)
  * @param size Size of chunk
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_OTA_VALIDATE_FAILED if the image
+ *         layout or its digest is invalid
  */
 esp_err_t ota_update_write(const uint8_t *data, size_t size);
 
 /**
  * End OTA update
- * Finalizes and validates firmware
+ * Finalizes and validates firmware and sets it as the boot partition,
+ * without rebooting: the caller reports the result, then calls
+ * ota_update_restart(). A truncated image is rejected before
+ * esp_ota_end() reads the partition back.
  * 
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the image or patch
+ *         is truncated, ESP_ERR_INVALID_CRC or ESP_ERR_INVALID_ARG for a
+ *         corrupt gzip stream, ESP_ERR_OTA_VALIDATE_FAILED if the image
+ *         fails its digest or esp_ota_end() check
  */
 esp_err_t ota_update_end(void);
 
+/**
+ * Reboot into the firmware of a successful ota_update_end()
+ * Waits 2 seconds first, so the HTTP response can be sent.
+ */
+void ota_update_restart(void);
+
 /**
  * Abort OTA update
  * Cancels ongoing update
  */
 void ota_update_abort(void);
 
+/**
+ * Get the time the running or last update spent hashing the image
+ * The hash is computed inside ota_update_write(), so this is part of its time.
+ *
+ * @return Microseconds
+ */
+uint32_t ota_update_get_verify_us(void);
+
 /**
  * Get OTA update progress
  * 
@@ -45,5 +108,60 @@ void ota_update_abort(void);
  */
 uint8_t ota_update_get_progress(void);
 
+/**
+ * Start a resumable upload session
+ * Begins an update like ota_update_begin(), replacing any earlier session.
+ * The session is kept in NVS: after a restart the upload continues from
+ * the last persisted offset (see OTA_UPDATE_SESSION_PERSIST_BYTES).
+ *
+ * @param firmware_size Firmware size
+ * @param session Receives the new session
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if another OTA call is
+ *         running, or an ota_update_begin() or NVS error
+ */
+esp_err_t ota_update_session_create(size_t firmware_size, ota_update_session_t *session);
+
+/**
+ * Get the current session
+ *
+ * @param session Receives the session
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is none,
+ *         ESP_ERR_TIMEOUT if another OTA call is running
+ */
+esp_err_t ota_update_session_get(ota_update_session_t *session);
+
+/**
+ * Write the next chunk of a session
+ * The chunk is checked against its CRC before it is written. The offset
+ * check, the write and the persisted progress are one step under the OTA
+ * lock, so a resent chunk can never be written twice.
+ *
+ * @param id Session ID
+ * @param offset Firmware offset of the chunk, must equal the session offset
+ * @param data Chunk data
+ * @param size Chunk size
+ * @param crc CRC-32 of the chunk (as zlib's crc32())
+ * @param session Receives the session after the write, on ESP_OK and
+ *        ESP_ERR_INVALID_STATE
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown session,
+ *         ESP_ERR_TIMEOUT if another OTA call is running,
+ *         ESP_ERR_INVALID_STATE if offset is not the session offset,
+ *         ESP_ERR_INVALID_SIZE if the chunk goes past the firmware size,
+ *         ESP_ERR_INVALID_CRC if the chunk is corrupt, or a write error
+ *         (which ends the session)
+ */
+esp_err_t ota_update_session_write(uint32_t id, size_t offset, const uint8_t *data, size_t size, uint32_t crc,
+                                   ota_update_session_t *session);
+
+/**
+ * Finish a complete session like ota_update_end()
+ *
+ * @param id Session ID
+ * @return ESP_ERR_NOT_FOUND for an unknown session, ESP_ERR_INVALID_SIZE
+ *         if not all data was written, ESP_ERR_TIMEOUT if another OTA
+ *         call is running, or an ota_update_end() error
+ */
+esp_err_t ota_update_session_commit(uint32_t id);
+
 #endif // OTA_UPDATE_H
 
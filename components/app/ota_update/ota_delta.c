@@ -0,0 +1,273 @@
+#include "ota_delta.h"
+#include "ota_field.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ota_delta";
+
+/*
+ * Patch format (little endian), written by tools/ota_delta.py:
+ *
+ *   "ODP1" | source size u32 | target size u32 | source SHA-256 [32]
+ *   then operations, each a tag byte and fields:
+ *     0x01 COPY   source offset u32, length u32
+ *     0x02 ADD    source offset u32, length u32, length bytes added to the source
+ *     0x03 INSERT length u32, length bytes
+ *     0x00 END
+ */
+#define OTA_DELTA_HEADER_LEN 44
+#define OTA_DELTA_OP_END    0x00
+#define OTA_DELTA_OP_COPY   0x01
+#define OTA_DELTA_OP_ADD    0x02
+#define OTA_DELTA_OP_INSERT 0x03
+
+// Source bytes read from flash at a time
+#define OTA_DELTA_READ_SIZE 1024
+
+typedef enum {
+    OTA_DELTA_HEADER,
+    OTA_DELTA_TAG,
+    OTA_DELTA_FIELDS,           // Offset and/or length of the operation
+    OTA_DELTA_ADD_DATA,
+    OTA_DELTA_INSERT_DATA,
+    OTA_DELTA_DONE,
+} ota_delta_state_t;
+
+struct ota_delta {
+    ota_delta_state_t state;
+    uint8_t field[OTA_DELTA_HEADER_LEN];
+    size_t field_len;
+    uint8_t op;
+    uint32_t src_offset;
+    uint32_t remaining;         // Bytes left of the operation
+    uint32_t source_size;
+    uint32_t target_size;
+    uint32_t out_size;          // Image bytes produced so far
+    const esp_partition_t *source;
+    ota_delta_output_t output;
+    uint8_t buf[OTA_DELTA_READ_SIZE];
+};
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+ota_delta_t *ota_delta_begin(ota_delta_output_t output)
+{
+    ota_delta_t *d = calloc(1, sizeof(*d));
+    if (d == NULL) {
+        ESP_LOGE(TAG, "No memory for the patcher");
+        return NULL;
+    }
+
+    d->state = OTA_DELTA_HEADER;
+    d->output = output;
+    ESP_LOGI(TAG, "Applying patch to the running firmware");
+    return d;
+}
+
+/**
+ * Check the header against the running firmware
+ */
+static esp_err_t check_header(ota_delta_t *d)
+{
+    if (memcmp(d->field, "ODP1", 4) != 0) {
+        ESP_LOGE(TAG, "Not a patch");
+        return ESP_ERR_INVALID_ARG;
+    }
+    d->source_size = get_u32(d->field + 4);
+    d->target_size = get_u32(d->field + 8);
+
+    d->source = esp_ota_get_running_partition();
+    if (d->source == NULL || d->source_size > d->source->size) {
+        ESP_LOGE(TAG, "Patch source larger than the running partition");
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    uint8_t sha[32];
+    esp_err_t ret = esp_partition_get_sha256(d->source, sha);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to hash the running firmware: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    if (memcmp(sha, d->field + 12, sizeof(sha)) != 0) {
+        ESP_LOGE(TAG, "Patch was made for different firmware");
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    ESP_LOGI(TAG, "Patch matches the running firmware, %" PRIu32 " -> %" PRIu32 " bytes",
+             d->source_size, d->target_size);
+    return ESP_OK;
+}
+
+/**
+ * Check an operation's ranges before it produces anything
+ */
+static esp_err_t check_op(const ota_delta_t *d, bool reads_source)
+{
+    if (d->remaining > d->target_size - d->out_size ||
+        (reads_source && (d->src_offset > d->source_size || d->remaining > d->source_size - d->src_offset))) {
+        ESP_LOGE(TAG, "Patch operation out of range");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t emit(ota_delta_t *d, const uint8_t *data, size_t size)
+{
+    d->out_size += size;
+    return d->output(data, size);
+}
+
+/**
+ * Copy a source range to the output
+ */
+static esp_err_t copy_source(ota_delta_t *d)
+{
+    while (d->remaining > 0) {
+        const size_t n = (d->remaining < OTA_DELTA_READ_SIZE) ? d->remaining : OTA_DELTA_READ_SIZE;
+        esp_err_t ret = esp_partition_read(d->source, d->src_offset, d->buf, n);
+        if (ret == ESP_OK) {
+            ret = emit(d, d->buf, n);
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        d->src_offset += n;
+        d->remaining -= n;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Add patch bytes to the source and output the sum
+ */
+static esp_err_t add_source(ota_delta_t *d, const uint8_t *data, size_t n)
+{
+    esp_err_t ret = esp_partition_read(d->source, d->src_offset, d->buf, n);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    for (size_t i = 0; i < n; i++) {
+        d->buf[i] += data[i];
+    }
+    d->src_offset += n;
+    d->remaining -= n;
+    return emit(d, d->buf, n);
+}
+
+/**
+ * Start the operation whose tag and fields were read
+ */
+static esp_err_t start_op(ota_delta_t *d)
+{
+    esp_err_t ret;
+
+    switch (d->op) {
+    case OTA_DELTA_OP_COPY:
+        d->src_offset = get_u32(d->field);
+        d->remaining = get_u32(d->field + 4);
+        ret = check_op(d, true);
+        if (ret == ESP_OK) {
+            ret = copy_source(d);
+        }
+        d->state = OTA_DELTA_TAG;
+        return ret;
+
+    case OTA_DELTA_OP_ADD:
+        d->src_offset = get_u32(d->field);
+        d->remaining = get_u32(d->field + 4);
+        d->state = OTA_DELTA_ADD_DATA;
+        return check_op(d, true);
+
+    case OTA_DELTA_OP_INSERT:
+        d->remaining = get_u32(d->field);
+        d->state = OTA_DELTA_INSERT_DATA;
+        return check_op(d, false);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t ota_delta_feed(ota_delta_t *d, const uint8_t *data, size_t size)
+{
+    esp_err_t ret = ESP_OK;
+
+    while (size > 0 && ret == ESP_OK) {
+        switch (d->state) {
+        case OTA_DELTA_HEADER:
+            if (ota_field_collect(d->field, &d->field_len, OTA_DELTA_HEADER_LEN, &data, &size)) {
+                ret = check_header(d);
+                d->state = OTA_DELTA_TAG;
+            }
+            break;
+
+        case OTA_DELTA_TAG:
+            d->op = *data++;
+            size--;
+            if (d->op == OTA_DELTA_OP_END) {
+                d->state = OTA_DELTA_DONE;
+            } else if (d->op <= OTA_DELTA_OP_INSERT) {
+                d->state = OTA_DELTA_FIELDS;
+            } else {
+                ESP_LOGE(TAG, "Unknown patch operation 0x%02x", d->op);
+                ret = ESP_ERR_INVALID_ARG;
+            }
+            break;
+
+        case OTA_DELTA_FIELDS:
+            if (ota_field_collect(d->field, &d->field_len, (d->op == OTA_DELTA_OP_INSERT) ? 4 : 8, &data, &size)) {
+                ret = start_op(d);
+            }
+            break;
+
+        case OTA_DELTA_ADD_DATA:
+        case OTA_DELTA_INSERT_DATA: {
+            size_t n = (d->remaining < size) ? d->remaining : size;
+            if (d->state == OTA_DELTA_ADD_DATA) {
+                if (n > OTA_DELTA_READ_SIZE) {
+                    n = OTA_DELTA_READ_SIZE;
+                }
+                ret = add_source(d, data, n);
+            } else {
+                // Literal bytes go out straight from the caller's buffer
+                d->remaining -= n;
+                ret = emit(d, data, n);
+            }
+            data += n;
+            size -= n;
+            break;
+        }
+
+        case OTA_DELTA_DONE:
+            ESP_LOGE(TAG, "Data after the end of the patch");
+            ret = ESP_ERR_INVALID_ARG;
+            break;
+        }
+
+        if ((d->state == OTA_DELTA_ADD_DATA || d->state == OTA_DELTA_INSERT_DATA) && d->remaining == 0) {
+            d->state = OTA_DELTA_TAG;
+        }
+    }
+
+    return ret;
+}
+
+esp_err_t ota_delta_finish(ota_delta_t *d)
+{
+    if (d->state != OTA_DELTA_DONE || d->out_size != d->target_size) {
+        ESP_LOGE(TAG, "Patch truncated: %" PRIu32 " of %" PRIu32 " bytes", d->out_size, d->target_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+void ota_delta_free(ota_delta_t *d)
+{
+    free(d);
+}
@@ -0,0 +1,59 @@
+#ifndef OTA_DELTA_H
+#define OTA_DELTA_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// First byte of a patch ("ODP1", see tools/ota_delta.py)
+#define OTA_DELTA_MAGIC_BYTE 'O'
+
+/**
+ * Output callback, receives the rebuilt image in order
+ *
+ * @param data Image bytes, only valid during the call
+ * @param size Number of bytes
+ * @return ESP_OK to continue, any other value stops patching
+ */
+typedef esp_err_t (*ota_delta_output_t)(const uint8_t *data, size_t size);
+
+typedef struct ota_delta ota_delta_t;
+
+/**
+ * Start applying a patch to the running firmware
+ * The patch header names the SHA-256 of the image it was made against;
+ * it is checked against the running partition before any output.
+ *
+ * @param output Callback receiving the new image
+ * @return Patcher, or NULL if out of memory
+ */
+ota_delta_t *ota_delta_begin(ota_delta_output_t output);
+
+/**
+ * Apply the next chunk of the patch
+ *
+ * @param d Patcher
+ * @param data Patch bytes, chunks may be split anywhere
+ * @param size Number of bytes
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the patch is malformed,
+ *         ESP_ERR_INVALID_VERSION if it was made for other firmware, a
+ *         flash read error, or the output callback's error
+ */
+esp_err_t ota_delta_feed(ota_delta_t *d, const uint8_t *data, size_t size);
+
+/**
+ * Check that the patch ended and produced the whole image
+ *
+ * @param d Patcher
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the patch is truncated
+ */
+esp_err_t ota_delta_finish(ota_delta_t *d);
+
+/**
+ * Free a patcher
+ *
+ * @param d Patcher, may be NULL
+ */
+void ota_delta_free(ota_delta_t *d);
+
+#endif // OTA_DELTA_H
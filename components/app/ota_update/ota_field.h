@@ -0,0 +1,39 @@
+#ifndef OTA_FIELD_H
+#define OTA_FIELD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Collect a fixed-size field from a stream split anywhere
+ * Shared by the gzip, patch and image-layout state machines.
+ *
+ * @param field Buffer of at least len bytes
+ * @param field_len Bytes collected so far, reset to 0 once complete
+ * @param len Size of the field
+ * @param data Input, advanced past the bytes taken
+ * @param size Input size, reduced by the bytes taken
+ * @return true once the field is complete
+ */
+static inline bool ota_field_collect(uint8_t *field, size_t *field_len, size_t len, const uint8_t **data,
+                                     size_t *size)
+{
+    size_t take = len - *field_len;
+    if (take > *size) {
+        take = *size;
+    }
+    memcpy(field + *field_len, *data, take);
+    *field_len += take;
+    *data += take;
+    *size -= take;
+
+    if (*field_len < len) {
+        return false;
+    }
+    *field_len = 0;
+    return true;
+}
+
+#endif // OTA_FIELD_H
@@ -0,0 +1,225 @@
+#include "ota_inflate.h"
+#include "ota_field.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "miniz.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ota_inflate";
+
+// gzip header flags (RFC 1952)
+#define GZIP_FHCRC      0x02
+#define GZIP_FEXTRA     0x04
+#define GZIP_FNAME      0x08
+#define GZIP_FCOMMENT   0x10
+
+#define GZIP_HEADER_LEN 10
+#define GZIP_TRAILER_LEN 8
+
+typedef enum {
+    OTA_INFLATE_HEADER,         // Fixed 10-byte header
+    OTA_INFLATE_EXTRA_LEN,
+    OTA_INFLATE_EXTRA,
+    OTA_INFLATE_NAME,
+    OTA_INFLATE_COMMENT,
+    OTA_INFLATE_HEADER_CRC,
+    OTA_INFLATE_DEFLATE,
+    OTA_INFLATE_TRAILER,        // CRC-32 and size of the decompressed data
+    OTA_INFLATE_DONE,
+} ota_inflate_state_t;
+
+struct ota_inflate {
+    tinfl_decompressor decomp;
+    uint8_t dict[TINFL_LZ_DICT_SIZE];   // Window, and output buffer of the inflater
+    size_t dict_ofs;
+    ota_inflate_state_t state;
+    uint8_t field[GZIP_HEADER_LEN];     // Fixed-size field being collected
+    size_t field_len;
+    size_t skip;                        // Bytes of FEXTRA left
+    uint8_t flags;
+    uint32_t crc;
+    uint32_t size;
+    ota_inflate_output_t output;
+};
+
+ota_inflate_t *ota_inflate_begin(ota_inflate_output_t output)
+{
+    ota_inflate_t *inf = malloc(sizeof(*inf));
+    if (inf == NULL) {
+        ESP_LOGE(TAG, "No memory for the inflater (%zu bytes)", sizeof(*inf));
+        return NULL;
+    }
+
+    tinfl_init(&inf->decomp);
+    inf->dict_ofs = 0;
+    inf->state = OTA_INFLATE_HEADER;
+    inf->field_len = 0;
+    inf->crc = 0;
+    inf->size = 0;
+    inf->output = output;
+    ESP_LOGI(TAG, "Decompressing gzip image");
+    return inf;
+}
+
+/**
+ * State after the header field just finished
+ */
+static ota_inflate_state_t next_header_state(const ota_inflate_t *inf, ota_inflate_state_t done)
+{
+    if (done < OTA_INFLATE_EXTRA_LEN && (inf->flags & GZIP_FEXTRA)) {
+        return OTA_INFLATE_EXTRA_LEN;
+    }
+    if (done < OTA_INFLATE_NAME && (inf->flags & GZIP_FNAME)) {
+        return OTA_INFLATE_NAME;
+    }
+    if (done < OTA_INFLATE_COMMENT && (inf->flags & GZIP_FCOMMENT)) {
+        return OTA_INFLATE_COMMENT;
+    }
+    if (done < OTA_INFLATE_HEADER_CRC && (inf->flags & GZIP_FHCRC)) {
+        return OTA_INFLATE_HEADER_CRC;
+    }
+    return OTA_INFLATE_DEFLATE;
+}
+
+/**
+ * Run the inflater over compressed data, passing on what comes out
+ */
+static esp_err_t run_inflater(ota_inflate_t *inf, const uint8_t **data, size_t *size)
+{
+    tinfl_status status;
+
+    do {
+        size_t in_size = *size;
+        size_t out_size = TINFL_LZ_DICT_SIZE - inf->dict_ofs;
+        status = tinfl_decompress(&inf->decomp, *data, &in_size, inf->dict, inf->dict + inf->dict_ofs,
+                                  &out_size, TINFL_FLAG_HAS_MORE_INPUT);
+        *data += in_size;
+        *size -= in_size;
+
+        if (out_size > 0) {
+            const uint8_t *out = inf->dict + inf->dict_ofs;
+            inf->crc = esp_rom_crc32_le(inf->crc, out, out_size);
+            inf->size += out_size;
+            esp_err_t ret = inf->output(out, out_size);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            inf->dict_ofs = (inf->dict_ofs + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Corrupt deflate data (%d)", status);
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            inf->state = OTA_INFLATE_TRAILER;
+            return ESP_OK;
+        }
+    } while (*size > 0 || status == TINFL_STATUS_HAS_MORE_OUTPUT);
+
+    return ESP_OK;
+}
+
+esp_err_t ota_inflate_feed(ota_inflate_t *inf, const uint8_t *data, size_t size)
+{
+    while (size > 0) {
+        switch (inf->state) {
+        case OTA_INFLATE_HEADER:
+            if (!ota_field_collect(inf->field, &inf->field_len, GZIP_HEADER_LEN, &data, &size)) {
+                break;
+            }
+            // Magic and the deflate method
+            if (inf->field[0] != 0x1F || inf->field[1] != 0x8B || inf->field[2] != 8) {
+                ESP_LOGE(TAG, "Not a gzip stream");
+                return ESP_ERR_INVALID_ARG;
+            }
+            inf->flags = inf->field[3];
+            inf->state = next_header_state(inf, OTA_INFLATE_HEADER);
+            break;
+
+        case OTA_INFLATE_EXTRA_LEN:
+            if (ota_field_collect(inf->field, &inf->field_len, 2, &data, &size)) {
+                inf->skip = inf->field[0] | (inf->field[1] << 8);
+                inf->state = OTA_INFLATE_EXTRA;
+            }
+            break;
+
+        case OTA_INFLATE_EXTRA: {
+            const size_t take = (inf->skip < size) ? inf->skip : size;
+            inf->skip -= take;
+            data += take;
+            size -= take;
+            if (inf->skip == 0) {
+                inf->state = next_header_state(inf, OTA_INFLATE_EXTRA);
+            }
+            break;
+        }
+
+        case OTA_INFLATE_NAME:
+        case OTA_INFLATE_COMMENT: {
+            // Zero-terminated strings
+            const uint8_t *end = memchr(data, 0, size);
+            const size_t take = (end != NULL) ? (size_t)(end - data) + 1 : size;
+            data += take;
+            size -= take;
+            if (end != NULL) {
+                inf->state = next_header_state(inf, inf->state);
+            }
+            break;
+        }
+
+        case OTA_INFLATE_HEADER_CRC:
+            if (ota_field_collect(inf->field, &inf->field_len, 2, &data, &size)) {
+                inf->state = OTA_INFLATE_DEFLATE;
+            }
+            break;
+
+        case OTA_INFLATE_DEFLATE: {
+            esp_err_t ret = run_inflater(inf, &data, &size);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            break;
+        }
+
+        case OTA_INFLATE_TRAILER:
+            if (ota_field_collect(inf->field, &inf->field_len, GZIP_TRAILER_LEN, &data, &size)) {
+                inf->state = OTA_INFLATE_DONE;
+            }
+            break;
+
+        case OTA_INFLATE_DONE:
+            // Padding after the stream; further gzip members are not supported
+            return ESP_OK;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ota_inflate_finish(ota_inflate_t *inf)
+{
+    if (inf->state != OTA_INFLATE_DONE) {
+        ESP_LOGE(TAG, "gzip stream truncated");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const uint8_t *t = inf->field;
+    const uint32_t crc = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+    const uint32_t size = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+    if (crc != inf->crc || size != inf->size) {
+        ESP_LOGE(TAG, "gzip check failed: CRC %08" PRIx32 "/%08" PRIx32 ", size %" PRIu32 "/%" PRIu32,
+                 inf->crc, crc, inf->size, size);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    ESP_LOGI(TAG, "gzip image intact, %" PRIu32 " bytes", inf->size);
+    return ESP_OK;
+}
+
+void ota_inflate_free(ota_inflate_t *inf)
+{
+    free(inf);
+}
@@ -0,0 +1,60 @@
+#ifndef OTA_INFLATE_H
+#define OTA_INFLATE_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// First byte of a gzip stream (an ESP image starts with ESP_IMAGE_HEADER_MAGIC)
+#define OTA_INFLATE_GZIP_MAGIC 0x1F
+
+/**
+ * Output callback, receives the decompressed image in order
+ *
+ * @param data Decompressed bytes, only valid during the call
+ * @param size Number of bytes
+ * @return ESP_OK to continue, any other value stops decompression
+ */
+typedef esp_err_t (*ota_inflate_output_t)(const uint8_t *data, size_t size);
+
+typedef struct ota_inflate ota_inflate_t;
+
+/**
+ * Start decompressing a gzip stream
+ * Uses the ROM inflater with a 32 KB window (about 43 KB of heap in all).
+ *
+ * @param output Callback receiving the decompressed bytes
+ * @return Inflater, or NULL if out of memory
+ */
+ota_inflate_t *ota_inflate_begin(ota_inflate_output_t output);
+
+/**
+ * Decompress the next chunk of the stream
+ *
+ * @param inf Inflater
+ * @param data Compressed bytes, chunks may be split anywhere
+ * @param size Number of bytes
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the stream is not
+ *         valid gzip, or the output callback's error
+ */
+esp_err_t ota_inflate_feed(ota_inflate_t *inf, const uint8_t *data, size_t size);
+
+/**
+ * Check that the stream ended completely and intact
+ *
+ * @param inf Inflater
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the stream is
+ *         truncated, ESP_ERR_INVALID_CRC if the gzip CRC or length does
+ *         not match the decompressed data
+ */
+esp_err_t ota_inflate_finish(ota_inflate_t *inf);
+
+/**
+ * Free an inflater
+ *
+ * @param inf Inflater, may be NULL
+ */
+void ota_inflate_free(ota_inflate_t *inf);
+
+#endif // OTA_INFLATE_H
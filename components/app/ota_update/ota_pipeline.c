@@ -0,0 +1,289 @@
+#include "ota_pipeline.h"
+#include "ota_update.h"
+#include "spsc_ring.h"
+#include "tasks.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ota_pipeline";
+
+// Data entries per buffer are few (one span, plus a replayed delimiter
+// prefix now and then), so this rarely makes the receiver wait
+#define OTA_PIPELINE_QUEUE_LEN 16
+
+/**
+ * Queued work for the writer
+ * data != NULL: write it; release != NULL: return the buffer to the pool;
+ * both NULL: stop.
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    uint8_t *release;
+} ota_pipeline_entry_t;
+
+static uint8_t *pool = NULL;
+
+// Both HTTP workers may start an upload; only one gets the pipeline
+static atomic_bool running = false;
+
+// Receiver -> writer
+static spsc_ring_t data_ring;
+static ota_pipeline_entry_t data_items[OTA_PIPELINE_QUEUE_LEN];
+
+// Writer -> receiver
+static spsc_ring_t free_ring;
+static uint8_t *free_items[OTA_PIPELINE_BUFFERS];
+
+static TaskHandle_t receiver_task = NULL;
+static TaskHandle_t writer_task = NULL;
+static atomic_bool writer_done = false;
+
+// The writer's ota_update_begin() succeeded: this pipeline owns the update
+static bool update_begun = false;
+
+// First writer error; receiver side reads it
+static _Atomic esp_err_t writer_err = ESP_OK;
+
+static size_t firmware_size_hint = 0;
+static int64_t acquired_at = 0;
+static bool timing_valid = false;
+static ota_pipeline_timing_t timing;
+
+static uint32_t elapsed_us(int64_t since)
+{
+    return (uint32_t)(esp_timer_get_time() - since);
+}
+
+/**
+ * Flash writer task: drains the data ring into the OTA partition
+ */
+static void ota_writer_task(void *pvParameters)
+{
+    ota_pipeline_entry_t entry;
+
+    while (1) {
+        int64_t start = esp_timer_get_time();
+        while (!spsc_ring_pop(&data_ring, &entry)) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        timing.write_idle_us += elapsed_us(start);
+
+        if (entry.data == NULL && entry.release == NULL) {
+            break;
+        }
+
+        // After an error keep draining, so the receiver gets its buffers back
+        if (entry.data != NULL && atomic_load(&writer_err) == ESP_OK) {
+            esp_err_t ret = ESP_OK;
+            if (!update_begun) {
+                start = esp_timer_get_time();
+                ret = ota_update_begin(firmware_size_hint);
+                timing.begin_us += elapsed_us(start);
+                update_begun = (ret == ESP_OK);
+            }
+            if (ret == ESP_OK) {
+                start = esp_timer_get_time();
+                ret = ota_update_write(entry.data, entry.size);
+                timing.write_us += elapsed_us(start);
+                timing.verify_us = ota_update_get_verify_us();
+                timing.bytes += entry.size;
+            }
+            if (ret != ESP_OK) {
+                atomic_store(&writer_err, ret);
+            }
+        }
+
+        if (entry.release != NULL) {
+            // Cannot fail: the ring holds every buffer
+            spsc_ring_push(&free_ring, &entry.release);
+        }
+        xTaskNotifyGive(receiver_task);
+    }
+
+    atomic_store(&writer_done, true);
+    xTaskNotifyGive(receiver_task);
+    vTaskDelete(NULL);
+}
+
+/**
+ * Queue an entry, waiting while the ring is full
+ */
+static void queue_entry(const ota_pipeline_entry_t *entry)
+{
+    while (!spsc_ring_push(&data_ring, entry)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    xTaskNotifyGive(writer_task);
+}
+
+/**
+ * Stop the writer and free the pool
+ */
+static void ota_pipeline_stop(void)
+{
+    const ota_pipeline_entry_t stop = {0};
+    queue_entry(&stop);
+    while (!atomic_load(&writer_done)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    writer_task = NULL;
+    free(pool);
+    pool = NULL;
+    atomic_store(&running, false);
+}
+
+esp_err_t ota_pipeline_begin(size_t firmware_size)
+{
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&running, &idle, true)) {
+        ESP_LOGW(TAG, "Pipeline already running");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pool = malloc(OTA_PIPELINE_BUFFERS * OTA_PIPELINE_BUFFER_SIZE);
+    if (pool == NULL) {
+        ESP_LOGW(TAG, "No memory for the buffer pool");
+        atomic_store(&running, false);
+        return ESP_ERR_NO_MEM;
+    }
+
+    spsc_ring_init(&data_ring, data_items, sizeof(data_items[0]), OTA_PIPELINE_QUEUE_LEN);
+    spsc_ring_init(&free_ring, free_items, sizeof(free_items[0]), OTA_PIPELINE_BUFFERS);
+    for (size_t i = 0; i < OTA_PIPELINE_BUFFERS; i++) {
+        uint8_t *buf = pool + i * OTA_PIPELINE_BUFFER_SIZE;
+        spsc_ring_push(&free_ring, &buf);
+    }
+
+    firmware_size_hint = firmware_size;
+    update_begun = false;
+    atomic_store(&writer_err, ESP_OK);
+    atomic_store(&writer_done, false);
+    memset(&timing, 0, sizeof(timing));
+    timing_valid = true;
+    receiver_task = xTaskGetCurrentTaskHandle();
+    // Clear a stale notification so the first wait really waits
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    BaseType_t ret = xTaskCreatePinnedToCore(
+        ota_writer_task,
+        "ota_writer",
+        OTA_WRITER_TASK_STACK_SIZE,
+        NULL,
+        OTA_WRITER_TASK_PRIORITY,
+        &writer_task,
+        OTA_WRITER_TASK_CORE_ID);
+
+    if (ret != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create writer task");
+        free(pool);
+        pool = NULL;
+        atomic_store(&running, false);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Pipelined update started, %d x %d byte buffers",
+             OTA_PIPELINE_BUFFERS, OTA_PIPELINE_BUFFER_SIZE);
+    return ESP_OK;
+}
+
+esp_err_t ota_pipeline_acquire(uint8_t **buf)
+{
+    const int64_t start = esp_timer_get_time();
+
+    while (!spsc_ring_pop(&free_ring, buf)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    timing.recv_stall_us += elapsed_us(start);
+
+    // On error the buffer is not handed back, the pool is freed as a whole
+    acquired_at = esp_timer_get_time();
+    return atomic_load(&writer_err);
+}
+
+esp_err_t ota_pipeline_write(const uint8_t *data, size_t size)
+{
+    esp_err_t err = atomic_load(&writer_err);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (size == 0) {
+        return ESP_OK;
+    }
+
+    const ota_pipeline_entry_t entry = {
+        .data = data,
+        .size = size,
+    };
+    queue_entry(&entry);
+    return ESP_OK;
+}
+
+void ota_pipeline_release(uint8_t *buf)
+{
+    timing.recv_us += elapsed_us(acquired_at);
+
+    const ota_pipeline_entry_t entry = {
+        .release = buf,
+    };
+    queue_entry(&entry);
+}
+
+esp_err_t ota_pipeline_end(void)
+{
+    if (pool == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ota_pipeline_stop();
+
+    ESP_LOGI(TAG, "%" PRIu32 " bytes: recv %" PRIu32 " ms (stalled %" PRIu32 " ms), "
+             "begin %" PRIu32 " ms, write %" PRIu32 " ms (verify %" PRIu32 " ms, idle %" PRIu32 " ms)",
+             timing.bytes, timing.recv_us / 1000, timing.recv_stall_us / 1000,
+             timing.begin_us / 1000, timing.write_us / 1000, timing.verify_us / 1000,
+             timing.write_idle_us / 1000);
+
+    esp_err_t err = atomic_load(&writer_err);
+    if (err == ESP_OK && timing.bytes == 0) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK && update_begun) {
+        ota_update_abort();
+    }
+    return err;
+}
+
+void ota_pipeline_abort(void)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    // Makes the writer drop whatever is still queued
+    esp_err_t expected = ESP_OK;
+    atomic_compare_exchange_strong(&writer_err, &expected, ESP_ERR_INVALID_STATE);
+
+    ota_pipeline_stop();
+    // An update begun by someone else is not ours to abort
+    if (update_begun) {
+        ota_update_abort();
+    }
+}
+
+esp_err_t ota_pipeline_get_timing(ota_pipeline_timing_t *out)
+{
+    if (!timing_valid) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    // Fields are 32-bit and each written by one task, a torn read is impossible
+    *out = timing;
+    return ESP_OK;
+}
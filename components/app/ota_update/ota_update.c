@@ -1,15 +1,32 @@
 #include "ota_update.h"
+#include "ota_inflate.h"
+#include "ota_delta.h"
+#include "ota_verify.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "esp_app_format.h"
 #include "esp_partition.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "ota_update";
 
+// NVS namespace and key of the persisted upload session
+#define OTA_SESSION_NAMESPACE "ota"
+#define OTA_SESSION_KEY "session"
+
+// Serializes the OTA calls of the HTTP workers, the httpd task and the OTA writer
+static SemaphoreHandle_t ota_mutex = NULL;
+
 // OTA state
 static esp_ota_handle_t ota_handle = 0;
 static const esp_partition_t *update_partition = NULL;
@@ -17,6 +34,47 @@ static size_t bytes_written = 0;
 static size_t total_size = 0;
 static bool ota_in_progress = false;
 
+// Streaming erase: data collected until a whole sector can be written
+static uint8_t *sector_buf = NULL;
+static size_t sector_len = 0;
+
+// Bytes that reached flash
+static size_t flash_offset = 0;
+
+// Decompressor of a gzip image, NULL for a plain one
+static ota_inflate_t *inflater = NULL;
+
+// Patcher of a delta update, NULL for a full image
+static ota_delta_t *patcher = NULL;
+
+// Hash of the image being written, checked against its appended digest
+static ota_verify_t *verifier = NULL;
+static int64_t verify_us = 0;
+
+// Bytes out of the decompressor (the upload itself for a plain one)
+static size_t payload_len = 0;
+
+/**
+ * Upload session as persisted in NVS
+ * offset only moves at flash_offset, so everything before it is on flash.
+ */
+typedef struct {
+    uint32_t id;
+    uint32_t size;
+    uint32_t offset;
+    uint32_t partition_address;
+} ota_session_record_t;
+
+static ota_session_record_t session;
+static bool session_active = false;
+
+// Duration of the update for the log
+static int64_t begin_time = 0;
+
+// Start of the image, collected until the header can be validated
+static uint8_t header_buf[sizeof(esp_image_header_t)];
+static size_t header_len = 0;
+
 /**
  * Validate firmware image header
  * Basic validation - checks magic byte and segments
@@ -48,7 +106,75 @@ static esp_err_t validate_firmware_header(const uint8_t *data, size_t size)
     return ESP_OK;
 }
 
-esp_err_t ota_update_begin(size_t firmware_size)
+/**
+ * Save the session, or erase it with record == NULL
+ */
+static esp_err_t session_store(const ota_session_record_t *record)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(OTA_SESSION_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    if (record != NULL) {
+        ret = nvs_set_blob(nvs_handle, OTA_SESSION_KEY, record, sizeof(*record));
+    } else {
+        ret = nvs_erase_key(nvs_handle, OTA_SESSION_KEY);
+        if (ret == ESP_ERR_NVS_NOT_FOUND) {
+            ret = ESP_OK;
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store OTA session: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+/**
+ * End the session, if any
+ */
+static void session_clear(void)
+{
+    if (session_active) {
+        session_active = false;
+        session_store(NULL);
+    }
+}
+
+/**
+ * Take the OTA lock
+ * Calls that start or drive an update from a request do not wait
+ * (wait = 0): while another call holds the lock they fail, so a client
+ * retry cannot interleave with the write it repeats.
+ */
+static esp_err_t ota_lock(TickType_t wait)
+{
+    if (ota_mutex == NULL) {
+        ESP_LOGE(TAG, "OTA not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(ota_mutex, wait) != pdTRUE) {
+        ESP_LOGW(TAG, "OTA busy");
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+static void ota_unlock(void)
+{
+    xSemaphoreGive(ota_mutex);
+}
+
+static void update_abort(void);
+
+static esp_err_t update_begin(size_t firmware_size)
 {
     if (ota_in_progress) {
         ESP_LOGE(TAG, "OTA already in progress");
@@ -69,31 +195,182 @@ esp_err_t ota_update_begin(size_t firmware_size)
         return ESP_FAIL;
     }
     
-    ESP_LOGI(TAG, "Writing to partition: %s at offset 0x%lx", 
+    ESP_LOGI(TAG, "Writing to partition: %s at offset 0x%" PRIx32, 
              update_partition->label, update_partition->address);
     
     // Check partition size
     if (firmware_size > update_partition->size) {
-        ESP_LOGE(TAG, "Firmware too large: %zu > %lu", firmware_size, update_partition->size);
+        ESP_LOGE(TAG, "Firmware too large: %zu > %" PRIu32, firmware_size, update_partition->size);
         return ESP_ERR_INVALID_SIZE;
     }
     
-    // Begin OTA
-    esp_err_t ret = esp_ota_begin(update_partition, firmware_size, &ota_handle);
+    begin_time = esp_timer_get_time();
+    
+    verifier = ota_verify_begin(update_partition->size);
+    if (verifier == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    verify_us = 0;
+    
+    if (OTA_UPDATE_STREAMING_ERASE) {
+        sector_buf = malloc(OTA_UPDATE_SECTOR_SIZE);
+        if (sector_buf == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate sector buffer");
+            ota_verify_free(verifier);
+            verifier = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+        sector_len = 0;
+    }
+    
+    // Begin OTA: either erase the image area now, or let every write erase the sectors it enters
+    esp_err_t ret = esp_ota_begin(update_partition,
+                                  OTA_UPDATE_STREAMING_ERASE ? OTA_WITH_SEQUENTIAL_WRITES : firmware_size,
+                                  &ota_handle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(ret));
+        ota_verify_free(verifier);
+        verifier = NULL;
+        free(sector_buf);
+        sector_buf = NULL;
         return ret;
     }
+    ESP_LOGI(TAG, "Ready for data after %" PRId64 " ms", (esp_timer_get_time() - begin_time) / 1000);
     
     total_size = firmware_size;
     bytes_written = 0;
+    flash_offset = 0;
+    payload_len = 0;
+    header_len = 0;
     ota_in_progress = true;
     
     ESP_LOGI(TAG, "OTA update started successfully");
     return ESP_OK;
 }
 
-esp_err_t ota_update_write(const uint8_t *data, size_t size)
+/**
+ * Write to flash, erasing the sectors entered first with streaming erase
+ */
+static esp_err_t flash_write(const uint8_t *data, size_t size)
+{
+    esp_err_t ret = esp_ota_write(ota_handle, data, size);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    flash_offset += size;
+    return ESP_OK;
+}
+
+/**
+ * Pass data to flash in whole sectors
+ * Whole sectors go straight from the caller's buffer when nothing is
+ * pending, the rest is collected in sector_buf.
+ */
+static esp_err_t sector_write(const uint8_t *data, size_t size)
+{
+    while (size > 0) {
+        if (sector_len == 0 && size >= OTA_UPDATE_SECTOR_SIZE) {
+            const size_t whole = size - size % OTA_UPDATE_SECTOR_SIZE;
+            esp_err_t ret = flash_write(data, whole);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            data += whole;
+            size -= whole;
+            continue;
+        }
+        
+        size_t take = OTA_UPDATE_SECTOR_SIZE - sector_len;
+        if (take > size) {
+            take = size;
+        }
+        memcpy(sector_buf + sector_len, data, take);
+        sector_len += take;
+        data += take;
+        size -= take;
+        
+        if (sector_len == OTA_UPDATE_SECTOR_SIZE) {
+            esp_err_t ret = flash_write(sector_buf, sector_len);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            sector_len = 0;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * Validate and write image bytes (after decompression)
+ */
+static esp_err_t image_write(const uint8_t *data, size_t size)
+{
+    // Validate the header once complete (chunks may be of any size)
+    if (header_len < sizeof(header_buf)) {
+        size_t take = sizeof(header_buf) - header_len;
+        if (take > size) {
+            take = size;
+        }
+        memcpy(header_buf + header_len, data, take);
+        header_len += take;
+        
+        if (header_len == sizeof(header_buf)) {
+            esp_err_t ret = validate_firmware_header(header_buf, header_len);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+    }
+    
+    // Hashed here, on the flash writer's core while the next data is received
+    const int64_t hash_start = esp_timer_get_time();
+    esp_err_t ret = ota_verify_feed(verifier, data, size);
+    verify_us += esp_timer_get_time() - hash_start;
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    // Write chunk to OTA partition
+    return OTA_UPDATE_STREAMING_ERASE ? sector_write(data, size) : flash_write(data, size);
+}
+
+/**
+ * Check that an image of unknown size can be written
+ * The erase size given to esp_ota_begin() was the upload size, which is
+ * not the image size for a compressed upload or a patch.
+ */
+static esp_err_t check_streaming_erase(const char *what)
+{
+    if (!OTA_UPDATE_STREAMING_ERASE) {
+        ESP_LOGE(TAG, "%s need OTA_UPDATE_STREAMING_ERASE", what);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Rebuild the image from a patch, or pass a full image through
+ */
+static esp_err_t payload_write(const uint8_t *data, size_t size)
+{
+    // A patch is told apart from an image by its first byte (images start with 0xE9)
+    if (payload_len == 0 && data[0] == OTA_DELTA_MAGIC_BYTE) {
+        esp_err_t ret = check_streaming_erase("Patches");
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        patcher = ota_delta_begin(image_write);
+        if (patcher == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    payload_len += size;
+    
+    return (patcher != NULL) ? ota_delta_feed(patcher, data, size) : image_write(data, size);
+}
+
+static esp_err_t update_write(const uint8_t *data, size_t size)
 {
     if (!ota_in_progress) {
         ESP_LOGE(TAG, "OTA not in progress");
@@ -104,20 +381,23 @@ esp_err_t ota_update_write(const uint8_t *data, size_t size)
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Validate first chunk (contains header)
-    if (bytes_written == 0) {
-        esp_err_t ret = validate_firmware_header(data, size);
+    // A gzip image is decompressed on the way to flash
+    if (bytes_written == 0 && data[0] == OTA_INFLATE_GZIP_MAGIC) {
+        esp_err_t ret = check_streaming_erase("Compressed images");
         if (ret != ESP_OK) {
-            ota_update_abort();
+            update_abort();
             return ret;
         }
+        inflater = ota_inflate_begin(payload_write);
+        if (inflater == NULL) {
+            update_abort();
+            return ESP_ERR_NO_MEM;
+        }
     }
     
-    // Write chunk to OTA partition
-    esp_err_t ret = esp_ota_write(ota_handle, data, size);
+    esp_err_t ret = (inflater != NULL) ? ota_inflate_feed(inflater, data, size) : payload_write(data, size);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(ret));
-        ota_update_abort();
+        update_abort();
         return ret;
     }
     
@@ -134,7 +414,7 @@ esp_err_t ota_update_write(const uint8_t *data, size_t size)
     return ESP_OK;
 }
 
-esp_err_t ota_update_end(void)
+static esp_err_t update_end(void)
 {
     if (!ota_in_progress) {
         ESP_LOGE(TAG, "OTA not in progress");
@@ -143,8 +423,54 @@ esp_err_t ota_update_end(void)
     
     ESP_LOGI(TAG, "Finalizing OTA update");
     
-    // End OTA and validate
-    esp_err_t ret = esp_ota_end(ota_handle);
+    if (inflater != NULL) {
+        esp_err_t ret = ota_inflate_finish(inflater);
+        ota_inflate_free(inflater);
+        inflater = NULL;
+        if (ret != ESP_OK) {
+            update_abort();
+            return ret;
+        }
+    }
+    
+    if (patcher != NULL) {
+        esp_err_t ret = ota_delta_finish(patcher);
+        ota_delta_free(patcher);
+        patcher = NULL;
+        if (ret != ESP_OK) {
+            update_abort();
+            return ret;
+        }
+    }
+    
+    // A truncated image fails here, before anything else is written
+    esp_err_t ret = ota_verify_finish(verifier);
+    ota_verify_free(verifier);
+    verifier = NULL;
+    if (ret != ESP_OK) {
+        update_abort();
+        return ret;
+    }
+    ESP_LOGI(TAG, "Hashing took %" PRId64 " ms of the upload", verify_us / 1000);
+    
+    // Last partial sector
+    if (sector_len > 0) {
+        ret = flash_write(sector_buf, sector_len);
+        if (ret != ESP_OK) {
+            update_abort();
+            return ret;
+        }
+        sector_len = 0;
+    }
+    free(sector_buf);
+    sector_buf = NULL;
+    
+    // End OTA and validate (the flash contents, and the signature with secure boot)
+    const int64_t verify_start = esp_timer_get_time();
+    ret = esp_ota_end(ota_handle);
+    ESP_LOGI(TAG, "Image check took %" PRId64 " ms", (esp_timer_get_time() - verify_start) / 1000);
+    // Finished either way: the image is complete or will never verify
+    session_clear();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "esp_ota_end failed: %s", esp_err_to_name(ret));
         ota_in_progress = false;
@@ -162,20 +488,12 @@ esp_err_t ota_update_end(void)
     ota_in_progress = false;
     
     ESP_LOGI(TAG, "OTA update completed successfully");
-    ESP_LOGI(TAG, "Total bytes written: %zu", bytes_written);
-    ESP_LOGI(TAG, "Rebooting to apply new firmware in 2 seconds...");
-    
-    // Give delay to allow HTTP response to be fully sent before reboot
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    
-    // Reboot to apply new firmware
-    esp_restart();
-    
-    // Should never reach here, but return OK just in case
+    ESP_LOGI(TAG, "Total bytes written: %zu in %" PRId64 " ms", bytes_written,
+             (esp_timer_get_time() - begin_time) / 1000);
     return ESP_OK;
 }
 
-void ota_update_abort(void)
+static void update_abort(void)
 {
     if (!ota_in_progress) {
         return;
@@ -184,11 +502,79 @@ void ota_update_abort(void)
     ESP_LOGW(TAG, "Aborting OTA update");
     
     esp_ota_abort(ota_handle);
+    session_clear();
+    ota_inflate_free(inflater);
+    inflater = NULL;
+    ota_delta_free(patcher);
+    patcher = NULL;
+    ota_verify_free(verifier);
+    verifier = NULL;
+    free(sector_buf);
+    sector_buf = NULL;
+    sector_len = 0;
     ota_in_progress = false;
     bytes_written = 0;
     total_size = 0;
 }
 
+esp_err_t ota_update_begin(size_t firmware_size)
+{
+    esp_err_t ret = ota_lock(0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = update_begin(firmware_size);
+    ota_unlock();
+    return ret;
+}
+
+esp_err_t ota_update_write(const uint8_t *data, size_t size)
+{
+    esp_err_t ret = ota_lock(portMAX_DELAY);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = update_write(data, size);
+    ota_unlock();
+    return ret;
+}
+
+esp_err_t ota_update_end(void)
+{
+    esp_err_t ret = ota_lock(portMAX_DELAY);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = update_end();
+    ota_unlock();
+    return ret;
+}
+
+void ota_update_restart(void)
+{
+    ESP_LOGI(TAG, "Rebooting to apply new firmware in 2 seconds...");
+    
+    // Give delay to allow HTTP response to be fully sent before reboot
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    
+    // Reboot to apply new firmware
+    esp_restart();
+}
+
+void ota_update_abort(void)
+{
+    if (ota_lock(portMAX_DELAY) != ESP_OK) {
+        return;
+    }
+    update_abort();
+    ota_unlock();
+}
+
+uint32_t ota_update_get_verify_us(void)
+{
+    return (uint32_t)verify_us;
+}
+
 uint8_t ota_update_get_progress(void)
 {
     if (total_size == 0) {
@@ -198,3 +584,229 @@ uint8_t ota_update_get_progress(void)
     return (bytes_written * 100) / total_size;
 }
 
+
+/**
+ * Reopen a session persisted before a restart
+ * Flash up to the durable offset is kept; what was written after it is
+ * erased again and must be resent.
+ */
+static void session_restore(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_SESSION_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    ota_session_record_t record;
+    size_t len = sizeof(record);
+    esp_err_t ret = nvs_get_blob(nvs_handle, OTA_SESSION_KEY, &record, &len);
+    nvs_close(nvs_handle);
+    if (ret != ESP_OK || len != sizeof(record)) {
+        return;
+    }
+    
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if (partition == NULL || partition->address != record.partition_address ||
+        record.size > partition->size || record.offset > record.size) {
+        ESP_LOGW(TAG, "Discarding stale OTA session");
+        session_store(NULL);
+        return;
+    }
+    
+    if (OTA_UPDATE_STREAMING_ERASE) {
+        sector_buf = malloc(OTA_UPDATE_SECTOR_SIZE);
+        if (sector_buf == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate sector buffer");
+            return;
+        }
+        sector_len = 0;
+    }
+    
+    // The hash restarts from what is already on flash
+    verifier = ota_verify_begin(partition->size);
+    if (verifier == NULL || ota_verify_feed_flash(verifier, partition, record.offset) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to hash the resumed image");
+        ota_verify_free(verifier);
+        verifier = NULL;
+        free(sector_buf);
+        sector_buf = NULL;
+        session_store(NULL);
+        return;
+    }
+    verify_us = 0;
+    
+    ret = esp_ota_resume(partition,
+                         OTA_UPDATE_STREAMING_ERASE ? OTA_WITH_SEQUENTIAL_WRITES : record.size - record.offset,
+                         record.offset, &ota_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_resume failed: %s", esp_err_to_name(ret));
+        ota_verify_free(verifier);
+        verifier = NULL;
+        free(sector_buf);
+        sector_buf = NULL;
+        session_store(NULL);
+        return;
+    }
+    
+    update_partition = partition;
+    total_size = record.size;
+    bytes_written = record.offset;
+    flash_offset = record.offset;
+    payload_len = record.offset;
+    // Durable offsets are 0 or a multiple of OTA_UPDATE_SESSION_PERSIST_BYTES, past the header
+    header_len = (record.offset > 0) ? sizeof(header_buf) : 0;
+    begin_time = esp_timer_get_time();
+    session = record;
+    session_active = true;
+    ota_in_progress = true;
+    
+    ESP_LOGI(TAG, "Resumed OTA session %08" PRIx32 " at %" PRIu32 " of %" PRIu32 " bytes",
+             record.id, record.offset, record.size);
+}
+
+esp_err_t ota_update_init(void)
+{
+    if (ota_mutex != NULL) {
+        return ESP_OK;
+    }
+    
+    ota_mutex = xSemaphoreCreateMutex();
+    if (ota_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create OTA mutex");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Rehashing the durable part of the image takes a while: once here, not in a request
+    session_restore();
+    return ESP_OK;
+}
+
+/**
+ * Fill in the current session
+ */
+static void session_get(ota_update_session_t *out)
+{
+    out->id = session.id;
+    out->size = session.size;
+    out->offset = bytes_written;
+}
+
+esp_err_t ota_update_session_create(size_t firmware_size, ota_update_session_t *out)
+{
+    esp_err_t ret = ota_lock(0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    if (session_active) {
+        ESP_LOGW(TAG, "Replacing OTA session %08" PRIx32, session.id);
+        update_abort();
+    }
+    
+    ret = update_begin(firmware_size);
+    if (ret != ESP_OK) {
+        ota_unlock();
+        return ret;
+    }
+    
+    session.id = esp_random();
+    session.size = firmware_size;
+    session.offset = 0;
+    session.partition_address = update_partition->address;
+    ret = session_store(&session);
+    if (ret != ESP_OK) {
+        update_abort();
+        ota_unlock();
+        return ret;
+    }
+    session_active = true;
+    
+    ESP_LOGI(TAG, "OTA session %08" PRIx32 " created", session.id);
+    session_get(out);
+    ota_unlock();
+    return ESP_OK;
+}
+
+esp_err_t ota_update_session_get(ota_update_session_t *out)
+{
+    esp_err_t ret = ota_lock(0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    ret = ESP_ERR_NOT_FOUND;
+    if (session_active) {
+        session_get(out);
+        ret = ESP_OK;
+    }
+    ota_unlock();
+    return ret;
+}
+
+/**
+ * Check and write a session chunk, with the OTA lock held
+ */
+static esp_err_t session_write(uint32_t id, size_t offset, const uint8_t *data, size_t size, uint32_t crc)
+{
+    if (!session_active || id != session.id) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (offset != bytes_written) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (size > session.size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    // Check before anything reaches flash
+    if (esp_rom_crc32_le(0, data, size) != crc) {
+        ESP_LOGW(TAG, "Chunk at %zu failed its CRC check", offset);
+        return ESP_ERR_INVALID_CRC;
+    }
+    
+    esp_err_t ret = update_write(data, size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    // A compressed upload or a patch cannot resume after a restart: their state is lost
+    if (inflater == NULL && patcher == NULL && flash_offset - session.offset >= OTA_UPDATE_SESSION_PERSIST_BYTES) {
+        // A failed store only means a longer resend after a restart
+        session.offset = flash_offset;
+        session_store(&session);
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_update_session_write(uint32_t id, size_t offset, const uint8_t *data, size_t size, uint32_t crc,
+                                   ota_update_session_t *out)
+{
+    esp_err_t ret = ota_lock(0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    ret = session_write(id, offset, data, size, crc);
+    if (ret == ESP_OK || ret == ESP_ERR_INVALID_STATE) {
+        session_get(out);
+    }
+    ota_unlock();
+    return ret;
+}
+
+esp_err_t ota_update_session_commit(uint32_t id)
+{
+    esp_err_t ret = ota_lock(0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    if (!session_active || id != session.id) {
+        ret = ESP_ERR_NOT_FOUND;
+    } else if (bytes_written != session.size) {
+        ret = ESP_ERR_INVALID_SIZE;
+    } else {
+        ret = update_end();
+    }
+    ota_unlock();
+    return ret;
+}
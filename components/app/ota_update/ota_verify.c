@@ -0,0 +1,231 @@
+#include "ota_verify.h"
+#include "ota_field.h"
+#include "esp_log.h"
+#include "esp_app_format.h"
+#include "esp_ota_ops.h"
+#include "psa/crypto.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ota_verify";
+
+#define OTA_VERIFY_DIGEST_LEN 32
+
+// Bytes read from flash at a time when resuming
+#define OTA_VERIFY_READ_SIZE 1024
+
+/*
+ * Image layout: header, segment_count times (segment header, data), padding
+ * and a checksum byte up to a multiple of 16, then with hash_appended the
+ * SHA-256 of everything before it. A signature block may follow; it is not
+ * hashed and left to esp_ota_end().
+ */
+typedef enum {
+    OTA_VERIFY_HEADER,
+    OTA_VERIFY_SEGMENT_HEADER,
+    OTA_VERIFY_SEGMENT_DATA,
+    OTA_VERIFY_CHECKSUM,        // Padding and checksum byte
+    OTA_VERIFY_DIGEST,
+    OTA_VERIFY_DONE,
+} ota_verify_state_t;
+
+struct ota_verify {
+    ota_verify_state_t state;
+    psa_hash_operation_t hash;
+    uint8_t field[OTA_VERIFY_DIGEST_LEN];
+    size_t field_len;
+    uint32_t pos;               // Image bytes seen
+    uint32_t skip_end;          // End of the segment data or checksum being skipped
+    uint32_t max_size;
+    uint8_t segments_left;
+    bool hash_appended;
+};
+
+ota_verify_t *ota_verify_begin(size_t max_size)
+{
+    if (psa_crypto_init() != PSA_SUCCESS) {
+        ESP_LOGE(TAG, "Failed to initialize PSA crypto");
+        return NULL;
+    }
+
+    ota_verify_t *v = calloc(1, sizeof(*v));
+    if (v == NULL) {
+        ESP_LOGE(TAG, "No memory for the verifier");
+        return NULL;
+    }
+
+    v->hash = psa_hash_operation_init();
+    if (psa_hash_setup(&v->hash, PSA_ALG_SHA_256) != PSA_SUCCESS) {
+        ESP_LOGE(TAG, "Failed to start SHA-256");
+        free(v);
+        return NULL;
+    }
+    v->state = OTA_VERIFY_HEADER;
+    v->max_size = max_size;
+    return v;
+}
+
+static esp_err_t hash(ota_verify_t *v, const uint8_t *data, size_t size)
+{
+    if (psa_hash_update(&v->hash, data, size) != PSA_SUCCESS) {
+        ESP_LOGE(TAG, "SHA-256 update failed");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Skip to the end of the segment data or the checksum byte
+ */
+static esp_err_t skip_to(ota_verify_t *v, ota_verify_state_t state, uint32_t len)
+{
+    if (len > v->max_size - v->pos) {
+        ESP_LOGE(TAG, "Image larger than the partition");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    v->state = state;
+    v->skip_end = v->pos + len;
+    return ESP_OK;
+}
+
+/**
+ * Move on from the segment data just skipped
+ */
+static esp_err_t next_segment(ota_verify_t *v)
+{
+    if (v->segments_left > 0) {
+        v->segments_left--;
+        v->state = OTA_VERIFY_SEGMENT_HEADER;
+        return ESP_OK;
+    }
+    // Padding up to the checksum byte, which ends a multiple of 16
+    return skip_to(v, OTA_VERIFY_CHECKSUM, 16 - (v->pos % 16));
+}
+
+/**
+ * Act on a completed header field
+ */
+static esp_err_t parse_field(ota_verify_t *v)
+{
+    if (v->state == OTA_VERIFY_HEADER) {
+        const esp_image_header_t *header = (const esp_image_header_t *)v->field;
+        if (header->magic != ESP_IMAGE_HEADER_MAGIC || header->segment_count == 0 ||
+            header->segment_count > ESP_IMAGE_MAX_SEGMENTS) {
+            ESP_LOGE(TAG, "Invalid image header (%u segments)", header->segment_count);
+            return ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        v->hash_appended = (header->hash_appended == 1);
+        v->segments_left = header->segment_count - 1;
+        v->state = OTA_VERIFY_SEGMENT_HEADER;
+        return ESP_OK;
+    }
+
+    const esp_image_segment_header_t *segment = (const esp_image_segment_header_t *)v->field;
+    return skip_to(v, OTA_VERIFY_SEGMENT_DATA, segment->data_len);
+}
+
+esp_err_t ota_verify_feed(ota_verify_t *v, const uint8_t *data, size_t size)
+{
+    esp_err_t ret = ESP_OK;
+
+    while (ret == ESP_OK) {
+        if (v->state == OTA_VERIFY_SEGMENT_DATA && v->pos == v->skip_end) {
+            // Also taken for empty segments, without input
+            ret = next_segment(v);
+            continue;
+        }
+        if (v->state == OTA_VERIFY_CHECKSUM && v->pos == v->skip_end) {
+            v->state = v->hash_appended ? OTA_VERIFY_DIGEST : OTA_VERIFY_DONE;
+            continue;
+        }
+        if (size == 0) {
+            break;
+        }
+
+        const uint8_t *start = data;
+        switch (v->state) {
+        case OTA_VERIFY_HEADER:
+        case OTA_VERIFY_SEGMENT_HEADER: {
+            const size_t len = (v->state == OTA_VERIFY_HEADER) ? sizeof(esp_image_header_t)
+                                                               : sizeof(esp_image_segment_header_t);
+            const bool complete = ota_field_collect(v->field, &v->field_len, len, &data, &size);
+            ret = hash(v, start, data - start);
+            if (ret == ESP_OK && complete) {
+                v->pos += data - start;
+                ret = parse_field(v);
+                continue;
+            }
+            break;
+        }
+
+        case OTA_VERIFY_SEGMENT_DATA:
+        case OTA_VERIFY_CHECKSUM: {
+            const size_t n = (v->skip_end - v->pos < size) ? v->skip_end - v->pos : size;
+            ret = hash(v, data, n);
+            data += n;
+            size -= n;
+            break;
+        }
+
+        case OTA_VERIFY_DIGEST:
+            if (ota_field_collect(v->field, &v->field_len, OTA_VERIFY_DIGEST_LEN, &data, &size)) {
+                if (psa_hash_verify(&v->hash, v->field, OTA_VERIFY_DIGEST_LEN) != PSA_SUCCESS) {
+                    ESP_LOGE(TAG, "Image SHA-256 mismatch");
+                    ret = ESP_ERR_OTA_VALIDATE_FAILED;
+                } else {
+                    ESP_LOGI(TAG, "Image SHA-256 verified (%" PRIu32 " bytes)", v->pos);
+                }
+                v->state = OTA_VERIFY_DONE;
+            }
+            break;
+
+        case OTA_VERIFY_DONE:
+            // Signature block or padding
+            data += size;
+            size = 0;
+            break;
+        }
+        v->pos += data - start;
+    }
+
+    return ret;
+}
+
+esp_err_t ota_verify_feed_flash(ota_verify_t *v, const esp_partition_t *partition, size_t size)
+{
+    uint8_t buf[OTA_VERIFY_READ_SIZE];
+
+    for (size_t offset = 0; offset < size; offset += sizeof(buf)) {
+        const size_t n = (size - offset < sizeof(buf)) ? size - offset : sizeof(buf);
+        esp_err_t ret = esp_partition_read(partition, offset, buf, n);
+        if (ret == ESP_OK) {
+            ret = ota_verify_feed(v, buf, n);
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_verify_finish(ota_verify_t *v)
+{
+    if (v->state != OTA_VERIFY_DONE) {
+        ESP_LOGE(TAG, "Image truncated after %" PRIu32 " bytes", v->pos);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (!v->hash_appended) {
+        ESP_LOGW(TAG, "Image has no SHA-256 digest, only its checksum is checked");
+    }
+    return ESP_OK;
+}
+
+void ota_verify_free(ota_verify_t *v)
+{
+    if (v != NULL) {
+        psa_hash_abort(&v->hash);
+        free(v);
+    }
+}
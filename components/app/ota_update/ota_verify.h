@@ -0,0 +1,62 @@
+#ifndef OTA_VERIFY_H
+#define OTA_VERIFY_H
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ota_verify ota_verify_t;
+
+/**
+ * Start verifying an image as it streams to flash
+ * The segment headers are followed to find where the image ends; the
+ * bytes up to there are hashed (SHA-256, on the hardware engine when
+ * mbedTLS is built with it) and compared to the digest appended by the
+ * build as soon as that arrives.
+ *
+ * @param max_size Size of the target partition, larger images are rejected
+ * @return Verifier, or NULL if out of memory
+ */
+ota_verify_t *ota_verify_begin(size_t max_size);
+
+/**
+ * Verify the next image bytes
+ *
+ * @param v Verifier
+ * @param data Image bytes, chunks may be split anywhere
+ * @param size Number of bytes
+ * @return ESP_OK on success, ESP_ERR_OTA_VALIDATE_FAILED if the layout is
+ *         invalid or the digest does not match
+ */
+esp_err_t ota_verify_feed(ota_verify_t *v, const uint8_t *data, size_t size);
+
+/**
+ * Verify image bytes already on flash
+ * Rebuilds the state of a resumed upload.
+ *
+ * @param v Verifier
+ * @param partition Partition holding the start of the image
+ * @param size Number of bytes from the partition start
+ * @return ESP_OK on success, a flash read error, or see ota_verify_feed()
+ */
+esp_err_t ota_verify_feed_flash(ota_verify_t *v, const esp_partition_t *partition, size_t size);
+
+/**
+ * Check that the whole image and its digest were seen
+ * Images built without an appended digest pass with a warning; they are
+ * left to the checksum check of esp_ota_end().
+ *
+ * @param v Verifier
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the image is truncated
+ */
+esp_err_t ota_verify_finish(ota_verify_t *v);
+
+/**
+ * Free a verifier
+ *
+ * @param v Verifier, may be NULL
+ */
+void ota_verify_free(ota_verify_t *v);
+
+#endif // OTA_VERIFY_H
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Write an old and a new firmware-like image for the OTA tests.
+
+  make_delta_images.py <old.bin> <new.bin>
+
+The images have the ESP app image layout: a header, three segments,
+padding and the checksum byte, then the SHA-256 of all of it
+(hash_appended), like a build output. The code segment is code-like
+(words from a small vocabulary with embedded absolute addresses). The new
+image inserts a block of new code in the middle of it, which shifts the
+addresses after it, and changes a string in the data segment.
+"""
+import hashlib
+import random
+import struct
+import sys
+
+CODE_SIZE = 440 * 1024
+DATA_SIZE = 64 * 1024
+IRAM_SIZE = 8 * 1024
+INSERT_AT = CODE_SIZE // 2
+INSERT_LEN = 3000
+
+DROM_ADDR = 0x3C000020
+IRAM_ADDR = 0x40080000
+IROM_ADDR = 0x42000020
+
+
+def image(segments):
+    """Pack (load address, data) segments as an app image with its digest."""
+    header = struct.pack('<BBBBIB3sHBHH4sB', 0xE9, len(segments), 2, 0x1F, IRAM_ADDR + 0x400, 0xEE,
+                         b'\x00' * 3, 0, 0, 0, 0xFFFF, b'\x00' * 4, 1)
+    assert len(header) == 24
+    body = bytearray(header)
+    checksum = 0xEF
+    for addr, data in segments:
+        body += struct.pack('<II', addr, len(data)) + data
+        for b in data:
+            checksum ^= b
+    # Padding and the checksum byte end on a multiple of 16
+    body += bytes(15 - len(body) % 16) + bytes([checksum])
+    return bytes(body) + hashlib.sha256(body).digest()
+
+
+def main():
+    rng = random.Random(5)
+    vocab = [bytes(rng.randrange(256) for _ in range(rng.randrange(2, 8))) for _ in range(400)]
+    code = bytearray()
+    while len(code) < CODE_SIZE:
+        code += rng.choice(vocab)
+        if rng.random() < 0.1:
+            code += struct.pack('<I', IROM_ADDR + rng.randrange(1 << 20))
+    # Constants: strings between runs of zeros
+    data = bytearray()
+    while len(data) < DATA_SIZE:
+        data += rng.choice(vocab) * 3 + b'\x00' if rng.random() < 0.2 else bytes(8)
+    data = data[:DATA_SIZE]
+    iram = bytes(rng.choice(vocab)[0] for _ in range(IRAM_SIZE))
+
+    new_code = bytearray(code)
+    new_code[INSERT_AT:INSERT_AT] = bytes(rng.randrange(256) for _ in range(INSERT_LEN))
+    for i in range(INSERT_AT + INSERT_LEN, len(new_code) - 4, 4000):
+        value = struct.unpack_from('<I', new_code, i)[0]
+        struct.pack_into('<I', new_code, i, (value + INSERT_LEN) & 0xffffffff)
+    new_data = bytearray(data)
+    new_data[100:110] = b'0123456789'
+
+    old = image([(DROM_ADDR, bytes(data)), (IRAM_ADDR, iram), (IROM_ADDR, bytes(code))])
+    new = image([(DROM_ADDR, bytes(new_data)), (IRAM_ADDR, iram), (IROM_ADDR, bytes(new_code))])
+    for path, contents in ((sys.argv[1], old), (sys.argv[2], new)):
+        with open(path, 'wb') as f:
+            f.write(contents)
+
+
+if __name__ == '__main__':
+    main()
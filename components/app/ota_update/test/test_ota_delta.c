@@ -0,0 +1,285 @@
+/**
+ * Host test of the patch applier
+ * Applies a patch made by tools/ota_delta.py in random splits and checks
+ * the rebuilt image, then feeds truncated, mismatched and corrupt patches.
+ *
+ * Usage: test_ota_delta <old.bin> <new.bin> <patch>
+ */
+#include "ota_delta.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "host_test.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SPLIT_RUNS 200
+#define HEADER_LEN 44
+
+// Running firmware: an image in a larger app partition, erased flash after it
+static esp_partition_t running = {
+    .type = ESP_PARTITION_TYPE_APP,
+    .subtype = ESP_PARTITION_SUBTYPE_APP_OTA_0,
+    .size = 1024 * 1024,
+    .label = "ota_0",
+};
+static const uint8_t *running_image;
+static size_t running_len;
+
+static uint8_t *out;
+static size_t out_len;
+static size_t out_cap;
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return &running;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (src_offset > partition->size || size > partition->size - src_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(dst, 0xff, size);
+    if (src_offset < running_len) {
+        memcpy(dst, running_image + src_offset,
+               (size < running_len - src_offset) ? size : running_len - src_offset);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256)
+{
+    // For an app partition, the digest appended to the image
+    memcpy(sha_256, running_image + running_len - 32, 32);
+    return ESP_OK;
+}
+
+static esp_err_t output(const uint8_t *data, size_t size)
+{
+    if (out_len + size > out_cap) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out + out_len, data, size);
+    out_len += size;
+    return ESP_OK;
+}
+
+static esp_err_t output_fails(const uint8_t *data, size_t size)
+{
+    return ESP_ERR_NO_MEM;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    rewind(f);
+    uint8_t *data = malloc(*len);
+    if (fread(data, 1, *len, f) != *len) {
+        perror(path);
+        exit(1);
+    }
+    fclose(f);
+    return data;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * Offset of the first operation with the given tag, 0 if none
+ */
+static size_t find_op(const uint8_t *patch, size_t len, uint8_t op)
+{
+    size_t pos = HEADER_LEN;
+    while (pos < len && patch[pos] != 0) {
+        if (patch[pos] == op) {
+            return pos;
+        }
+        switch (patch[pos]) {
+            case 1: pos += 9; break;
+            case 2: pos += 9 + get_u32(patch + pos + 5); break;
+            case 3: pos += 5 + get_u32(patch + pos + 1); break;
+            default: return 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Apply a patch in splits of up to max_split bytes
+ *
+ * @return The first feed error, else the finish result
+ */
+static esp_err_t apply(const uint8_t *patch, size_t len, size_t max_split, uint32_t *rng)
+{
+    out_len = 0;
+    ota_delta_t *d = ota_delta_begin(output);
+    esp_err_t ret = ESP_OK;
+    for (size_t off = 0; off < len && ret == ESP_OK;) {
+        size_t n = (max_split == 0) ? len : 1 + host_test_rand(rng) % max_split;
+        if (n > len - off) {
+            n = len - off;
+        }
+        ret = ota_delta_feed(d, patch + off, n);
+        off += n;
+    }
+    if (ret == ESP_OK) {
+        ret = ota_delta_finish(d);
+    }
+    ota_delta_free(d);
+    return ret;
+}
+
+static void test_random_splits(const uint8_t *patch, size_t len, const uint8_t *new_image, size_t new_len)
+{
+    uint32_t rng = 3;
+    const uint64_t start = host_test_now_ns();
+    for (int i = 0; i < SPLIT_RUNS; i++) {
+        // Tiny splits cross every field, large ones run the ADD data in bulk
+        const size_t max_split = (i % 3 == 0) ? 7 : 5000;
+        CHECK(apply(patch, len, max_split, &rng) == ESP_OK);
+        CHECK(out_len == new_len && memcmp(out, new_image, new_len) == 0);
+        if (host_test_failures > 0) {
+            fprintf(stderr, "run %d, splits up to %zu\n", i, max_split);
+            return;
+        }
+    }
+    printf("ota_delta: %zu byte patch -> %zu byte image, %d split runs in %.0f ms\n",
+           len, new_len, SPLIT_RUNS, (host_test_now_ns() - start) / 1e6);
+}
+
+static void test_truncated(const uint8_t *patch, size_t len)
+{
+    const size_t cuts[] = {0, 10, HEADER_LEN, HEADER_LEN + 1, HEADER_LEN + 5, len / 3, len / 2, len - 2, len - 1};
+    for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) {
+        // Nothing may pass as a complete image
+        CHECK(apply(patch, cuts[i], 0, NULL) == ESP_ERR_INVALID_SIZE);
+    }
+}
+
+static void test_mismatched(uint8_t *patch, size_t len, const uint8_t *new_image, size_t new_len,
+                            const uint8_t *old_image, size_t old_len)
+{
+    // Made against other firmware: refused before any output
+    running_image = new_image;
+    running_len = new_len;
+    CHECK(apply(patch, len, 0, NULL) == ESP_ERR_INVALID_VERSION);
+    CHECK(out_len == 0);
+    running_image = old_image;
+    running_len = old_len;
+
+    // Source larger than the running partition
+    uint8_t saved[4];
+    memcpy(saved, patch + 4, 4);
+    memset(patch + 4, 0xff, 4);
+    CHECK(apply(patch, len, 0, NULL) == ESP_ERR_INVALID_VERSION);
+    memcpy(patch + 4, saved, 4);
+
+    // Target size of the header not what the operations produce
+    memcpy(saved, patch + 8, 4);
+    patch[8]--;
+    CHECK(apply(patch, len, 0, NULL) == ESP_ERR_INVALID_ARG);
+    memcpy(patch + 8, saved, 4);
+    patch[9]++;
+    CHECK(apply(patch, len, 0, NULL) == ESP_ERR_INVALID_SIZE);
+    memcpy(patch + 8, saved, 4);
+}
+
+static void test_corrupt(uint8_t *patch, size_t len, const uint8_t *new_image, size_t new_len)
+{
+    // Not a patch
+    patch[0] = 'X';
+    CHECK(apply(patch, len, 0, NULL) == ESP_ERR_INVALID_ARG);
+    patch[0] = 'O';
+
+    // Unknown operation
+    const uint8_t first_op = patch[HEADER_LEN];
+    patch[HEADER_LEN] = 0x7f;
+    CHECK(apply(patch, len, 0, NULL) == ESP_ERR_INVALID_ARG);
+    patch[HEADER_LEN] = first_op;
+
+    // Operations reading past the source, or writing past the target
+    const uint8_t ops[] = {1, 2};
+    for (size_t i = 0; i < sizeof(ops); i++) {
+        const size_t pos = find_op(patch, len, ops[i]);
+        CHECK(pos != 0);
+        if (pos == 0) {
+            continue;
+        }
+        uint8_t saved[8];
+        memcpy(saved, patch + pos + 1, 8);
+        memset(patch + pos + 1, 0xee, 4);       // Source offset
+        CHECK(apply(patch, len, 0, NULL) == ESP_ERR_INVALID_ARG);
+        memcpy(patch + pos + 1, saved, 8);
+        if (ops[i] == 1) {
+            memset(patch + pos + 5, 0xee, 4);   // Length
+            CHECK(apply(patch, len, 0, NULL) == ESP_ERR_INVALID_ARG);
+            memcpy(patch + pos + 1, saved, 8);
+        }
+    }
+    const size_t insert = find_op(patch, len, 3);
+    CHECK(insert != 0);
+    if (insert != 0) {
+        uint8_t saved[4];
+        memcpy(saved, patch + insert + 1, 4);
+        memset(patch + insert + 1, 0xee, 4);
+        CHECK(apply(patch, len, 0, NULL) == ESP_ERR_INVALID_ARG);
+        memcpy(patch + insert + 1, saved, 4);
+    }
+
+    // Data after the end
+    uint8_t *longer = malloc(len + 1);
+    memcpy(longer, patch, len);
+    longer[len] = 0;
+    CHECK(apply(longer, len + 1, 0, NULL) == ESP_ERR_INVALID_ARG);
+    free(longer);
+
+    // A flipped data byte still patches; the image digest (ota_verify) catches it
+    const size_t add = find_op(patch, len, 2);
+    if (add != 0 && get_u32(patch + add + 5) > 0) {
+        patch[add + 9] ^= 0x01;
+        CHECK(apply(patch, len, 0, NULL) == ESP_OK);
+        CHECK(out_len == new_len && memcmp(out, new_image, new_len) != 0);
+        patch[add + 9] ^= 0x01;
+    }
+
+    // Output errors stop patching
+    ota_delta_t *d = ota_delta_begin(output_fails);
+    CHECK(ota_delta_feed(d, patch, len) == ESP_ERR_NO_MEM);
+    ota_delta_free(d);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <old.bin> <new.bin> <patch>\n", argv[0]);
+        return 2;
+    }
+    size_t old_len, new_len, patch_len;
+    uint8_t *old_image = read_file(argv[1], &old_len);
+    uint8_t *new_image = read_file(argv[2], &new_len);
+    uint8_t *patch = read_file(argv[3], &patch_len);
+    running_image = old_image;
+    running_len = old_len;
+    out_cap = new_len;
+    out = malloc(out_cap);
+
+    test_random_splits(patch, patch_len, new_image, new_len);
+    test_truncated(patch, patch_len);
+    test_mismatched(patch, patch_len, new_image, new_len, old_image, old_len);
+    test_corrupt(patch, patch_len, new_image, new_len);
+
+    free(old_image);
+    free(new_image);
+    free(patch);
+    free(out);
+    return host_test_result("ota_delta");
+}
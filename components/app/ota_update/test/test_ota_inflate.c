@@ -0,0 +1,240 @@
+/**
+ * Host test and benchmark of the gzip image inflater
+ * Compresses a firmware-like image with gzip, reports the upload size
+ * saved, feeds the stream in random splits and checks the image, then
+ * measures decompression throughput in the pipeline's receive buffer
+ * size. Truncated, corrupt and foreign streams must be refused.
+ * The ROM inflater is stood in for by zlib (host_tinfl), so the MB/s are
+ * the framing's cost plus zlib's, not the ROM's.
+ *
+ * Usage: test_ota_inflate <image.bin>
+ */
+#include "ota_inflate.h"
+#include "ota_pipeline.h"
+#include "host_test.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define SPLIT_RUNS 50
+#define BENCH_ROUNDS 20
+#define GZIP_HEADER_LEN 10
+#define GZIP_TRAILER_LEN 8
+
+static uint8_t *out;
+static size_t out_len;
+static size_t out_cap;
+
+static esp_err_t output(const uint8_t *data, size_t size)
+{
+    if (out_len + size > out_cap) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out + out_len, data, size);
+    out_len += size;
+    return ESP_OK;
+}
+
+static esp_err_t output_count(const uint8_t *data, size_t size)
+{
+    out_len += size;
+    return ESP_OK;
+}
+
+static esp_err_t output_fails(const uint8_t *data, size_t size)
+{
+    return ESP_ERR_NO_MEM;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    rewind(f);
+    uint8_t *data = malloc(*len);
+    if (fread(data, 1, *len, f) != *len) {
+        perror(path);
+        exit(1);
+    }
+    fclose(f);
+    return data;
+}
+
+/**
+ * gzip an image, with all optional header fields if requested
+ */
+static uint8_t *gzip_image(const uint8_t *image, size_t len, int level, bool header_fields, size_t *gz_len)
+{
+    z_stream s = {0};
+    CHECK(deflateInit2(&s, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    gz_header header = {0};
+    if (header_fields) {
+        static uint8_t extra[] = "AB\x04\x00" "data";
+        header.extra = extra;
+        header.extra_len = sizeof(extra) - 1;
+        header.name = (Bytef *)"firmware.bin";
+        header.comment = (Bytef *)"built on the host";
+        header.hcrc = 1;
+        CHECK(deflateSetHeader(&s, &header) == Z_OK);
+    }
+    const size_t cap = deflateBound(&s, len) + 64;
+    uint8_t *gz = malloc(cap);
+    s.next_in = (Bytef *)image;
+    s.avail_in = len;
+    s.next_out = gz;
+    s.avail_out = cap;
+    CHECK(deflate(&s, Z_FINISH) == Z_STREAM_END);
+    *gz_len = s.total_out;
+    deflateEnd(&s);
+    return gz;
+}
+
+/**
+ * Inflate a stream in splits of up to max_split bytes
+ *
+ * @return The first feed error, else the finish result
+ */
+static esp_err_t inflate_stream(const uint8_t *gz, size_t len, size_t max_split, uint32_t *rng,
+                                ota_inflate_output_t sink)
+{
+    out_len = 0;
+    ota_inflate_t *inf = ota_inflate_begin(sink);
+    CHECK(inf != NULL);
+    esp_err_t ret = ESP_OK;
+    for (size_t off = 0; off < len && ret == ESP_OK;) {
+        size_t n = (rng == NULL) ? max_split : 1 + host_test_rand(rng) % max_split;
+        if (n > len - off) {
+            n = len - off;
+        }
+        ret = ota_inflate_feed(inf, gz + off, n);
+        off += n;
+    }
+    if (ret == ESP_OK) {
+        ret = ota_inflate_finish(inf);
+    }
+    ota_inflate_free(inf);
+    return ret;
+}
+
+static void test_upload_size(const uint8_t *image, size_t len)
+{
+    printf("ota_inflate: %zu byte image\n", len);
+    const int levels[] = {1, 6, 9};
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        size_t gz_len;
+        uint8_t *gz = gzip_image(image, len, levels[i], false, &gz_len);
+        printf("  gzip -%d: %zu bytes uploaded, %.1f %% saved\n", levels[i], gz_len,
+               100.0 * (1.0 - (double)gz_len / len));
+        CHECK(gz_len < len);
+        free(gz);
+    }
+}
+
+static void test_random_splits(const uint8_t *gz, size_t gz_len, const uint8_t *image, size_t len)
+{
+    uint32_t rng = 23;
+    for (int i = 0; i < SPLIT_RUNS; i++) {
+        // Tiny splits cross every header field, large ones the deflate blocks
+        const size_t max_split = (i % 3 == 0) ? 7 : 5000;
+        CHECK(inflate_stream(gz, gz_len, max_split, &rng, output) == ESP_OK);
+        CHECK(out_len == len && memcmp(out, image, len) == 0);
+        if (host_test_failures > 0) {
+            fprintf(stderr, "run %d, splits up to %zu\n", i, max_split);
+            return;
+        }
+    }
+}
+
+static void bench_inflate(const uint8_t *gz, size_t gz_len, size_t len)
+{
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        const uint64_t start = host_test_now_ns();
+        CHECK(inflate_stream(gz, gz_len, OTA_PIPELINE_BUFFER_SIZE, NULL, output_count) == ESP_OK);
+        const uint64_t elapsed = host_test_now_ns() - start;
+        CHECK(out_len == len);
+        best = elapsed < best ? elapsed : best;
+    }
+    printf("  inflate in %d byte chunks: %.2f ms, %.1f MB/s out, %.1f MB/s in\n", OTA_PIPELINE_BUFFER_SIZE,
+           best / 1e6, len * 1e3 / best, gz_len * 1e3 / best);
+}
+
+static void test_truncated(const uint8_t *gz, size_t len)
+{
+    const size_t cuts[] = {0, 1, GZIP_HEADER_LEN - 1, GZIP_HEADER_LEN, GZIP_HEADER_LEN + 5, len / 3, len / 2,
+                           len - GZIP_TRAILER_LEN, len - 1};
+    for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) {
+        // Nothing may pass as a complete image
+        CHECK(inflate_stream(gz, cuts[i], cuts[i] + 1, NULL, output) == ESP_ERR_INVALID_SIZE);
+    }
+}
+
+static void test_corrupt(uint8_t *gz, size_t len, const uint8_t *image, size_t image_len)
+{
+    // An uncompressed ESP image, and another compression method
+    CHECK(inflate_stream(image, image_len, image_len, NULL, output) == ESP_ERR_INVALID_ARG);
+    gz[2] = 7;
+    CHECK(inflate_stream(gz, len, len, NULL, output) == ESP_ERR_INVALID_ARG);
+    gz[2] = 8;
+
+    // Reserved deflate block type
+    const uint8_t first = gz[GZIP_HEADER_LEN];
+    gz[GZIP_HEADER_LEN] = 0x07;
+    CHECK(inflate_stream(gz, len, len, NULL, output) == ESP_ERR_INVALID_ARG);
+    gz[GZIP_HEADER_LEN] = first;
+
+    // Trailer CRC and length
+    for (size_t pos = len - GZIP_TRAILER_LEN; pos < len; pos += 4) {
+        gz[pos] ^= 0x01;
+        CHECK(inflate_stream(gz, len, len, NULL, output) == ESP_ERR_INVALID_CRC);
+        gz[pos] ^= 0x01;
+    }
+
+    // Padding after the stream is ignored
+    uint8_t *longer = malloc(len + 16);
+    memcpy(longer, gz, len);
+    memset(longer + len, 0, 16);
+    CHECK(inflate_stream(longer, len + 16, len + 16, NULL, output) == ESP_OK);
+    CHECK(out_len == image_len);
+    free(longer);
+
+    // Output errors stop decompression
+    ota_inflate_t *inf = ota_inflate_begin(output_fails);
+    CHECK(ota_inflate_feed(inf, gz, len) == ESP_ERR_NO_MEM);
+    ota_inflate_free(inf);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <image.bin>\n", argv[0]);
+        return 2;
+    }
+    size_t len;
+    uint8_t *image = read_file(argv[1], &len);
+    out_cap = len;
+    out = malloc(out_cap);
+
+    test_upload_size(image, len);
+
+    size_t gz_len;
+    uint8_t *gz = gzip_image(image, len, 9, false, &gz_len);
+    bench_inflate(gz, gz_len, len);
+    test_truncated(gz, gz_len);
+    test_corrupt(gz, gz_len, image, len);
+    free(gz);
+
+    // Name, comment, extra field and header CRC, as gzip tools may write them
+    gz = gzip_image(image, len, 9, true, &gz_len);
+    test_random_splits(gz, gz_len, image, len);
+    free(gz);
+
+    free(image);
+    free(out);
+    return host_test_result("ota_inflate");
+}
@@ -0,0 +1,435 @@
+/**
+ * Host test and benchmark of the OTA write path on emulated flash
+ * Drives ota_update_begin/write/end with a firmware-like image on a
+ * file-backed app partition (host_partition, NOR rules). Built once per
+ * erase mode (OTA_UPDATE_STREAMING_ERASE 1 and 0); reports the time to
+ * the first accepted byte and the total duration, measured on the host
+ * and with a model of the flash timings, and checks the flash writes:
+ * with streaming erase every one is a whole, aligned sector except the
+ * final flush, and both the pass-through and the buffered branch of
+ * sector_write() run.
+ *
+ * The esp_ota_* stand-ins below erase like ESP-IDF: the image area in
+ * esp_ota_begin(), or with OTA_WITH_SEQUENTIAL_WRITES each sector as a
+ * write enters it.
+ *
+ * Usage: test_ota_update_flash_<mode> <image.bin> <flash image file>
+ */
+#include "ota_update.h"
+#include "esp_ota_ops.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "host_partition.h"
+#include "host_test.h"
+#include "nvs.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define PARTITION_SIZE (1536 * 1024)
+#define SECTOR_SIZE HOST_PARTITION_SECTOR_SIZE
+#define BLOCK_SIZE (64 * 1024)
+#define PAGE_SIZE 256
+// Typical SPI NOR timings (W25Q32JV datasheet): sector and block erase, page program
+#define SECTOR_ERASE_US 45000
+#define BLOCK_ERASE_US 150000
+#define PAGE_PROGRAM_US 400
+// TCP payload of one segment, as the HTTP server receives an upload
+#define MSS_CHUNK 1436
+
+static const esp_partition_t *partition;
+static const uint8_t *upload;
+static size_t upload_len;
+
+/* Flash model and write log, filled in by the esp_ota_* stand-ins */
+
+typedef struct {
+    uint64_t flash_us;          // Modeled flash busy time
+    uint32_t writes;
+    uint32_t pass_through;      // Written straight from the upload buffer
+    uint32_t buffered;          // Written from ota_update's sector buffer
+    uint32_t unaligned;         // Not a whole sector at a sector boundary
+    bool last_unaligned;
+    bool boot_set;
+} flash_log_t;
+
+static flash_log_t flash_log;
+
+static struct {
+    bool open;
+    bool sequential;
+    size_t wrote;
+} ota;
+
+static void model_erase(size_t offset, size_t size)
+{
+    // spi_flash erases whole 64 KB blocks where it can
+    for (size_t end = offset + size; offset < end;) {
+        if (offset % BLOCK_SIZE == 0 && end - offset >= BLOCK_SIZE) {
+            flash_log.flash_us += BLOCK_ERASE_US;
+            offset += BLOCK_SIZE;
+        } else {
+            flash_log.flash_us += SECTOR_ERASE_US;
+            offset += SECTOR_SIZE;
+        }
+    }
+}
+
+static esp_err_t erase(size_t offset, size_t size)
+{
+    model_erase(offset, size);
+    return esp_partition_erase_range(partition, offset, size);
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    return partition;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *part, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    CHECK(!ota.open);
+    ota.open = true;
+    ota.wrote = 0;
+    ota.sequential = (image_size == OTA_WITH_SEQUENTIAL_WRITES);
+    *out_handle = 1;
+    if (ota.sequential) {
+        return ESP_OK;
+    }
+    const size_t size = (image_size == OTA_SIZE_UNKNOWN) ? part->size
+                                                         : (image_size + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+    return erase(0, size);
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    CHECK(ota.open && size > 0);
+    if (ota.sequential) {
+        // Erase the sectors this write enters
+        const size_t first = ota.wrote / SECTOR_SIZE;
+        const size_t last = (ota.wrote + size - 1) / SECTOR_SIZE;
+        esp_err_t ret = ESP_OK;
+        if (ota.wrote % SECTOR_SIZE == 0) {
+            ret = erase(ota.wrote, (last - first + 1) * SECTOR_SIZE);
+        } else if (first != last) {
+            ret = erase((first + 1) * SECTOR_SIZE, (last - first) * SECTOR_SIZE);
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    const bool aligned = ota.wrote % SECTOR_SIZE == 0 && size % SECTOR_SIZE == 0;
+    flash_log.writes++;
+    flash_log.unaligned += !aligned;
+    flash_log.last_unaligned = !aligned;
+    if ((const uint8_t *)data >= upload && (const uint8_t *)data < upload + upload_len) {
+        flash_log.pass_through++;
+    } else {
+        flash_log.buffered++;
+    }
+    flash_log.flash_us += (uint64_t)((ota.wrote + size + PAGE_SIZE - 1) / PAGE_SIZE - ota.wrote / PAGE_SIZE) *
+                          PAGE_PROGRAM_US;
+
+    esp_err_t ret = esp_partition_write(partition, ota.wrote, data, size);
+    ota.wrote += size;
+    return ret;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    CHECK(ota.open);
+    ota.open = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    ota.open = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *part)
+{
+    flash_log.boot_set = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_resume(const esp_partition_t *part, size_t erase_size, size_t image_offset,
+                         esp_ota_handle_t *out_handle)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+// Patches are not sent here
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return NULL;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t *part, uint8_t *sha_256)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+/* Sessions are not used here: NVS is empty and refuses writes */
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+/* FreeRTOS and system calls ota_update.c makes (single-threaded here) */
+
+static int mutex_handle;
+static bool mutex_taken;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return (SemaphoreHandle_t)&mutex_handle;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait)
+{
+    CHECK(!mutex_taken);
+    mutex_taken = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    CHECK(mutex_taken);
+    mutex_taken = false;
+    return pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)(host_test_now_ns() / 1000);
+}
+
+uint32_t esp_random(void)
+{
+    return 0x5eed;
+}
+
+void esp_restart(void)
+{
+    CHECK(false);
+}
+
+/* Uploads */
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    rewind(f);
+    uint8_t *data = malloc(*len);
+    if (fread(data, 1, *len, f) != *len) {
+        perror(path);
+        exit(1);
+    }
+    fclose(f);
+    return data;
+}
+
+static uint8_t *gzip_image(const uint8_t *image, size_t len, size_t *gz_len)
+{
+    z_stream s = {0};
+    CHECK(deflateInit2(&s, 9, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    const size_t cap = deflateBound(&s, len);
+    uint8_t *gz = malloc(cap);
+    s.next_in = (Bytef *)image;
+    s.avail_in = len;
+    s.next_out = gz;
+    s.avail_out = cap;
+    CHECK(deflate(&s, Z_FINISH) == Z_STREAM_END);
+    *gz_len = s.total_out;
+    deflateEnd(&s);
+    return gz;
+}
+
+typedef struct {
+    uint64_t first_byte_us;     // ota_update_begin() to the first accepted write
+    uint64_t first_byte_flash_us;
+    uint64_t total_us;
+    uint64_t total_flash_us;
+    host_partition_stats_t stats;
+} upload_result_t;
+
+/**
+ * Upload data in chunks: max_chunk bytes, or random sizes up to it with rng
+ *
+ * @return The first error of the OTA calls
+ */
+static esp_err_t run_upload(const uint8_t *data, size_t len, size_t max_chunk, uint32_t *rng, upload_result_t *r)
+{
+    upload = data;
+    upload_len = len;
+    memset(&flash_log, 0, sizeof(flash_log));
+    host_partition_reset_stats(partition);
+
+    const uint64_t start = host_test_now_ns();
+    esp_err_t ret = ota_update_begin(len);
+    for (size_t off = 0; off < len && ret == ESP_OK;) {
+        size_t n = (rng == NULL) ? max_chunk : 1 + host_test_rand(rng) % max_chunk;
+        if (n > len - off) {
+            n = len - off;
+        }
+        ret = ota_update_write(data + off, n);
+        if (off == 0) {
+            r->first_byte_us = (host_test_now_ns() - start) / 1000;
+            r->first_byte_flash_us = flash_log.flash_us;
+        }
+        off += n;
+    }
+    if (ret == ESP_OK) {
+        ret = ota_update_end();
+    }
+    r->total_us = (host_test_now_ns() - start) / 1000;
+    r->total_flash_us = flash_log.flash_us;
+    host_partition_get_stats(partition, &r->stats);
+    return ret;
+}
+
+static void check_flash(const uint8_t *image, size_t len)
+{
+    uint8_t *flash = malloc(len);
+    CHECK(esp_partition_read(partition, 0, flash, len) == ESP_OK);
+    CHECK(memcmp(flash, image, len) == 0);
+    free(flash);
+}
+
+static void report(const char *what, const upload_result_t *r)
+{
+    printf("  %-22s first byte %7.2f ms (flash %7.1f ms), done %7.2f ms (flash %7.1f ms), "
+           "%" PRIu32 " sectors erased, %" PRIu32 " writes (%" PRIu32 " pass-through, %" PRIu32 " buffered)\n",
+           what, r->first_byte_us / 1e3, r->first_byte_flash_us / 1e3, r->total_us / 1e3, r->total_flash_us / 1e3,
+           r->stats.erases, flash_log.writes, flash_log.pass_through, flash_log.buffered);
+}
+
+static void test_plain(const uint8_t *image, size_t len)
+{
+    const uint32_t sectors = (len + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    const struct {
+        const char *name;
+        size_t max_chunk;
+        bool random;
+    } patterns[] = {
+        // Odd sizes: some chunks end mid-sector, some carry whole sectors after the buffered part
+        {"random 1..12000 B", 12000, true},
+        {"1436 B (TCP segments)", MSS_CHUNK, false},
+        {"4096 B (pipeline)", 4096, false},
+    };
+
+    uint32_t rng = 21;
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        upload_result_t r = {0};
+        CHECK(run_upload(image, len, patterns[i].max_chunk, patterns[i].random ? &rng : NULL, &r) == ESP_OK);
+        report(patterns[i].name, &r);
+        check_flash(image, len);
+        CHECK(flash_log.boot_set);
+        CHECK(r.stats.write_conflicts == 0);
+        CHECK(r.stats.erases == sectors);
+
+        if (OTA_UPDATE_STREAMING_ERASE) {
+            // Whole sectors only, but for the flush of the last partial one
+            CHECK(flash_log.unaligned == 0 || (flash_log.unaligned == 1 && flash_log.last_unaligned));
+            CHECK(flash_log.unaligned == (len % SECTOR_SIZE != 0));
+            // Nothing to erase before data is accepted
+            CHECK(r.first_byte_flash_us <= SECTOR_ERASE_US + SECTOR_SIZE / PAGE_SIZE * PAGE_PROGRAM_US);
+            if (patterns[i].random) {
+                CHECK(flash_log.pass_through > 0 && flash_log.buffered > 0);
+            }
+        } else {
+            // The image area is erased before the first byte, chunks go to flash as they come
+            CHECK(!patterns[i].random || flash_log.unaligned > 0);
+            CHECK(r.first_byte_flash_us >= sectors / (BLOCK_SIZE / SECTOR_SIZE) * BLOCK_ERASE_US);
+        }
+    }
+}
+
+static void test_gzip(const uint8_t *image, size_t len)
+{
+    size_t gz_len;
+    uint8_t *gz = gzip_image(image, len, &gz_len);
+    uint32_t rng = 22;
+    upload_result_t r = {0};
+    const esp_err_t ret = run_upload(gz, gz_len, 12000, &rng, &r);
+    if (OTA_UPDATE_STREAMING_ERASE) {
+        CHECK(ret == ESP_OK);
+        report("gzip, random chunks", &r);
+        check_flash(image, len);
+        // Decompressed data never comes from the upload buffer
+        CHECK(flash_log.pass_through == 0);
+        CHECK(flash_log.unaligned == (len % SECTOR_SIZE != 0));
+    } else {
+        // The erase size would be the compressed size
+        CHECK(ret == ESP_ERR_NOT_SUPPORTED);
+    }
+    free(gz);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <image.bin> <flash image file>\n", argv[0]);
+        return 2;
+    }
+    size_t len;
+    uint8_t *image = read_file(argv[1], &len);
+    unlink(argv[2]);
+    partition = host_partition_add("ota_1", ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1,
+                                   PARTITION_SIZE, argv[2]);
+    CHECK(partition != NULL);
+    if (partition == NULL) {
+        return host_test_result("ota_update_flash");
+    }
+    CHECK(ota_update_init() == ESP_OK);
+
+    printf("ota_update, %s erase, %zu byte image:\n", OTA_UPDATE_STREAMING_ERASE ? "streaming" : "up-front", len);
+    test_plain(image, len);
+    test_gzip(image, len);
+
+    free(image);
+    return host_test_result("ota_update_flash");
+}
@@ -0,0 +1,332 @@
+/**
+ * Host test of the streaming image verifier
+ * Feeds the image made by make_delta_images.py in random splits, with and
+ * without a trailing signature block and resumed from flash, then images
+ * built here to reach every part of the layout parser: each remainder of
+ * the checksum padding, empty and oversized segments, images without a
+ * digest, truncation in every state and a flipped bit at every offset.
+ *
+ * Usage: test_ota_verify <image.bin> <flash image file>
+ */
+#include "ota_verify.h"
+#include "esp_app_format.h"
+#include "esp_ota_ops.h"
+#include "host_partition.h"
+#include "host_test.h"
+#include "psa/crypto.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SPLIT_RUNS 50
+#define PARTITION_SIZE (1024 * 1024)
+#define SIGNATURE_LEN 4096
+#define DIGEST_LEN 32
+#define BUILD_MAX (64 * 1024)
+
+/**
+ * Where the parts of a built image start
+ */
+typedef struct {
+    size_t segment[ESP_IMAGE_MAX_SEGMENTS];    // Segment headers
+    size_t padding;                             // After the last segment
+    size_t checksum;
+    size_t digest;                              // End of the checksum
+    size_t len;
+} layout_t;
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    rewind(f);
+    uint8_t *data = malloc(*len);
+    if (fread(data, 1, *len, f) != *len) {
+        perror(path);
+        exit(1);
+    }
+    fclose(f);
+    return data;
+}
+
+/**
+ * Build an image with segments of the given sizes, as esptool lays it out
+ *
+ * @return Layout of the image written to buf
+ */
+static layout_t build_image(uint8_t *buf, const uint32_t *sizes, size_t count, bool hash_appended,
+                            size_t signature_len)
+{
+    layout_t layout = {0};
+    uint32_t rng = 101 + count;
+    esp_image_header_t header = {
+        .magic = ESP_IMAGE_HEADER_MAGIC,
+        .segment_count = count,
+        .spi_mode = 2,
+        .entry_addr = 0x40080400,
+        .wp_pin = 0xEE,
+        .max_chip_rev_full = 0xFFFF,
+        .hash_appended = hash_appended,
+    };
+    memcpy(buf, &header, sizeof(header));
+    size_t pos = sizeof(header);
+
+    uint8_t checksum = ESP_CHECKSUM_MAGIC;
+    for (size_t i = 0; i < count; i++) {
+        const esp_image_segment_header_t segment = { .load_addr = 0x3C000020 + i * 0x10000, .data_len = sizes[i] };
+        layout.segment[i] = pos;
+        memcpy(buf + pos, &segment, sizeof(segment));
+        pos += sizeof(segment);
+        for (uint32_t j = 0; j < sizes[i]; j++) {
+            buf[pos] = (uint8_t)host_test_rand(&rng);
+            checksum ^= buf[pos++];
+        }
+    }
+
+    layout.padding = pos;
+    const size_t padding = 15 - pos % 16;
+    memset(buf + pos, 0, padding);
+    pos += padding;
+    layout.checksum = pos;
+    buf[pos++] = checksum;
+    layout.digest = pos;
+
+    if (hash_appended) {
+        psa_hash_operation_t op = psa_hash_operation_init();
+        size_t len;
+        CHECK(psa_hash_setup(&op, PSA_ALG_SHA_256) == PSA_SUCCESS);
+        CHECK(psa_hash_update(&op, buf, pos) == PSA_SUCCESS);
+        CHECK(psa_hash_finish(&op, buf + pos, DIGEST_LEN, &len) == PSA_SUCCESS);
+        pos += DIGEST_LEN;
+    }
+    for (size_t i = 0; i < signature_len; i++) {
+        buf[pos++] = (uint8_t)host_test_rand(&rng);
+    }
+    layout.len = pos;
+    return layout;
+}
+
+/**
+ * Verify an image in splits of up to max_split bytes
+ *
+ * @return The first feed error, else the finish result
+ */
+static esp_err_t verify(const uint8_t *image, size_t len, size_t max_size, size_t max_split, uint32_t *rng)
+{
+    ota_verify_t *v = ota_verify_begin(max_size);
+    CHECK(v != NULL);
+    esp_err_t ret = ESP_OK;
+    for (size_t off = 0; off < len && ret == ESP_OK;) {
+        size_t n = (rng == NULL) ? max_split : 1 + host_test_rand(rng) % max_split;
+        if (n > len - off) {
+            n = len - off;
+        }
+        ret = ota_verify_feed(v, image + off, n);
+        off += n;
+    }
+    if (ret == ESP_OK) {
+        ret = ota_verify_finish(v);
+    }
+    ota_verify_free(v);
+    return ret;
+}
+
+static void test_generated(const uint8_t *image, size_t len)
+{
+    uint32_t rng = 25;
+    const uint64_t start = host_test_now_ns();
+    for (int i = 0; i < SPLIT_RUNS; i++) {
+        // Tiny splits cross every header field, large ones hash in bulk
+        const size_t max_split = (i % 3 == 0) ? 7 : 5000;
+        CHECK(verify(image, len, PARTITION_SIZE, max_split, &rng) == ESP_OK);
+    }
+    printf("ota_verify: %zu byte image, %d split runs in %.0f ms\n", len, SPLIT_RUNS,
+           (host_test_now_ns() - start) / 1e6);
+
+    // A signature block after the digest is not hashed
+    uint8_t *signed_image = malloc(len + SIGNATURE_LEN);
+    memcpy(signed_image, image, len);
+    memset(signed_image + len, 0xA5, SIGNATURE_LEN);
+    CHECK(verify(signed_image, len + SIGNATURE_LEN, PARTITION_SIZE, 5000, &rng) == ESP_OK);
+    free(signed_image);
+
+    // The partition must hold the image up to its checksum
+    CHECK(verify(image, len, len - DIGEST_LEN, len, NULL) == ESP_OK);
+    CHECK(verify(image, len, len - DIGEST_LEN - 1, len, NULL) == ESP_ERR_OTA_VALIDATE_FAILED);
+
+    // Any changed byte of the code or the digest fails the digest
+    uint8_t *copy = malloc(len);
+    memcpy(copy, image, len);
+    const size_t offsets[] = {100, len / 2, len - DIGEST_LEN - 1, len - DIGEST_LEN, len - 1};
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        copy[offsets[i]] ^= 0x01;
+        CHECK(verify(copy, len, PARTITION_SIZE, 5000, &rng) == ESP_ERR_OTA_VALIDATE_FAILED);
+        copy[offsets[i]] ^= 0x01;
+    }
+    free(copy);
+}
+
+/**
+ * Resume: part of the image is on flash, the rest still streams
+ */
+static void test_resume(const uint8_t *image, size_t len, const char *flash_path)
+{
+    const esp_partition_t *partition = host_partition_add("ota_0", ESP_PARTITION_TYPE_APP,
+                                                          ESP_PARTITION_SUBTYPE_APP_OTA_0, PARTITION_SIZE,
+                                                          flash_path);
+    CHECK(partition != NULL);
+    if (partition == NULL) {
+        return;
+    }
+    CHECK(esp_partition_erase_range(partition, 0, PARTITION_SIZE) == ESP_OK);
+    CHECK(esp_partition_write(partition, 0, image, len) == ESP_OK);
+
+    const size_t on_flash[] = {0, 10, sizeof(esp_image_header_t), 28, 4096, len / 2, len - DIGEST_LEN, len};
+    for (size_t i = 0; i < sizeof(on_flash) / sizeof(on_flash[0]); i++) {
+        ota_verify_t *v = ota_verify_begin(PARTITION_SIZE);
+        CHECK(ota_verify_feed_flash(v, partition, on_flash[i]) == ESP_OK);
+        CHECK(ota_verify_feed(v, image + on_flash[i], len - on_flash[i]) == ESP_OK);
+        CHECK(ota_verify_finish(v) == ESP_OK);
+        ota_verify_free(v);
+    }
+}
+
+static void test_padding(void)
+{
+    static uint8_t buf[BUILD_MAX];
+
+    // The checksum padding has 15 - (pos % 16) bytes for every remainder of pos
+    for (uint32_t rem = 0; rem < 16; rem++) {
+        // Header and two segment headers: 40 bytes
+        const uint32_t sizes[] = {100, 16 + (rem + 16 - (40 + 100 + 16) % 16) % 16};
+        for (int digest = 0; digest <= 1; digest++) {
+            const layout_t layout = build_image(buf, sizes, 2, digest, 0);
+            CHECK(layout.padding % 16 == rem);
+            CHECK(layout.digest % 16 == 0);
+            CHECK(verify(buf, layout.len, PARTITION_SIZE, 1, NULL) == ESP_OK);
+            CHECK(verify(buf, layout.len, PARTITION_SIZE, layout.len, NULL) == ESP_OK);
+            // One byte short of the end
+            CHECK(verify(buf, layout.len - 1, PARTITION_SIZE, layout.len, NULL) == ESP_ERR_INVALID_SIZE);
+        }
+    }
+}
+
+static void test_segments(void)
+{
+    static uint8_t buf[BUILD_MAX];
+
+    // Empty segments, first, between others and last
+    const uint32_t empty[] = {0, 50, 0, 7, 0};
+    layout_t layout = build_image(buf, empty, 5, true, 0);
+    CHECK(verify(buf, layout.len, PARTITION_SIZE, 1, NULL) == ESP_OK);
+    CHECK(verify(buf, layout.len, PARTITION_SIZE, layout.len, NULL) == ESP_OK);
+
+    // The most segments the format allows
+    uint32_t many[ESP_IMAGE_MAX_SEGMENTS];
+    for (size_t i = 0; i < ESP_IMAGE_MAX_SEGMENTS; i++) {
+        many[i] = 1 + i * 37;
+    }
+    layout = build_image(buf, many, ESP_IMAGE_MAX_SEGMENTS, true, 0);
+    CHECK(verify(buf, layout.len, PARTITION_SIZE, 3, NULL) == ESP_OK);
+
+    // No segments, or more than the format allows
+    buf[1] = 0;
+    CHECK(verify(buf, layout.len, PARTITION_SIZE, layout.len, NULL) == ESP_ERR_OTA_VALIDATE_FAILED);
+    buf[1] = ESP_IMAGE_MAX_SEGMENTS + 1;
+    CHECK(verify(buf, layout.len, PARTITION_SIZE, layout.len, NULL) == ESP_ERR_OTA_VALIDATE_FAILED);
+
+    // Not an app image
+    const uint32_t one[] = {64};
+    layout = build_image(buf, one, 1, true, 0);
+    buf[0] = 0x1F;
+    CHECK(verify(buf, layout.len, PARTITION_SIZE, layout.len, NULL) == ESP_ERR_OTA_VALIDATE_FAILED);
+
+    // Segment data past the partition: refused at its header, before the data arrives
+    const uint32_t sizes[] = {64, 200};
+    layout = build_image(buf, sizes, 2, true, 0);
+    const size_t max_size = layout.segment[1] + sizeof(esp_image_segment_header_t) + 199;
+    CHECK(verify(buf, layout.segment[1] + sizeof(esp_image_segment_header_t), max_size, 1, NULL) ==
+          ESP_ERR_OTA_VALIDATE_FAILED);
+    CHECK(verify(buf, layout.len, layout.digest, layout.len, NULL) == ESP_OK);
+    // Padding past the partition
+    CHECK(verify(buf, layout.len, layout.checksum, layout.len, NULL) == ESP_ERR_OTA_VALIDATE_FAILED);
+}
+
+static void test_truncated(void)
+{
+    static uint8_t buf[BUILD_MAX];
+    const uint32_t sizes[] = {100, 0, 61};
+    const layout_t layout = build_image(buf, sizes, 3, true, 0);
+    CHECK(layout.padding < layout.checksum);
+
+    // Cuts in each state: header, segment header, segment data (also the
+    // empty one), padding, checksum and digest
+    const size_t cuts[] = {
+        0, 1, sizeof(esp_image_header_t) - 1, sizeof(esp_image_header_t), layout.segment[0] + 4,
+        layout.segment[0] + sizeof(esp_image_segment_header_t), layout.segment[0] + 50, layout.segment[1],
+        layout.segment[2], layout.segment[2] + sizeof(esp_image_segment_header_t) + 60, layout.padding,
+        layout.checksum, layout.digest, layout.digest + DIGEST_LEN / 2, layout.len - 1,
+    };
+    for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) {
+        CHECK(verify(buf, cuts[i], PARTITION_SIZE, 1, NULL) == ESP_ERR_INVALID_SIZE);
+        CHECK(verify(buf, cuts[i], PARTITION_SIZE, cuts[i] + 1, NULL) == ESP_ERR_INVALID_SIZE);
+    }
+
+    // Without a digest the image ends with its checksum byte
+    build_image(buf, sizes, 3, false, 0);
+    CHECK(verify(buf, layout.checksum, PARTITION_SIZE, 1, NULL) == ESP_ERR_INVALID_SIZE);
+    CHECK(verify(buf, layout.digest, PARTITION_SIZE, 1, NULL) == ESP_OK);
+}
+
+static void test_flipped_bits(void)
+{
+    static uint8_t buf[BUILD_MAX];
+    const uint32_t sizes[] = {40, 23};
+    const layout_t layout = build_image(buf, sizes, 2, true, 0);
+
+    for (size_t pos = 0; pos < layout.len; pos++) {
+        buf[pos] ^= 0x01;
+        const esp_err_t ret = verify(buf, layout.len, PARTITION_SIZE, 5, NULL);
+        buf[pos] ^= 0x01;
+
+        const bool data_len = (pos >= layout.segment[0] + 4 && pos < layout.segment[0] + 8) ||
+                              (pos >= layout.segment[1] + 4 && pos < layout.segment[1] + 8);
+        if (pos == offsetof(esp_image_header_t, hash_appended)) {
+            // Without the flag the digest is trailing data; esp_ota_end() is left with the checksum
+            CHECK(ret == ESP_OK);
+        } else if (pos == offsetof(esp_image_header_t, segment_count) || data_len) {
+            // The layout moves: the digest is looked for elsewhere, or not found
+            CHECK(ret == ESP_ERR_OTA_VALIDATE_FAILED || ret == ESP_ERR_INVALID_SIZE);
+        } else {
+            CHECK(ret == ESP_ERR_OTA_VALIDATE_FAILED);
+        }
+        if (host_test_failures > 0) {
+            fprintf(stderr, "flipped bit at offset %zu\n", pos);
+            return;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <image.bin> <flash image file>\n", argv[0]);
+        return 2;
+    }
+    size_t len;
+    uint8_t *image = read_file(argv[1], &len);
+
+    test_generated(image, len);
+    test_resume(image, len, argv[2]);
+    test_padding();
+    test_segments();
+    test_truncated();
+    test_flipped_bits();
+
+    free(image);
+    return host_test_result("ota_verify");
+}
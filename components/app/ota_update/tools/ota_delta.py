@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""Make and apply binary patches between two firmware images.
+
+  ota_delta.py diff <old.bin> <new.bin> <patch> [--raw]
+  ota_delta.py apply <old.bin> <patch> <new.bin>
+
+old.bin must be the exact image running on the device: the patch carries
+its SHA-256 (the hash appended to the image) and the device refuses a
+patch made against anything else. The patch is gzipped unless --raw is
+given; upload it to /OTAupdate or an upload session like a full image.
+
+Matching regions are coded as the byte-wise difference to the old image
+(as bsdiff does), so code that only moved by a few bytes costs runs of
+small values that compress well. Every patch written is applied again
+and compared to new.bin before the sizes are reported.
+"""
+import gzip
+import hashlib
+import struct
+import sys
+
+MAGIC = b'ODP1'
+OP_END, OP_COPY, OP_ADD, OP_INSERT = 0, 1, 2, 3
+
+# Bytes hashed to find match candidates, and the spacing of indexed old offsets
+SEED_LEN = 16
+SEED_STEP = 4
+# A match is extended while it keeps more equal than differing bytes,
+# giving up this far below the best score
+EXTEND_SLACK = 64
+# Equal runs shorter than this stay inside an ADD
+MIN_COPY = 32
+
+
+def source_hash(old):
+    """SHA-256 the device reports for the running partition."""
+    digest = old[-32:]
+    if len(old) <= 32 or hashlib.sha256(old[:-32]).digest() != digest:
+        sys.exit('old image has no appended SHA-256, is it a build output?')
+    return digest
+
+
+class Patch:
+    def __init__(self, old, new):
+        self.old = old
+        self.out = bytearray(MAGIC + struct.pack('<II', len(old), len(new)) + source_hash(old))
+
+    def copy(self, src, length):
+        self.out += struct.pack('<BII', OP_COPY, src, length)
+
+    def add(self, src, diff):
+        self.out += struct.pack('<BII', OP_ADD, src, len(diff)) + diff
+
+    def insert(self, data):
+        if data:
+            self.out += struct.pack('<BI', OP_INSERT, len(data)) + data
+
+    def region(self, src, new, dst, length):
+        """Code new[dst:dst + length] against old[src:]."""
+        old = self.old
+        add_start = 0
+        i = 0
+        while i < length:
+            if old[src + i] != new[dst + i]:
+                i += 1
+                continue
+            j = i
+            while j < length and old[src + j] == new[dst + j]:
+                j += 1
+            if j - i >= MIN_COPY:
+                self.add_range(src, new, dst, add_start, i)
+                self.copy(src + i, j - i)
+                add_start = j
+            i = j
+        self.add_range(src, new, dst, add_start, length)
+
+    def add_range(self, src, new, dst, start, end):
+        if end > start:
+            old = self.old
+            self.add(src + start, bytes((new[dst + k] - old[src + k]) & 0xFF for k in range(start, end)))
+
+    def finish(self):
+        self.out.append(OP_END)
+        return bytes(self.out)
+
+
+def exact_length(old, s, new, t):
+    n = 0
+    limit = min(len(old) - s, len(new) - t)
+    while n + 64 <= limit and old[s + n:s + n + 64] == new[t + n:t + n + 64]:
+        n += 64
+    while n < limit and old[s + n] == new[t + n]:
+        n += 1
+    return n
+
+
+def extend(old, s, new, t, n):
+    """Length of the approximate match starting with n equal bytes."""
+    best_len = n
+    score = best = 0
+    limit = min(len(old) - s, len(new) - t)
+    i = n
+    while i < limit:
+        score += 1 if old[s + i] == new[t + i] else -1
+        i += 1
+        if score > best:
+            best, best_len = score, i
+        elif score < best - EXTEND_SLACK:
+            break
+    return best_len
+
+
+def diff(old, new):
+    index = {}
+    for s in range(0, len(old) - SEED_LEN + 1, SEED_STEP):
+        index.setdefault(old[s:s + SEED_LEN], s)
+
+    patch = Patch(old, new)
+    literal = 0
+    t = 0
+    while t + SEED_LEN <= len(new):
+        # Any match is found by one of SEED_STEP consecutive seeds
+        s = index.get(new[t:t + SEED_LEN])
+        if s is None:
+            t += 1
+            continue
+        # Take back bytes that would otherwise be literals
+        while t > literal and s > 0 and old[s - 1] == new[t - 1]:
+            s -= 1
+            t -= 1
+        length = extend(old, s, new, t, exact_length(old, s, new, t))
+        patch.insert(new[literal:t])
+        patch.region(s, new, t, length)
+        t += length
+        literal = t
+    patch.insert(new[literal:])
+    return patch.finish()
+
+
+def apply(old, patch):
+    """Reference implementation of ota_delta.c."""
+    if patch[:2] == b'\x1f\x8b':
+        patch = gzip.decompress(patch)
+    if patch[:4] != MAGIC:
+        raise ValueError('not a patch')
+    source_size, target_size = struct.unpack_from('<II', patch, 4)
+    if source_size != len(old) or patch[12:44] != source_hash(old):
+        raise ValueError('patch was made for a different image')
+
+    new = bytearray()
+    pos = 44
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_INSERT:
+            (length,) = struct.unpack_from('<I', patch, pos)
+            pos += 4
+            new += patch[pos:pos + length]
+            pos += length
+            continue
+        src, length = struct.unpack_from('<II', patch, pos)
+        pos += 8
+        if src + length > source_size:
+            raise ValueError('operation out of range')
+        if op == OP_COPY:
+            new += old[src:src + length]
+        elif op == OP_ADD:
+            new += bytes((a + b) & 0xFF for a, b in zip(old[src:src + length], patch[pos:pos + length]))
+            pos += length
+        else:
+            raise ValueError('unknown operation 0x%02x' % op)
+    if pos != len(patch) or len(new) != target_size:
+        raise ValueError('patch truncated or followed by data')
+    return bytes(new)
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def write(path, data):
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+def size_line(name, size, full):
+    return '%-14s %9d bytes  %6.2f%%' % (name, size, 100.0 * size / full)
+
+
+def main():
+    args = [a for a in sys.argv[1:] if a != '--raw']
+    raw = len(args) != len(sys.argv) - 1
+
+    if len(args) == 4 and args[0] == 'diff':
+        old, new = read(args[1]), read(args[2])
+        patch = diff(old, new)
+        packed = patch if raw else gzip.compress(patch, compresslevel=9, mtime=0)
+        if apply(old, packed) != new:
+            sys.exit('patch does not rebuild the new image')
+        write(args[3], packed)
+
+        full_gz = len(gzip.compress(new, compresslevel=9, mtime=0))
+        print(size_line('image', len(new), len(new)))
+        print(size_line('image gzip', full_gz, len(new)))
+        print(size_line('patch', len(patch), len(new)))
+        if not raw:
+            print(size_line('patch gzip', len(packed), len(new)))
+    elif len(args) == 4 and args[0] == 'apply' and not raw:
+        try:
+            write(args[3], apply(read(args[1]), read(args[2])))
+        except ValueError as e:
+            sys.exit(str(e))
+    else:
+        sys.exit('usage: ota_delta.py diff <old.bin> <new.bin> <patch> [--raw]\n'
+                 '       ota_delta.py apply <old.bin> <patch> <new.bin>')
+
+
+if __name__ == '__main__':
+    main()
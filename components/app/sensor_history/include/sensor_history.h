@@ -0,0 +1,97 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include "esp_err.h"
+#include <time.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw samples: 2 s resolution for 1 hour
+#define SENSOR_HISTORY_RAW_POINTS 1800
+
+// 1-minute rollups for 1 day
+#define SENSOR_HISTORY_MINUTE_POINTS 1440
+
+// 1-hour rollups for 30 days
+#define SENSOR_HISTORY_HOUR_POINTS 720
+
+/**
+ * History resolution tiers
+ */
+typedef enum {
+    SENSOR_HISTORY_TIER_RAW = 0,
+    SENSOR_HISTORY_TIER_MINUTE,
+    SENSOR_HISTORY_TIER_HOUR,
+    SENSOR_HISTORY_TIER_COUNT
+} sensor_history_tier_t;
+
+/**
+ * One history point
+ * For the raw tier min, max and mean are the sample value and count is 1.
+ */
+typedef struct {
+    time_t timestamp;       // Sample time, or start of the rollup period
+    uint16_t count;         // Number of samples aggregated
+    float temp_min;
+    float temp_max;
+    float temp_mean;
+    float hum_min;
+    float hum_max;
+    float hum_mean;
+} sensor_history_point_t;
+
+/**
+ * Initialize history storage
+ * Allocates the fixed-size rings, preferring PSRAM when available.
+ * 
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if allocation failed
+ */
+esp_err_t sensor_history_init(void);
+
+/**
+ * Add a sample
+ * Rollups are updated incrementally; a rollup point is stored once its
+ * period has ended. A timestamp older than the newest sample clears the
+ * history (the clock was set back).
+ * 
+ * @param timestamp Sample time
+ * @param temperature Temperature in °C
+ * @param humidity Relative humidity in %
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t sensor_history_add(time_t timestamp, float temperature, float humidity);
+
+/**
+ * Read points of a tier in time order
+ * The rollup period still in progress is returned as the last point.
+ * To page through a long range, call again with from set to the last
+ * returned timestamp + 1.
+ * 
+ * @param tier Tier to read
+ * @param from First timestamp to include
+ * @param to Last timestamp to include
+ * @param points Output array
+ * @param max_points Size of the output array
+ * @return Number of points written
+ */
+size_t sensor_history_read(sensor_history_tier_t tier, time_t from, time_t to,
+                           sensor_history_point_t *points, size_t max_points);
+
+/**
+ * Parse a tier name ("raw", "minute", "hour")
+ * 
+ * @param name Tier name
+ * @param tier Receives the tier
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for unknown names
+ */
+esp_err_t sensor_history_tier_from_name(const char *name, sensor_history_tier_t *tier);
+
+/**
+ * Get the name of a tier
+ * 
+ * @param tier Tier
+ * @return Tier name
+ */
+const char *sensor_history_tier_name(sensor_history_tier_t tier);
+
+#endif // SENSOR_HISTORY_H
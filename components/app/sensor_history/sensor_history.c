@@ -0,0 +1,316 @@
+#include "sensor_history.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "sensor_history";
+
+// Rollup period per tier in seconds
+#define MINUTE_PERIOD 60
+#define HOUR_PERIOD 3600
+
+/**
+ * Stored raw sample (0.1 °C / 0.1 % fixed point)
+ */
+typedef struct {
+    uint32_t timestamp;
+    int16_t temp;
+    uint16_t hum;
+} raw_point_t;
+
+/**
+ * Stored rollup (0.1 °C / 0.1 % fixed point)
+ */
+typedef struct {
+    uint32_t timestamp;
+    uint16_t count;
+    int16_t temp_min;
+    int16_t temp_max;
+    int16_t temp_mean;
+    uint16_t hum_min;
+    uint16_t hum_max;
+    uint16_t hum_mean;
+} rollup_point_t;
+
+/**
+ * Rollup of the period in progress
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t period;
+    uint16_t count;
+    int16_t temp_min;
+    int16_t temp_max;
+    uint16_t hum_min;
+    uint16_t hum_max;
+    int32_t temp_sum;
+    uint32_t hum_sum;
+} rollup_acc_t;
+
+/**
+ * Fixed-capacity ring, oldest entry at (head - count)
+ */
+typedef struct {
+    void *points;
+    size_t point_size;
+    size_t capacity;
+    size_t head;
+    size_t count;
+} ring_t;
+
+static ring_t rings[SENSOR_HISTORY_TIER_COUNT];
+static rollup_acc_t minute_acc = { .period = MINUTE_PERIOD };
+static rollup_acc_t hour_acc = { .period = HOUR_PERIOD };
+static uint32_t last_timestamp = 0;
+static SemaphoreHandle_t history_mutex = NULL;
+
+static const char *tier_names[SENSOR_HISTORY_TIER_COUNT] = {
+    [SENSOR_HISTORY_TIER_RAW] = "raw",
+    [SENSOR_HISTORY_TIER_MINUTE] = "minute",
+    [SENSOR_HISTORY_TIER_HOUR] = "hour",
+};
+
+static esp_err_t ring_init(ring_t *ring, size_t capacity, size_t point_size)
+{
+    // Large tiers go to PSRAM when the board has it, internal RAM otherwise
+    ring->points = heap_caps_calloc_prefer(capacity, point_size, 2,
+                                           MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    if (ring->points == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ring->point_size = point_size;
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->count = 0;
+    return ESP_OK;
+}
+
+static void *ring_at(const ring_t *ring, size_t index)
+{
+    // index 0 is the oldest entry
+    size_t pos = (ring->head + ring->capacity - ring->count + index) % ring->capacity;
+    return (uint8_t *)ring->points + pos * ring->point_size;
+}
+
+static void ring_push(ring_t *ring, const void *point)
+{
+    memcpy((uint8_t *)ring->points + ring->head * ring->point_size, point, ring->point_size);
+    ring->head = (ring->head + 1) % ring->capacity;
+    if (ring->count < ring->capacity) {
+        ring->count++;
+    }
+}
+
+/**
+ * Index of the first entry with timestamp >= from (entries are time ordered,
+ * every point type starts with its uint32_t timestamp)
+ */
+static size_t ring_lower_bound(const ring_t *ring, uint32_t from)
+{
+    size_t lo = 0;
+    size_t hi = ring->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (*(const uint32_t *)ring_at(ring, mid) < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void rollup_finish(const rollup_acc_t *acc, rollup_point_t *point)
+{
+    point->timestamp = acc->start;
+    point->count = acc->count;
+    point->temp_min = acc->temp_min;
+    point->temp_max = acc->temp_max;
+    point->temp_mean = (int16_t)lroundf((float)acc->temp_sum / acc->count);
+    point->hum_min = acc->hum_min;
+    point->hum_max = acc->hum_max;
+    point->hum_mean = (uint16_t)lroundf((float)acc->hum_sum / acc->count);
+}
+
+static void rollup_add(rollup_acc_t *acc, ring_t *ring, uint32_t timestamp, int16_t temp, uint16_t hum)
+{
+    uint32_t start = timestamp - (timestamp % acc->period);
+
+    // Period ended: store it and start a new one
+    if (acc->count > 0 && start != acc->start) {
+        rollup_point_t point;
+        rollup_finish(acc, &point);
+        ring_push(ring, &point);
+        acc->count = 0;
+    }
+
+    if (acc->count == 0) {
+        acc->start = start;
+        acc->temp_min = acc->temp_max = temp;
+        acc->hum_min = acc->hum_max = hum;
+        acc->temp_sum = 0;
+        acc->hum_sum = 0;
+    }
+
+    if (temp < acc->temp_min) acc->temp_min = temp;
+    if (temp > acc->temp_max) acc->temp_max = temp;
+    if (hum < acc->hum_min) acc->hum_min = hum;
+    if (hum > acc->hum_max) acc->hum_max = hum;
+    acc->temp_sum += temp;
+    acc->hum_sum += hum;
+    acc->count++;
+}
+
+static void raw_to_point(const raw_point_t *raw, sensor_history_point_t *point)
+{
+    point->timestamp = raw->timestamp;
+    point->count = 1;
+    point->temp_min = point->temp_max = point->temp_mean = raw->temp / 10.0f;
+    point->hum_min = point->hum_max = point->hum_mean = raw->hum / 10.0f;
+}
+
+static void rollup_to_point(const rollup_point_t *rollup, sensor_history_point_t *point)
+{
+    point->timestamp = rollup->timestamp;
+    point->count = rollup->count;
+    point->temp_min = rollup->temp_min / 10.0f;
+    point->temp_max = rollup->temp_max / 10.0f;
+    point->temp_mean = rollup->temp_mean / 10.0f;
+    point->hum_min = rollup->hum_min / 10.0f;
+    point->hum_max = rollup->hum_max / 10.0f;
+    point->hum_mean = rollup->hum_mean / 10.0f;
+}
+
+static void history_clear(void)
+{
+    for (int i = 0; i < SENSOR_HISTORY_TIER_COUNT; i++) {
+        rings[i].head = 0;
+        rings[i].count = 0;
+    }
+    minute_acc.count = 0;
+    hour_acc.count = 0;
+}
+
+esp_err_t sensor_history_init(void)
+{
+    if (history_mutex != NULL) {
+        return ESP_OK;
+    }
+
+    if (ring_init(&rings[SENSOR_HISTORY_TIER_RAW], SENSOR_HISTORY_RAW_POINTS, sizeof(raw_point_t)) != ESP_OK ||
+        ring_init(&rings[SENSOR_HISTORY_TIER_MINUTE], SENSOR_HISTORY_MINUTE_POINTS, sizeof(rollup_point_t)) != ESP_OK ||
+        ring_init(&rings[SENSOR_HISTORY_TIER_HOUR], SENSOR_HISTORY_HOUR_POINTS, sizeof(rollup_point_t)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate history rings");
+        for (int i = 0; i < SENSOR_HISTORY_TIER_COUNT; i++) {
+            heap_caps_free(rings[i].points);
+            rings[i].points = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    history_mutex = xSemaphoreCreateMutex();
+    if (history_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create history mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "History initialized (%zu raw, %zu minute, %zu hour points)",
+             (size_t)SENSOR_HISTORY_RAW_POINTS, (size_t)SENSOR_HISTORY_MINUTE_POINTS,
+             (size_t)SENSOR_HISTORY_HOUR_POINTS);
+    return ESP_OK;
+}
+
+esp_err_t sensor_history_add(time_t timestamp, float temperature, float humidity)
+{
+    if (history_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    raw_point_t raw = {
+        .timestamp = (uint32_t)timestamp,
+        .temp = (int16_t)lroundf(temperature * 10.0f),
+        .hum = (uint16_t)lroundf(humidity * 10.0f),
+    };
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+
+    // Keep the rings time ordered if the clock was set back
+    if (raw.timestamp < last_timestamp) {
+        ESP_LOGW(TAG, "Clock moved backwards, clearing history");
+        history_clear();
+    }
+    last_timestamp = raw.timestamp;
+
+    ring_push(&rings[SENSOR_HISTORY_TIER_RAW], &raw);
+    rollup_add(&minute_acc, &rings[SENSOR_HISTORY_TIER_MINUTE], raw.timestamp, raw.temp, raw.hum);
+    rollup_add(&hour_acc, &rings[SENSOR_HISTORY_TIER_HOUR], raw.timestamp, raw.temp, raw.hum);
+
+    xSemaphoreGive(history_mutex);
+    return ESP_OK;
+}
+
+size_t sensor_history_read(sensor_history_tier_t tier, time_t from, time_t to,
+                           sensor_history_point_t *points, size_t max_points)
+{
+    if (history_mutex == NULL || tier >= SENSOR_HISTORY_TIER_COUNT ||
+        points == NULL || max_points == 0 || from > to || to < 0) {
+        return 0;
+    }
+
+    const uint32_t from_ts = (from < 0) ? 0 : (uint32_t)from;
+    const uint32_t to_ts = (to > UINT32_MAX) ? UINT32_MAX : (uint32_t)to;
+    const ring_t *ring = &rings[tier];
+    size_t written = 0;
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+
+    for (size_t i = ring_lower_bound(ring, from_ts); i < ring->count && written < max_points; i++) {
+        const void *entry = ring_at(ring, i);
+        if (*(const uint32_t *)entry > to_ts) {
+            break;
+        }
+        if (tier == SENSOR_HISTORY_TIER_RAW) {
+            raw_to_point(entry, &points[written]);
+        } else {
+            rollup_to_point(entry, &points[written]);
+        }
+        written++;
+    }
+
+    // Append the rollup still in progress
+    const rollup_acc_t *acc = (tier == SENSOR_HISTORY_TIER_MINUTE) ? &minute_acc :
+                              (tier == SENSOR_HISTORY_TIER_HOUR) ? &hour_acc : NULL;
+    if (acc != NULL && acc->count > 0 && written < max_points &&
+        acc->start >= from_ts && acc->start <= to_ts) {
+        rollup_point_t partial;
+        rollup_finish(acc, &partial);
+        rollup_to_point(&partial, &points[written]);
+        written++;
+    }
+
+    xSemaphoreGive(history_mutex);
+    return written;
+}
+
+esp_err_t sensor_history_tier_from_name(const char *name, sensor_history_tier_t *tier)
+{
+    if (name == NULL || tier == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < SENSOR_HISTORY_TIER_COUNT; i++) {
+        if (strcmp(name, tier_names[i]) == 0) {
+            *tier = (sensor_history_tier_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+const char *sensor_history_tier_name(sensor_history_tier_t tier)
+{
+    return (tier < SENSOR_HISTORY_TIER_COUNT) ? tier_names[tier] : "unknown";
+}
@@ -0,0 +1,134 @@
+#include <stdatomic.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+
+#include "dht_bus.h"
+
+static const char *TAG = "dht_bus";
+
+/**
+ * Ring slot
+ * seq holds the sequence number of the stored sample, or 0 while the
+ * producer is rewriting the slot. Readers copy the sample and accept it
+ * only if seq was the expected value before and after the copy.
+ */
+typedef struct {
+    atomic_uint_least32_t seq;
+    dht_sample_t sample;
+} dht_bus_slot_t;
+
+struct dht_bus_subscriber {
+    SemaphoreHandle_t signal;   // Given on every publish, never blocks the producer
+    uint32_t next_seq;          // Only touched by the subscriber itself
+    bool in_use;
+};
+
+static dht_bus_slot_t bus_slots[DHT_BUS_CAPACITY];
+static atomic_uint_least32_t bus_head = 0;     // Sequence number of the latest sample
+static dht_bus_subscriber_t bus_subscribers[DHT_BUS_MAX_SUBSCRIBERS];
+static portMUX_TYPE bus_subscribers_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Only taken by the producer: keeps the slot rewrite from being preempted,
+// so a reader on the same core never spins on a half-written slot
+static portMUX_TYPE bus_publish_lock = portMUX_INITIALIZER_UNLOCKED;
+
+dht_bus_subscriber_t *dht_bus_subscribe(void)
+{
+    SemaphoreHandle_t signal = xSemaphoreCreateBinary();
+    if (signal == NULL) {
+        ESP_LOGE(TAG, "Failed to create subscriber semaphore");
+        return NULL;
+    }
+
+    dht_bus_subscriber_t *sub = NULL;
+
+    taskENTER_CRITICAL(&bus_subscribers_lock);
+    for (int i = 0; i < DHT_BUS_MAX_SUBSCRIBERS; i++) {
+        if (!bus_subscribers[i].in_use) {
+            sub = &bus_subscribers[i];
+            // Start at the latest sample so a new subscriber gets a value right away
+            uint32_t head = atomic_load_explicit(&bus_head, memory_order_acquire);
+            sub->next_seq = (head > 0) ? head : 1;
+            sub->signal = signal;
+            sub->in_use = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&bus_subscribers_lock);
+
+    if (sub == NULL) {
+        ESP_LOGE(TAG, "No free subscriber slot (max %d)", DHT_BUS_MAX_SUBSCRIBERS);
+        vSemaphoreDelete(signal);
+    }
+    return sub;
+}
+
+void dht_bus_publish(const dht_data_t *data, int64_t timestamp_us)
+{
+    uint32_t seq = atomic_load_explicit(&bus_head, memory_order_relaxed) + 1;
+    dht_bus_slot_t *slot = &bus_slots[seq % DHT_BUS_CAPACITY];
+
+    taskENTER_CRITICAL(&bus_publish_lock);
+
+    // Invalidate the slot before overwriting it
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->sample.data = *data;
+    slot->sample.timestamp_us = timestamp_us;
+    slot->sample.seq = seq;
+
+    atomic_store_explicit(&slot->seq, seq, memory_order_release);
+    atomic_store_explicit(&bus_head, seq, memory_order_release);
+
+    taskEXIT_CRITICAL(&bus_publish_lock);
+
+    // Wake subscribers (xSemaphoreGive on a binary semaphore never blocks)
+    for (int i = 0; i < DHT_BUS_MAX_SUBSCRIBERS; i++) {
+        if (bus_subscribers[i].in_use) {
+            xSemaphoreGive(bus_subscribers[i].signal);
+        }
+    }
+}
+
+esp_err_t dht_bus_receive(dht_bus_subscriber_t *sub, dht_sample_t *sample, TickType_t timeout)
+{
+    if (sub == NULL || sample == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    while (1) {
+        uint32_t head = atomic_load_explicit(&bus_head, memory_order_acquire);
+
+        if (head < sub->next_seq) {
+            // Nothing new, wait for the next publish
+            if (xSemaphoreTake(sub->signal, timeout) != pdTRUE) {
+                return ESP_ERR_TIMEOUT;
+            }
+            continue;
+        }
+
+        // Skip samples that have already been overwritten
+        if (head - sub->next_seq >= DHT_BUS_CAPACITY) {
+            sub->next_seq = head - DHT_BUS_CAPACITY + 1;
+        }
+
+        dht_bus_slot_t *slot = &bus_slots[sub->next_seq % DHT_BUS_CAPACITY];
+        uint32_t before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (before != sub->next_seq) {
+            // Slot is being rewritten with a newer sample, re-evaluate the head
+            continue;
+        }
+
+        *sample = slot->sample;
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != before) {
+            continue;
+        }
+
+        sub->next_seq++;
+        return ESP_OK;
+    }
+}
@@ -0,0 +1,47 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dht_decoder.h"
+
+esp_err_t dht_decode_pulses(const dht_pulse_t *pulses, size_t count, float *humidity, float *temperature)
+{
+    if (pulses == NULL || humidity == NULL || temperature == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Drop the trailing low phase that ends the transmission (no high phase follows)
+    while (count > 0 && pulses[count - 1].high_us == 0) {
+        count--;
+    }
+
+    if (count < DHT_DATA_BITS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Data bits are the last 40 pulses, anything before is start signal and response
+    const dht_pulse_t *bits = &pulses[count - DHT_DATA_BITS];
+    uint8_t data[5] = {0};
+
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        if (bits[i].low_us > DHT_PULSE_MAX_US || bits[i].high_us > DHT_PULSE_MAX_US) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (bits[i].high_us > DHT_BIT_THRESHOLD_US) {
+            data[i / 8] |= (uint8_t)(1 << (7 - (i % 8)));
+        }
+    }
+
+    // Verify checksum
+    uint8_t checksum = data[0] + data[1] + data[2] + data[3];
+    if (checksum != data[4]) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    // Parse data (DHT22/AM2301 format)
+    *humidity = ((data[0] << 8) | data[1]) / 10.0f;
+    int16_t temp_raw = ((data[2] & 0x7F) << 8) | data[3];
+    if (data[2] & 0x80) temp_raw = -temp_raw;
+    *temperature = temp_raw / 10.0f;
+
+    return ESP_OK;
+}
@@ -4,213 +4,399 @@
 #include <esp_err.h>
 #include <esp_log.h>
 #include <esp_rom_sys.h>
+#include <esp_timer.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
 #include <driver/gpio.h>
+#if CONFIG_DHT_CAPTURE_RMT
+#include <driver/rmt_rx.h>
+#endif
 
 #include "dht_reader.h"
-#include "sdkconfig.h"
+#include "dht_decoder.h"
+#include "dht_bus.h"
 
 static const char *TAG = "dht_reader";
 
 #define DHT_DATA_GPIO CONFIG_DHT_DATA_GPIO
 
-static QueueHandle_t dht_queue = NULL;
+// Consecutive failed reads after which a sensor is reported as faulty
+#define DHT_FAILURE_WARN_THRESHOLD 5
+
+typedef struct {
+    gpio_num_t pin;
+    uint32_t consecutive_failures;
+    uint32_t reads;
+    uint32_t failures;
+} dht_sensor_t;
+
+static bool dht_initialized = false;
+static dht_sensor_t dht_sensors[DHT_MAX_SENSORS];
+static size_t dht_sensor_count = 0;
+
+#if CONFIG_DHT_CAPTURE_RMT
 
-// Simple DHT22 read - bypassing the library entirely
-static esp_err_t simple_dht_read(gpio_num_t pin, float *humidity, float *temperature)
+// RMT capture: 1 tick = 1 us, room for start signal, response, 40 bits and end marker
+#define DHT_RMT_RESOLUTION_HZ 1000000
+#define DHT_RMT_MEM_SYMBOLS 64
+#define DHT_RMT_CAPTURE_TIMEOUT_MS 20
+
+static QueueHandle_t dht_rx_done_queue = NULL;
+static rmt_symbol_word_t dht_rx_symbols[DHT_RMT_MEM_SYMBOLS];
+
+/**
+ * RMT receive-done callback (ISR context)
+ * Hands the captured symbols to the reading task
+ */
+static bool IRAM_ATTR dht_rmt_rx_done(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata, void *user_ctx)
 {
-    uint8_t data[5] = {0};
+    BaseType_t high_task_wakeup = pdFALSE;
+    xQueueSendFromISR((QueueHandle_t)user_ctx, edata, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
+
+static esp_err_t dht_capture_init(void)
+{
+    dht_rx_done_queue = xQueueCreate(1, sizeof(rmt_rx_done_event_data_t));
+    return (dht_rx_done_queue != NULL) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/**
+ * Create and enable an RMT RX channel on the given pin
+ * Sensors are read one at a time, so a single channel is moved from pin to
+ * pin instead of holding one of the few RX channels per sensor.
+ */
+static esp_err_t dht_capture_open(gpio_num_t pin, rmt_channel_handle_t *channel)
+{
+    rmt_rx_channel_config_t rx_config = {
+        .gpio_num = pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = DHT_RMT_RESOLUTION_HZ,
+        .mem_block_symbols = DHT_RMT_MEM_SYMBOLS,
+    };
+    esp_err_t ret = rmt_new_rx_channel(&rx_config, channel);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    rmt_rx_event_callbacks_t cbs = {
+        .on_recv_done = dht_rmt_rx_done,
+    };
+    ret = rmt_rx_register_event_callbacks(*channel, &cbs, dht_rx_done_queue);
+    if (ret == ESP_OK) {
+        ret = rmt_enable(*channel);
+    }
+    if (ret != ESP_OK) {
+        rmt_del_channel(*channel);
+        *channel = NULL;
+    }
+    return ret;
+}
+
+static void dht_capture_close(rmt_channel_handle_t channel)
+{
+    rmt_disable(channel);
+    rmt_del_channel(channel);
+}
+
+/**
+ * Convert RMT symbols into low/high pulse pairs
+ * A low phase opens a new pulse, the following high phase completes it.
+ * A leading high phase (line released before the sensor answers) is skipped.
+ */
+static size_t dht_symbols_to_pulses(const rmt_symbol_word_t *symbols, size_t num_symbols,
+                                    dht_pulse_t *pulses, size_t max_pulses)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < num_symbols; i++) {
+        const uint16_t levels[2] = {symbols[i].level0, symbols[i].level1};
+        const uint16_t durations[2] = {symbols[i].duration0, symbols[i].duration1};
+
+        for (int half = 0; half < 2; half++) {
+            if (durations[half] == 0) {
+                // End marker
+                return count;
+            }
+            if (levels[half] == 0) {
+                if (count == max_pulses) {
+                    return count;
+                }
+                pulses[count].low_us = durations[half];
+                pulses[count].high_us = 0;
+                count++;
+            } else if (count > 0 && pulses[count - 1].high_us == 0) {
+                pulses[count - 1].high_us = durations[half];
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * DHT22 read using RMT capture
+ * The pulse train is recorded by hardware while the task sleeps, so no
+ * interrupts are disabled and WiFi/lwIP keep running on this core.
+ */
+static esp_err_t dht_read(gpio_num_t pin, float *humidity, float *temperature)
+{
+    rmt_receive_config_t receive_config = {
+        .signal_range_min_ns = 1000,     // Ignore glitches shorter than 1 us
+        .signal_range_max_ns = 200000,   // Line idle for 200 us ends the frame
+    };
+    rmt_rx_done_event_data_t rx_data;
+    dht_pulse_t pulses[DHT_RMT_MEM_SYMBOLS];
+    rmt_channel_handle_t channel = NULL;
+
+    esp_err_t ret = dht_capture_open(pin, &channel);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Opening the channel routes the pin as a plain input: make it an open-drain
+    // output again (the input path stays connected to the RMT) to drive the start pulse
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_pull_mode(pin, GPIO_PULLUP_ONLY);
+
+    // Drop a stale capture left over from a previous timeout
+    xQueueReset(dht_rx_done_queue);
+
+    // Send start signal: pull low for 20ms, then release
+    gpio_set_level(pin, 0);
+    vTaskDelay(pdMS_TO_TICKS(20));
+
+    ret = rmt_receive(channel, dht_rx_symbols, sizeof(dht_rx_symbols), &receive_config);
+    gpio_set_level(pin, 1);
+
+    // Sleep until the hardware has captured the whole frame (~5 ms)
+    if (ret == ESP_OK &&
+        xQueueReceive(dht_rx_done_queue, &rx_data, pdMS_TO_TICKS(DHT_RMT_CAPTURE_TIMEOUT_MS)) != pdTRUE) {
+        ret = ESP_ERR_TIMEOUT;
+    }
+    dht_capture_close(channel);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    size_t count = dht_symbols_to_pulses(rx_data.received_symbols, rx_data.num_symbols,
+                                         pulses, DHT_RMT_MEM_SYMBOLS);
+    return dht_decode_pulses(pulses, count, humidity, temperature);
+}
+
+#else // CONFIG_DHT_CAPTURE_RMT
+
+static esp_err_t dht_capture_init(void)
+{
+    return ESP_OK;
+}
+
+/**
+ * Busy-wait until the line leaves the given level
+ * @return Time spent at the level in us, or -1 on timeout
+ */
+static int dht_wait_level(gpio_num_t pin, int level)
+{
+    int elapsed = 0;
+    while (gpio_get_level(pin) == level) {
+        if (elapsed >= DHT_PULSE_MAX_US) {
+            return -1;
+        }
+        esp_rom_delay_us(1);
+        elapsed++;
+    }
+    return elapsed;
+}
+
+/**
+ * DHT22 read by polling the GPIO
+ * Fallback for targets without RMT: disables interrupts for ~5 ms per read.
+ */
+static esp_err_t dht_read(gpio_num_t pin, float *humidity, float *temperature)
+{
+    dht_pulse_t pulses[DHT_DATA_BITS + 1];
     
     // Send start signal: pull low for 20ms, then high
-    gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
     gpio_set_level(pin, 0);
     vTaskDelay(pdMS_TO_TICKS(20));
     gpio_set_level(pin, 1);
-    esp_rom_delay_us(30); // Wait 30us before switching to input
-    
-    // Switch to input and wait for response
-    gpio_set_direction(pin, GPIO_MODE_INPUT);
+    esp_rom_delay_us(30); // Wait 30us before sampling the response
     
     // Disable interrupts during critical timing section to prevent WiFi interference
     portDISABLE_INTERRUPTS();
     
     // Wait for DHT to pull low (response signal)
-    int timeout = 100;
-    while (gpio_get_level(pin) == 1 && timeout > 0) {
-        esp_rom_delay_us(1);
-        timeout--;
-    }
-    if (timeout == 0) {
-        portENABLE_INTERRUPTS();
-        return ESP_ERR_TIMEOUT;
+    esp_err_t ret = ESP_OK;
+    if (dht_wait_level(pin, 1) < 0) {
+        ret = ESP_ERR_TIMEOUT;
     }
     
-    // Wait for DHT to release (go high)
-    timeout = 100;
-    while (gpio_get_level(pin) == 0 && timeout > 0) {
-        esp_rom_delay_us(1);
-        timeout--;
-    }
-    if (timeout == 0) {
-        portENABLE_INTERRUPTS();
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    // Wait for DHT to pull low again (start of data)
-    timeout = 100;
-    while (gpio_get_level(pin) == 1 && timeout > 0) {
-        esp_rom_delay_us(1);
-        timeout--;
-    }
-    if (timeout == 0) {
-        portENABLE_INTERRUPTS();
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    // Read 40 bits of data
-    for (int i = 0; i < 40; i++) {
-        // Wait for high
-        timeout = 100;
-        while (gpio_get_level(pin) == 0 && timeout > 0) {
-            esp_rom_delay_us(1);
-            timeout--;
-        }
-        if (timeout == 0) {
-            portENABLE_INTERRUPTS();
-            return ESP_ERR_TIMEOUT;
-        }
-        
-        // Measure high pulse duration
-        int high_time = 0;
-        while (gpio_get_level(pin) == 1 && high_time < 100) {
-            esp_rom_delay_us(1);
-            high_time++;
-        }
-        
-        // High pulse > 40us means 1, otherwise 0
-        int byte_idx = i / 8;
-        int bit_idx = 7 - (i % 8);
-        if (high_time > 40) {
-            data[byte_idx] |= (1 << bit_idx);
+    // Response pulse followed by 40 data bits
+    for (int i = 0; ret == ESP_OK && i < DHT_DATA_BITS + 1; i++) {
+        int low_us = dht_wait_level(pin, 0);
+        int high_us = dht_wait_level(pin, 1);
+        if (low_us < 0 || high_us < 0) {
+            ret = ESP_ERR_TIMEOUT;
+            break;
         }
+        pulses[i].low_us = low_us;
+        pulses[i].high_us = high_us;
     }
     
     // Re-enable interrupts after critical timing section
     portENABLE_INTERRUPTS();
     
-    // Verify checksum
-    uint8_t checksum = data[0] + data[1] + data[2] + data[3];
-    if (checksum != data[4]) {
-        ESP_LOGD(TAG, "Checksum failed: %d != %d (data: %02X %02X %02X %02X %02X)", 
-                 checksum, data[4], data[0], data[1], data[2], data[3], data[4]);
-        return ESP_ERR_INVALID_CRC;
+    if (ret != ESP_OK) {
+        return ret;
     }
     
-    // Parse data (DHT22/AM2301 format)
-    *humidity = ((data[0] << 8) | data[1]) / 10.0f;
-    int16_t temp_raw = ((data[2] & 0x7F) << 8) | data[3];
-    if (data[2] & 0x80) temp_raw = -temp_raw;
-    *temperature = temp_raw / 10.0f;
+    return dht_decode_pulses(pulses, DHT_DATA_BITS + 1, humidity, temperature);
+}
+
+#endif // CONFIG_DHT_CAPTURE_RMT
+
+/**
+ * Read one sensor and publish the result
+ * A failed read is not retried immediately; the sensor gets its next
+ * attempt in its next slot so the schedule of the other sensors holds.
+ */
+static void dht_read_sensor(uint8_t sensor_id)
+{
+    dht_sensor_t *sensor = &dht_sensors[sensor_id];
+    float humidity = 0, temperature = 0;
     
-    return ESP_OK;
+    esp_err_t result = dht_read(sensor->pin, &humidity, &temperature);
+    sensor->reads++;
+    if (result == ESP_OK)
+    {
+        sensor->consecutive_failures = 0;
+        
+        // Publishing never blocks, so slow consumers cannot shift the schedule
+        dht_data_t sensor_data = {humidity, temperature, sensor_id};
+        dht_bus_publish(&sensor_data, esp_timer_get_time());
+        return;
+    }
+    
+    sensor->consecutive_failures++;
+    sensor->failures++;
+    ESP_LOGW(TAG, "DHT %d (GPIO %d) read failed: %s (consecutive failures: %" PRIu32 ")",
+             sensor_id, sensor->pin, esp_err_to_name(result), sensor->consecutive_failures);
+    
+    // If too many consecutive failures, sensor might be disconnected
+    if (sensor->consecutive_failures == DHT_FAILURE_WARN_THRESHOLD)
+    {
+        ESP_LOGE(TAG, "WARNING: DHT %d may be disconnected or faulty!", sensor_id);
+    }
 }
 
-void dht_task(void *pvParameters)
+/**
+ * Scheduler task
+ * Reads the sensors round-robin, one per slot. The read interval is split
+ * into equal slots so reads never overlap and every sensor is read exactly
+ * once per DHT_MIN_READ_INTERVAL_MS, regardless of the number of sensors.
+ */
+static void dht_task(void *pvParameters)
 {
-    gpio_num_t pin = DHT_DATA_GPIO;
-    ESP_LOGI(TAG, "DHT task started on GPIO %d", pin);
+    ESP_LOGI(TAG, "DHT task started with %zu sensor(s)", dht_sensor_count);
     
-    // Configure GPIO with pull-up
-    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT_OD);
-    gpio_set_pull_mode(pin, GPIO_PULLUP_ONLY);
-    gpio_set_level(pin, 1);
+    // Configure capture backend, then idle the lines high: open drain with pull-up
+    // (the RMT backend re-applies this per read, after opening its channel)
+    esp_err_t init_ret = dht_capture_init();
+    if (init_ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize DHT capture: %s", esp_err_to_name(init_ret));
+        vTaskDelete(NULL);
+        return;
+    }
+    for (size_t i = 0; i < dht_sensor_count; i++)
+    {
+        gpio_set_direction(dht_sensors[i].pin, GPIO_MODE_INPUT_OUTPUT_OD);
+        gpio_set_pull_mode(dht_sensors[i].pin, GPIO_PULLUP_ONLY);
+        gpio_set_level(dht_sensors[i].pin, 1);
+    }
     
-    // Wait for sensor to stabilize after power-on
+    // Wait for sensors to stabilize after power-on
     vTaskDelay(pdMS_TO_TICKS(2000));
     
-    const int MAX_RETRIES = 3;
-    int consecutive_failures = 0;
+    // Round the slot up so N slots never add up to less than the minimum interval
+    const TickType_t interval = pdMS_TO_TICKS(DHT_MIN_READ_INTERVAL_MS);
+    const TickType_t slot = (interval + dht_sensor_count - 1) / dht_sensor_count;
+    TickType_t last_wake = xTaskGetTickCount();
+    uint8_t next_sensor = 0;
     
     while (1)
     {
-        float humidity = 0, temperature = 0;
-        esp_err_t result = ESP_FAIL;
-        
-        // Retry mechanism: try up to MAX_RETRIES times
-        for (int retry = 0; retry < MAX_RETRIES; retry++)
-        {
-            result = simple_dht_read(pin, &humidity, &temperature);
-            
-            if (result == ESP_OK)
-            {
-                // Success! Reset failure counter
-                consecutive_failures = 0;
-                
-                dht_data_t sensor_data = {humidity, temperature};
-                
-                if (dht_queue != NULL)
-                {
-                    xQueueSend(dht_queue, &sensor_data, portMAX_DELAY);
-                }
-                break; // Exit retry loop on success
-            }
-            else
-            {
-                // Only log on first attempt to reduce spam
-                if (retry == 0)
-                {
-                    ESP_LOGW(TAG, "DHT read failed: %s, retrying...", esp_err_to_name(result));
-                }
-                
-                // Wait a bit before retrying (DHT needs time between attempts)
-                if (retry < MAX_RETRIES - 1)
-                {
-                    vTaskDelay(pdMS_TO_TICKS(500));
-                }
-            }
-        }
-        
-        // If all retries failed
-        if (result != ESP_OK)
-        {
-            consecutive_failures++;
-            ESP_LOGE(TAG, "DHT read failed after %d retries (consecutive failures: %d)", 
-                     MAX_RETRIES, consecutive_failures);
-            
-            // If too many consecutive failures, sensor might be disconnected
-            if (consecutive_failures >= 5)
-            {
-                ESP_LOGE(TAG, "WARNING: DHT sensor may be disconnected or faulty!");
-            }
-        }
+        dht_read_sensor(next_sensor);
+        next_sensor = (next_sensor + 1) % dht_sensor_count;
         
-        // DHT sensors need at least 2 seconds between reads
-        vTaskDelay(pdMS_TO_TICKS(2000));
+        xTaskDelayUntil(&last_wake, slot);
     }
 }
 
-QueueHandle_t dht_init(void)
+esp_err_t dht_init_multi(const gpio_num_t *pins, size_t count)
 {
-    ESP_LOGI(TAG, "Initializing DHT reader on GPIO %d", DHT_DATA_GPIO);
+    if (pins == NULL || count == 0 || count > DHT_MAX_SENSORS)
+    {
+        ESP_LOGE(TAG, "Invalid sensor list (count: %zu, max: %d)", count, DHT_MAX_SENSORS);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (dht_initialized)
+    {
+        ESP_LOGW(TAG, "DHT reader already initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
     
-    // Create a queue to hold dht_data_t
-    dht_queue = xQueueCreate(1, sizeof(dht_data_t));
-    if (dht_queue == NULL)
+    for (size_t i = 0; i < count; i++)
     {
-        ESP_LOGE(TAG, "Failed to create DHT queue");
-        return NULL;
+        if (!GPIO_IS_VALID_OUTPUT_GPIO(pins[i]))
+        {
+            ESP_LOGE(TAG, "Invalid DHT GPIO: %d", pins[i]);
+            return ESP_ERR_INVALID_ARG;
+        }
+        dht_sensors[i].pin = pins[i];
+        dht_sensors[i].consecutive_failures = 0;
+        dht_sensors[i].reads = 0;
+        dht_sensors[i].failures = 0;
+        ESP_LOGI(TAG, "Initializing DHT %zu on GPIO %d", i, pins[i]);
     }
+    dht_sensor_count = count;
     
-    // Create the DHT reading task
+    // Create the DHT scheduler task
     BaseType_t ret = xTaskCreate(dht_task, "dht_task", 4096, NULL, 5, NULL);
     if (ret != pdPASS)
     {
         ESP_LOGE(TAG, "Failed to create DHT task");
-        vQueueDelete(dht_queue);
-        return NULL;
+        return ESP_FAIL;
     }
     
+    dht_initialized = true;
     ESP_LOGI(TAG, "DHT reader initialized successfully");
-    return dht_queue;
+    return ESP_OK;
+}
+
+esp_err_t dht_init(void)
+{
+    const gpio_num_t pin = DHT_DATA_GPIO;
+    return dht_init_multi(&pin, 1);
 }
 
+size_t dht_get_sensor_count(void)
+{
+    return dht_initialized ? dht_sensor_count : 0;
+}
 
+esp_err_t dht_get_stats(uint8_t sensor_id, dht_stats_t *stats)
+{
+    if (stats == NULL || !dht_initialized || sensor_id >= dht_sensor_count)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    const dht_sensor_t *sensor = &dht_sensors[sensor_id];
+    stats->reads = sensor->reads;
+    stats->failures = sensor->failures;
+    stats->consecutive_failures = sensor->consecutive_failures;
+    return ESP_OK;
+}
@@ -0,0 +1,57 @@
+#ifndef DHT_BUS_H
+#define DHT_BUS_H
+
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <esp_err.h>
+
+#include "dht_reader.h"
+
+// Number of samples kept on the bus; slower subscribers lose the oldest ones
+#define DHT_BUS_CAPACITY 16
+
+// Maximum number of concurrent subscribers
+#define DHT_BUS_MAX_SUBSCRIBERS 6
+
+/**
+ * Sample as published on the bus
+ */
+typedef struct {
+    dht_data_t data;
+    int64_t timestamp_us;   // esp_timer time of the capture (monotonic)
+    uint32_t seq;           // Publish sequence number, starts at 1 and has no gaps
+} dht_sample_t;
+
+typedef struct dht_bus_subscriber dht_bus_subscriber_t;
+
+/**
+ * Register a new subscriber
+ * Each subscriber has its own read cursor, starting at the latest sample.
+ *
+ * @return Subscriber handle, NULL if all slots are taken
+ */
+dht_bus_subscriber_t *dht_bus_subscribe(void);
+
+/**
+ * Get the next sample for a subscriber
+ * If the subscriber fell more than DHT_BUS_CAPACITY samples behind, the
+ * overwritten samples are skipped; the gap is visible in sample->seq.
+ *
+ * @param sub Subscriber handle
+ * @param sample Receives the sample
+ * @param timeout Time to wait for a new sample
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL arguments,
+ *         ESP_ERR_TIMEOUT if no new sample arrived in time
+ */
+esp_err_t dht_bus_receive(dht_bus_subscriber_t *sub, dht_sample_t *sample, TickType_t timeout);
+
+/**
+ * Publish a sample (single producer: the DHT scheduler task)
+ * Never blocks; subscribers that are behind lose their oldest samples.
+ *
+ * @param data Sensor reading
+ * @param timestamp_us esp_timer time of the capture
+ */
+void dht_bus_publish(const dht_data_t *data, int64_t timestamp_us);
+
+#endif // DHT_BUS_H
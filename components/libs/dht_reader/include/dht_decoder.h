@@ -0,0 +1,46 @@
+#ifndef DHT_DECODER_H
+#define DHT_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+// Number of data bits in one DHT transmission (16 humidity, 16 temperature, 8 checksum)
+#define DHT_DATA_BITS 40
+
+// High pulses longer than this are decoded as 1 (typical: 26-28 us = 0, 70 us = 1)
+#define DHT_BIT_THRESHOLD_US 40
+
+// Any low or high phase longer than this is not part of a valid transmission
+#define DHT_PULSE_MAX_US 100
+
+/**
+ * One low/high phase pair of the DHT data line, in microseconds.
+ * Every bit starts with a ~50 us low phase; the length of the following
+ * high phase encodes the bit value.
+ */
+typedef struct {
+    uint16_t low_us;
+    uint16_t high_us;
+} dht_pulse_t;
+
+/**
+ * @brief Decode a captured DHT22/AM2301 pulse train
+ *
+ * The capture may contain leading pulses (host start signal, sensor response)
+ * and a trailing unterminated low phase (high_us == 0); only the last
+ * DHT_DATA_BITS complete pulses are decoded. The function has no hardware
+ * dependencies so it can be built and run on the host.
+ *
+ * @param pulses Captured pulses in line order
+ * @param count Number of entries in pulses
+ * @param humidity Receives relative humidity in %
+ * @param temperature Receives temperature in °C
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL arguments,
+ *         ESP_ERR_INVALID_SIZE if fewer than DHT_DATA_BITS pulses were captured,
+ *         ESP_ERR_INVALID_RESPONSE if a pulse is out of range,
+ *         ESP_ERR_INVALID_CRC on checksum mismatch
+ */
+esp_err_t dht_decode_pulses(const dht_pulse_t *pulses, size_t count, float *humidity, float *temperature);
+
+#endif // DHT_DECODER_H
@@ -1,15 +1,68 @@
 #ifndef DHT_READER_H
 #define DHT_READER_H
 
-#include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
+#include <stdint.h>
 #include <esp_err.h>
+#include <driver/gpio.h>
+
+// Maximum number of sensors handled by the scheduler
+#define DHT_MAX_SENSORS 8
+
+// DHT sensors need at least 2 seconds between reads
+#define DHT_MIN_READ_INTERVAL_MS 2000
 
 typedef struct {
     float humidity;
     float temperature;
+    uint8_t sensor_id;      // Index of the sensor's pin in dht_init_multi()
 } dht_data_t;
 
-QueueHandle_t dht_init(void);
+/**
+ * Read counters of one sensor since start
+ */
+typedef struct {
+    uint32_t reads;                 // Read attempts
+    uint32_t failures;              // Failed reads (timeout, checksum, ...)
+    uint32_t consecutive_failures;  // Failed reads since the last good one
+} dht_stats_t;
+
+/**
+ * Start reading a single sensor on CONFIG_DHT_DATA_GPIO
+ * Samples are published on the sample bus (see dht_bus.h).
+ * 
+ * @return ESP_OK on success
+ */
+esp_err_t dht_init(void);
+
+/**
+ * Start reading several sensors from one scheduler task
+ * Reads are staggered evenly over DHT_MIN_READ_INTERVAL_MS, so they never
+ * overlap and every sensor is read once per interval.
+ * 
+ * Samples are published on the sample bus (see dht_bus.h).
+ * 
+ * @param pins Data GPIO of each sensor; the array index becomes the sensor ID
+ * @param count Number of sensors (1..DHT_MAX_SENSORS)
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad pin list,
+ *         ESP_ERR_INVALID_STATE if already initialized
+ */
+esp_err_t dht_init_multi(const gpio_num_t *pins, size_t count);
+
+/**
+ * Get the number of sensors being read
+ * 
+ * @return Sensor count, 0 before initialization
+ */
+size_t dht_get_sensor_count(void);
+
+/**
+ * Get the read counters of a sensor
+ * Counters are updated by the reader task; each one is read atomically.
+ * 
+ * @param sensor_id Sensor ID
+ * @param stats Receives the counters
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on an unknown sensor
+ */
+esp_err_t dht_get_stats(uint8_t sensor_id, dht_stats_t *stats);
 
 #endif
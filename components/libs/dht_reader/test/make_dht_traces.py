@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Write the DHT22 pulse trace corpus of the decoder test.
+
+  make_dht_traces.py > dht_traces.txt
+
+Traces follow the datasheet timing (80/80 us response, 50 us low per
+bit, 26-28 us high for 0 and 70 us for 1) with capture jitter, and the
+faults seen on a loaded system: flipped bits, stretched phases, lost
+tails and glitches splitting a phase. The expected result of each trace
+comes from a reference decoder written from the datasheet, independent
+of dht_decoder.c. Traces recorded on hardware can be appended in the
+same format.
+"""
+import random
+
+PULSE_MAX_US = 100
+THRESHOLD_US = 40
+
+
+def reference_decode(pulses):
+    """Return ('ok', humidity, temperature) or the expected error."""
+    while pulses and pulses[-1][1] == 0:
+        pulses = pulses[:-1]
+    if len(pulses) < 40:
+        return ('size',)
+    bits = pulses[-40:]
+    if any(low > PULSE_MAX_US or high > PULSE_MAX_US for low, high in bits):
+        return ('response',)
+    value = 0
+    for _, high in bits:
+        value = (value << 1) | (high > THRESHOLD_US)
+    data = value.to_bytes(5, 'big')
+    if (sum(data[:4]) & 0xff) != data[4]:
+        return ('crc',)
+    humidity = ((data[0] << 8) | data[1]) / 10
+    temperature = (((data[2] & 0x7f) << 8) | data[3]) / 10
+    if data[2] & 0x80:
+        temperature = -temperature
+    return ('ok', humidity, temperature)
+
+
+def frame(rng, humidity, temperature):
+    raw_h = round(humidity * 10)
+    raw_t = round(abs(temperature) * 10) | (0x8000 if temperature < 0 else 0)
+    data = [raw_h >> 8, raw_h & 0xff, raw_t >> 8, raw_t & 0xff]
+    data.append(sum(data) & 0xff)
+    return [(byte >> (7 - i)) & 1 for byte in data for i in range(8)]
+
+
+def trace(rng, bits, jitter):
+    def j(us):
+        return max(1, us + rng.randint(-jitter, jitter))
+    pulses = [(j(80), j(80))]
+    pulses += [(j(50), j(70) if bit else j(rng.choice((26, 27, 28)))) for bit in bits]
+    # The line goes low once more before it is released; no high phase follows
+    pulses.append((j(50), 0))
+    return pulses
+
+
+def main():
+    rng = random.Random(22)
+    lines = []
+
+    def add(label, pulses):
+        expect = reference_decode(pulses)
+        values = ' %.1f %.1f' % expect[1:] if expect[0] == 'ok' else ''
+        lines.append('%s %s%s : %s' % (label, expect[0], values,
+                                       ' '.join('%d,%d' % p for p in pulses)))
+
+    def reading():
+        return rng.randint(0, 1000) / 10, rng.randint(-400, 800) / 10
+
+    for _ in range(120):
+        add('clean', trace(rng, frame(rng, *reading()), 3))
+    for _ in range(30):
+        # Heavy jitter: a 0 can stretch past the threshold
+        add('loaded', trace(rng, frame(rng, *reading()), 14))
+    for _ in range(15):
+        bits = frame(rng, *reading())
+        bits[rng.randrange(32)] ^= 1
+        add('flip', trace(rng, bits, 3))
+    for _ in range(15):
+        pulses = trace(rng, frame(rng, *reading()), 3)
+        i = rng.randrange(1, 41)
+        pulses[i] = (pulses[i][0], rng.randint(101, 400)) if rng.random() < 0.5 else (rng.randint(101, 400), pulses[i][1])
+        add('stretch', pulses)
+    for _ in range(15):
+        pulses = trace(rng, frame(rng, *reading()), 3)
+        add('truncated', pulses[:rng.randrange(5, 41)])
+    for _ in range(15):
+        pulses = trace(rng, frame(rng, *reading()), 3)
+        # A short spike splits a high phase in two
+        i = rng.randrange(1, 41)
+        low, high = pulses[i]
+        cut = rng.randint(2, max(2, high - 2))
+        pulses[i:i + 1] = [(low, cut), (1, max(1, high - cut - 1))]
+        add('glitch', pulses)
+
+    print('# DHT22 pulse traces for test_dht_decoder, written by make_dht_traces.py')
+    print('# <label> <expected: ok humidity temperature | size | response | crc> : <low_us>,<high_us> ...')
+    print('\n'.join(lines))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,3 @@
+// Configuration of the scheduler test: the polling backend is simulated
+#define CONFIG_DHT_DATA_GPIO 4
+#define CONFIG_DHT_CAPTURE_RMT 0
@@ -0,0 +1,225 @@
+/**
+ * Host test and benchmark of the DHT pulse decoder
+ * Every trace of the corpus (dht_traces.txt, see make_dht_traces.py) must
+ * decode to its expected result; the decode failure rate is reported per
+ * kind of trace, then the decode cost is measured over the whole corpus.
+ */
+#include "dht_decoder.h"
+#include "host_test.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAX_PULSES 64
+#define MAX_TRACES 1024
+#define MAX_LABELS 16
+#define BENCH_ROUNDS 2000
+
+typedef struct {
+    char label[16];
+    esp_err_t expect;
+    float humidity;
+    float temperature;
+    dht_pulse_t pulses[TRACE_MAX_PULSES];
+    size_t count;
+} trace_t;
+
+typedef struct {
+    char label[16];
+    int traces;
+    int failed;
+} label_stats_t;
+
+static trace_t traces[MAX_TRACES];
+static size_t trace_count;
+
+static esp_err_t parse_expect(const char *word)
+{
+    if (strcmp(word, "ok") == 0) return ESP_OK;
+    if (strcmp(word, "size") == 0) return ESP_ERR_INVALID_SIZE;
+    if (strcmp(word, "response") == 0) return ESP_ERR_INVALID_RESPONSE;
+    if (strcmp(word, "crc") == 0) return ESP_ERR_INVALID_CRC;
+    return ESP_FAIL;
+}
+
+/**
+ * Parse one corpus line: <label> <expected> [<humidity> <temperature>] : <low>,<high> ...
+ */
+static bool parse_trace(char *line, trace_t *trace)
+{
+    char *pulses = strchr(line, ':');
+    if (pulses == NULL) {
+        return false;
+    }
+    *pulses++ = '\0';
+
+    char expect[16];
+    int fields = sscanf(line, "%15s %15s %f %f", trace->label, expect, &trace->humidity, &trace->temperature);
+    if (fields < 2) {
+        return false;
+    }
+    trace->expect = parse_expect(expect);
+    if (trace->expect == ESP_FAIL || (trace->expect == ESP_OK && fields != 4)) {
+        return false;
+    }
+
+    trace->count = 0;
+    unsigned low, high;
+    int used;
+    while (sscanf(pulses, " %u,%u%n", &low, &high, &used) == 2) {
+        if (trace->count == TRACE_MAX_PULSES) {
+            return false;
+        }
+        trace->pulses[trace->count++] = (dht_pulse_t){ .low_us = low, .high_us = high };
+        pulses += used;
+    }
+    return true;
+}
+
+static void load_corpus(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        exit(1);
+    }
+    char line[2048];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        CHECK(trace_count < MAX_TRACES);
+        if (trace_count == MAX_TRACES) {
+            break;
+        }
+        if (!parse_trace(line, &traces[trace_count])) {
+            fprintf(stderr, "%s:%d: malformed trace\n", path, line_no);
+            host_test_failures++;
+            continue;
+        }
+        trace_count++;
+    }
+    fclose(file);
+    CHECK(trace_count > 0);
+}
+
+static label_stats_t *stats_for(label_stats_t *stats, int *count, const char *label)
+{
+    for (int i = 0; i < *count; i++) {
+        if (strcmp(stats[i].label, label) == 0) {
+            return &stats[i];
+        }
+    }
+    if (*count == MAX_LABELS) {
+        return NULL;
+    }
+    label_stats_t *entry = &stats[(*count)++];
+    // Labels come from trace_t.label, which has the same size
+    strcpy(entry->label, label);
+    entry->traces = 0;
+    entry->failed = 0;
+    return entry;
+}
+
+static void test_corpus(void)
+{
+    label_stats_t stats[MAX_LABELS];
+    int label_count = 0;
+
+    for (size_t i = 0; i < trace_count; i++) {
+        const trace_t *trace = &traces[i];
+        float humidity = NAN, temperature = NAN;
+        esp_err_t err = dht_decode_pulses(trace->pulses, trace->count, &humidity, &temperature);
+
+        if (err != trace->expect) {
+            fprintf(stderr, "trace %zu (%s): got %s, expected %s\n", i + 1, trace->label,
+                    esp_err_to_name(err), esp_err_to_name(trace->expect));
+        }
+        CHECK(err == trace->expect);
+        if (err == ESP_OK && trace->expect == ESP_OK) {
+            // The corpus holds values to 0.1, the decoder divides the raw tenths
+            CHECK(fabsf(humidity - trace->humidity) < 0.05f);
+            CHECK(fabsf(temperature - trace->temperature) < 0.05f);
+        }
+
+        label_stats_t *entry = stats_for(stats, &label_count, trace->label);
+        CHECK(entry != NULL);
+        if (entry != NULL) {
+            entry->traces++;
+            entry->failed += err != ESP_OK;
+        }
+    }
+
+    printf("decode failure rate over %zu traces:\n", trace_count);
+    for (int i = 0; i < label_count; i++) {
+        printf("  %-10s %3d/%3d (%5.1f %%)\n", stats[i].label, stats[i].failed, stats[i].traces,
+               100.0 * stats[i].failed / stats[i].traces);
+    }
+}
+
+static void test_edge_cases(void)
+{
+    float humidity, temperature;
+    dht_pulse_t pulses[DHT_DATA_BITS + 1] = {0};
+
+    CHECK(dht_decode_pulses(NULL, 0, &humidity, &temperature) == ESP_ERR_INVALID_ARG);
+    CHECK(dht_decode_pulses(pulses, DHT_DATA_BITS, NULL, &temperature) == ESP_ERR_INVALID_ARG);
+    CHECK(dht_decode_pulses(pulses, DHT_DATA_BITS, &humidity, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(dht_decode_pulses(pulses, 0, &humidity, &temperature) == ESP_ERR_INVALID_SIZE);
+
+    // 40 pulses of 50/26 us: all bits 0, checksum 0 matches
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        pulses[i] = (dht_pulse_t){ .low_us = 50, .high_us = 26 };
+    }
+    CHECK(dht_decode_pulses(pulses, DHT_DATA_BITS, &humidity, &temperature) == ESP_OK);
+    CHECK(humidity == 0.0f && temperature == 0.0f);
+
+    // Exactly at the limits: 40 us is still a 0, 100 us is still in range
+    pulses[0] = (dht_pulse_t){ .low_us = DHT_PULSE_MAX_US, .high_us = DHT_BIT_THRESHOLD_US };
+    CHECK(dht_decode_pulses(pulses, DHT_DATA_BITS, &humidity, &temperature) == ESP_OK);
+    pulses[0].high_us = DHT_PULSE_MAX_US + 1;
+    CHECK(dht_decode_pulses(pulses, DHT_DATA_BITS, &humidity, &temperature) == ESP_ERR_INVALID_RESPONSE);
+
+    // Trailing unterminated low phases do not count as bits
+    pulses[0].high_us = 26;
+    pulses[DHT_DATA_BITS] = (dht_pulse_t){ .low_us = 50, .high_us = 0 };
+    CHECK(dht_decode_pulses(pulses, DHT_DATA_BITS + 1, &humidity, &temperature) == ESP_OK);
+    CHECK(dht_decode_pulses(pulses + 1, DHT_DATA_BITS, &humidity, &temperature) == ESP_ERR_INVALID_SIZE);
+}
+
+static void bench_decode(void)
+{
+    volatile float sink = 0;
+    float humidity, temperature;
+    size_t decodes = 0;
+
+    uint64_t start = host_test_now_ns();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (size_t i = 0; i < trace_count; i++) {
+            if (dht_decode_pulses(traces[i].pulses, traces[i].count, &humidity, &temperature) == ESP_OK) {
+                sink += humidity;
+            }
+            decodes++;
+        }
+    }
+    uint64_t elapsed = host_test_now_ns() - start;
+
+    printf("decode: %zu traces in %.1f ms, %.1f ns/trace\n", decodes, elapsed / 1e6, (double)elapsed / decodes);
+    (void)sink;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <dht_traces.txt>\n", argv[0]);
+        return 2;
+    }
+    load_corpus(argv[1]);
+    test_corpus();
+    test_edge_cases();
+    bench_decode();
+    return host_test_result("dht_decoder");
+}
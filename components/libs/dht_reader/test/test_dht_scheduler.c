@@ -0,0 +1,402 @@
+/**
+ * Host test of the DHT scheduler
+ * dht_reader.c runs with its polling backend against simulated DHT22
+ * sensors on a virtual clock. A DHT22 ignores a start signal that comes
+ * less than 2 s after the previous one (or after power-on), so for 1 to
+ * 8 sensors every read must be answered, and every sensor must be sampled
+ * at 0.5 Hz whatever the number of sensors. Each scenario runs in its own
+ * process since the reader can only be initialized once.
+ */
+#include "dht_reader.h"
+#include "dht_bus.h"
+#include "dht_decoder.h"
+#include "host_test.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_rom_sys.h>
+#include <esp_timer.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define SIM_DURATION_US (120 * 1000000LL)
+// Shorter, every failed read is logged
+#define SIM_DISCONNECTED_DURATION_US (20 * 1000000LL)
+#define TICK_US (1000000 / configTICK_RATE_HZ)
+#define MAX_SAMPLES 2048
+
+// DHT22 timing
+#define SENSOR_MIN_INTERVAL_US (DHT_MIN_READ_INTERVAL_MS * 1000LL)
+#define SENSOR_START_LOW_MIN_US 1000
+#define SENSOR_RESPONSE_DELAY_US 30
+// Response delay, response low and high, a low/high pair per bit, final low
+#define FRAME_SEGMENTS (3 + 2 * DHT_DATA_BITS + 1)
+
+typedef struct {
+    gpio_num_t pin;
+    bool connected;
+    bool configured;            // Set to open drain by the reader
+    uint32_t host_level;        // Level driven by the MCU (1 = released)
+    int64_t host_low_since;
+    int64_t last_start_us;      // Last answered start signal, 0 = power-on
+    int64_t frame_start_us;     // -1 while idle
+    uint16_t segments[FRAME_SEGMENTS];  // Phase lengths, starting with a high phase
+    float humidity;
+    float temperature;
+    uint32_t answered;
+    uint32_t ignored;
+    int64_t min_gap_us;
+    int64_t max_gap_us;
+} sim_sensor_t;
+
+typedef struct {
+    dht_data_t data;
+    int64_t timestamp_us;
+} sim_sample_t;
+
+static const gpio_num_t sim_pins[DHT_MAX_SENSORS] = {4, 5, 6, 7, 15, 16, 17, 18};
+
+static sim_sensor_t sensors[DHT_MAX_SENSORS];
+static size_t sensor_count;
+static sim_sample_t samples[MAX_SAMPLES];
+static size_t sample_count;
+
+static int64_t now_us;
+static int64_t sim_end_us;
+static jmp_buf sim_end;
+
+static TaskFunction_t task_function;
+static void *task_param;
+static bool task_deleted;
+static uint32_t missed_deadlines;
+
+static int64_t irq_off_since = -1;
+static int64_t irq_off_max_us;
+
+/* Virtual clock and the kernel calls dht_reader.c makes */
+
+static void sleep_until(int64_t wake_us)
+{
+    if (wake_us >= sim_end_us) {
+        longjmp(sim_end, 1);
+    }
+    now_us = wake_us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    now_us += us;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us / TICK_US);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    CHECK(irq_off_since < 0);
+    sleep_until((int64_t)(xTaskGetTickCount() + ticks) * TICK_US);
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+    CHECK(irq_off_since < 0);
+    *previous_wake += increment;
+    if (*previous_wake <= xTaskGetTickCount()) {
+        missed_deadlines++;
+        return pdFALSE;
+    }
+    sleep_until((int64_t)*previous_wake * TICK_US);
+    return pdTRUE;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    CHECK(task_function == NULL);
+    task_function = task;
+    task_param = param;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    task_deleted = true;
+    longjmp(sim_end, 1);
+}
+
+void vPortDisableInterrupts(void)
+{
+    CHECK(irq_off_since < 0);
+    irq_off_since = now_us;
+}
+
+void vPortEnableInterrupts(void)
+{
+    CHECK(irq_off_since >= 0);
+    if (now_us - irq_off_since > irq_off_max_us) {
+        irq_off_max_us = now_us - irq_off_since;
+    }
+    irq_off_since = -1;
+}
+
+void dht_bus_publish(const dht_data_t *data, int64_t timestamp_us)
+{
+    CHECK(sample_count < MAX_SAMPLES);
+    if (sample_count < MAX_SAMPLES) {
+        samples[sample_count++] = (sim_sample_t){ .data = *data, .timestamp_us = timestamp_us };
+    }
+}
+
+/* Simulated DHT22 sensors on an open-drain line */
+
+static sim_sensor_t *sensor_on(gpio_num_t pin)
+{
+    for (size_t i = 0; i < sensor_count; i++) {
+        if (sensors[i].pin == pin) {
+            return &sensors[i];
+        }
+    }
+    CHECK(!"access to a GPIO without sensor");
+    return NULL;
+}
+
+/**
+ * Build the answer to a start signal: response, 40 data bits, checksum
+ */
+static void sensor_start_frame(sim_sensor_t *sensor)
+{
+    uint16_t raw_h = (uint16_t)lroundf(sensor->humidity * 10);
+    uint16_t raw_t = (uint16_t)lroundf(fabsf(sensor->temperature) * 10);
+    if (sensor->temperature < 0) {
+        raw_t |= 0x8000;
+    }
+    uint8_t data[5] = {raw_h >> 8, raw_h & 0xff, raw_t >> 8, raw_t & 0xff};
+    data[4] = data[0] + data[1] + data[2] + data[3];
+
+    uint16_t *seg = sensor->segments;
+    *seg++ = SENSOR_RESPONSE_DELAY_US;
+    *seg++ = 80;
+    *seg++ = 80;
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        *seg++ = 50;
+        *seg++ = (data[i / 8] & (0x80 >> (i % 8))) ? 70 : 27;
+    }
+    *seg++ = 50;
+
+    if (sensor->answered > 0) {
+        int64_t gap = now_us - sensor->last_start_us;
+        if (sensor->answered == 1 || gap < sensor->min_gap_us) {
+            sensor->min_gap_us = gap;
+        }
+        if (gap > sensor->max_gap_us) {
+            sensor->max_gap_us = gap;
+        }
+    }
+    sensor->last_start_us = now_us;
+    sensor->frame_start_us = now_us;
+    sensor->answered++;
+}
+
+static int sensor_level(sim_sensor_t *sensor)
+{
+    if (sensor->frame_start_us < 0) {
+        return 1;
+    }
+    int64_t t = now_us - sensor->frame_start_us;
+    for (int i = 0; i < FRAME_SEGMENTS; i++) {
+        if (t < sensor->segments[i]) {
+            // Even phases are high: the sensor releases the line
+            return (i % 2 == 0) ? 1 : 0;
+        }
+        t -= sensor->segments[i];
+    }
+    sensor->frame_start_us = -1;
+    return 1;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode)
+{
+    sim_sensor_t *sensor = sensor_on(pin);
+    CHECK(mode == GPIO_MODE_INPUT_OUTPUT_OD);
+    if (sensor != NULL) {
+        sensor->configured = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t pin, gpio_pull_mode_t pull)
+{
+    CHECK(pull == GPIO_PULLUP_ONLY);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    sim_sensor_t *sensor = sensor_on(pin);
+    if (sensor == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    CHECK(sensor->configured);
+
+    if (level == 0 && sensor->host_level == 1) {
+        // Pulling the line low in the middle of a frame corrupts it
+        CHECK(sensor_level(sensor) == 1 && sensor->frame_start_us < 0);
+        sensor->host_low_since = now_us;
+    } else if (level == 1 && sensor->host_level == 0 &&
+               now_us - sensor->host_low_since >= SENSOR_START_LOW_MIN_US && sensor->connected) {
+        if (now_us - sensor->last_start_us >= SENSOR_MIN_INTERVAL_US) {
+            sensor_start_frame(sensor);
+        } else {
+            sensor->ignored++;
+        }
+    }
+    sensor->host_level = level ? 1 : 0;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+    sim_sensor_t *sensor = sensor_on(pin);
+    if (sensor == NULL || sensor->host_level == 0) {
+        return 0;
+    }
+    return sensor_level(sensor);
+}
+
+/* Scenarios */
+
+/**
+ * Check one sensor's reads and samples
+ *
+ * @return Sample rate of the sensor in Hz, 0 if it is disconnected
+ */
+static double check_sensor(size_t id, int64_t period_us)
+{
+    const sim_sensor_t *sensor = &sensors[id];
+    dht_stats_t stats;
+    CHECK(dht_get_stats(id, &stats) == ESP_OK);
+
+    if (!sensor->connected) {
+        CHECK(stats.reads > 0 && stats.failures == stats.reads);
+        return 0;
+    }
+
+    CHECK(sensor->ignored == 0);
+    CHECK(stats.failures == 0);
+    CHECK(stats.reads == sensor->answered);
+    CHECK(sensor->min_gap_us >= SENSOR_MIN_INTERVAL_US);
+    CHECK(sensor->max_gap_us <= period_us);
+
+    size_t published = 0;
+    int64_t first_us = 0, last_us = 0;
+    for (size_t i = 0; i < sample_count; i++) {
+        const sim_sample_t *sample = &samples[i];
+        if (sample->data.sensor_id != id) {
+            continue;
+        }
+        // Values are tagged with the sensor they were read from
+        CHECK(fabsf(sample->data.humidity - sensor->humidity) < 0.05f);
+        CHECK(fabsf(sample->data.temperature - sensor->temperature) < 0.05f);
+        if (published++ == 0) {
+            first_us = sample->timestamp_us;
+        }
+        last_us = sample->timestamp_us;
+    }
+    CHECK(published == sensor->answered);
+    CHECK(published >= 2);
+    if (published < 2) {
+        return 0;
+    }
+    double rate_hz = (published - 1) * 1e6 / (double)(last_us - first_us);
+    const double target_hz = 1000.0 / DHT_MIN_READ_INTERVAL_MS;
+    CHECK(fabs(rate_hz - target_hz) < 0.01 * target_hz);
+    return rate_hz;
+}
+
+/**
+ * Run the reader with count sensors for duration_us of virtual time
+ *
+ * @param disconnected Index of a sensor that never answers, or -1
+ */
+static void run_scenario(size_t count, int disconnected, int64_t duration_us)
+{
+    sensor_count = count;
+    for (size_t i = 0; i < count; i++) {
+        sensors[i] = (sim_sensor_t){
+            .pin = sim_pins[i],
+            .connected = (int)i != disconnected,
+            .host_level = 1,
+            .frame_start_us = -1,
+            .humidity = 35.0f + 2 * i,
+            .temperature = (i % 2 ? -1 : 1) * (12.5f + i),
+        };
+    }
+    sim_end_us = duration_us;
+
+    CHECK(dht_init_multi(sim_pins, count) == ESP_OK);
+    CHECK(dht_get_sensor_count() == count);
+    CHECK(task_function != NULL);
+    if (task_function != NULL && setjmp(sim_end) == 0) {
+        task_function(task_param);
+    }
+    CHECK(!task_deleted);
+    CHECK(missed_deadlines == 0);
+
+    // Every sensor is read once per N slots of ceil(interval / N) ticks
+    const TickType_t interval = pdMS_TO_TICKS(DHT_MIN_READ_INTERVAL_MS);
+    const int64_t period_us = (int64_t)((interval + count - 1) / count) * count * TICK_US;
+    uint32_t reads = 0;
+    double rate_min = INFINITY, rate_max = 0;
+    for (size_t i = 0; i < count; i++) {
+        double rate = check_sensor(i, period_us);
+        reads += sensors[i].answered;
+        if (sensors[i].connected) {
+            rate_min = fmin(rate_min, rate);
+            rate_max = fmax(rate_max, rate);
+        }
+    }
+
+    printf("%zu sensor(s)%s: %.4f..%.4f Hz per sensor, read every %lld ms, %u reads answered, "
+           "interrupts off up to %lld us per read\n",
+           count, disconnected >= 0 ? " (one disconnected)" : "", rate_min, rate_max,
+           (long long)period_us / 1000, reads, (long long)irq_off_max_us);
+}
+
+static void run_isolated(size_t count, int disconnected, int64_t duration_us)
+{
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_scenario(count, disconnected, duration_us);
+        fflush(stdout);
+        _exit(host_test_failures > 0 ? 1 : 0);
+    }
+    int status = 0;
+    CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "scenario with %zu sensor(s) failed\n", count);
+        host_test_failures++;
+    }
+}
+
+int main(void)
+{
+    static const size_t counts[] = {1, 2, 3, 4, 5, 8};
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        run_isolated(counts[i], -1, SIM_DURATION_US);
+    }
+    // A sensor that times out must not shift the schedule of the others
+    run_isolated(4, 1, SIM_DISCONNECTED_DURATION_US);
+    return host_test_result("dht_scheduler");
+}
@@ -0,0 +1,154 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+// Deepest supported nesting of objects and arrays
+#define JSON_WRITER_MAX_DEPTH 16
+
+/**
+ * Flush callback, receives the filled part of the buffer
+ *
+ * @param data Output to send
+ * @param len Number of bytes
+ * @param ctx User context passed to json_writer_init
+ * @return ESP_OK on success; any other value stops the writer
+ */
+typedef esp_err_t (*json_writer_flush_t)(const char *data, size_t len, void *ctx);
+
+/**
+ * Streaming JSON writer
+ *
+ * Writes JSON text straight into a caller-supplied buffer (usually on the
+ * stack) and hands it to the flush callback whenever it fills up, so
+ * output of any size is produced without heap allocations.
+ *
+ * Errors are sticky: after a failed flush or an overflow every call is a
+ * no-op and json_writer_error() reports the first error. Callers can
+ * write the whole document and check once at the end.
+ *
+ * Values take a key, which must be NULL inside arrays and for the root.
+ */
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;                 // Bytes in buf not yet flushed
+    bool flushed;               // The flush callback ran at least once
+    json_writer_flush_t flush;
+    void *ctx;
+    esp_err_t err;
+    uint8_t depth;
+    uint32_t has_items;         // Bit n: container at depth n has members
+} json_writer_t;
+
+/**
+ * @brief Start writing into a buffer
+ *
+ * @param w Writer state
+ * @param buf Output buffer
+ * @param size Size of buf in bytes
+ * @param flush Called when buf is full, or NULL to fail with
+ *              ESP_ERR_NO_MEM instead
+ * @param ctx User context for the callback
+ */
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_writer_flush_t flush, void *ctx);
+
+/**
+ * @brief Open an object
+ *
+ * @param w Writer state
+ * @param key Member name, or NULL
+ */
+void json_writer_object_begin(json_writer_t *w, const char *key);
+
+/**
+ * @brief Close the innermost object
+ */
+void json_writer_object_end(json_writer_t *w);
+
+/**
+ * @brief Open an array
+ *
+ * @param w Writer state
+ * @param key Member name, or NULL
+ */
+void json_writer_array_begin(json_writer_t *w, const char *key);
+
+/**
+ * @brief Close the innermost array
+ */
+void json_writer_array_end(json_writer_t *w);
+
+/**
+ * @brief Write a string, escaped as needed
+ *
+ * @param w Writer state
+ * @param key Member name, or NULL
+ * @param value NUL-terminated string
+ */
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+
+/**
+ * @brief Write an integer
+ *
+ * @param w Writer state
+ * @param key Member name, or NULL
+ * @param value Value
+ */
+void json_writer_int(json_writer_t *w, const char *key, int64_t value);
+
+/**
+ * @brief Write a number with a fixed number of decimals
+ *
+ * NaN and infinity are written as null.
+ *
+ * @param w Writer state
+ * @param key Member name, or NULL
+ * @param value Value
+ * @param decimals Digits after the decimal point (0-9)
+ */
+void json_writer_float(json_writer_t *w, const char *key, double value, int decimals);
+
+/**
+ * @brief Write true or false
+ *
+ * @param w Writer state
+ * @param key Member name, or NULL
+ * @param value Value
+ */
+void json_writer_bool(json_writer_t *w, const char *key, bool value);
+
+/**
+ * @brief Write null
+ *
+ * @param w Writer state
+ * @param key Member name, or NULL
+ */
+void json_writer_null(json_writer_t *w, const char *key);
+
+/**
+ * @brief Write pre-rendered JSON as a value
+ *
+ * The data is copied as is, it must be a complete JSON value.
+ *
+ * @param w Writer state
+ * @param key Member name, or NULL
+ * @param json JSON text
+ * @param len Length of json in bytes
+ */
+void json_writer_raw(json_writer_t *w, const char *key, const char *json, size_t len);
+
+/**
+ * @brief Get the first error
+ *
+ * @param w Writer state
+ * @return ESP_OK, the error returned by the flush callback, ESP_ERR_NO_MEM
+ *         if the buffer overflowed without a callback, or
+ *         ESP_ERR_INVALID_STATE if nesting was too deep or unbalanced
+ */
+esp_err_t json_writer_error(const json_writer_t *w);
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "json_writer.h"
+
+/**
+ * Hand the buffer to the flush callback
+ */
+static void flush_buffer(json_writer_t *w)
+{
+    if (w->flush == NULL) {
+        w->err = ESP_ERR_NO_MEM;
+        return;
+    }
+    esp_err_t ret = w->flush(w->buf, w->len, w->ctx);
+    w->flushed = true;
+    w->len = 0;
+    if (ret != ESP_OK) {
+        w->err = ret;
+    }
+}
+
+static void put(json_writer_t *w, const char *data, size_t len)
+{
+    while (len > 0 && w->err == ESP_OK) {
+        if (w->len == w->size) {
+            flush_buffer(w);
+            continue;
+        }
+        size_t take = w->size - w->len;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(w->buf + w->len, data, take);
+        w->len += take;
+        data += take;
+        len -= take;
+    }
+}
+
+static void put_char(json_writer_t *w, char c)
+{
+    put(w, &c, 1);
+}
+
+static void put_escaped(json_writer_t *w, const char *str)
+{
+    put_char(w, '"');
+    while (*str != '\0') {
+        // Copy runs that need no escaping in one go
+        const char *run = str;
+        while (*str != '\0' && *str != '"' && *str != '\\' && (unsigned char)*str >= 0x20) {
+            str++;
+        }
+        put(w, run, str - run);
+        if (*str == '\0') {
+            break;
+        }
+
+        char esc[7];
+        switch (*str) {
+            case '"':  put(w, "\\\"", 2); break;
+            case '\\': put(w, "\\\\", 2); break;
+            case '\n': put(w, "\\n", 2); break;
+            case '\r': put(w, "\\r", 2); break;
+            case '\t': put(w, "\\t", 2); break;
+            default:
+                snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)*str);
+                put(w, esc, 6);
+                break;
+        }
+        str++;
+    }
+    put_char(w, '"');
+}
+
+/**
+ * Write the separator and key that go before every value
+ */
+static void begin_value(json_writer_t *w, const char *key)
+{
+    if (w->depth > 0) {
+        const uint32_t bit = 1u << (w->depth - 1);
+        if (w->has_items & bit) {
+            put_char(w, ',');
+        }
+        w->has_items |= bit;
+    }
+    if (key != NULL) {
+        put_escaped(w, key);
+        put_char(w, ':');
+    }
+}
+
+static void container_begin(json_writer_t *w, const char *key, char open)
+{
+    if (w->depth == JSON_WRITER_MAX_DEPTH) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    begin_value(w, key);
+    put_char(w, open);
+    w->depth++;
+    w->has_items &= ~(1u << (w->depth - 1));
+}
+
+static void container_end(json_writer_t *w, char close)
+{
+    if (w->depth == 0) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth--;
+    put_char(w, close);
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_writer_flush_t flush, void *ctx)
+{
+    *w = (json_writer_t) {
+        .buf = buf,
+        .size = size,
+        .flush = flush,
+        .ctx = ctx,
+        .err = ESP_OK,
+    };
+}
+
+void json_writer_object_begin(json_writer_t *w, const char *key)
+{
+    container_begin(w, key, '{');
+}
+
+void json_writer_object_end(json_writer_t *w)
+{
+    container_end(w, '}');
+}
+
+void json_writer_array_begin(json_writer_t *w, const char *key)
+{
+    container_begin(w, key, '[');
+}
+
+void json_writer_array_end(json_writer_t *w)
+{
+    container_end(w, ']');
+}
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value)
+{
+    begin_value(w, key);
+    put_escaped(w, value);
+}
+
+void json_writer_int(json_writer_t *w, const char *key, int64_t value)
+{
+    char num[24];
+    int len = snprintf(num, sizeof(num), "%" PRId64, value);
+    begin_value(w, key);
+    put(w, num, len);
+}
+
+void json_writer_float(json_writer_t *w, const char *key, double value, int decimals)
+{
+    if (!isfinite(value)) {
+        json_writer_null(w, key);
+        return;
+    }
+    if (decimals < 0) {
+        decimals = 0;
+    } else if (decimals > 9) {
+        decimals = 9;
+    }
+
+    char num[32];
+    int len = snprintf(num, sizeof(num), "%.*f", decimals, value);
+    if (len < 0 || len >= (int)sizeof(num)) {
+        // Too large for fixed notation
+        len = snprintf(num, sizeof(num), "%.6e", value);
+    }
+    begin_value(w, key);
+    put(w, num, len);
+}
+
+void json_writer_bool(json_writer_t *w, const char *key, bool value)
+{
+    begin_value(w, key);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void json_writer_null(json_writer_t *w, const char *key)
+{
+    begin_value(w, key);
+    put(w, "null", 4);
+}
+
+void json_writer_raw(json_writer_t *w, const char *key, const char *json, size_t len)
+{
+    begin_value(w, key);
+    put(w, json, len);
+}
+
+esp_err_t json_writer_error(const json_writer_t *w)
+{
+    return w->err;
+}
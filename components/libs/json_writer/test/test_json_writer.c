@@ -0,0 +1,566 @@
+/**
+ * Host test and benchmark of the JSON writer
+ * Builds the /status.json and /tasks.json documents with json_writer into
+ * the handlers' stack buffer and, when cJSON is available (HAVE_CJSON),
+ * the way the handlers used to: a cJSON tree printed unformatted. Reports
+ * ns, heap allocations and peak heap per document for both, and checks
+ * that both produce the same JSON. The writer's own behaviour (escaping,
+ * flushes at every buffer size, errors) is checked without cJSON.
+ */
+#include "json_writer.h"
+#include "host_test.h"
+#include <malloc.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_CJSON
+#include "cJSON.h"
+#endif
+
+#define BENCH_ITERATIONS 20000
+// Buffer of the HTTP handlers
+#define HANDLER_BUF_SIZE 512
+#define SINK_SIZE 8192
+#define TASK_COUNT 24
+#define CORE_COUNT 2
+
+/* Heap accounting: the test links with --wrap for the allocation calls */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static size_t heap_allocs;
+static size_t heap_current;
+static size_t heap_peak;
+
+static void heap_track(void *ptr)
+{
+    if (ptr != NULL) {
+        heap_allocs++;
+        heap_current += malloc_usable_size(ptr);
+        heap_peak = heap_current > heap_peak ? heap_current : heap_peak;
+    }
+}
+
+static void heap_untrack(void *ptr)
+{
+    if (ptr != NULL) {
+        heap_current -= malloc_usable_size(ptr);
+    }
+}
+
+static void heap_reset(void)
+{
+    heap_allocs = 0;
+    heap_current = 0;
+    heap_peak = 0;
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    heap_track(ptr);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *ptr = __real_calloc(n, size);
+    heap_track(ptr);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t old = ptr != NULL ? malloc_usable_size(ptr) : 0;
+    void *out = __real_realloc(ptr, size);
+    if (out != NULL) {
+        heap_current -= old;
+        heap_track(out);
+    }
+    return out;
+}
+
+void __wrap_free(void *ptr)
+{
+    heap_untrack(ptr);
+    __real_free(ptr);
+}
+
+/* Response sink, stands in for httpd_resp_send_chunk() */
+
+typedef struct {
+    char data[SINK_SIZE];
+    size_t len;
+    size_t flushes;
+} sink_t;
+
+static esp_err_t sink_flush(const char *data, size_t len, void *ctx)
+{
+    sink_t *sink = ctx;
+    if (sink->len + len > sizeof(sink->data)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(sink->data + sink->len, data, len);
+    sink->len += len;
+    sink->flushes++;
+    return ESP_OK;
+}
+
+static esp_err_t fail_flush(const char *data, size_t len, void *ctx)
+{
+    return ESP_FAIL;
+}
+
+/**
+ * Finish a document: flush what is left in the buffer
+ */
+static esp_err_t writer_finish(json_writer_t *w)
+{
+    if (json_writer_error(w) == ESP_OK && w->len > 0) {
+        return w->flush(w->buf, w->len, w->ctx);
+    }
+    return json_writer_error(w);
+}
+
+/* Document data, as the handlers get it from the coordinator */
+
+typedef struct {
+    char name[16];
+    int core;
+    int priority;
+    double cpu_short;
+    double cpu_long;
+    int stack_free_min;
+} task_t;
+
+static task_t tasks[TASK_COUNT];
+static double idle_short[CORE_COUNT] = {91.25, 97.5};
+static double idle_long[CORE_COUNT] = {93.75, 98.0};
+
+static void make_tasks(void)
+{
+    static const char *const names[] = {
+        "IDLE0", "IDLE1", "tiT", "wifi", "sys_evt", "esp_timer", "httpd", "http_w0", "http_w1", "dht_task",
+        "sensor_mon", "system_mon", "ota_writer", "ipc0", "ipc1", "Tmr Svc", "dns_srv", "wifi_app",
+        "app_coord", "history", "nvs_task", "events", "btm", "main",
+    };
+    for (int i = 0; i < TASK_COUNT; i++) {
+        tasks[i] = (task_t){
+            .core = i % 3 == 2 ? -1 : i % 2,
+            .priority = (i * 7) % 24,
+            // Quarters: exact in binary, so both libraries print the same value
+            .cpu_short = (i * 37 % 400) / 4.0,
+            .cpu_long = (i * 53 % 400) / 4.0,
+            .stack_free_min = 512 + i * 97,
+        };
+        snprintf(tasks[i].name, sizeof(tasks[i].name), "%s", names[i]);
+    }
+}
+
+/* json_writer documents */
+
+static void writer_status(json_writer_t *w)
+{
+    json_writer_object_begin(w, NULL);
+
+    json_writer_object_begin(w, "ssid");
+    json_writer_string(w, "ssid", "ESP32_DHT_AP");
+    json_writer_object_end(w);
+
+    json_writer_object_begin(w, "sensor");
+    json_writer_string(w, "temp", "21.5");
+    json_writer_string(w, "humidity", "45.2");
+    json_writer_object_end(w);
+
+    json_writer_object_begin(w, "time");
+    json_writer_string(w, "time", "2026-10-17 14:03:21");
+    json_writer_object_end(w);
+
+    json_writer_object_begin(w, "wifi");
+    json_writer_int(w, "wifi_connect_status", 3);
+    json_writer_string(w, "ap", "Home \"Net\"");
+    json_writer_string(w, "ip", "192.168.1.42");
+    json_writer_string(w, "netmask", "255.255.255.0");
+    json_writer_string(w, "gw", "192.168.1.1");
+    json_writer_object_end(w);
+
+    json_writer_object_begin(w, "ota");
+    json_writer_int(w, "ota_update_status", 0);
+    json_writer_string(w, "compile_date", "Oct 17 2026");
+    json_writer_string(w, "compile_time", "09:12:44");
+    json_writer_object_end(w);
+
+    json_writer_object_begin(w, "system");
+    json_writer_int(w, "heap_free", 183524);
+    json_writer_int(w, "heap_min", 161208);
+    json_writer_int(w, "uptime_seconds", 86423);
+    json_writer_string(w, "firmware_version", "1.0.0");
+    json_writer_string(w, "compile_date", "Oct 17 2026");
+    json_writer_string(w, "compile_time", "09:12:44");
+    json_writer_bool(w, "wifi_sta_connected", true);
+    json_writer_int(w, "wifi_ap_clients", 1);
+    json_writer_object_end(w);
+
+    json_writer_object_end(w);
+}
+
+static void writer_tasks(json_writer_t *w)
+{
+    json_writer_object_begin(w, NULL);
+    json_writer_int(w, "window_short_s", 1);
+    json_writer_int(w, "window_long_s", 10);
+    json_writer_int(w, "task_total", TASK_COUNT);
+
+    json_writer_array_begin(w, "cores");
+    for (int core = 0; core < CORE_COUNT; core++) {
+        json_writer_object_begin(w, NULL);
+        json_writer_int(w, "core", core);
+        json_writer_float(w, "idle_short", idle_short[core], 2);
+        json_writer_float(w, "idle_long", idle_long[core], 2);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+
+    json_writer_array_begin(w, "tasks");
+    for (int i = 0; i < TASK_COUNT; i++) {
+        const task_t *task = &tasks[i];
+        json_writer_object_begin(w, NULL);
+        json_writer_string(w, "name", task->name);
+        json_writer_int(w, "core", task->core);
+        json_writer_int(w, "priority", task->priority);
+        json_writer_float(w, "cpu_short", task->cpu_short, 2);
+        json_writer_float(w, "cpu_long", task->cpu_long, 2);
+        json_writer_int(w, "stack_free_min", task->stack_free_min);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+
+    json_writer_object_end(w);
+}
+
+#if HAVE_CJSON
+
+/* The same documents as cJSON trees, as the handlers built them before */
+
+static cJSON *cjson_status(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *section;
+
+    section = cJSON_CreateObject();
+    cJSON_AddStringToObject(section, "ssid", "ESP32_DHT_AP");
+    cJSON_AddItemToObject(root, "ssid", section);
+
+    section = cJSON_CreateObject();
+    cJSON_AddStringToObject(section, "temp", "21.5");
+    cJSON_AddStringToObject(section, "humidity", "45.2");
+    cJSON_AddItemToObject(root, "sensor", section);
+
+    section = cJSON_CreateObject();
+    cJSON_AddStringToObject(section, "time", "2026-10-17 14:03:21");
+    cJSON_AddItemToObject(root, "time", section);
+
+    section = cJSON_CreateObject();
+    cJSON_AddNumberToObject(section, "wifi_connect_status", 3);
+    cJSON_AddStringToObject(section, "ap", "Home \"Net\"");
+    cJSON_AddStringToObject(section, "ip", "192.168.1.42");
+    cJSON_AddStringToObject(section, "netmask", "255.255.255.0");
+    cJSON_AddStringToObject(section, "gw", "192.168.1.1");
+    cJSON_AddItemToObject(root, "wifi", section);
+
+    section = cJSON_CreateObject();
+    cJSON_AddNumberToObject(section, "ota_update_status", 0);
+    cJSON_AddStringToObject(section, "compile_date", "Oct 17 2026");
+    cJSON_AddStringToObject(section, "compile_time", "09:12:44");
+    cJSON_AddItemToObject(root, "ota", section);
+
+    section = cJSON_CreateObject();
+    cJSON_AddNumberToObject(section, "heap_free", 183524);
+    cJSON_AddNumberToObject(section, "heap_min", 161208);
+    cJSON_AddNumberToObject(section, "uptime_seconds", 86423);
+    cJSON_AddStringToObject(section, "firmware_version", "1.0.0");
+    cJSON_AddStringToObject(section, "compile_date", "Oct 17 2026");
+    cJSON_AddStringToObject(section, "compile_time", "09:12:44");
+    cJSON_AddBoolToObject(section, "wifi_sta_connected", true);
+    cJSON_AddNumberToObject(section, "wifi_ap_clients", 1);
+    cJSON_AddItemToObject(root, "system", section);
+
+    return root;
+}
+
+static cJSON *cjson_tasks(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "window_short_s", 1);
+    cJSON_AddNumberToObject(root, "window_long_s", 10);
+    cJSON_AddNumberToObject(root, "task_total", TASK_COUNT);
+
+    cJSON *cores = cJSON_AddArrayToObject(root, "cores");
+    for (int core = 0; core < CORE_COUNT; core++) {
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddNumberToObject(entry, "core", core);
+        cJSON_AddNumberToObject(entry, "idle_short", idle_short[core]);
+        cJSON_AddNumberToObject(entry, "idle_long", idle_long[core]);
+        cJSON_AddItemToArray(cores, entry);
+    }
+
+    cJSON *list = cJSON_AddArrayToObject(root, "tasks");
+    for (int i = 0; i < TASK_COUNT; i++) {
+        const task_t *task = &tasks[i];
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddStringToObject(entry, "name", task->name);
+        cJSON_AddNumberToObject(entry, "core", task->core);
+        cJSON_AddNumberToObject(entry, "priority", task->priority);
+        cJSON_AddNumberToObject(entry, "cpu_short", task->cpu_short);
+        cJSON_AddNumberToObject(entry, "cpu_long", task->cpu_long);
+        cJSON_AddNumberToObject(entry, "stack_free_min", task->stack_free_min);
+        cJSON_AddItemToArray(list, entry);
+    }
+    return root;
+}
+
+// Route cJSON through the accounting also when it is a shared library
+static void *cjson_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    heap_track(ptr);
+    return ptr;
+}
+
+static void cjson_free(void *ptr)
+{
+    heap_untrack(ptr);
+    __real_free(ptr);
+}
+
+#endif // HAVE_CJSON
+
+/* Benchmark */
+
+typedef struct {
+    const char *name;
+    void (*writer)(json_writer_t *w);
+#if HAVE_CJSON
+    cJSON *(*cjson)(void);
+#endif
+} document_t;
+
+typedef struct {
+    double ns;
+    double allocs;
+    size_t peak;
+    size_t bytes;
+} bench_result_t;
+
+static void print_result(const char *document, const char *library, const bench_result_t *r)
+{
+    printf("  %-7s %-11s %8.0f ns/doc  %5.1f allocs/doc  %6zu B peak heap  %5zu B\n", document, library, r->ns,
+           r->allocs, r->peak, r->bytes);
+}
+
+static bench_result_t bench_writer(const document_t *doc, sink_t *sink)
+{
+    bench_result_t r = {0};
+    heap_reset();
+    uint64_t start = host_test_now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        char buf[HANDLER_BUF_SIZE];
+        json_writer_t w;
+        sink->len = 0;
+        json_writer_init(&w, buf, sizeof(buf), sink_flush, sink);
+        doc->writer(&w);
+        CHECK(writer_finish(&w) == ESP_OK);
+    }
+    r.ns = (double)(host_test_now_ns() - start) / BENCH_ITERATIONS;
+    r.allocs = (double)heap_allocs / BENCH_ITERATIONS;
+    r.peak = heap_peak;
+    r.bytes = sink->len;
+    return r;
+}
+
+#if HAVE_CJSON
+static bench_result_t bench_cjson(const document_t *doc, sink_t *sink)
+{
+    bench_result_t r = {0};
+    heap_reset();
+    uint64_t start = host_test_now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        cJSON *root = doc->cjson();
+        char *json = cJSON_PrintUnformatted(root);
+        CHECK(json != NULL);
+        if (json != NULL) {
+            sink->len = 0;
+            CHECK(sink_flush(json, strlen(json), sink) == ESP_OK);
+            cJSON_free(json);
+        }
+        cJSON_Delete(root);
+    }
+    r.ns = (double)(host_test_now_ns() - start) / BENCH_ITERATIONS;
+    r.allocs = (double)heap_allocs / BENCH_ITERATIONS;
+    r.peak = heap_peak;
+    r.bytes = sink->len;
+    return r;
+}
+#endif
+
+static void bench_documents(void)
+{
+    static const document_t documents[] = {
+#if HAVE_CJSON
+        {"status", writer_status, cjson_status},
+        {"tasks", writer_tasks, cjson_tasks},
+#else
+        {"status", writer_status},
+        {"tasks", writer_tasks},
+#endif
+    };
+    static sink_t writer_sink;
+
+#if HAVE_CJSON
+    static sink_t cjson_sink;
+    cJSON_Hooks hooks = { .malloc_fn = cjson_malloc, .free_fn = cjson_free };
+    cJSON_InitHooks(&hooks);
+    printf("json_writer (%d byte buffer) against cJSON tree + PrintUnformatted:\n", HANDLER_BUF_SIZE);
+#else
+    printf("json_writer (%d byte buffer); cJSON not found, no comparison:\n", HANDLER_BUF_SIZE);
+#endif
+
+    for (size_t i = 0; i < sizeof(documents) / sizeof(documents[0]); i++) {
+        const document_t *doc = &documents[i];
+        bench_result_t writer = bench_writer(doc, &writer_sink);
+        // The writer streams from the stack buffer and never touches the heap
+        CHECK(heap_allocs == 0);
+        print_result(doc->name, "json_writer", &writer);
+
+#if HAVE_CJSON
+        bench_result_t cjson = bench_cjson(doc, &cjson_sink);
+        print_result(doc->name, "cJSON", &cjson);
+
+        // Same document: parse both outputs and compare the trees
+        cJSON *from_writer = cJSON_ParseWithLength(writer_sink.data, writer_sink.len);
+        cJSON *from_cjson = cJSON_ParseWithLength(cjson_sink.data, cjson_sink.len);
+        CHECK(from_writer != NULL && from_cjson != NULL);
+        CHECK(cJSON_Compare(from_writer, from_cjson, true));
+        cJSON_Delete(from_writer);
+        cJSON_Delete(from_cjson);
+#endif
+    }
+}
+
+/* json_writer behaviour */
+
+static void test_status_output(void)
+{
+    static const char expected[] =
+        "{\"ssid\":{\"ssid\":\"ESP32_DHT_AP\"},\"sensor\":{\"temp\":\"21.5\",\"humidity\":\"45.2\"},"
+        "\"time\":{\"time\":\"2026-10-17 14:03:21\"},"
+        "\"wifi\":{\"wifi_connect_status\":3,\"ap\":\"Home \\\"Net\\\"\",\"ip\":\"192.168.1.42\","
+        "\"netmask\":\"255.255.255.0\",\"gw\":\"192.168.1.1\"},"
+        "\"ota\":{\"ota_update_status\":0,\"compile_date\":\"Oct 17 2026\",\"compile_time\":\"09:12:44\"},"
+        "\"system\":{\"heap_free\":183524,\"heap_min\":161208,\"uptime_seconds\":86423,"
+        "\"firmware_version\":\"1.0.0\",\"compile_date\":\"Oct 17 2026\",\"compile_time\":\"09:12:44\","
+        "\"wifi_sta_connected\":true,\"wifi_ap_clients\":1}}";
+    static sink_t sink;
+
+    // Flushes at every possible position give the same output
+    for (size_t size = 1; size <= sizeof(expected); size++) {
+        char buf[sizeof(expected)];
+        json_writer_t w;
+        sink.len = 0;
+        sink.flushes = 0;
+        json_writer_init(&w, buf, size, sink_flush, &sink);
+        writer_status(&w);
+        CHECK(writer_finish(&w) == ESP_OK);
+        CHECK(sink.len == sizeof(expected) - 1 && memcmp(sink.data, expected, sink.len) == 0);
+        CHECK(sink.flushes == (sizeof(expected) - 1 + size - 1) / size);
+    }
+
+    // A document that fits is never flushed by the writer (sent with Content-Length)
+    char buf[sizeof(expected)];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+    writer_status(&w);
+    CHECK(json_writer_error(&w) == ESP_OK && !w.flushed);
+    CHECK(w.len == sizeof(expected) - 1 && memcmp(buf, expected, w.len) == 0);
+}
+
+static void test_values(void)
+{
+    static const char expected[] =
+        "[\"q\\\"b\\\\s\\n\\r\\t\\u0001\\u001f\xc3\xa9\",-9223372036854775808,9223372036854775807,"
+        "21.5,-0.1,3,null,null,false,null,{\"a\":[],\"b\":{}},{\"k\\\"\":1},{\"raw\":[1,2]}]";
+    char buf[256];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+
+    json_writer_array_begin(&w, NULL);
+    json_writer_string(&w, NULL, "q\"b\\s\n\r\t\x01\x1f\xc3\xa9");
+    json_writer_int(&w, NULL, INT64_MIN);
+    json_writer_int(&w, NULL, INT64_MAX);
+    json_writer_float(&w, NULL, 21.5, 1);
+    json_writer_float(&w, NULL, -0.1, 1);
+    json_writer_float(&w, NULL, 3.4, -1);
+    json_writer_float(&w, NULL, NAN, 2);
+    json_writer_float(&w, NULL, INFINITY, 2);
+    json_writer_bool(&w, NULL, false);
+    json_writer_null(&w, NULL);
+    json_writer_object_begin(&w, NULL);
+    json_writer_array_begin(&w, "a");
+    json_writer_array_end(&w);
+    json_writer_object_begin(&w, "b");
+    json_writer_object_end(&w);
+    json_writer_object_end(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_int(&w, "k\"", 1);
+    json_writer_object_end(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_raw(&w, "raw", "[1,2]", 5);
+    json_writer_object_end(&w);
+    json_writer_array_end(&w);
+
+    CHECK(json_writer_error(&w) == ESP_OK);
+    CHECK(w.len == sizeof(expected) - 1 && memcmp(buf, expected, w.len) == 0);
+}
+
+static void test_errors(void)
+{
+    char buf[64];
+    json_writer_t w;
+
+    // Too deep
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+    for (int i = 0; i <= JSON_WRITER_MAX_DEPTH; i++) {
+        json_writer_array_begin(&w, NULL);
+    }
+    CHECK(json_writer_error(&w) == ESP_ERR_INVALID_STATE);
+
+    // Unbalanced end
+    json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+    json_writer_object_end(&w);
+    CHECK(json_writer_error(&w) == ESP_ERR_INVALID_STATE);
+
+    // Full buffer without a flush callback
+    json_writer_init(&w, buf, 8, NULL, NULL);
+    json_writer_string(&w, NULL, "longer than eight");
+    CHECK(json_writer_error(&w) == ESP_ERR_NO_MEM);
+
+    // Flush errors are sticky: nothing more is written
+    json_writer_init(&w, buf, 4, fail_flush, NULL);
+    json_writer_string(&w, NULL, "abcdefgh");
+    size_t len = w.len;
+    json_writer_int(&w, NULL, 1);
+    CHECK(json_writer_error(&w) == ESP_FAIL && w.len == len);
+}
+
+int main(void)
+{
+    make_tasks();
+    test_status_output();
+    test_values();
+    test_errors();
+    bench_documents();
+    return host_test_result("json_writer");
+}
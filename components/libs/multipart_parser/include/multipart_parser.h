@@ -0,0 +1,99 @@
+#ifndef MULTIPART_PARSER_H
+#define MULTIPART_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+// Longest boundary allowed by RFC 2046
+#define MULTIPART_BOUNDARY_MAX 70
+
+// Header lines are inspected up to this length, the rest is skipped
+#define MULTIPART_HEADER_LINE_MAX 128
+
+/**
+ * Data callback, receives the file part in order
+ *
+ * @param data File bytes, usually pointing into the buffer passed to
+ *             multipart_parser_feed()
+ * @param len Number of bytes
+ * @param ctx User context passed to multipart_parser_init
+ * @return ESP_OK on success; any other value stops the parser
+ */
+typedef esp_err_t (*multipart_data_cb_t)(const uint8_t *data, size_t len, void *ctx);
+
+typedef enum {
+    MULTIPART_STATE_PREAMBLE,
+    MULTIPART_STATE_DELIMITER,      // After a delimiter: "--" or transport padding and CRLF
+    MULTIPART_STATE_DELIMITER_CR,
+    MULTIPART_STATE_CLOSE,
+    MULTIPART_STATE_HEADERS,
+    MULTIPART_STATE_BODY,
+    MULTIPART_STATE_DONE,           // Closing delimiter seen, the epilogue is ignored
+    MULTIPART_STATE_ERROR,
+} multipart_state_t;
+
+/**
+ * Incremental multipart/form-data parser
+ *
+ * Takes the request body in chunks of any size, split anywhere, and
+ * passes the content of the first part that carries a filename to the
+ * data callback. Other parts are skipped.
+ *
+ * Body bytes are handed over straight from the caller's buffer. Only a
+ * partial delimiter at the end of a chunk is held back; as those bytes
+ * equal the start of the delimiter, they need no copy either and are
+ * replayed from it if the match fails in the next chunk.
+ *
+ * Errors are sticky: after a malformed body or a failed callback every
+ * feed returns the first error.
+ */
+typedef struct {
+    char delimiter[4 + MULTIPART_BOUNDARY_MAX];     // "\r\n--" + boundary, not terminated
+    size_t delimiter_len;
+    size_t match;                                   // Delimiter bytes matched so far
+    multipart_state_t state;
+    esp_err_t err;
+    char line[MULTIPART_HEADER_LINE_MAX];           // Current header line, lower case
+    size_t line_len;
+    bool part_is_file;
+    bool deliver;                                   // Current part goes to the callback
+    bool file_complete;
+    multipart_data_cb_t on_data;
+    void *ctx;
+} multipart_parser_t;
+
+/**
+ * @brief Start parsing a body
+ *
+ * @param p Parser state
+ * @param content_type Value of the Content-Type header, holding the boundary
+ * @param on_data Callback receiving the file content
+ * @param ctx User context for the callback
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if content_type has no
+ *         usable boundary
+ */
+esp_err_t multipart_parser_init(multipart_parser_t *p, const char *content_type,
+                                multipart_data_cb_t on_data, void *ctx);
+
+/**
+ * @brief Feed the next chunk of the body
+ *
+ * @param p Parser state
+ * @param data Body bytes
+ * @param len Number of bytes
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the body is malformed,
+ *         or the error returned by the callback
+ */
+esp_err_t multipart_parser_feed(multipart_parser_t *p, const uint8_t *data, size_t len);
+
+/**
+ * @brief Check whether the file part has been received completely
+ *
+ * @param p Parser state
+ * @return true once the delimiter after the file part was seen
+ */
+bool multipart_parser_file_complete(const multipart_parser_t *p);
+
+#endif // MULTIPART_PARSER_H
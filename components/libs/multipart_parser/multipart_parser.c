@@ -0,0 +1,216 @@
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include "multipart_parser.h"
+
+/**
+ * Find a parameter in a header value, case-insensitively
+ */
+static const char *find_param(const char *value, const char *name)
+{
+    const size_t name_len = strlen(name);
+    for (const char *s = value; *s != '\0'; s++) {
+        if (strncasecmp(s, name, name_len) == 0 && (s == value || s[-1] == ';' || s[-1] == ' ')) {
+            return s + name_len;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t multipart_parser_init(multipart_parser_t *p, const char *content_type,
+                                multipart_data_cb_t on_data, void *ctx)
+{
+    memset(p, 0, sizeof(*p));
+    p->on_data = on_data;
+    p->ctx = ctx;
+    p->state = MULTIPART_STATE_ERROR;
+    p->err = ESP_ERR_INVALID_ARG;
+
+    const char *boundary = find_param(content_type, "boundary=");
+    if (boundary == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t len;
+    if (*boundary == '"') {
+        boundary++;
+        const char *end = strchr(boundary, '"');
+        if (end == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        len = end - boundary;
+    } else {
+        len = strcspn(boundary, "; \t");
+    }
+    if (len == 0 || len > MULTIPART_BOUNDARY_MAX || memchr(boundary, '\r', len) != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(p->delimiter, "\r\n--", 4);
+    memcpy(p->delimiter + 4, boundary, len);
+    p->delimiter_len = 4 + len;
+
+    // The first delimiter may open the body: act as if a CRLF came before it
+    p->match = 2;
+    p->state = MULTIPART_STATE_PREAMBLE;
+    p->err = ESP_OK;
+    return ESP_OK;
+}
+
+static esp_err_t emit(multipart_parser_t *p, const uint8_t *data, size_t len)
+{
+    if (len == 0 || !p->deliver) {
+        return ESP_OK;
+    }
+    return p->on_data(data, len, p->ctx);
+}
+
+/**
+ * Pass body bytes on up to the next delimiter
+ * Returns the bytes consumed; *found tells whether that includes a
+ * complete delimiter.
+ */
+static size_t scan_body(multipart_parser_t *p, const uint8_t *data, size_t len, bool *found)
+{
+    // Delimiter bytes matched in earlier chunks, not part of data
+    size_t held = p->match;
+    size_t i = 0;
+
+    *found = false;
+    while (i < len) {
+        if (p->match == 0) {
+            // Only a CR can start a delimiter (boundaries contain none)
+            const uint8_t *cr = memchr(data + i, '\r', len - i);
+            if (cr == NULL) {
+                break;
+            }
+            i = cr - data;
+        }
+
+        if (data[i] == (uint8_t)p->delimiter[p->match]) {
+            p->match++;
+            i++;
+            if (p->match == p->delimiter_len) {
+                p->err = emit(p, data, i - (p->delimiter_len - held));
+                p->match = 0;
+                *found = true;
+                return i;
+            }
+        } else {
+            // The matched bytes were content after all; retry this byte from scratch
+            if (held > 0) {
+                p->err = emit(p, (const uint8_t *)p->delimiter, held);
+                held = 0;
+                if (p->err != ESP_OK) {
+                    return len;
+                }
+            }
+            p->match = 0;
+        }
+    }
+
+    // Hold back a partial delimiter at the end
+    p->err = emit(p, data, len - (p->match - held));
+    return len;
+}
+
+/**
+ * Inspect a complete header line
+ */
+static void header_line(multipart_parser_t *p)
+{
+    p->line[p->line_len] = '\0';
+    if (strncmp(p->line, "content-disposition:", 20) == 0 &&
+        (find_param(p->line + 20, "filename=") != NULL || find_param(p->line + 20, "filename*=") != NULL)) {
+        p->part_is_file = true;
+    }
+}
+
+esp_err_t multipart_parser_feed(multipart_parser_t *p, const uint8_t *data, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len && p->err == ESP_OK) {
+        const uint8_t c = data[i];
+
+        switch (p->state) {
+        case MULTIPART_STATE_PREAMBLE:
+        case MULTIPART_STATE_BODY: {
+            bool found;
+            i += scan_body(p, data + i, len - i, &found);
+            if (found) {
+                if (p->deliver) {
+                    p->deliver = false;
+                    p->file_complete = true;
+                }
+                p->state = MULTIPART_STATE_DELIMITER;
+            }
+            continue;
+        }
+
+        case MULTIPART_STATE_DELIMITER:
+            if (c == '-') {
+                p->state = MULTIPART_STATE_CLOSE;
+            } else if (c == '\r') {
+                p->state = MULTIPART_STATE_DELIMITER_CR;
+            } else if (c != ' ' && c != '\t') {
+                p->err = ESP_ERR_INVALID_ARG;
+            }
+            break;
+
+        case MULTIPART_STATE_DELIMITER_CR:
+            if (c == '\n') {
+                p->state = MULTIPART_STATE_HEADERS;
+                p->line_len = 0;
+                p->part_is_file = false;
+            } else {
+                p->err = ESP_ERR_INVALID_ARG;
+            }
+            break;
+
+        case MULTIPART_STATE_CLOSE:
+            if (c == '-') {
+                p->state = MULTIPART_STATE_DONE;
+            } else {
+                p->err = ESP_ERR_INVALID_ARG;
+            }
+            break;
+
+        case MULTIPART_STATE_HEADERS:
+            if (c == '\n') {
+                if (p->line_len > 0 && p->line[p->line_len - 1] == '\r') {
+                    p->line_len--;
+                }
+                if (p->line_len == 0) {
+                    // Blank line: the part's content follows
+                    p->state = MULTIPART_STATE_BODY;
+                    p->deliver = p->part_is_file && !p->file_complete;
+                } else {
+                    header_line(p);
+                    p->line_len = 0;
+                }
+            } else if (p->line_len < MULTIPART_HEADER_LINE_MAX - 1) {
+                p->line[p->line_len++] = tolower(c);
+            }
+            break;
+
+        case MULTIPART_STATE_DONE:
+            return ESP_OK;
+
+        case MULTIPART_STATE_ERROR:
+            break;
+        }
+        i++;
+    }
+
+    if (p->err != ESP_OK) {
+        p->state = MULTIPART_STATE_ERROR;
+    }
+    return p->err;
+}
+
+bool multipart_parser_file_complete(const multipart_parser_t *p)
+{
+    return p->file_complete;
+}
@@ -0,0 +1,222 @@
+/**
+ * Host test of the multipart parser
+ * Random bodies are fed in random splits and the file part must come out
+ * unchanged, then the parse rate is measured at the OTA buffer size.
+ */
+#include "multipart_parser.h"
+#include "host_test.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BOUNDARY "----WebKitFormBoundary7MA4YWxkTrZu0gW"
+#define CORPUS_BODIES 3000
+#define CORPUS_FILE_MAX 3000
+#define CORPUS_LARGE_FILE (1024 * 1024)
+#define BENCH_FILE_SIZE (8 * 1024 * 1024)
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} collect_t;
+
+static esp_err_t collect(const uint8_t *data, size_t len, void *ctx)
+{
+    collect_t *out = ctx;
+    if (out->len + len > out->cap) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out->data + out->len, data, len);
+    out->len += len;
+    return ESP_OK;
+}
+
+static esp_err_t count_only(const uint8_t *data, size_t len, void *ctx)
+{
+    *(size_t *)ctx += len;
+    return ESP_OK;
+}
+
+static esp_err_t fail_cb(const uint8_t *data, size_t len, void *ctx)
+{
+    return ESP_ERR_NO_MEM;
+}
+
+/**
+ * File content biased towards delimiter look-alikes: CR, LF, dashes and
+ * an occasional truncated delimiter
+ */
+static void make_file(uint8_t *file, size_t len, uint32_t *rng)
+{
+    for (size_t i = 0; i < len; i++) {
+        switch (host_test_rand(rng) % 8) {
+            case 0: file[i] = '\r'; break;
+            case 1: file[i] = '\n'; break;
+            case 2: file[i] = '-'; break;
+            default: file[i] = host_test_rand(rng); break;
+        }
+    }
+    static const char near[] = "\r\n--" BOUNDARY;
+    if (len > sizeof(near) && host_test_rand(rng) % 3 == 0) {
+        // One byte short of a delimiter, at a random place
+        const size_t at = host_test_rand(rng) % (len - sizeof(near));
+        memcpy(file + at, near, sizeof(near) - 2);
+        // Random bytes could complete it
+        file[at + sizeof(near) - 2] = 'x';
+    }
+}
+
+/**
+ * Build a form with a text field, the file, and optional preamble and epilogue
+ */
+static size_t make_body(uint8_t *body, const uint8_t *file, size_t file_len, uint32_t *rng)
+{
+    size_t len = 0;
+    if (host_test_rand(rng) % 4 == 0) {
+        len += sprintf((char *)body, "This is the preamble.\r\n");
+    }
+    len += sprintf((char *)body + len,
+                   "--" BOUNDARY "\r\n"
+                   "Content-Disposition: form-data; name=\"note\"\r\n\r\n"
+                   "hello\r\n"
+                   "--" BOUNDARY "%s\r\n"
+                   "Content-Disposition: form-data; name=\"file\"; filename=\"fw.bin\"\r\n"
+                   "Content-Type: application/octet-stream\r\n\r\n",
+                   (host_test_rand(rng) % 4 == 0) ? " \t" : "");
+    memcpy(body + len, file, file_len);
+    len += file_len;
+    len += sprintf((char *)body + len, "\r\n--" BOUNDARY "--%s",
+                   (host_test_rand(rng) % 2) ? "\r\nepilogue" : "");
+    return len;
+}
+
+/**
+ * Feed a body in random splits, up to max_split bytes each
+ */
+static esp_err_t feed_split(multipart_parser_t *p, const uint8_t *body, size_t len, size_t max_split,
+                            uint32_t *rng)
+{
+    size_t off = 0;
+    while (off < len) {
+        size_t n = 1 + host_test_rand(rng) % max_split;
+        if (n > len - off) {
+            n = len - off;
+        }
+        esp_err_t ret = multipart_parser_feed(p, body + off, n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        off += n;
+    }
+    return ESP_OK;
+}
+
+static void test_random_corpus(void)
+{
+    uint32_t rng = 1;
+    uint8_t *file = malloc(CORPUS_LARGE_FILE);
+    uint8_t *body = malloc(CORPUS_LARGE_FILE + 1024);
+    collect_t out = {.data = malloc(CORPUS_LARGE_FILE), .cap = CORPUS_LARGE_FILE};
+    const char *content_types[] = {
+        "multipart/form-data; boundary=" BOUNDARY,
+        "multipart/form-data; boundary=\"" BOUNDARY "\"; charset=utf-8",
+    };
+
+    for (int i = 0; i < CORPUS_BODIES; i++) {
+        // Mostly small bodies, every tenth one large
+        const size_t file_len = (i % 10 == 9) ? CORPUS_LARGE_FILE - (host_test_rand(&rng) % 4096)
+                                              : host_test_rand(&rng) % CORPUS_FILE_MAX;
+        make_file(file, file_len, &rng);
+        const size_t body_len = make_body(body, file, file_len, &rng);
+        // Tiny splits hit every state boundary, large ones the zero-copy path
+        const size_t max_split = (i % 2) ? 7 : 5000;
+
+        multipart_parser_t p;
+        out.len = 0;
+        CHECK(multipart_parser_init(&p, content_types[i % 2], collect, &out) == ESP_OK);
+        esp_err_t ret = feed_split(&p, body, body_len, max_split, &rng);
+        CHECK(ret == ESP_OK);
+        CHECK(multipart_parser_file_complete(&p));
+        CHECK(out.len == file_len && memcmp(out.data, file, file_len) == 0);
+        if (host_test_failures > 0) {
+            fprintf(stderr, "body %d: %zu byte file, splits up to %zu\n", i, file_len, max_split);
+            break;
+        }
+    }
+
+    free(file);
+    free(body);
+    free(out.data);
+}
+
+static void test_malformed(void)
+{
+    multipart_parser_t p;
+    size_t count = 0;
+
+    CHECK(multipart_parser_init(&p, "multipart/form-data", count_only, &count) == ESP_ERR_INVALID_ARG);
+    CHECK(multipart_parser_feed(&p, (const uint8_t *)"x", 1) == ESP_ERR_INVALID_ARG);
+    CHECK(multipart_parser_init(&p, "multipart/form-data; boundary=\"open", count_only, &count) ==
+          ESP_ERR_INVALID_ARG);
+    CHECK(multipart_parser_init(&p, "multipart/form-data; boundary="
+                                    "12345678901234567890123456789012345678901234567890123456789012345678901",
+                                count_only, &count) == ESP_ERR_INVALID_ARG);
+
+    // Truncated: the file never ends
+    const char truncated[] = "--b\r\nContent-Disposition: form-data; name=\"f\"; filename=\"a\"\r\n\r\nabc";
+    CHECK(multipart_parser_init(&p, "multipart/form-data; boundary=b", count_only, &count) == ESP_OK);
+    CHECK(multipart_parser_feed(&p, (const uint8_t *)truncated, strlen(truncated)) == ESP_OK);
+    CHECK(!multipart_parser_file_complete(&p));
+
+    // Garbage after a delimiter
+    const char garbage[] = "--bXY\r\n";
+    CHECK(multipart_parser_init(&p, "multipart/form-data; boundary=b", count_only, &count) == ESP_OK);
+    CHECK(multipart_parser_feed(&p, (const uint8_t *)garbage, strlen(garbage)) == ESP_ERR_INVALID_ARG);
+
+    // Callback errors are sticky
+    const char body[] = "--b\r\nContent-Disposition: form-data; name=\"f\"; filename=\"a\"\r\n\r\nabc\r\n--b--";
+    CHECK(multipart_parser_init(&p, "multipart/form-data; boundary=b", fail_cb, NULL) == ESP_OK);
+    CHECK(multipart_parser_feed(&p, (const uint8_t *)body, strlen(body)) == ESP_ERR_NO_MEM);
+    CHECK(multipart_parser_feed(&p, (const uint8_t *)"x", 1) == ESP_ERR_NO_MEM);
+}
+
+/**
+ * Parse rate with the chunk sizes of the OTA upload and of a TCP segment
+ */
+static void bench_throughput(void)
+{
+    uint32_t rng = 2;
+    uint8_t *body = malloc(BENCH_FILE_SIZE + 1024);
+    size_t len = sprintf((char *)body, "--" BOUNDARY "\r\n"
+                         "Content-Disposition: form-data; name=\"file\"; filename=\"fw.bin\"\r\n\r\n");
+    for (size_t i = 0; i < BENCH_FILE_SIZE; i++) {
+        body[len + i] = host_test_rand(&rng);
+    }
+    len += BENCH_FILE_SIZE;
+    len += sprintf((char *)body + len, "\r\n--" BOUNDARY "--\r\n");
+
+    const size_t chunks[] = {4096, 1460};
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        multipart_parser_t p;
+        size_t count = 0;
+        multipart_parser_init(&p, "multipart/form-data; boundary=" BOUNDARY, count_only, &count);
+
+        const uint64_t start = host_test_now_ns();
+        for (size_t off = 0; off < len; off += chunks[c]) {
+            multipart_parser_feed(&p, body + off, (len - off < chunks[c]) ? len - off : chunks[c]);
+        }
+        const double seconds = (host_test_now_ns() - start) / 1e9;
+
+        CHECK(count == BENCH_FILE_SIZE && multipart_parser_file_complete(&p));
+        printf("multipart_parser: %zu byte chunks: %.0f MB/s\n", chunks[c], BENCH_FILE_SIZE / seconds / 1e6);
+    }
+    free(body);
+}
+
+int main(void)
+{
+    test_random_corpus();
+    test_malformed();
+    bench_throughput();
+    return host_test_result("multipart_parser");
+}
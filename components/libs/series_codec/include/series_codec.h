@@ -0,0 +1,112 @@
+#ifndef SERIES_CODEC_H
+#define SERIES_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+// Worst case size of one encoded sample in bits (timestamp 36, two values 19 each)
+#define SERIES_CODEC_MAX_SAMPLE_BITS 74
+
+// Buffer size that always holds n encoded samples
+#define SERIES_CODEC_MAX_BYTES(n) ((((size_t)(n)) * SERIES_CODEC_MAX_SAMPLE_BITS + 7) / 8)
+
+/**
+ * Streaming encoder for (timestamp, temperature, humidity) series
+ *
+ * Gorilla-style bit packing:
+ * - the first sample is stored verbatim (32 + 16 + 16 bits)
+ * - timestamps as delta-of-delta: '0' for a steady interval, otherwise
+ *   '10' + 7 bits, '110' + 9 bits, '1110' + 12 bits or '1111' + 32 bits
+ * - values as zigzag fixed-point deltas to the previous sample: '0' for
+ *   no change, otherwise '10' + 4 bits, '110' + 8 bits or '111' + 16 bits
+ *
+ * Values are the DHT's native 0.1 °C / 0.1 % integers, so encoding is
+ * lossless. In frames of 32 samples (the history log's), a steady 2 s
+ * series costs about 0.67 bytes per sample instead of 8; with sensor
+ * noise or read-time jitter about 1.7 (see test/test_series_codec.c).
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t capacity;        // Bytes
+    size_t bits;            // Bits written
+    uint32_t count;         // Samples encoded
+    uint32_t prev_ts;
+    int64_t prev_delta;
+    int16_t prev_temp;
+    uint16_t prev_hum;
+} series_encoder_t;
+
+/**
+ * Streaming decoder, reads what series_encoder_t wrote
+ */
+typedef struct {
+    const uint8_t *buf;
+    size_t size_bits;
+    size_t bits;            // Bits read
+    uint32_t remaining;     // Samples left to decode
+    bool first;
+    uint32_t prev_ts;
+    int64_t prev_delta;
+    int16_t prev_temp;
+    uint16_t prev_hum;
+} series_decoder_t;
+
+/**
+ * @brief Start encoding into a buffer
+ *
+ * The buffer is zeroed as samples are added, it does not need to be cleared.
+ *
+ * @param enc Encoder state
+ * @param buf Output buffer
+ * @param capacity Size of buf in bytes
+ */
+void series_encoder_init(series_encoder_t *enc, uint8_t *buf, size_t capacity);
+
+/**
+ * @brief Append a sample
+ *
+ * Timestamps must not decrease. If the sample does not fit, the encoder is
+ * left unchanged so the caller can finish the buffer and start a new one.
+ *
+ * @param enc Encoder state
+ * @param timestamp Sample time in seconds
+ * @param temp Temperature in 0.1 °C
+ * @param hum Relative humidity in 0.1 %
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the timestamp went back,
+ *         ESP_ERR_NO_MEM if the sample does not fit
+ */
+esp_err_t series_encoder_add(series_encoder_t *enc, uint32_t timestamp, int16_t temp, uint16_t hum);
+
+/**
+ * @brief Get the encoded size
+ *
+ * @param enc Encoder state
+ * @return Number of bytes used in the buffer
+ */
+size_t series_encoder_size(const series_encoder_t *enc);
+
+/**
+ * @brief Start decoding a buffer
+ *
+ * @param dec Decoder state
+ * @param buf Encoded data
+ * @param size Size of buf in bytes
+ * @param count Number of samples encoded in buf
+ */
+void series_decoder_init(series_decoder_t *dec, const uint8_t *buf, size_t size, uint32_t count);
+
+/**
+ * @brief Decode the next sample
+ *
+ * @param dec Decoder state
+ * @param timestamp Receives the sample time
+ * @param temp Receives the temperature in 0.1 °C
+ * @param hum Receives the relative humidity in 0.1 %
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND after the last sample,
+ *         ESP_ERR_INVALID_SIZE if the data is truncated
+ */
+esp_err_t series_decoder_next(series_decoder_t *dec, uint32_t *timestamp, int16_t *temp, uint16_t *hum);
+
+#endif // SERIES_CODEC_H
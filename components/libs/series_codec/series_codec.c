@@ -0,0 +1,288 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "series_codec.h"
+
+/**
+ * Write the low n bits of value, most significant first (n <= 32)
+ */
+static void put_bits(uint8_t *buf, size_t *pos, uint32_t value, unsigned n)
+{
+    while (n > 0) {
+        size_t byte = *pos >> 3;
+        unsigned used = *pos & 7;
+        unsigned space = 8 - used;
+        unsigned take = (n < space) ? n : space;
+        uint8_t chunk = (value >> (n - take)) & ((1u << take) - 1);
+
+        if (used == 0) {
+            buf[byte] = 0;
+        }
+        buf[byte] |= (uint8_t)(chunk << (space - take));
+        *pos += take;
+        n -= take;
+    }
+}
+
+/**
+ * Read n bits, most significant first (n <= 32)
+ */
+static uint32_t get_bits(const uint8_t *buf, size_t *pos, unsigned n)
+{
+    uint32_t value = 0;
+    while (n > 0) {
+        size_t byte = *pos >> 3;
+        unsigned used = *pos & 7;
+        unsigned space = 8 - used;
+        unsigned take = (n < space) ? n : space;
+        uint8_t chunk = (buf[byte] >> (space - take)) & ((1u << take) - 1);
+
+        value = (value << take) | chunk;
+        *pos += take;
+        n -= take;
+    }
+    return value;
+}
+
+static uint32_t zigzag_encode(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t zigzag_decode(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * Timestamp delta-of-delta buckets: prefix, prefix length, payload bits, bias
+ */
+typedef struct {
+    uint8_t prefix;
+    uint8_t prefix_bits;
+    uint8_t payload_bits;
+    int32_t bias;
+} ts_bucket_t;
+
+static const ts_bucket_t ts_buckets[] = {
+    { 0x2, 2, 7, 63 },      // '10'   [-63, 64]
+    { 0x6, 3, 9, 255 },     // '110'  [-255, 256]
+    { 0xE, 4, 12, 2047 },   // '1110' [-2047, 2048]
+};
+
+// '1111' + the plain 32-bit delta
+#define TS_ESCAPE_PREFIX 0xF
+#define TS_ESCAPE_PREFIX_BITS 4
+
+static unsigned timestamp_bits(int64_t dod)
+{
+    if (dod == 0) {
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(ts_buckets) / sizeof(ts_buckets[0]); i++) {
+        const ts_bucket_t *b = &ts_buckets[i];
+        if (dod >= -b->bias && dod <= (int64_t)(1 << b->payload_bits) - 1 - b->bias) {
+            return b->prefix_bits + b->payload_bits;
+        }
+    }
+    return TS_ESCAPE_PREFIX_BITS + 32;
+}
+
+static void timestamp_put(uint8_t *buf, size_t *pos, int64_t dod, uint32_t delta)
+{
+    if (dod == 0) {
+        put_bits(buf, pos, 0, 1);
+        return;
+    }
+    for (size_t i = 0; i < sizeof(ts_buckets) / sizeof(ts_buckets[0]); i++) {
+        const ts_bucket_t *b = &ts_buckets[i];
+        if (dod >= -b->bias && dod <= (int64_t)(1 << b->payload_bits) - 1 - b->bias) {
+            put_bits(buf, pos, b->prefix, b->prefix_bits);
+            put_bits(buf, pos, (uint32_t)(dod + b->bias), b->payload_bits);
+            return;
+        }
+    }
+    put_bits(buf, pos, TS_ESCAPE_PREFIX, TS_ESCAPE_PREFIX_BITS);
+    put_bits(buf, pos, delta, 32);
+}
+
+/**
+ * Value encoding: '0' unchanged, '10' + 4-bit zigzag delta,
+ * '110' + 8-bit zigzag delta, '111' + the plain 16-bit value
+ */
+static unsigned value_bits(int32_t delta)
+{
+    uint32_t zz = zigzag_encode(delta);
+    if (zz == 0) return 1;
+    if (zz < 16) return 2 + 4;
+    if (zz < 256) return 3 + 8;
+    return 3 + 16;
+}
+
+static void value_put(uint8_t *buf, size_t *pos, int32_t delta, uint16_t value)
+{
+    uint32_t zz = zigzag_encode(delta);
+    if (zz == 0) {
+        put_bits(buf, pos, 0x0, 1);
+    } else if (zz < 16) {
+        put_bits(buf, pos, 0x2, 2);
+        put_bits(buf, pos, zz, 4);
+    } else if (zz < 256) {
+        put_bits(buf, pos, 0x6, 3);
+        put_bits(buf, pos, zz, 8);
+    } else {
+        put_bits(buf, pos, 0x7, 3);
+        put_bits(buf, pos, value, 16);
+    }
+}
+
+/**
+ * Decode a value, or return false if the data is truncated
+ */
+static bool value_get(series_decoder_t *dec, uint16_t prev, uint16_t *value)
+{
+    if (dec->bits + 1 > dec->size_bits) return false;
+    if (get_bits(dec->buf, &dec->bits, 1) == 0) {
+        *value = prev;
+        return true;
+    }
+
+    if (dec->bits + 1 > dec->size_bits) return false;
+    unsigned payload_bits;
+    if (get_bits(dec->buf, &dec->bits, 1) == 0) {
+        payload_bits = 4;
+    } else {
+        if (dec->bits + 1 > dec->size_bits) return false;
+        payload_bits = (get_bits(dec->buf, &dec->bits, 1) == 0) ? 8 : 16;
+    }
+
+    if (dec->bits + payload_bits > dec->size_bits) return false;
+    uint32_t payload = get_bits(dec->buf, &dec->bits, payload_bits);
+    *value = (payload_bits == 16) ? (uint16_t)payload : (uint16_t)(prev + zigzag_decode(payload));
+    return true;
+}
+
+void series_encoder_init(series_encoder_t *enc, uint8_t *buf, size_t capacity)
+{
+    *enc = (series_encoder_t) {
+        .buf = buf,
+        .capacity = capacity,
+    };
+}
+
+esp_err_t series_encoder_add(series_encoder_t *enc, uint32_t timestamp, int16_t temp, uint16_t hum)
+{
+    if (enc->count == 0) {
+        if (enc->bits + 64 > enc->capacity * 8) {
+            return ESP_ERR_NO_MEM;
+        }
+        put_bits(enc->buf, &enc->bits, timestamp, 32);
+        put_bits(enc->buf, &enc->bits, (uint16_t)temp, 16);
+        put_bits(enc->buf, &enc->bits, hum, 16);
+    } else {
+        if (timestamp < enc->prev_ts) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        const uint32_t delta = timestamp - enc->prev_ts;
+        const int64_t dod = (int64_t)delta - enc->prev_delta;
+        const int32_t temp_delta = (int32_t)temp - enc->prev_temp;
+        const int32_t hum_delta = (int32_t)hum - enc->prev_hum;
+
+        // Check the fit first so a full buffer leaves the encoder untouched
+        size_t needed = timestamp_bits(dod) + value_bits(temp_delta) + value_bits(hum_delta);
+        if (enc->bits + needed > enc->capacity * 8) {
+            return ESP_ERR_NO_MEM;
+        }
+
+        timestamp_put(enc->buf, &enc->bits, dod, delta);
+        value_put(enc->buf, &enc->bits, temp_delta, (uint16_t)temp);
+        value_put(enc->buf, &enc->bits, hum_delta, hum);
+        enc->prev_delta = delta;
+    }
+
+    enc->prev_ts = timestamp;
+    enc->prev_temp = temp;
+    enc->prev_hum = hum;
+    enc->count++;
+    return ESP_OK;
+}
+
+size_t series_encoder_size(const series_encoder_t *enc)
+{
+    return (enc->bits + 7) / 8;
+}
+
+void series_decoder_init(series_decoder_t *dec, const uint8_t *buf, size_t size, uint32_t count)
+{
+    *dec = (series_decoder_t) {
+        .buf = buf,
+        .size_bits = size * 8,
+        .remaining = count,
+        .first = true,
+    };
+}
+
+esp_err_t series_decoder_next(series_decoder_t *dec, uint32_t *timestamp, int16_t *temp, uint16_t *hum)
+{
+    if (dec->remaining == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (dec->first) {
+        if (dec->bits + 64 > dec->size_bits) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        dec->prev_ts = get_bits(dec->buf, &dec->bits, 32);
+        dec->prev_temp = (int16_t)get_bits(dec->buf, &dec->bits, 16);
+        dec->prev_hum = (uint16_t)get_bits(dec->buf, &dec->bits, 16);
+        dec->first = false;
+    } else {
+        // Count the leading ones of the timestamp prefix (at most 4)
+        unsigned ones = 0;
+        while (ones < TS_ESCAPE_PREFIX_BITS) {
+            if (dec->bits + 1 > dec->size_bits) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            if (get_bits(dec->buf, &dec->bits, 1) == 0) {
+                break;
+            }
+            ones++;
+        }
+
+        uint32_t delta;
+        if (ones == 0) {
+            delta = (uint32_t)dec->prev_delta;
+        } else if (ones < TS_ESCAPE_PREFIX_BITS) {
+            const ts_bucket_t *b = &ts_buckets[ones - 1];
+            if (dec->bits + b->payload_bits > dec->size_bits) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            int64_t dod = (int64_t)get_bits(dec->buf, &dec->bits, b->payload_bits) - b->bias;
+            delta = (uint32_t)(dec->prev_delta + dod);
+        } else {
+            if (dec->bits + 32 > dec->size_bits) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            delta = get_bits(dec->buf, &dec->bits, 32);
+        }
+
+        uint16_t temp_bits;
+        uint16_t hum_value;
+        if (!value_get(dec, (uint16_t)dec->prev_temp, &temp_bits) ||
+            !value_get(dec, dec->prev_hum, &hum_value)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        dec->prev_ts += delta;
+        dec->prev_delta = delta;
+        dec->prev_temp = (int16_t)temp_bits;
+        dec->prev_hum = hum_value;
+    }
+
+    *timestamp = dec->prev_ts;
+    *temp = dec->prev_temp;
+    *hum = dec->prev_hum;
+    dec->remaining--;
+    return ESP_OK;
+}
@@ -0,0 +1,262 @@
+/**
+ * Host test and benchmark of the series codec
+ * Synthetic DHT traces are encoded in frames of the history log's size
+ * and must decode to the exact input; bytes per sample and the encode and
+ * decode cost per sample are reported per trace. Edge cases cover value
+ * extremes, large timestamp gaps, full buffers and truncated input.
+ */
+#include "series_codec.h"
+#include "host_test.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_SAMPLES 200000
+#define START_TS 1700000000u
+// Frames as the history log writes them (HISTORY_LOG_BUFFER_RECORDS)
+#define FRAME_SAMPLES 32
+#define FRAME_MAX_BYTES SERIES_CODEC_MAX_BYTES(FRAME_SAMPLES)
+#define BENCH_ROUNDS 5
+
+typedef struct {
+    uint32_t timestamp;
+    int16_t temp;
+    uint16_t hum;
+} sample_t;
+
+typedef enum {
+    TRACE_STEADY,       // 2 s reads, slow daily swing
+    TRACE_NOISY,        // Sensor noise of a few tenths
+    TRACE_JITTER,       // Read times off by a second now and then, missed reads
+    TRACE_RANDOM,       // Nothing to compress
+} trace_kind_t;
+
+static const char *const trace_names[] = {"steady", "noisy", "jitter", "random"};
+
+static void make_trace(trace_kind_t kind, sample_t *samples, size_t count)
+{
+    uint32_t rng = 7 + kind;
+    uint32_t ts = START_TS;
+
+    for (size_t i = 0; i < count; i++) {
+        double day = 2 * M_PI * (i * 2) / 86400.0;
+        int temp = 215 + (int)lround(30 * sin(day));
+        int hum = 450 - (int)lround(80 * sin(day));
+        uint32_t step = 2;
+
+        switch (kind) {
+            case TRACE_STEADY:
+                break;
+            case TRACE_NOISY:
+                temp += (int)(host_test_rand(&rng) % 5) - 2;
+                hum += (int)(host_test_rand(&rng) % 9) - 4;
+                break;
+            case TRACE_JITTER:
+                temp += (int)(host_test_rand(&rng) % 3) - 1;
+                hum += (int)(host_test_rand(&rng) % 5) - 2;
+                switch (host_test_rand(&rng) % 50) {
+                    case 0: step = 3; break;
+                    case 1: step = 1; break;
+                    case 2: step = 4 + host_test_rand(&rng) % 60; break;
+                    default: break;
+                }
+                break;
+            case TRACE_RANDOM:
+                temp = (int)(host_test_rand(&rng) % 1201) - 400;
+                hum = (int)(host_test_rand(&rng) % 1001);
+                // Up to 20000 s apart: timestamps stay within 32 bits over the trace
+                step = host_test_rand(&rng) % 20000;
+                break;
+        }
+
+        if (i > 0) {
+            ts += step;
+        }
+        samples[i] = (sample_t){ .timestamp = ts, .temp = (int16_t)temp, .hum = (uint16_t)hum };
+    }
+}
+
+/**
+ * Encode in frames of FRAME_SAMPLES
+ *
+ * @return Total encoded size in bytes
+ */
+static size_t encode_frames(const sample_t *samples, size_t count, uint8_t *out, size_t *frame_sizes)
+{
+    size_t total = 0;
+    for (size_t f = 0; f * FRAME_SAMPLES < count; f++) {
+        series_encoder_t enc;
+        series_encoder_init(&enc, out + total, FRAME_MAX_BYTES);
+        size_t n = count - f * FRAME_SAMPLES < FRAME_SAMPLES ? count - f * FRAME_SAMPLES : FRAME_SAMPLES;
+        for (size_t i = 0; i < n; i++) {
+            const sample_t *s = &samples[f * FRAME_SAMPLES + i];
+            CHECK(series_encoder_add(&enc, s->timestamp, s->temp, s->hum) == ESP_OK);
+        }
+        frame_sizes[f] = series_encoder_size(&enc);
+        total += frame_sizes[f];
+    }
+    return total;
+}
+
+/**
+ * Decode the frames written by encode_frames
+ *
+ * @return Number of samples that differ from the input
+ */
+static size_t decode_frames(const sample_t *samples, size_t count, const uint8_t *in, const size_t *frame_sizes)
+{
+    size_t mismatches = 0;
+    size_t offset = 0;
+    for (size_t f = 0; f * FRAME_SAMPLES < count; f++) {
+        size_t n = count - f * FRAME_SAMPLES < FRAME_SAMPLES ? count - f * FRAME_SAMPLES : FRAME_SAMPLES;
+        series_decoder_t dec;
+        series_decoder_init(&dec, in + offset, frame_sizes[f], n);
+        for (size_t i = 0; i < n; i++) {
+            sample_t out;
+            const sample_t *s = &samples[f * FRAME_SAMPLES + i];
+            if (series_decoder_next(&dec, &out.timestamp, &out.temp, &out.hum) != ESP_OK ||
+                out.timestamp != s->timestamp || out.temp != s->temp || out.hum != s->hum) {
+                mismatches++;
+            }
+        }
+        uint32_t ts;
+        int16_t temp;
+        uint16_t hum;
+        if (series_decoder_next(&dec, &ts, &temp, &hum) != ESP_ERR_NOT_FOUND) {
+            mismatches++;
+        }
+        offset += frame_sizes[f];
+    }
+    return mismatches;
+}
+
+static void bench_trace(trace_kind_t kind)
+{
+    sample_t *samples = malloc(TRACE_SAMPLES * sizeof(sample_t));
+    size_t frames = (TRACE_SAMPLES + FRAME_SAMPLES - 1) / FRAME_SAMPLES;
+    uint8_t *encoded = malloc(frames * FRAME_MAX_BYTES);
+    size_t *frame_sizes = malloc(frames * sizeof(size_t));
+    CHECK(samples != NULL && encoded != NULL && frame_sizes != NULL);
+    if (samples == NULL || encoded == NULL || frame_sizes == NULL) {
+        goto out;
+    }
+    make_trace(kind, samples, TRACE_SAMPLES);
+
+    uint64_t encode_ns = UINT64_MAX, decode_ns = UINT64_MAX;
+    size_t total = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t start = host_test_now_ns();
+        total = encode_frames(samples, TRACE_SAMPLES, encoded, frame_sizes);
+        uint64_t mid = host_test_now_ns();
+        size_t mismatches = decode_frames(samples, TRACE_SAMPLES, encoded, frame_sizes);
+        uint64_t end = host_test_now_ns();
+        CHECK(mismatches == 0);
+        encode_ns = (mid - start < encode_ns) ? mid - start : encode_ns;
+        decode_ns = (end - mid < decode_ns) ? end - mid : decode_ns;
+    }
+
+    const double bytes_per_sample = (double)total / TRACE_SAMPLES;
+    CHECK(total <= frames * FRAME_MAX_BYTES);
+    // Slowly changing readings have to compress well below the 8 bytes of a plain record
+    if (kind != TRACE_RANDOM) {
+        CHECK(bytes_per_sample < 2.0);
+    }
+    printf("  %-7s %5.2f bytes/sample (%4.1f bits, %4.1fx vs 8 bytes), encode %5.1f ns/sample, "
+           "decode %5.1f ns/sample\n",
+           trace_names[kind], bytes_per_sample, bytes_per_sample * 8, 8 / bytes_per_sample,
+           (double)encode_ns / TRACE_SAMPLES, (double)decode_ns / TRACE_SAMPLES);
+
+out:
+    free(samples);
+    free(encoded);
+    free(frame_sizes);
+}
+
+static void test_extremes(void)
+{
+    static const sample_t samples[] = {
+        {0, INT16_MIN, 0},
+        {0, INT16_MAX, UINT16_MAX},
+        {1, INT16_MIN, UINT16_MAX},
+        {UINT32_MAX / 2, 0, 0},
+        {UINT32_MAX / 2 + 2, -1, 1},
+        {UINT32_MAX / 2 + 4, 1, UINT16_MAX},
+        {UINT32_MAX - 1, INT16_MAX, 0},
+        {UINT32_MAX, INT16_MIN, 32768},
+        {UINT32_MAX, INT16_MIN, 32768},
+    };
+    const size_t count = sizeof(samples) / sizeof(samples[0]);
+    uint8_t buf[SERIES_CODEC_MAX_BYTES(sizeof(samples) / sizeof(samples[0]))];
+    series_encoder_t enc;
+    series_encoder_init(&enc, buf, sizeof(buf));
+    for (size_t i = 0; i < count; i++) {
+        CHECK(series_encoder_add(&enc, samples[i].timestamp, samples[i].temp, samples[i].hum) == ESP_OK);
+    }
+    // Worst case bound holds
+    CHECK(series_encoder_size(&enc) <= sizeof(buf));
+
+    series_decoder_t dec;
+    series_decoder_init(&dec, buf, series_encoder_size(&enc), count);
+    for (size_t i = 0; i < count; i++) {
+        sample_t out;
+        CHECK(series_decoder_next(&dec, &out.timestamp, &out.temp, &out.hum) == ESP_OK);
+        CHECK(out.timestamp == samples[i].timestamp && out.temp == samples[i].temp &&
+              out.hum == samples[i].hum);
+    }
+
+    // Timestamps must not go back
+    CHECK(series_encoder_add(&enc, 5, 0, 0) == ESP_ERR_INVALID_ARG);
+}
+
+static void test_full_buffer(void)
+{
+    sample_t samples[64];
+    make_trace(TRACE_NOISY, samples, 64);
+
+    // A sample that does not fit leaves the encoder as it was
+    uint8_t buf[16];
+    series_encoder_t enc;
+    series_encoder_init(&enc, buf, sizeof(buf));
+    size_t added = 0;
+    while (added < 64 && series_encoder_add(&enc, samples[added].timestamp, samples[added].temp,
+                                            samples[added].hum) == ESP_OK) {
+        added++;
+    }
+    CHECK(added > 1 && added < 64);
+    const size_t size = series_encoder_size(&enc);
+    CHECK(size <= sizeof(buf));
+    CHECK(series_encoder_add(&enc, samples[added].timestamp, samples[added].temp, samples[added].hum) ==
+          ESP_ERR_NO_MEM);
+    CHECK(series_encoder_size(&enc) == size);
+
+    series_decoder_t dec;
+    series_decoder_init(&dec, buf, size, added);
+    for (size_t i = 0; i < added; i++) {
+        sample_t out;
+        CHECK(series_decoder_next(&dec, &out.timestamp, &out.temp, &out.hum) == ESP_OK);
+        CHECK(out.timestamp == samples[i].timestamp && out.temp == samples[i].temp && out.hum == samples[i].hum);
+    }
+
+    // Claiming more samples than the data holds fails instead of reading past it
+    for (size_t cut = 0; cut < size; cut++) {
+        series_decoder_init(&dec, buf, cut, added);
+        esp_err_t ret = ESP_OK;
+        sample_t out;
+        for (size_t i = 0; i < added && ret == ESP_OK; i++) {
+            ret = series_decoder_next(&dec, &out.timestamp, &out.temp, &out.hum);
+        }
+        CHECK(ret == ESP_ERR_INVALID_SIZE);
+    }
+}
+
+int main(void)
+{
+    test_extremes();
+    test_full_buffer();
+
+    printf("%d samples per trace, frames of %d samples:\n", TRACE_SAMPLES, FRAME_SAMPLES);
+    for (trace_kind_t kind = TRACE_STEADY; kind <= TRACE_RANDOM; kind++) {
+        bench_trace(kind);
+    }
+    return host_test_result("series_codec");
+}
@@ -0,0 +1,62 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Lock-free single-producer single-consumer ring of fixed-size items
+ *
+ * One task pushes, one task pops; neither ever blocks or takes a lock.
+ * The producer owns head, the consumer owns tail, and each publishes its
+ * index with release ordering after touching the item, so the other side
+ * sees the item complete once it sees the index move. Indices run freely
+ * and wrap, the capacity must be a power of two.
+ *
+ * Waiting on a full or empty ring is up to the caller (e.g. a task
+ * notification from the other side).
+ */
+typedef struct {
+    uint8_t *items;
+    size_t item_size;
+    size_t mask;            // Capacity - 1
+    atomic_size_t head;     // Next slot to push, written by the producer only
+    atomic_size_t tail;     // Next slot to pop, written by the consumer only
+} spsc_ring_t;
+
+/**
+ * @brief Set up an empty ring
+ *
+ * @param r Ring state
+ * @param storage Room for capacity items
+ * @param item_size Size of one item in bytes
+ * @param capacity Number of items, a power of two
+ */
+void spsc_ring_init(spsc_ring_t *r, void *storage, size_t item_size, size_t capacity);
+
+/**
+ * @brief Append an item (producer only)
+ *
+ * @param r Ring state
+ * @param item Item to copy in
+ * @return true on success, false if the ring is full
+ */
+bool spsc_ring_push(spsc_ring_t *r, const void *item);
+
+/**
+ * @brief Take the oldest item (consumer only)
+ *
+ * @param r Ring state
+ * @param item Receives the item
+ * @return true on success, false if the ring is empty
+ */
+bool spsc_ring_pop(spsc_ring_t *r, void *item);
+
+/**
+ * @brief Number of items queued, a snapshot when called by neither side
+ */
+size_t spsc_ring_count(const spsc_ring_t *r);
+
+#endif // SPSC_RING_H
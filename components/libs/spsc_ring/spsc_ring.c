@@ -0,0 +1,44 @@
+#include <string.h>
+
+#include "spsc_ring.h"
+
+void spsc_ring_init(spsc_ring_t *r, void *storage, size_t item_size, size_t capacity)
+{
+    r->items = storage;
+    r->item_size = item_size;
+    r->mask = capacity - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+}
+
+bool spsc_ring_push(spsc_ring_t *r, const void *item)
+{
+    const size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail > r->mask) {
+        return false;
+    }
+
+    memcpy(r->items + (head & r->mask) * r->item_size, item, r->item_size);
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool spsc_ring_pop(spsc_ring_t *r, void *item)
+{
+    const size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+
+    memcpy(item, r->items + (tail & r->mask) * r->item_size, r->item_size);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+size_t spsc_ring_count(const spsc_ring_t *r)
+{
+    return atomic_load_explicit(&r->head, memory_order_acquire) -
+           atomic_load_explicit(&r->tail, memory_order_acquire);
+}
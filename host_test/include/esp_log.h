@@ -0,0 +1,26 @@
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+/**
+ * Host stand-in for ESP-IDF's esp_log.h
+ * Errors and warnings go to stderr; info and below are compiled out (the
+ * format is still checked) so they do not skew the benchmarks.
+ */
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+
+#define HOST_LOG_NONE(tag, format, ...)                 \
+    do {                                                \
+        if (0) {                                        \
+            printf("%s: " format, tag, ##__VA_ARGS__);  \
+        }                                               \
+    } while (0)
+
+#define ESP_LOGI(tag, format, ...) HOST_LOG_NONE(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG_NONE(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG_NONE(tag, format, ##__VA_ARGS__)
+
+#endif // HOST_ESP_LOG_H
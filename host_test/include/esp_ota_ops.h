@@ -0,0 +1,31 @@
+#ifndef HOST_ESP_OTA_OPS_H
+#define HOST_ESP_OTA_OPS_H
+
+/**
+ * Host stand-in for ESP-IDF's esp_ota_ops.h
+ * Only what the OTA helpers use; the test provides the functions.
+ */
+
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#define ESP_ERR_OTA_BASE                0x1500
+#define ESP_ERR_OTA_VALIDATE_FAILED     (ESP_ERR_OTA_BASE + 0x03)
+
+// esp_ota_begin() image sizes: erase the whole partition, or each sector as it is entered
+#define OTA_SIZE_UNKNOWN                0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES      0xfffffffe
+
+typedef uint32_t esp_ota_handle_t;
+
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle);
+esp_err_t esp_ota_resume(const esp_partition_t *partition, size_t erase_size, size_t image_offset,
+                         esp_ota_handle_t *out_handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
+
+#endif // HOST_ESP_OTA_OPS_H
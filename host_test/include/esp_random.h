@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_RANDOM_H
+#define HOST_ESP_RANDOM_H
+
+/**
+ * Host stand-in for esp_random.h, implemented by the tests
+ */
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
+
+#endif // HOST_ESP_RANDOM_H
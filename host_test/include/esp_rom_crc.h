@@ -0,0 +1,13 @@
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+/**
+ * Host stand-in for esp_rom_crc.h
+ * Same results as the ROM: esp_rom_crc32_le(0, ...) is the zlib CRC-32.
+ */
+
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif // HOST_ESP_ROM_CRC_H
@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_ROM_SYS_H
+#define HOST_ESP_ROM_SYS_H
+
+/**
+ * Host stand-in for esp_rom_sys.h, implemented by the tests
+ */
+
+#include <stdint.h>
+
+void esp_rom_delay_us(uint32_t us);
+
+#endif // HOST_ESP_ROM_SYS_H
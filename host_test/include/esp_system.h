@@ -0,0 +1,15 @@
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+/**
+ * Host stand-in for esp_system.h, implemented by the tests
+ */
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle);
+void esp_restart(void);
+
+#endif // HOST_ESP_SYSTEM_H
@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+/**
+ * Host stand-in for esp_timer.h, implemented by the tests
+ */
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,42 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+/**
+ * Host stand-in for FreeRTOS.h
+ * Only types and declarations: the tests that include FreeRTOS headers
+ * implement the kernel calls they use, usually on a virtual clock.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+
+// ESP-IDF default (CONFIG_FREERTOS_HZ)
+#define configTICK_RATE_HZ 100
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+
+// A spinlock, as on the target; on the host its holder can still be preempted
+typedef struct {
+    atomic_flag locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { .locked = ATOMIC_FLAG_INIT }
+
+void vPortDisableInterrupts(void);
+void vPortEnableInterrupts(void);
+#define portDISABLE_INTERRUPTS() vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS() vPortEnableInterrupts()
+
+#endif // HOST_FREERTOS_H
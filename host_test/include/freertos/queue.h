@@ -0,0 +1,12 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+/**
+ * Host stand-in for FreeRTOS queue.h: only the handle type
+ */
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct QueueDefinition *QueueHandle_t;
+
+#endif // HOST_FREERTOS_QUEUE_H
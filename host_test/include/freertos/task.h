@@ -0,0 +1,35 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+/**
+ * Host stand-in for FreeRTOS task.h
+ * The tests implement the task calls; critical sections take the spinlock.
+ */
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake, TickType_t increment);
+TickType_t xTaskGetTickCount(void);
+
+static inline void host_critical_enter(portMUX_TYPE *mux)
+{
+    while (atomic_flag_test_and_set_explicit(&mux->locked, memory_order_acquire)) {
+    }
+}
+
+static inline void host_critical_exit(portMUX_TYPE *mux)
+{
+    atomic_flag_clear_explicit(&mux->locked, memory_order_release);
+}
+
+#define taskENTER_CRITICAL(mux) host_critical_enter(mux)
+#define taskEXIT_CRITICAL(mux) host_critical_exit(mux)
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,54 @@
+#ifndef HOST_PARTITION_H
+#define HOST_PARTITION_H
+
+/**
+ * File-backed flash partitions for the host tests
+ * Implements the esp_partition.h calls on image files with NOR flash
+ * rules: erasing sets a sector to 0xFF and writing can only clear bits.
+ * The image outlives the process, so a test can reboot by reopening it
+ * in a new process.
+ */
+
+#include "esp_partition.h"
+
+#define HOST_PARTITION_SECTOR_SIZE 4096
+
+/**
+ * Flash traffic of a partition since it was added or the stats were reset
+ */
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t erases;            // Sectors erased
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    uint32_t write_conflicts;   // Writes that tried to set bits without an erase
+} host_partition_stats_t;
+
+/**
+ * Add a partition backed by an image file
+ * A missing or short file is extended with erased flash; existing
+ * contents are kept.
+ *
+ * @return The partition, or NULL if the file cannot be opened or the table is full
+ */
+const esp_partition_t *host_partition_add(const char *label, esp_partition_type_t type,
+                                          esp_partition_subtype_t subtype, uint32_t size, const char *path);
+
+/**
+ * Cut the next write short, as power loss would
+ * Only the first keep bytes of the next write reach the image, and the
+ * write reports ESP_FAIL.
+ */
+void host_partition_tear_next_write(const esp_partition_t *partition, size_t keep);
+
+/**
+ * Erase count of every sector, sectors entries
+ */
+const uint32_t *host_partition_sector_erases(const esp_partition_t *partition, size_t *sectors);
+
+void host_partition_get_stats(const esp_partition_t *partition, host_partition_stats_t *stats);
+
+void host_partition_reset_stats(const esp_partition_t *partition);
+
+#endif // HOST_PARTITION_H
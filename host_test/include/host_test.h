@@ -0,0 +1,62 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Minimal support for the host tests
+ * A failed CHECK is reported and counted, and the test goes on; main()
+ * returns host_test_result() so CTest sees the failures.
+ */
+
+static int host_test_failures = 0;
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++;                                                   \
+        }                                                                           \
+    } while (0)
+
+/**
+ * Monotonic time in nanoseconds, for the benchmarks
+ */
+static inline uint64_t host_test_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * xorshift32: fixed seeds keep the random corpora the same on every run
+ */
+static inline uint32_t host_test_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * Report the outcome
+ *
+ * @return Exit code for main()
+ */
+static inline int host_test_result(const char *name)
+{
+    if (host_test_failures > 0) {
+        printf("%s: %d check(s) failed\n", name, host_test_failures);
+        return 1;
+    }
+    printf("%s: passed\n", name);
+    return 0;
+}
+
+#endif // HOST_TEST_H
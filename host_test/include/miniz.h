@@ -0,0 +1,48 @@
+#ifndef HOST_MINIZ_H
+#define HOST_MINIZ_H
+
+/**
+ * Host stand-in for the ROM inflater (the tinfl part of miniz.h)
+ * Same interface and status codes as tinfl_decompress() with a wrapping
+ * output buffer, implemented on zlib's raw inflate (host_tinfl library).
+ * zlib's state lives in an arena inside the decompressor, so, as with
+ * tinfl, nothing needs freeing.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+// Decompression flags
+#define TINFL_FLAG_PARSE_ZLIB_HEADER 1
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+
+// Holds zlib's inflate state and window
+#define HOST_TINFL_ARENA_SIZE (48 * 1024)
+
+typedef enum {
+    TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS = -4,
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+typedef struct {
+    uint32_t m_state;           // 0 until the first call after tinfl_init
+    z_stream stream;
+    size_t arena_used;
+    _Alignas(16) uint8_t arena[HOST_TINFL_ARENA_SIZE];
+} tinfl_decompressor;
+
+#define tinfl_init(r) do { (r)->m_state = 0; } while (0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in_buf_next, size_t *in_buf_size,
+                              uint8_t *out_buf_start, uint8_t *out_buf_next, size_t *out_buf_size,
+                              const uint32_t decomp_flags);
+
+#endif // HOST_MINIZ_H
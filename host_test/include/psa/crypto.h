@@ -0,0 +1,48 @@
+#ifndef HOST_PSA_CRYPTO_H
+#define HOST_PSA_CRYPTO_H
+
+/**
+ * Host stand-in for the PSA Crypto API of mbedTLS
+ * Only SHA-256 hashing, implemented in software (src/psa_hash.c).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int32_t psa_status_t;
+typedef uint32_t psa_algorithm_t;
+
+#define PSA_SUCCESS                     ((psa_status_t)0)
+#define PSA_ERROR_NOT_SUPPORTED         ((psa_status_t)-134)
+#define PSA_ERROR_BAD_STATE             ((psa_status_t)-137)
+#define PSA_ERROR_BUFFER_TOO_SMALL      ((psa_status_t)-138)
+#define PSA_ERROR_INVALID_SIGNATURE     ((psa_status_t)-149)
+
+#define PSA_ALG_SHA_256                 ((psa_algorithm_t)0x02000009)
+#define PSA_HASH_LENGTH(alg)            32
+
+typedef struct {
+    psa_algorithm_t alg;        // 0 when inactive
+    uint32_t state[8];
+    uint64_t length;            // Bytes hashed
+    uint8_t block[64];
+    size_t block_len;
+} psa_hash_operation_t;
+
+#define PSA_HASH_OPERATION_INIT {0}
+
+static inline psa_hash_operation_t psa_hash_operation_init(void)
+{
+    const psa_hash_operation_t op = PSA_HASH_OPERATION_INIT;
+    return op;
+}
+
+psa_status_t psa_crypto_init(void);
+psa_status_t psa_hash_setup(psa_hash_operation_t *operation, psa_algorithm_t alg);
+psa_status_t psa_hash_update(psa_hash_operation_t *operation, const uint8_t *input, size_t input_length);
+psa_status_t psa_hash_finish(psa_hash_operation_t *operation, uint8_t *hash, size_t hash_size,
+                             size_t *hash_length);
+psa_status_t psa_hash_verify(psa_hash_operation_t *operation, const uint8_t *hash, size_t hash_length);
+psa_status_t psa_hash_abort(psa_hash_operation_t *operation);
+
+#endif // HOST_PSA_CRYPTO_H
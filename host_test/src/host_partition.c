@@ -0,0 +1,216 @@
+#include "host_partition.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_PARTITIONS 4
+
+typedef struct {
+    esp_partition_t partition;
+    int fd;
+    uint32_t *sector_erases;
+    host_partition_stats_t stats;
+    size_t tear_keep;
+    bool tear_next;
+} host_partition_t;
+
+static host_partition_t partitions[MAX_PARTITIONS];
+static size_t partition_count;
+
+static host_partition_t *lookup(const esp_partition_t *partition)
+{
+    for (size_t i = 0; i < partition_count; i++) {
+        if (&partitions[i].partition == partition) {
+            return &partitions[i];
+        }
+    }
+    return NULL;
+}
+
+static bool in_range(const host_partition_t *p, size_t offset, size_t size)
+{
+    return offset <= p->partition.size && size <= p->partition.size - offset;
+}
+
+const esp_partition_t *host_partition_add(const char *label, esp_partition_type_t type,
+                                          esp_partition_subtype_t subtype, uint32_t size, const char *path)
+{
+    if (partition_count == MAX_PARTITIONS || size % HOST_PARTITION_SECTOR_SIZE != 0) {
+        return NULL;
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    // Extend the image with erased flash
+    off_t end = lseek(fd, 0, SEEK_END);
+    size_t length = (end > 0) ? (size_t)end : 0;
+    uint8_t erased[HOST_PARTITION_SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    while (length < size) {
+        size_t chunk = (size - length < sizeof(erased)) ? size - length : sizeof(erased);
+        if (pwrite(fd, erased, chunk, length) != (ssize_t)chunk) {
+            close(fd);
+            return NULL;
+        }
+        length += chunk;
+    }
+
+    host_partition_t *p = &partitions[partition_count];
+    memset(p, 0, sizeof(*p));
+    p->fd = fd;
+    p->sector_erases = calloc(size / HOST_PARTITION_SECTOR_SIZE, sizeof(uint32_t));
+    if (p->sector_erases == NULL) {
+        close(fd);
+        return NULL;
+    }
+    p->partition.type = type;
+    p->partition.subtype = subtype;
+    p->partition.address = 0x10000 * (partition_count + 1);
+    p->partition.size = size;
+    p->partition.erase_size = HOST_PARTITION_SECTOR_SIZE;
+    strncpy(p->partition.label, label, sizeof(p->partition.label) - 1);
+    partition_count++;
+    return &p->partition;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    for (size_t i = 0; i < partition_count; i++) {
+        const esp_partition_t *partition = &partitions[i].partition;
+        if ((type == ESP_PARTITION_TYPE_ANY || partition->type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || partition->subtype == subtype) &&
+            (label == NULL || strcmp(partition->label, label) == 0)) {
+            return partition;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    host_partition_t *p = lookup(partition);
+    if (p == NULL || dst == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!in_range(p, src_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (pread(p->fd, dst, size, src_offset) != (ssize_t)size) {
+        return ESP_FAIL;
+    }
+    p->stats.reads++;
+    p->stats.read_bytes += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    host_partition_t *p = lookup(partition);
+    if (p == NULL || src == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!in_range(p, dst_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (p->tear_next) {
+        p->tear_next = false;
+        if (p->tear_keep < size) {
+            size = p->tear_keep;
+            ret = ESP_FAIL;
+        }
+    }
+
+    // Programming can only clear bits
+    uint8_t *merged = malloc(size > 0 ? size : 1);
+    if (merged == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (pread(p->fd, merged, size, dst_offset) != (ssize_t)size) {
+        free(merged);
+        return ESP_FAIL;
+    }
+    const uint8_t *bytes = src;
+    bool conflict = false;
+    for (size_t i = 0; i < size; i++) {
+        conflict |= (bytes[i] & ~merged[i]) != 0;
+        merged[i] &= bytes[i];
+    }
+    if (pwrite(p->fd, merged, size, dst_offset) != (ssize_t)size) {
+        ret = ESP_FAIL;
+    }
+    free(merged);
+
+    p->stats.writes++;
+    p->stats.write_bytes += size;
+    p->stats.write_conflicts += conflict;
+    return ret;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    host_partition_t *p = lookup(partition);
+    if (p == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset % HOST_PARTITION_SECTOR_SIZE != 0 || size % HOST_PARTITION_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!in_range(p, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t erased[HOST_PARTITION_SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (size_t sector = offset; sector < offset + size; sector += HOST_PARTITION_SECTOR_SIZE) {
+        if (pwrite(p->fd, erased, sizeof(erased), sector) != (ssize_t)sizeof(erased)) {
+            return ESP_FAIL;
+        }
+        p->sector_erases[sector / HOST_PARTITION_SECTOR_SIZE]++;
+        p->stats.erases++;
+    }
+    return ESP_OK;
+}
+
+void host_partition_tear_next_write(const esp_partition_t *partition, size_t keep)
+{
+    host_partition_t *p = lookup(partition);
+    if (p != NULL) {
+        p->tear_next = true;
+        p->tear_keep = keep;
+    }
+}
+
+const uint32_t *host_partition_sector_erases(const esp_partition_t *partition, size_t *sectors)
+{
+    host_partition_t *p = lookup(partition);
+    if (p == NULL) {
+        *sectors = 0;
+        return NULL;
+    }
+    *sectors = p->partition.size / HOST_PARTITION_SECTOR_SIZE;
+    return p->sector_erases;
+}
+
+void host_partition_get_stats(const esp_partition_t *partition, host_partition_stats_t *stats)
+{
+    host_partition_t *p = lookup(partition);
+    if (p != NULL) {
+        *stats = p->stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+void host_partition_reset_stats(const esp_partition_t *partition)
+{
+    host_partition_t *p = lookup(partition);
+    if (p != NULL) {
+        memset(&p->stats, 0, sizeof(p->stats));
+    }
+}
@@ -0,0 +1,77 @@
+#include "miniz.h"
+#include <string.h>
+
+enum {
+    STATE_START,
+    STATE_RUNNING,
+    STATE_DONE,
+    STATE_FAILED,
+};
+
+/**
+ * Bump allocator over the decompressor's arena, reset by tinfl_init
+ */
+static voidpf arena_alloc(voidpf opaque, uInt items, uInt size)
+{
+    tinfl_decompressor *r = opaque;
+    const size_t len = ((size_t)items * size + 15) & ~(size_t)15;
+    if (len > sizeof(r->arena) - r->arena_used) {
+        return Z_NULL;
+    }
+    void *ptr = r->arena + r->arena_used;
+    r->arena_used += len;
+    return ptr;
+}
+
+static void arena_free(voidpf opaque, voidpf ptr)
+{
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in_buf_next, size_t *in_buf_size,
+                              uint8_t *out_buf_start, uint8_t *out_buf_next, size_t *out_buf_size,
+                              const uint32_t decomp_flags)
+{
+    if (r->m_state == STATE_START) {
+        memset(&r->stream, 0, sizeof(r->stream));
+        r->stream.zalloc = arena_alloc;
+        r->stream.zfree = arena_free;
+        r->stream.opaque = r;
+        r->arena_used = 0;
+        const int window_bits = (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15;
+        if (inflateInit2(&r->stream, window_bits) != Z_OK) {
+            r->m_state = STATE_FAILED;
+        } else {
+            r->m_state = STATE_RUNNING;
+        }
+    }
+    if (r->m_state != STATE_RUNNING) {
+        *in_buf_size = 0;
+        *out_buf_size = 0;
+        return r->m_state == STATE_DONE ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+    }
+
+    // zlib keeps its own window, the output buffer only has to take the bytes
+    r->stream.next_in = (Bytef *)in_buf_next;
+    r->stream.avail_in = *in_buf_size;
+    r->stream.next_out = out_buf_next;
+    r->stream.avail_out = *out_buf_size;
+    const int ret = inflate(&r->stream, Z_NO_FLUSH);
+    *in_buf_size -= r->stream.avail_in;
+    *out_buf_size -= r->stream.avail_out;
+
+    switch (ret) {
+    case Z_STREAM_END:
+        r->m_state = STATE_DONE;
+        return TINFL_STATUS_DONE;
+    case Z_OK:
+    case Z_BUF_ERROR:
+        if (r->stream.avail_out == 0) {
+            return TINFL_STATUS_HAS_MORE_OUTPUT;
+        }
+        return (decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT
+                                                          : TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS;
+    default:
+        r->m_state = STATE_FAILED;
+        return TINFL_STATUS_FAILED;
+    }
+}
@@ -4,32 +4,25 @@
 var seconds 	= null;
 var otaTimerVar =  null;
 var wifiConnectInterval = null;
+var eventSource = null;
+var wifiConnectPending = false;
 
 /**
  * Initialize functions here.
  */
 $(document).ready(function(){
-	// Load critical data immediately
-	getSSID();
+	// SSID, firmware info and connection info in one request
+	loadStatus();
 	
-	// Stagger other requests to avoid connection queuing
-	// (max_open_sockets = 7, server uses 3 internally = 4 available)
+	// Sensor, time and connection status are pushed over /events;
+	// without EventSource support fall back to polling
 	setTimeout(function() {
-		getUpdateStatus();
-	}, 100);
-	
-	setTimeout(function() {
-		startDHTSensorInterval();  // This calls getDHTSensorValues() immediately
+		if (!startEventStream())
+		{
+			startPolling();
+		}
 	}, 200);
 	
-	setTimeout(function() {
-		startLocalTimeInterval();  // This calls getLocalTime() immediately
-	}, 300);
-	
-	setTimeout(function() {
-		getConnectInfo();
-	}, 400);
-	
 	$("#connect_wifi").on("click", function(){
 		checkCredentials();
 	}); 
@@ -38,6 +31,21 @@ $(document).ready(function(){
 	}); 
 });   
 
+/**
+ * Gets the initial page state from /status.json.
+ */
+function loadStatus()
+{
+	$.getJSON('/status.json?fields=ssid,ota,wifi', function(data) {
+		$("#ap_ssid").text(data.ssid.ssid);
+		if (data.ota)
+		{
+			showUpdateStatus(data.ota);
+		}
+		showConnectInfo(data.wifi);
+	});
+}
+
 /**
  * Gets file name and size for display on the web page.
  */        
@@ -115,29 +123,35 @@ function getUpdateStatus()
         method: 'POST',
         data: 'ota_update_status',
         dataType: 'json',
-        success: function(response) {
-            document.getElementById("latest_firmware").innerHTML = response.compile_date + " - " + response.compile_time
-
-            // If flashing was complete it will return a 1, else -1
-            // A return of 0 is just for information on the Latest Firmware request
-            if (response.ota_update_status == 1) 
-            {
-                // Set the countdown timer time
-                seconds = 10;
-                // Start the countdown timer
-                otaRebootTimer();
-            } 
-            else if (response.ota_update_status == -1)
-            {
-                document.getElementById("ota_update_status").innerHTML = "!!! Upload Error !!!";
-            }
-        },
+        success: showUpdateStatus,
         error: function() {
             // Silently fail - OTA status is not critical for page load
         }
     });
 }
 
+/**
+ * Shows the firmware info and the OTA result.
+ */
+function showUpdateStatus(response)
+{
+    document.getElementById("latest_firmware").innerHTML = response.compile_date + " - " + response.compile_time
+
+    // If flashing was complete it will return a 1, else -1
+    // A return of 0 is just for information on the Latest Firmware request
+    if (response.ota_update_status == 1) 
+    {
+        // Set the countdown timer time
+        seconds = 10;
+        // Start the countdown timer
+        otaRebootTimer();
+    } 
+    else if (response.ota_update_status == -1)
+    {
+        document.getElementById("ota_update_status").innerHTML = "!!! Upload Error !!!";
+    }
+}
+
 /**
  * Displays the reboot countdown.
  */
@@ -156,15 +170,70 @@ function otaRebootTimer()
     }
 }
 
+/**
+ * Opens the /events stream.
+ * @return false if the browser has no EventSource support.
+ */
+function startEventStream()
+{
+	if (!window.EventSource)
+	{
+		return false;
+	}
+	
+	eventSource = new EventSource('/events');
+	
+	eventSource.addEventListener('sensor', function(e) {
+		showDHTSensorValues(JSON.parse(e.data));
+	});
+	eventSource.addEventListener('time', function(e) {
+		$("#local_time").text(JSON.parse(e.data)["time"]);
+	});
+	eventSource.addEventListener('status', function(e) {
+		handleWifiConnectStatus(JSON.parse(e.data)["wifi_connect_status"]);
+	});
+	
+	// EventSource reconnects by itself after network errors; it only
+	// closes for good when the server refuses the stream (e.g. all slots taken)
+	eventSource.onerror = function() {
+		if (eventSource.readyState == EventSource.CLOSED)
+		{
+			eventSource = null;
+			startPolling();
+			if (wifiConnectPending)
+			{
+				startWifiConnectStatusInterval();
+			}
+		}
+	};
+	
+	return true;
+}
+
+/**
+ * Polls sensor values and local time (fallback without /events).
+ */
+function startPolling()
+{
+	startDHTSensorInterval();  // This calls getDHTSensorValues() immediately
+	startLocalTimeInterval();  // This calls getLocalTime() immediately
+}
+
+/**
+ * Displays DHT22 sensor temperature and humidity values.
+ */
+function showDHTSensorValues(data)
+{
+	$("#temperature_reading").text(data["temp"]);
+	$("#humidity_reading").text(data["humidity"]);
+}
+
 /**
  * Gets DHT22 sensor temperature and humidity values for display on the web page.
  */
 function getDHTSensorValues()
 {
-	$.getJSON('/dhtSensor.json', function(data) {
-		$("#temperature_reading").text(data["temp"]);
-		$("#humidity_reading").text(data["humidity"]);
-	});
+	$.getJSON('/dhtSensor.json', showDHTSensorValues);
 }
 
 /**
@@ -203,19 +272,7 @@ function getWifiConnectStatus()
 		data: 'wifi_connect_status',
 		dataType: 'json',
 		success: function(response) {
-			document.getElementById("wifi_connect_status").innerHTML = "Connecting...";
-			
-			if (response.wifi_connect_status == 2)
-			{
-				document.getElementById("wifi_connect_status").innerHTML = "<h4 class='rd'>Failed to Connect. Please check your AP credentials and compatibility</h4>";
-				stopWifiConnectStatusInterval();
-			}
-			else if (response.wifi_connect_status == 3)
-			{
-				document.getElementById("wifi_connect_status").innerHTML = "<h4 class='gr'>Connection Success!</h4>";
-				stopWifiConnectStatusInterval();
-				getConnectInfo();
-			}
+			handleWifiConnectStatus(response.wifi_connect_status);
 		},
 		error: function() {
 			// Silently fail - connection status check will retry on next interval
@@ -223,6 +280,33 @@ function getWifiConnectStatus()
 	});
 }
 
+/**
+ * Shows the progress of a connection attempt started from this page.
+ */
+function handleWifiConnectStatus(status)
+{
+	if (!wifiConnectPending)
+	{
+		return;
+	}
+	
+	document.getElementById("wifi_connect_status").innerHTML = "Connecting...";
+	
+	if (status == 2)
+	{
+		document.getElementById("wifi_connect_status").innerHTML = "<h4 class='rd'>Failed to Connect. Please check your AP credentials and compatibility</h4>";
+		wifiConnectPending = false;
+		stopWifiConnectStatusInterval();
+	}
+	else if (status == 3)
+	{
+		document.getElementById("wifi_connect_status").innerHTML = "<h4 class='gr'>Connection Success!</h4>";
+		wifiConnectPending = false;
+		stopWifiConnectStatusInterval();
+		getConnectInfo();
+	}
+}
+
 /**
  * Starts the interval for checking the connection status.
  */
@@ -249,7 +333,13 @@ function connectWifi()
 		data: {'timestamp': Date.now()}
 	});
 	
-	startWifiConnectStatusInterval();
+	// Status changes arrive over /events; poll only without a stream
+	wifiConnectPending = true;
+	document.getElementById("wifi_connect_status").innerHTML = "Connecting...";
+	if (eventSource == null)
+	{
+		startWifiConnectStatusInterval();
+	}
 }
 
 /**
@@ -306,22 +396,27 @@ function showPassword()
  */
 function getConnectInfo()
 {
-	$.getJSON('/wifiConnectInfo.json', function(data)
-	{
-		$("#connected_ap_label").html("Connected to: ");
-		$("#connected_ap").text(data["ap"]);
-		
-		$("#ip_address_label").html("IP Address: ");
-		$("#wifi_connect_ip").text(data["ip"]);
-		
-		$("#netmask_label").html("Netmask: ");
-		$("#wifi_connect_netmask").text(data["netmask"]);
-		
-		$("#gateway_label").html("Gateway: ");
-		$("#wifi_connect_gw").text(data["gw"]);
-		
-		document.getElementById('disconnect_wifi').style.display = 'block';
-	});
+	$.getJSON('/wifiConnectInfo.json', showConnectInfo);
+}
+
+/**
+ * Shows the connection information.
+ */
+function showConnectInfo(data)
+{
+	$("#connected_ap_label").html("Connected to: ");
+	$("#connected_ap").text(data["ap"]);
+	
+	$("#ip_address_label").html("IP Address: ");
+	$("#wifi_connect_ip").text(data["ip"]);
+	
+	$("#netmask_label").html("Netmask: ");
+	$("#wifi_connect_netmask").text(data["netmask"]);
+	
+	$("#gateway_label").html("Gateway: ");
+	$("#wifi_connect_gw").text(data["gw"]);
+	
+	document.getElementById('disconnect_wifi').style.display = 'block';
 }
 
 /**